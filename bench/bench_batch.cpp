@@ -0,0 +1,77 @@
+/* Batch execution benchmark: the same requests performed one after the other
+ * by CppHTTPClient versus CppHTTPAsyncClient::ExecuteBatch() with bounded
+ * parallelism.
+ *
+ * Usage: bench_batch url [requests] [max parallel requests] */
+
+#include "httpasyncclient.h"
+
+#define PRINT_LOG [](const std::string &strLogMsg) { std::cerr << strLogMsg << std::endl; }
+
+using namespace std;
+
+namespace
+{
+void Print(const char *pszName, const chrono::steady_clock::time_point &tpStart,
+           const size_t usRequests, const size_t usSucceeded)
+{
+   double dSeconds = chrono::duration<double>(chrono::steady_clock::now() - tpStart).count();
+   printf("%-28s %8zu requests %8zu succeeded %8.3f s %10.0f /s\n",
+          pszName, usRequests, usSucceeded, dSeconds, usRequests / dSeconds);
+}
+
+void Sequential(const string &strUrl, const size_t usRequests)
+{
+   CppHTTPClient oClient(PRINT_LOG);
+   oClient.InitSession(false, CppHTTPClient::NO_FLAGS);
+   CppHTTPClient::HeadersMap mapHeaders;
+   CppHTTPClient::HttpResponse oResponse;
+   size_t usSucceeded = 0;
+   auto tpStart = chrono::steady_clock::now();
+
+   for (size_t i = 0; i < usRequests; ++i)
+   {
+      if (oClient.Get(strUrl, mapHeaders, oResponse))
+         ++usSucceeded;
+   }
+
+   Print("sequential", tpStart, usRequests, usSucceeded);
+   oClient.CleanupSession();
+}
+
+void Batch(const string &strUrl, const size_t usRequests, const size_t usMaxParallel)
+{
+   CppHTTPAsyncClient oClient(PRINT_LOG);
+   oClient.InitSession(false, CppHTTPClient::NO_FLAGS);
+   vector<CppHTTPAsyncClient::Request> vecRequests(usRequests);
+   for (size_t i = 0; i < usRequests; ++i)
+   {
+      vecRequests[i].strUrl = strUrl;
+      vecRequests[i].ullTag = i;
+   }
+   vector<CppHTTPAsyncClient::Completion> vecResults;
+   auto tpStart = chrono::steady_clock::now();
+
+   size_t usSucceeded = oClient.ExecuteBatch(vecRequests, vecResults, usMaxParallel);
+
+   char szName[64];
+   snprintf(szName, sizeof(szName), "batch (%zu parallel)", usMaxParallel);
+   Print(szName, tpStart, usRequests, usSucceeded);
+   oClient.CleanupSession();
+}
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+   if (argc < 2)
+   {
+      cerr << "Usage: " << argv[0] << " url [requests] [max parallel requests]" << endl;
+      return 1;
+   }
+   size_t usRequests = (argc > 2) ? stoul(argv[2]) : 200;
+   size_t usMaxParallel = (argc > 3) ? stoul(argv[3]) : 32;
+
+   Sequential(argv[1], usRequests);
+   Batch(argv[1], usRequests, usMaxParallel);
+   return 0;
+}
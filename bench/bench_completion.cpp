@@ -0,0 +1,247 @@
+/* Completion delivery benchmark: one consumer thread woken up per completion
+ * (mutex + condition variable queue) versus batches published once per loop
+ * iteration through CppHTTPCompletionQueue.
+ *
+ * Usage: bench_completion [completions] [completions per loop iteration] [url [requests]]
+ * With an URL, the same comparison is run on real requests performed by CppHTTPAsyncClient. */
+
+#include "httpcompletionqueue.h"
+
+#include <sys/resource.h>
+#include <condition_variable>
+#include <thread>
+
+#define PRINT_LOG [](const std::string &strLogMsg) { std::cerr << strLogMsg << std::endl; }
+
+using namespace std;
+
+namespace
+{
+struct Measure
+{
+   chrono::steady_clock::time_point tpStart;
+   long lVoluntary;
+   long lInvoluntary;
+
+   void Start()
+   {
+      struct rusage oUsage;
+      getrusage(RUSAGE_SELF, &oUsage);
+      lVoluntary = oUsage.ru_nvcsw;
+      lInvoluntary = oUsage.ru_nivcsw;
+      tpStart = chrono::steady_clock::now();
+   }
+
+   void Print(const char *pszName, const unsigned long long ullCompletions, const unsigned long long ullWakeups)
+   {
+      double dSeconds = chrono::duration<double>(chrono::steady_clock::now() - tpStart).count();
+      struct rusage oUsage;
+      getrusage(RUSAGE_SELF, &oUsage);
+      printf("%-28s %10llu completions %8.3f s %12.0f /s %10llu wakeups %10ld ctx-switches (%ld voluntary)\n",
+             pszName, ullCompletions, dSeconds, ullCompletions / dSeconds, ullWakeups,
+             (oUsage.ru_nvcsw - lVoluntary) + (oUsage.ru_nivcsw - lInvoluntary), oUsage.ru_nvcsw - lVoluntary);
+   }
+};
+
+// consumer woken up for every completion
+class PerCompletionQueue
+{
+public:
+   PerCompletionQueue() : m_bClosed(false), m_ullWakeups(0) {}
+
+   void Push(CppHTTPAsyncClient::Completion &&oCompletion)
+   {
+      lock_guard<mutex> oLock(m_mtx);
+      m_dqCompletions.push_back(move(oCompletion));
+      m_cv.notify_one();
+   }
+
+   bool Pop(CppHTTPAsyncClient::Completion &oCompletion)
+   {
+      unique_lock<mutex> oLock(m_mtx);
+      if (m_dqCompletions.empty() && !m_bClosed)
+      {
+         m_cv.wait(oLock, [&]() { return !m_dqCompletions.empty() || m_bClosed; });
+         ++m_ullWakeups;
+      }
+      if (m_dqCompletions.empty())
+         return false;
+      oCompletion = move(m_dqCompletions.front());
+      m_dqCompletions.pop_front();
+      return true;
+   }
+
+   void Close()
+   {
+      lock_guard<mutex> oLock(m_mtx);
+      m_bClosed = true;
+      m_cv.notify_one();
+   }
+
+   unsigned long long GetWakeupCount() const { return m_ullWakeups; }
+
+private:
+   mutex m_mtx;
+   condition_variable m_cv;
+   deque<CppHTTPAsyncClient::Completion> m_dqCompletions;
+   bool m_bClosed;
+   unsigned long long m_ullWakeups;
+};
+
+CppHTTPAsyncClient::Completion MakeCompletion(const unsigned long long ullTag)
+{
+   CppHTTPAsyncClient::Completion oCompletion;
+   oCompletion.oRequest.ullTag = ullTag;
+   oCompletion.bSuccess = true;
+   oCompletion.oResponse.iCode = 200;
+   oCompletion.oResponse.strBody = "{\"DATA\":\"DATA\"}";
+   return oCompletion;
+}
+
+void SimulatedPerCompletion(const unsigned long long ullCompletions, const unsigned long long ullPerIteration)
+{
+   PerCompletionQueue oQueue;
+   unsigned long long ullConsumed = 0;
+   Measure oMeasure;
+   oMeasure.Start();
+
+   thread Consumer([&]() {
+      CppHTTPAsyncClient::Completion oCompletion;
+      while (oQueue.Pop(oCompletion))
+         ++ullConsumed;
+   });
+   for (unsigned long long i = 0; i < ullCompletions; ++i)
+   {
+      oQueue.Push(MakeCompletion(i));
+      if ((i + 1) % ullPerIteration == 0)
+         this_thread::yield(); // end of a loop iteration
+   }
+   oQueue.Close();
+   Consumer.join();
+
+   oMeasure.Print("simulated per-completion", ullConsumed, oQueue.GetWakeupCount());
+}
+
+void SimulatedBatched(const unsigned long long ullCompletions, const unsigned long long ullPerIteration)
+{
+   CppHTTPCompletionQueue oQueue(1024);
+   unsigned long long ullConsumed = 0;
+   Measure oMeasure;
+   oMeasure.Start();
+
+   thread Consumer([&]() {
+      CppHTTPCompletionQueue::Batch vecCompletions;
+      while (oQueue.Drain(vecCompletions, -1) > 0 || !oQueue.IsClosed())
+      {
+         ullConsumed += vecCompletions.size();
+         vecCompletions.clear();
+      }
+      ullConsumed += oQueue.Drain(vecCompletions, 0);
+   });
+   CppHTTPCompletionQueue::Batch vecBatch;
+   for (unsigned long long i = 0; i < ullCompletions; ++i)
+   {
+      vecBatch.push_back(MakeCompletion(i));
+      if ((i + 1) % ullPerIteration == 0 || i + 1 == ullCompletions)
+      {
+         while (!oQueue.Push(vecBatch))
+            this_thread::yield();
+         this_thread::yield(); // end of a loop iteration
+      }
+   }
+   oQueue.Close();
+   Consumer.join();
+
+   oMeasure.Print("simulated batched", ullConsumed, oQueue.GetWakeupCount());
+}
+
+void RealPerCompletion(const string &strUrl, const unsigned long long ullRequests)
+{
+   CppHTTPAsyncClient oClient(PRINT_LOG);
+   oClient.InitSession(false, CppHTTPClient::NO_FLAGS);
+   PerCompletionQueue oQueue;
+   unsigned long long ullConsumed = 0;
+   Measure oMeasure;
+   oMeasure.Start();
+
+   thread Consumer([&]() {
+      CppHTTPAsyncClient::Completion oCompletion;
+      while (oQueue.Pop(oCompletion))
+         ++ullConsumed;
+   });
+   for (unsigned long long i = 0; i < ullRequests; ++i)
+   {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.strUrl = strUrl;
+      oRequest.ullTag = i;
+      oClient.Submit(oRequest, [&oQueue, oRequest](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+         CppHTTPAsyncClient::Completion oCompletion;
+         oCompletion.oRequest = oRequest;
+         oCompletion.bSuccess = bSuccess;
+         oCompletion.oResponse = move(Response);
+         oQueue.Push(move(oCompletion));
+      });
+   }
+   while (oClient.Poll(100) > 0)
+   {
+   }
+   oQueue.Close();
+   Consumer.join();
+   oClient.CleanupSession();
+
+   oMeasure.Print("http per-completion", ullConsumed, oQueue.GetWakeupCount());
+}
+
+void RealBatched(const string &strUrl, const unsigned long long ullRequests)
+{
+   CppHTTPAsyncClient oClient(PRINT_LOG);
+   oClient.InitSession(false, CppHTTPClient::NO_FLAGS);
+   auto pQueue = make_shared<CppHTTPCompletionQueue>(1024);
+   oClient.SetCompletionQueue(pQueue, 256, 0);
+   unsigned long long ullConsumed = 0;
+   Measure oMeasure;
+   oMeasure.Start();
+
+   thread Consumer([&]() {
+      CppHTTPCompletionQueue::Batch vecCompletions;
+      while (pQueue->Drain(vecCompletions, -1) > 0 || !pQueue->IsClosed())
+      {
+         ullConsumed += vecCompletions.size();
+         vecCompletions.clear();
+      }
+      ullConsumed += pQueue->Drain(vecCompletions, 0);
+   });
+   for (unsigned long long i = 0; i < ullRequests; ++i)
+   {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.strUrl = strUrl;
+      oRequest.ullTag = i;
+      oClient.Submit(oRequest, nullptr);
+   }
+   while (oClient.Poll(100) > 0)
+   {
+   }
+   oClient.CleanupSession();
+   pQueue->Close();
+   Consumer.join();
+
+   oMeasure.Print("http batched", ullConsumed, pQueue->GetWakeupCount());
+}
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+   unsigned long long ullCompletions = (argc > 1) ? stoull(argv[1]) : 1000000;
+   unsigned long long ullPerIteration = (argc > 2) ? max(stoull(argv[2]), 1ULL) : 32;
+
+   SimulatedPerCompletion(ullCompletions, ullPerIteration);
+   SimulatedBatched(ullCompletions, ullPerIteration);
+
+   if (argc > 3)
+   {
+      unsigned long long ullRequests = (argc > 4) ? stoull(argv[4]) : 1000;
+      RealPerCompletion(argv[3], ullRequests);
+      RealBatched(argv[3], ullRequests);
+   }
+   return 0;
+}
@@ -0,0 +1,115 @@
+/* Rate limiter contention benchmark: threads taking tokens of the same bucket,
+ * then of one bucket each, with CppHTTPRateLimiter (one compare-and-swap per
+ * token) versus the same token bucket behind a mutex.
+ *
+ * Usage: bench_ratelimit [threads] [calls per thread] [rate per second] */
+
+#include "httpratelimiter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+// the classic refill-on-access token bucket, one lock per call
+class MutexBucket
+{
+public:
+   MutexBucket(const double dRate, const double dBurst)
+       : m_dRate(dRate), m_dBurst(dBurst), m_dTokens(dBurst), m_tpLast(chrono::steady_clock::now()) {}
+
+   bool TryAcquire()
+   {
+      lock_guard<mutex> oLock(m_mtx);
+      auto tpNow = chrono::steady_clock::now();
+      m_dTokens = min(m_dBurst, m_dTokens + chrono::duration<double>(tpNow - m_tpLast).count() * m_dRate);
+      m_tpLast = tpNow;
+      if (m_dTokens < 1.)
+         return false;
+      m_dTokens -= 1.;
+      return true;
+   }
+
+private:
+   mutex m_mtx;
+   const double m_dRate;
+   const double m_dBurst;
+   double m_dTokens;
+   chrono::steady_clock::time_point m_tpLast;
+};
+
+template <typename Fn>
+void Run(const char *pszName, const size_t usThreads, const size_t usCalls, Fn fnAcquire)
+{
+   atomic<unsigned long long> ullAdmitted(0);
+   vector<thread> vecThreads;
+   auto tpStart = chrono::steady_clock::now();
+
+   for (size_t i = 0; i < usThreads; ++i)
+      vecThreads.emplace_back([&, i]() {
+         unsigned long long ullLocal = 0;
+         for (size_t j = 0; j < usCalls; ++j)
+            if (fnAcquire(i))
+               ++ullLocal;
+         ullAdmitted += ullLocal;
+      });
+   for (auto &oThread : vecThreads)
+      oThread.join();
+
+   double dSeconds = chrono::duration<double>(chrono::steady_clock::now() - tpStart).count();
+   double dCalls = static_cast<double>(usThreads * usCalls);
+   printf("%-28s %4zu threads %10.0f calls %10llu admitted %8.3f s %8.1f ns/call\n",
+          pszName, usThreads, dCalls, ullAdmitted.load(), dSeconds, dSeconds * 1e9 / dCalls * usThreads);
+}
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+   size_t usThreads = (argc > 1) ? stoul(argv[1]) : 64;
+   size_t usCalls = (argc > 2) ? stoul(argv[2]) : 200000;
+   double dRate = (argc > 3) ? stod(argv[3]) : 1e6;
+   if (usThreads == 0 || usCalls == 0 || !(dRate > 0.))
+   {
+      cerr << "Usage: " << argv[0] << " [threads] [calls per thread] [rate per second]" << endl;
+      return 1;
+   }
+
+   // the threads share a single bucket
+   {
+      CppHTTPRateLimiter oLimiter;
+      oLimiter.AddRule("http://partner", CppHTTPRateLimiter::Rule(dRate, 100));
+      const string strUrl = "http://partner/v1/orders";
+      Run("shared bucket, atomic", usThreads, usCalls,
+          [&oLimiter, &strUrl](size_t) { return oLimiter.TryAcquire(strUrl); });
+
+      MutexBucket oBucket(dRate, 100.);
+      Run("shared bucket, mutex", usThreads, usCalls, [&oBucket](size_t) { return oBucket.TryAcquire(); });
+   }
+
+   // every thread has its own origin, only the rule lookup is shared
+   {
+      CppHTTPRateLimiter oLimiter;
+      vector<string> vecUrls;
+      vector<unique_ptr<MutexBucket>> vecBuckets;
+      for (size_t i = 0; i < usThreads; ++i)
+      {
+         string strOrigin = "http://partner" + to_string(i);
+         oLimiter.AddRule(strOrigin, CppHTTPRateLimiter::Rule(dRate, 100));
+         vecUrls.push_back(strOrigin + "/v1/orders");
+         vecBuckets.emplace_back(new MutexBucket(dRate, 100.));
+      }
+      Run("bucket per thread, atomic", usThreads, usCalls,
+          [&oLimiter, &vecUrls](size_t i) { return oLimiter.TryAcquire(vecUrls[i]); });
+      Run("bucket per thread, mutex", usThreads, usCalls,
+          [&vecBuckets](size_t i) { return vecBuckets[i]->TryAcquire(); });
+   }
+   return 0;
+}
@@ -0,0 +1,31 @@
+#include "httpasioadapter.h"
+#include <fstream>
+#include <sstream>
+#define PRINT_LOG [](const std::string &strLogMsg) { std::cout << strLogMsg << std::endl; }
+
+using namespace std;
+int main(int argc, char const *argv[])
+{
+    ifstream in("test.file.ip");
+    istreambuf_iterator<char> begin(in);
+    istreambuf_iterator<char> end;
+    string ipPort(begin, end);
+
+    asio::io_context context;
+    CppHTTPAsioAdapter adapter(context, PRINT_LOG);
+    adapter.InitSession();
+
+    // ipPort : http://{{ip}}:{{port}}
+    adapter.async_get(ipPort, CppHTTPClient::HeadersMap(),
+                      [&](asio::error_code ec, CppHTTPClient::HttpResponse response) {
+                          if (ec)
+                              cout << ec.message() << endl;
+                          else
+                              cout << response.iCode << endl
+                                   << response.strBody << endl;
+                          adapter.CleanupSession();
+                      });
+
+    context.run();
+    return 0;
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "httpasyncclient.h"
+
+#include <asio.hpp>
+
+#include <map>
+#include <memory>
+
+/* Drives a CppHTTPAsyncClient from a (standalone) asio::io_context.
+ *
+ * The sockets reported by the client are watched with asio::posix::stream_descriptor
+ * and its timer is an asio::steady_timer, every handler runs on a strand of the
+ * io_context, so the io_context may be run by several threads. No thread is created.
+ *
+ * async_get/async_post follow the asio completion token model, the completion
+ * signature is void(asio::error_code, CppHTTPClient::HttpResponse).
+ *
+ * Example Usage:
+ * @code
+ *    asio::io_context oContext;
+ *    CppHTTPAsioAdapter oAdapter(oContext, PRINT_LOG);
+ *    oAdapter.InitSession();
+ *    oAdapter.async_get("http://httpbin.org/get", CppHTTPClient::HeadersMap(),
+ *                       [](asio::error_code ec, CppHTTPClient::HttpResponse Response) { ... });
+ *    oContext.run();
+ * @endcode
+ */
+class CppHTTPAsioAdapter
+{
+public:
+   // Public definitions
+   typedef CppHTTPAsyncClient::HeadersMap HeadersMap;
+   typedef CppHTTPAsyncClient::HttpResponse HttpResponse;
+   typedef asio::strand<asio::io_context::executor_type> Strand;
+
+   // error reported when the transfer failed, the response code is then -1
+   enum Error
+   {
+      REQUEST_FAILED = 1
+   };
+
+   explicit CppHTTPAsioAdapter(asio::io_context &oContext, CppHTTPAsyncClient::LogFnCallback oLogger)
+       : m_oContext(oContext),
+         m_oStrand(asio::make_strand(oContext)),
+         m_oTimer(oContext),
+         m_oClient(oLogger)
+   {
+      m_oClient.SetSocketCallback([this](curl_socket_t Socket, int iEvents) { OnSocketInterest(Socket, iEvents); });
+      m_oClient.SetTimerCallback([this](long lTimeoutMs) { OnTimerChange(lTimeoutMs); });
+   }
+
+   virtual ~CppHTTPAsioAdapter()
+   {
+      if (m_oClient.GetCurlMultiPointer() != nullptr)
+         CleanupSession();
+   }
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPAsioAdapter(const CppHTTPAsioAdapter &Copy) = delete;
+   CppHTTPAsioAdapter &operator=(const CppHTTPAsioAdapter &Copy) = delete;
+
+   /* the client can be configured (timeouts, SSL...) but must not be driven
+    * by anything else than the adapter */
+   CppHTTPAsyncClient &GetClient() { return m_oClient; }
+   const Strand &GetStrand() const { return m_oStrand; }
+
+   // Session, must be called from the strand or before the io_context runs
+   const bool InitSession(const bool &bHTTPS = false,
+                          const CppHTTPAsyncClient::SettingsFlag &SettingsFlags = CppHTTPClient::ALL_FLAGS)
+   {
+      return m_oClient.InitSession(bHTTPS, SettingsFlags);
+   }
+
+   const bool CleanupSession()
+   {
+      bool bCleaned = m_oClient.CleanupSession();
+      for (auto &Watch : m_mapWatches)
+         Unwatch(*Watch.second);
+      m_mapWatches.clear();
+      m_oTimer.cancel();
+      return bCleaned;
+   }
+
+   // REST requests
+   template <typename CompletionToken>
+   auto async_submit(const CppHTTPAsyncClient::Request &oRequest, CompletionToken &&Token)
+   {
+      return asio::async_initiate<CompletionToken, void(asio::error_code, HttpResponse)>(
+          [this](auto &&Handler, const CppHTTPAsyncClient::Request &oRequest) {
+             typedef typename std::decay<decltype(Handler)>::type HandlerType;
+
+             // std::function needs a copyable callable, asio handlers may be move-only
+             auto pHandler = std::make_shared<HandlerType>(std::forward<decltype(Handler)>(Handler));
+             auto oWork = asio::make_work_guard(asio::get_associated_executor(*pHandler, m_oStrand));
+
+             bool bSubmitted = m_oClient.Submit(oRequest, [pHandler, oWork](const bool bSuccess, HttpResponse &Response) mutable {
+                // already on the strand: runs inline when the handler has no other executor
+                auto oExecutor = asio::get_associated_executor(*pHandler, oWork.get_executor());
+                asio::dispatch(oExecutor, [pHandler, bSuccess, Response = std::move(Response)]() mutable {
+                   (*pHandler)(bSuccess ? asio::error_code() : MakeErrorCode(REQUEST_FAILED), std::move(Response));
+                });
+                oWork.reset();
+             });
+
+             if (!bSubmitted)
+             {
+                HttpResponse Response;
+                Response.iCode = -1;
+                asio::post(m_oStrand, [pHandler, Response]() mutable {
+                   (*pHandler)(asio::error::make_error_code(asio::error::invalid_argument), std::move(Response));
+                });
+             }
+          },
+          Token, oRequest);
+   }
+
+   template <typename CompletionToken>
+   auto async_get(const std::string &strUrl, const HeadersMap &Headers, CompletionToken &&Token)
+   {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.eMethod = CppHTTPAsyncClient::HTTP_GET;
+      oRequest.strUrl = strUrl;
+      oRequest.mapHeaders = Headers;
+
+      return async_submit(oRequest, std::forward<CompletionToken>(Token));
+   }
+
+   template <typename CompletionToken>
+   auto async_post(const std::string &strUrl, const HeadersMap &Headers,
+                   const std::string &strPostData, CompletionToken &&Token)
+   {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.eMethod = CppHTTPAsyncClient::HTTP_POST;
+      oRequest.strUrl = strUrl;
+      oRequest.mapHeaders = Headers;
+      oRequest.strBody = strPostData;
+
+      return async_submit(oRequest, std::forward<CompletionToken>(Token));
+   }
+
+   static asio::error_code MakeErrorCode(const Error eError)
+   {
+      return asio::error_code(static_cast<int>(eError), GetErrorCategory());
+   }
+
+   static const asio::error_category &GetErrorCategory()
+   {
+      static const ErrorCategory s_oCategory;
+      return s_oCategory;
+   }
+
+protected:
+   class ErrorCategory : public asio::error_category
+   {
+   public:
+      const char *name() const noexcept override { return "CppHTTPClient"; }
+      std::string message(int iValue) const override
+      {
+         return (iValue == REQUEST_FAILED) ? "Unable to perform the REST request" : "Unknown error";
+      }
+   };
+
+   // a socket of the client, the descriptor does not own it (cURL closes it)
+   struct SocketWatch
+   {
+      SocketWatch(asio::io_context &oContext, curl_socket_t Socket)
+          : oDescriptor(oContext, Socket), iEvents(CppHTTPAsyncClient::EVENT_NONE),
+            bActive(true), bReadPending(false), bWritePending(false) {}
+      asio::posix::stream_descriptor oDescriptor;
+      int iEvents;
+      bool bActive;
+      bool bReadPending;
+      bool bWritePending;
+   };
+
+   void OnSocketInterest(curl_socket_t Socket, int iEvents)
+   {
+      auto it = m_mapWatches.find(Socket);
+      if (iEvents == CppHTTPAsyncClient::EVENT_NONE)
+      {
+         if (it != m_mapWatches.end())
+         {
+            Unwatch(*it->second);
+            m_mapWatches.erase(it);
+         }
+         return;
+      }
+
+      if (it == m_mapWatches.end())
+         it = m_mapWatches.emplace(Socket, std::make_shared<SocketWatch>(m_oContext, Socket)).first;
+
+      it->second->iEvents = iEvents;
+      Arm(it->second);
+   }
+
+   void Arm(const std::shared_ptr<SocketWatch> &pWatch)
+   {
+      if ((pWatch->iEvents & CppHTTPAsyncClient::EVENT_IN) && !pWatch->bReadPending)
+      {
+         pWatch->bReadPending = true;
+         pWatch->oDescriptor.async_wait(asio::posix::stream_descriptor::wait_read,
+                                        asio::bind_executor(m_oStrand, [this, pWatch](const asio::error_code &ec) {
+                                           pWatch->bReadPending = false;
+                                           OnSocketEvent(pWatch, ec, CppHTTPAsyncClient::EVENT_IN);
+                                        }));
+      }
+      if ((pWatch->iEvents & CppHTTPAsyncClient::EVENT_OUT) && !pWatch->bWritePending)
+      {
+         pWatch->bWritePending = true;
+         pWatch->oDescriptor.async_wait(asio::posix::stream_descriptor::wait_write,
+                                        asio::bind_executor(m_oStrand, [this, pWatch](const asio::error_code &ec) {
+                                           pWatch->bWritePending = false;
+                                           OnSocketEvent(pWatch, ec, CppHTTPAsyncClient::EVENT_OUT);
+                                        }));
+      }
+   }
+
+   void OnSocketEvent(const std::shared_ptr<SocketWatch> &pWatch, const asio::error_code &ec, const int iEvent)
+   {
+      if (!pWatch->bActive || ec == asio::error::operation_aborted)
+         return;
+
+      m_oClient.OnSocketReady(pWatch->oDescriptor.native_handle(),
+                              ec ? (iEvent | CppHTTPAsyncClient::EVENT_ERROR) : iEvent);
+
+      // cURL may have removed the socket meanwhile
+      if (pWatch->bActive)
+         Arm(pWatch);
+   }
+
+   void Unwatch(SocketWatch &oWatch)
+   {
+      oWatch.bActive = false;
+      // aborts the pending waits without closing the socket
+      oWatch.oDescriptor.release();
+   }
+
+   void OnTimerChange(long lTimeoutMs)
+   {
+      m_oTimer.cancel();
+      if (lTimeoutMs < 0)
+         return;
+
+      m_oTimer.expires_after(std::chrono::milliseconds(lTimeoutMs));
+      m_oTimer.async_wait(asio::bind_executor(m_oStrand, [this](const asio::error_code &ec) {
+         if (!ec)
+            m_oClient.OnTimeout();
+      }));
+   }
+
+   asio::io_context &m_oContext;
+   Strand m_oStrand;
+   asio::steady_timer m_oTimer;
+   std::map<curl_socket_t, std::shared_ptr<SocketWatch>> m_mapWatches;
+
+   CppHTTPAsyncClient m_oClient;
+};
@@ -0,0 +1,452 @@
+#pragma once
+
+#include "httpcanceltoken.h"
+#include "httpclient.h"
+#include "httprequestqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+class CppHTTPCompletionQueue;
+class CppHTTPLoadBalancer;
+class CppHTTPConcurrencyLimiter;
+class CppHTTPNegativeCache;
+class CppHTTPRateLimiter;
+
+/* Asynchronous HTTP client built on top of the cURL multi socket interface.
+ *
+ * The client does not own any thread: it is driven by an event loop, either
+ * the caller's own loop (epoll, libevent, ...) through the socket/timer
+ * callbacks and OnSocketReady()/OnTimeout(), or the built-in Poll() driver.
+ * Completions are delivered inline from the thread driving the loop.
+ *
+ * Requests may be submitted from any thread. Every other method must be called
+ * from the thread that drives the loop. */
+class CppHTTPAsyncClient
+{
+public:
+   // Public definitions
+   typedef CppHTTPClient::LogFnCallback LogFnCallback;
+   typedef CppHTTPClient::HeadersMap HeadersMap;
+   typedef CppHTTPClient::HttpResponse HttpResponse;
+   typedef CppHTTPClient::SettingsFlag SettingsFlag;
+   typedef CppHTTPClient::TimeoutPolicy TimeoutPolicy;
+   typedef CppHTTPClient::TimePoint TimePoint;
+   typedef CppHTTPClient::ThrottleStats ThrottleStats;
+   typedef CppHTTPClient::ThrottleFnCallback ThrottleFnCallback;
+
+   enum Method
+   {
+      HTTP_HEAD,
+      HTTP_GET,
+      HTTP_DELETE,
+      HTTP_POST,
+      HTTP_PUT
+   };
+
+   // socket interest, reported to and received from the event loop
+   enum SocketEvent
+   {
+      EVENT_NONE = 0x00, // stop watching the socket
+      EVENT_IN = 0x01,
+      EVENT_OUT = 0x02,
+      EVENT_ERROR = 0x04
+   };
+
+   /* scheduling class of a request, applied while it waits for a connection
+    * slot and as HTTP/2 stream weight once it runs */
+   enum Priority
+   {
+      PRIORITY_HIGH,   // interactive requests
+      PRIORITY_NORMAL,
+      PRIORITY_LOW,    // background and bulk requests
+      PRIORITY_COUNT
+   };
+
+   // behaviour of Submit() when the wait queue is full, see SetQueueLimit()
+   enum OverflowPolicy
+   {
+      OVERFLOW_REJECT,     // Submit() fails
+      OVERFLOW_BLOCK,      // Submit() waits for a free place, fails on the loop thread which frees them
+      OVERFLOW_DROP_OLDEST // the oldest waiting request fails with ERR_QUEUE_FULL
+   };
+
+   // HTTP request data
+   struct Request
+   {
+      Request() : eMethod(HTTP_GET), ullTag(0), ePriority(PRIORITY_NORMAL) {}
+      Method eMethod;
+      std::string strUrl;       // URL to request
+      HeadersMap mapHeaders;    // HTTP request headers fields
+      std::string strBody;      // payload of POST and PUT requests
+      unsigned long long ullTag; // opaque value, returned with the Completion
+      Priority ePriority;
+      std::string strTenant;    // fair queuing group, see SetTenantWeight()
+      std::shared_ptr<CppHTTPCancelToken> pCancelToken; // optional, aborts the request from any thread
+      TimeoutPolicy oTimeouts;  // 0 fields use the client's limits, see SetTimeouts()
+      TimePoint tpDeadline;     // the request fails once reached, queueing included (TimePoint(): none)
+   };
+
+   // per tenant statistics
+   struct TenantStats
+   {
+      TenantStats() : usInFlight(0), ullCompleted(0), ullFailed(0), ullBytesReceived(0),
+                      ullTotalLatencyUs(0), ullMaxLatencyUs(0) {}
+      CppHTTPQueueStats oQueue;             // waiting for a connection slot
+      size_t usInFlight;                    // running transfers
+      unsigned long long ullCompleted;      // completed requests, failures included
+      unsigned long long ullFailed;         // transfers that failed
+      unsigned long long ullBytesReceived;  // response bodies
+      unsigned long long ullTotalLatencyUs; // sum of submission to completion latencies, in microseconds
+      unsigned long long ullMaxLatencyUs;   // highest submission to completion latency, in microseconds
+   };
+
+   // admission control statistics
+   struct AdmissionStats
+   {
+      AdmissionStats() : usInFlight(0), ullAccepted(0), ullRejected(0), ullDropped(0), ullBlocked(0),
+                         ullBlockedUs(0) {}
+      CppHTTPQueueStats oQueue;         // wait queue, all priority classes
+      size_t usInFlight;                // running transfers
+      unsigned long long ullAccepted;   // submitted requests
+      unsigned long long ullRejected;   // requests refused by Submit() or TrySubmit()
+      unsigned long long ullDropped;    // waiting requests dropped for newer ones
+      unsigned long long ullBlocked;    // Submit() calls that waited for a free place
+      unsigned long long ullBlockedUs;  // time spent waiting in Submit(), in microseconds
+   };
+
+   // finished request, delivered through a CppHTTPCompletionQueue
+   struct Completion
+   {
+      Completion() : bSuccess(false) {}
+      Request oRequest;
+      bool bSuccess;
+      HttpResponse oResponse;
+   };
+
+   // completion policy of a FanOut()
+   enum FanOutMode
+   {
+      FANOUT_ALL,   // every endpoint answers, or FanOutPolicy::tpDeadline is reached (partial results)
+      FANOUT_QUORUM // FanOutPolicy::usQuorum endpoints answered, the stragglers are cancelled
+   };
+
+   struct FanOutPolicy
+   {
+      FanOutPolicy() : eMode(FANOUT_ALL), usQuorum(0) {}
+      FanOutMode eMode;
+      size_t usQuorum;      // answers needed by FANOUT_QUORUM
+      TimePoint tpDeadline; // the requests still running fail once reached (TimePoint(): none)
+   };
+
+   // answer of one endpoint of a FanOut()
+   struct FanOutResult
+   {
+      FanOutResult() : bSuccess(false), ullLatencyUs(0) {}
+      std::string strUrl;
+      bool bSuccess;
+      HttpResponse oResponse;          // eError is ERR_CANCELLED for the stragglers
+      unsigned long long ullLatencyUs; // submission to completion, in microseconds
+   };
+
+   /* called once per request from the loop thread,
+    * bSuccess is false when the transfer failed (Response.iCode is then -1 and
+    * Response.eError tells why, ERR_CANCELLED for a cancelled request) */
+   typedef std::function<void(const bool, HttpResponse &)> CompletionFnCallback;
+   // socket interest changed, iEvents is a combination of SocketEvent flags
+   typedef std::function<void(curl_socket_t, int)> SocketFnCallback;
+   // OnTimeout() must be called in lTimeoutMs milliseconds (-1 cancels the timer)
+   typedef std::function<void(long)> TimerFnCallback;
+   // task run on the loop thread by ScheduleTimer()
+   typedef std::function<void()> TaskFnCallback;
+
+   explicit CppHTTPAsyncClient(LogFnCallback oLogger);
+   virtual ~CppHTTPAsyncClient();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPAsyncClient(const CppHTTPAsyncClient &Copy) = delete;
+   CppHTTPAsyncClient &operator=(const CppHTTPAsyncClient &Copy) = delete;
+
+   // Setters - Getters
+   inline void SetTimeout(const int &iTimeout) { m_iCurlTimeout = iTimeout; }
+   inline void SetHTTPS(const bool &bEnableHTTPS) { m_bHTTPS = bEnableHTTPS; }
+   inline const int GetTimeout() const { return m_iCurlTimeout; }
+   // default limits of the requests, TimeoutPolicy::lTotalMs overrides SetTimeout()
+   inline void SetTimeouts(const TimeoutPolicy &oTimeouts) { m_oTimeouts = oTimeouts; }
+   inline const TimeoutPolicy &GetTimeouts() const { return m_oTimeouts; }
+   inline const bool GetHTTPS() const { return m_bHTTPS; }
+   inline const unsigned char GetSettingsFlags() const { return m_eSettingsFlags; }
+
+   /* external event loop integration, the callbacks must be set before
+    * InitSession() and are only called from the loop thread */
+   inline void SetSocketCallback(SocketFnCallback oSocket) { m_oSocket = oSocket; }
+   inline void SetTimerCallback(TimerFnCallback oTimer) { m_oTimer = oTimer; }
+
+   // Session
+   const bool InitSession(const bool &bHTTPS = false,
+                          const SettingsFlag &SettingsFlags = CppHTTPClient::ALL_FLAGS);
+   const bool CleanupSession();
+   // refuses new requests, lets the pending ones complete until tpDeadline then cleans the session
+   const bool Drain(const TimePoint &tpDeadline);
+
+   /* requests submitted without completion callback are delivered in batches
+    * through pQueue: a batch is published when it holds usMaxBatch completions,
+    * or at the end of the loop iteration once its oldest completion waited iMaxDelayMs */
+   void SetCompletionQueue(std::shared_ptr<CppHTTPCompletionQueue> pQueue,
+                           const size_t usMaxBatch = 64, const int iMaxDelayMs = 0);
+
+   /* connection slots: at most usMaxInFlight running transfers, usMaxHostInFlight
+    * per origin (0: unlimited), the other requests wait by priority. A waiting request
+    * is promoted by one class every iAgingMs milliseconds so that low priorities
+    * can't starve. */
+   inline void SetMaxInFlight(const size_t usMaxInFlight) { m_usMaxInFlight = usMaxInFlight; }
+   inline void SetMaxHostInFlight(const size_t usMaxHostInFlight) { m_usMaxHostInFlight = usMaxHostInFlight; }
+   inline void SetPriorityAgingMs(const int iAgingMs) { m_oQueue.SetAgingMs(iAgingMs); }
+   inline const size_t GetMaxInFlight() const { return m_usMaxInFlight; }
+   inline const size_t GetMaxHostInFlight() const { return m_usMaxHostInFlight; }
+   inline const int GetPriorityAgingMs() const { return m_oQueue.GetAgingMs(); }
+
+   /* wait queue bound: at most usMaxQueued requests wait for a connection slot
+    * (0: unlimited), ePolicy tells what Submit() does beyond. TrySubmit() always fails
+    * at once on a full queue. */
+   void SetQueueLimit(const size_t usMaxQueued, const OverflowPolicy ePolicy = OVERFLOW_REJECT);
+   const size_t GetMaxQueued() const;
+   const OverflowPolicy GetOverflowPolicy() const;
+
+   /* tenants sharing the connection slots are served by deficit round robin,
+    * a tenant of weight N gets N times the slots of a tenant of weight 1 */
+   inline void SetTenantWeight(const std::string &strTenant, const unsigned uWeight) { m_oQueue.SetWeight(strTenant, uWeight); }
+   inline const unsigned GetTenantWeight(const std::string &strTenant) const { return m_oQueue.GetWeight(strTenant); }
+
+   /* "lb://<service>/..." URLs are sent to an endpoint of the service, see CppHTTPLoadBalancer.
+    * Submitting a request of an unknown service fails. Set before submitting requests. */
+   inline void SetLoadBalancer(std::shared_ptr<CppHTTPLoadBalancer> pBalancer) { m_pLoadBalancer = pBalancer; }
+   inline const std::shared_ptr<CppHTTPLoadBalancer> &GetLoadBalancer() const { return m_pLoadBalancer; }
+
+   /* adaptive limit of the requests in flight per origin, on top of SetMaxHostInFlight():
+    * the requests beyond it wait in the queue, or are refused once too many wait.
+    * Set before submitting requests. */
+   inline void SetConcurrencyLimiter(std::shared_ptr<CppHTTPConcurrencyLimiter> pLimiter) { m_pConcurrencyLimiter = pLimiter; }
+   inline const std::shared_ptr<CppHTTPConcurrencyLimiter> &GetConcurrencyLimiter() const { return m_pConcurrencyLimiter; }
+
+   /* token bucket rate limits per origin or URL prefix: a request reserves its token
+    * when submitted and waits in the queue until then, or is refused beyond the
+    * longest delay of its rule. Set before submitting requests. */
+   inline void SetRateLimiter(std::shared_ptr<CppHTTPRateLimiter> pLimiter) { m_pRateLimiter = pLimiter; }
+   inline const std::shared_ptr<CppHTTPRateLimiter> &GetRateLimiter() const { return m_pRateLimiter; }
+
+   /* requests to an origin known unreachable fail when dispatched, with the cached error.
+    * Set before submitting requests. */
+   inline void SetNegativeCache(std::shared_ptr<CppHTTPNegativeCache> pCache) { m_pNegativeCache = pCache; }
+   inline const std::shared_ptr<CppHTTPNegativeCache> &GetNegativeCache() const { return m_pNegativeCache; }
+
+   /* an origin answering 429 or 503 with Retry-After is paused: its queued requests wait
+    * for the end of the pause, capped by lMaxRetryAfterMs (60 s by default, 0 ignores Retry-After).
+    * The callback is called from the loop thread. */
+   inline void SetMaxRetryAfter(const long lMaxRetryAfterMs) { m_lMaxRetryAfterMs = std::max(lMaxRetryAfterMs, 0L); }
+   inline const long GetMaxRetryAfter() const { return m_lMaxRetryAfterMs; }
+   inline void SetThrottleFnCallback(ThrottleFnCallback oThrottle) { m_oThrottle = oThrottle; }
+   const ThrottleStats GetThrottleStats(const std::string &strHost) const;
+
+   const CURLM *GetCurlMultiPointer() const { return m_pCurlMulti; }
+   const size_t GetPendingCount() const;
+   // queueing latency and depth of a priority class
+   inline const CppHTTPQueueStats GetQueueStats(const Priority ePriority) const { return m_oQueue.GetStats(ePriority); }
+   const TenantStats GetTenantStats(const std::string &strTenant) const;
+   const AdmissionStats GetAdmissionStats() const;
+
+   // REST requests
+   const bool Submit(const Request &oRequest, CompletionFnCallback oCompletion);
+   const bool TrySubmit(const Request &oRequest, CompletionFnCallback oCompletion);
+   const bool Head(const std::string &strUrl, const HeadersMap &Headers, CompletionFnCallback oCompletion);
+   const bool Get(const std::string &strUrl, const HeadersMap &Headers, CompletionFnCallback oCompletion);
+   const bool Del(const std::string &strUrl, const HeadersMap &Headers, CompletionFnCallback oCompletion);
+   const bool Post(const std::string &strUrl, const HeadersMap &Headers,
+                   const std::string &strPostData, CompletionFnCallback oCompletion);
+   const bool Put(const std::string &strUrl, const HeadersMap &Headers,
+                  const std::string &strPutData, CompletionFnCallback oCompletion);
+
+   // performs independent requests concurrently and waits for all of them (loop thread)
+   const size_t ExecuteBatch(const std::vector<Request> &vecRequests, std::vector<Completion> &vecResults,
+                             const size_t usMaxParallel = 0, const TimePoint &tpDeadline = TimePoint());
+   // sends oTemplate to every endpoint and waits for the answers oPolicy needs (loop thread)
+   const size_t FanOut(const Request &oTemplate, const std::vector<std::string> &vecEndpoints,
+                       std::vector<FanOutResult> &vecResults, const FanOutPolicy &oPolicy = FanOutPolicy());
+
+   // Event loop
+   void OnSocketReady(const curl_socket_t Socket, const int iEvents);
+   void OnTimeout();
+   const int Poll(const int iTimeoutMs);
+
+   // Timers (loop thread), oTask runs from OnTimeout() once iDelayMs elapsed
+   const unsigned long long ScheduleTimer(const int iDelayMs, TaskFnCallback oTask);
+   const bool CancelTimer(const unsigned long long ullTimerId);
+
+   // SSL certs
+   void SetSSLCertFile(const std::string &strPath) { m_strSSLCertFile = strPath; }
+   const std::string &GetSSLCertFile() const { return m_strSSLCertFile; }
+
+   void SetSSLKeyFile(const std::string &strPath) { m_strSSLKeyFile = strPath; }
+   const std::string &GetSSLKeyFile() const { return m_strSSLKeyFile; }
+
+   void SetSSLKeyPassword(const std::string &strPwd) { m_strSSLKeyPwd = strPwd; }
+   const std::string &GetSSLKeyPwd() const { return m_strSSLKeyPwd; }
+
+protected:
+   // place of a request in the concurrency limiter
+   enum LimiterSlot
+   {
+      LIMITER_NONE,
+      LIMITER_WAITING,
+      LIMITER_RUNNING
+   };
+
+   // state of a single request, owned by the client until its completion
+   struct Transfer
+   {
+      Transfer() : pCurl(nullptr), pHeaderlist(nullptr), eLimiterSlot(LIMITER_NONE), bRateReserved(false),
+                   ullCancelSubscription(0), lBudgetMs(0), eTimeoutError(CppHTTPClient::ERR_NONE),
+                   eAbortError(CppHTTPClient::ERR_NONE), bCachedFailure(false), ullWatchdogTimerId(0) {}
+      CURL *pCurl;
+      struct curl_slist *pHeaderlist;
+      Request oRequest;
+      std::string strURL;  // URL with its protocol scheme
+      std::string strHostKey;
+      std::string strEndpoint; // picked by the load balancer, released by the completion
+      LimiterSlot eLimiterSlot;
+      TimePoint tpSubmitted;
+      TimePoint tpNotBefore; // token of the rate limiter, TimePoint() for none
+      std::string strRateUrl; // URL matched by the rules of the rate limiter
+      bool bRateReserved;     // token to give back if the request isn't sent
+      unsigned long long ullCancelSubscription;
+      TimeoutPolicy oTimeouts;   // merged with the client's limits
+      long lBudgetMs;            // total limit once dispatched, deadline included
+      TimePoint tpStarted;
+      CppHTTPClient::ErrorCode eTimeoutError;
+      CppHTTPClient::ErrorCode eAbortError; // reason of an abort decided by the client
+      bool bCachedFailure;                  // failed from the negative cache, not sent
+      unsigned long long ullWatchdogTimerId; // phase limits check
+      CppHTTPClient::UploadObject oPayload;
+      HttpResponse oResponse;
+      CompletionFnCallback oCompletion;
+   };
+
+   /* common operations are performed here */
+   const bool Enqueue(const Request &oRequest, CompletionFnCallback oCompletion, const bool bTry);
+   const bool IsQueueFull() const;
+   Transfer *CreateTransfer(const Request &oRequest, CompletionFnCallback oCompletion);
+   void DestroyTransfer(Transfer *pTransfer);
+   void Dispatch();
+   void ExpireQueued();
+   void CancelRequests();
+   void CompleteDropped();
+   const size_t AbortPending();
+   const bool ArmWatchdog(Transfer *pTransfer);
+   void CheckWatchdog(CURL *pCurl);
+   std::unique_ptr<Transfer> Detach(CURL *pCurl);
+   void SocketAction(const curl_socket_t Socket, const int iCurlEvents);
+   void CheckCompleted();
+   void Complete(std::unique_ptr<Transfer> pTransfer, const CURLcode eResult);
+   void Wakeup();
+   void DrainWakeup();
+   void ArmTimer();
+   void RunTimers();
+   void FlushBatch(const bool bForce);
+
+   // Curl multi callbacks
+   static int SocketCallback(CURL *pCurl, curl_socket_t Socket, int iWhat, void *pUserData, void *pSocketData);
+   static int TimerCallback(CURLM *pMulti, long lTimeoutMs, void *pUserData);
+
+   bool m_bHTTPS;
+   SettingsFlag m_eSettingsFlags;
+   int m_iCurlTimeout;
+   TimeoutPolicy m_oTimeouts;
+
+   // SSL
+   std::string m_strSSLCertFile;
+   std::string m_strSSLKeyFile;
+   std::string m_strSSLKeyPwd;
+
+   CURLM *m_pCurlMulti;
+   std::unordered_map<CURL *, std::unique_ptr<Transfer>> m_mapRunning;
+   std::unordered_map<std::string, size_t> m_mapHostInFlight; // running transfers per origin
+   std::unordered_map<std::string, TenantStats> m_mapTenantStats;
+   std::unordered_map<std::string, TimePoint> m_mapHostPausedUntil; // Retry-After of the origins (loop thread)
+   std::unordered_map<std::string, ThrottleStats> m_mapThrottles;
+   long m_lMaxRetryAfterMs;
+   ThrottleFnCallback m_oThrottle;
+   size_t m_usMaxInFlight;
+   size_t m_usMaxHostInFlight;
+
+   // requests submitted from any thread, waiting for a connection slot
+   CppHTTPRequestQueue<std::unique_ptr<Transfer>> m_oQueue;
+   mutable std::mutex m_mtxSubmitted; // guards m_mapRunning, m_mapTenantStats, m_mapThrottles, m_bDraining, the admission and the wakeup
+   std::condition_variable m_cvQueueSpace; // signaled when queued requests leave, see OVERFLOW_BLOCK
+   size_t m_usMaxQueued;
+   OverflowPolicy m_eOverflowPolicy;
+   AdmissionStats m_oAdmission;
+   std::vector<std::unique_ptr<Transfer>> m_vecDropped; // completed by the loop thread
+   bool m_bWakeupPending;
+   bool m_bCancelPending; // a cancel token of a pending request was triggered
+   bool m_bDraining;      // Submit() refuses the new requests
+   bool m_bDrainExpired;  // the aborted requests fail with ERR_DRAINED
+   std::atomic<std::thread::id> m_idLoopThread; // last thread that drove the loop, never blocked by Submit()
+   TimePoint m_tpNextExpiry; // earliest deadline of the queued requests, TimePoint() for none
+   int m_arrWakeupPipe[2]; // [0] is watched by the event loop, [1] is written by Submit()
+
+   // interest set, kept for Poll()
+   std::unordered_map<curl_socket_t, int> m_mapSockets;
+
+   // cURL timer, timers and the earliest of them as reported to the event loop
+   unsigned long long m_ullDeadlineTimerId; // wakes the loop up at m_tpNextExpiry
+   TimePoint m_tpDeadlineTimer;
+   unsigned long long m_ullPacingTimerId; // wakes the loop up at the next token of a queued request, or the end of a pause
+   TimePoint m_tpPacingTimer;
+   bool m_bCurlTimerArmed;
+   TimePoint m_tpCurlDeadline;
+   std::multimap<TimePoint, std::pair<unsigned long long, TaskFnCallback>> m_mapTimers;
+   unsigned long long m_ullLastTimerId;
+   bool m_bTimerArmed;
+   TimePoint m_tpTimerDeadline;
+
+   std::shared_ptr<CppHTTPLoadBalancer> m_pLoadBalancer;
+   std::shared_ptr<CppHTTPConcurrencyLimiter> m_pConcurrencyLimiter;
+   std::shared_ptr<CppHTTPRateLimiter> m_pRateLimiter;
+   std::shared_ptr<CppHTTPNegativeCache> m_pNegativeCache;
+
+   // batched completion delivery
+   std::shared_ptr<CppHTTPCompletionQueue> m_pCompletionQueue;
+   size_t m_usMaxBatch;
+   int m_iMaxBatchDelayMs;
+   std::vector<Completion> m_vecBatch;
+   TimePoint m_tpBatchStart;
+   unsigned long long m_ullFlushTimerId;
+
+   SocketFnCallback m_oSocket;
+   TimerFnCallback m_oTimer;
+
+   // Log printer callback
+   LogFnCallback m_oLog;
+};
+
+// Logs messages
+#define LOG_ERROR_ASYNC_ALREADY_INIT_MSG "[CppHTTPAsyncClient][Error] Curl multi session is already initialized ! Use CleanupSession() to clean the present one."
+#define LOG_ERROR_ASYNC_NOT_INIT_MSG "[CppHTTPAsyncClient][Error] Curl multi session is not initialized ! Use InitSession() before."
+#define LOG_ERROR_ASYNC_POLL_FAILED_MSG "[CppHTTPAsyncClient][Error] Polling the event loop failed, request abandoned."
+#define LOG_WARNING_ASYNC_OBJECT_NOT_CLEANED "[CppHTTPAsyncClient][Warning] Object was freed before calling CppHTTPAsyncClient::CleanupSession(). The API session was cleaned though."
+#define LOG_WARNING_ASYNC_ABORTED_FORMAT "[CppHTTPAsyncClient][Warning] %u pending request(s) aborted by CleanupSession()."
+#define LOG_WARNING_ASYNC_DRAINED_FORMAT "[CppHTTPAsyncClient][Warning] %u pending request(s) aborted, Drain() reached its deadline."
+#define LOG_ERROR_ASYNC_DRAINING_MSG "[CppHTTPAsyncClient][Error] The session is draining, new requests are refused."
+#define LOG_WARNING_ASYNC_QUEUE_FULL_FORMAT "[CppHTTPAsyncClient][Warning] Wait queue full (%u requests), request to '%s' refused."
+#define LOG_WARNING_ASYNC_SHED_FORMAT "[CppHTTPAsyncClient][Warning] Concurrency limit of the origin reached (%u requests), request to '%s' refused."
+#define LOG_WARNING_ASYNC_THROTTLED_FORMAT "[CppHTTPAsyncClient][Warning] Origin '%s' throttled the REST requests, paused for %ld ms."
+#define LOG_WARNING_ASYNC_RATE_LIMITED_FORMAT "[CppHTTPAsyncClient][Warning] Rate limit reached, request to '%s' refused."
+#define LOG_WARNING_ASYNC_DROPPED_FORMAT "[CppHTTPAsyncClient][Warning] Wait queue full, oldest request to '%s' dropped."
+
+#define LOG_ERROR_ASYNC_NO_ENDPOINT_FORMAT "[CppHTTPAsyncClient][Error] No endpoint to send the REST request to '%s'."
+#define LOG_WARNING_ASYNC_CANCELLED_FORMAT "[CppHTTPAsyncClient][Warning] REST request to '%s' cancelled."
+#define LOG_ERROR_ASYNC_REST_FAILURE_FORMAT "[CppHTTPAsyncClient][Error] Unable to perform a REST request from '%s' (Error = %d | %s)"
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "httpcanceltoken.h"
+#include "httpclient.h"
+
+#include <condition_variable>
+#include <thread>
+
+/* Source of the bearer tokens sent by the clients, see CppHTTPClient::SetAuthProvider().
+ * The implementations are thread-safe, a provider is shared by the clients. */
+class CppHTTPAuthProvider
+{
+public:
+   virtual ~CppHTTPAuthProvider() {}
+
+   /* current token, may wait for the token being fetched.
+    * false when no token could be obtained, the request is then not sent */
+   virtual const bool GetToken(std::string &strToken) = 0;
+   /* the server rejected strToken (401), the next GetToken() returns another one.
+    * The rejections of a token already replaced are ignored. */
+   virtual void Invalidate(const std::string &strToken) = 0;
+};
+
+/* Bearer tokens of an OAuth2 client credentials grant (RFC 6749, section 4.4),
+ * cached and refreshed before they expire.
+ *
+ * Start() fetches the first token, then a worker thread fetches the next one
+ * once dRefreshRatio of the lifetime ("expires_in") of the current token has
+ * elapsed, so that the requests never wait for a token nor get a 401 for an
+ * expired one. A failed refresh is tried again every iRetryMs while the current
+ * token is still valid. GetToken() waits at most iWaitMs when no valid token is
+ * cached, the callers waiting together, and the rejections of the same token,
+ * are served by a single fetch.
+ *
+ * Example Usage:
+ * @code
+ *    CppHTTPOAuth2Provider::Config oConfig;
+ *    oConfig.strTokenUrl = "https://auth.example.com/oauth2/token";
+ *    oConfig.strClientId = "orders";
+ *    oConfig.strClientSecret = strSecret;
+ *    auto pAuth = std::make_shared<CppHTTPOAuth2Provider>(oConfig, PRINT_LOG);
+ *    pAuth->Start(true);
+ *    oClient.SetAuthProvider(pAuth);
+ * @endcode
+ */
+class CppHTTPOAuth2Provider : public CppHTTPAuthProvider
+{
+public:
+   typedef CppHTTPClient::LogFnCallback LogFnCallback;
+   typedef CppHTTPClient::SettingsFlag SettingsFlag;
+   typedef std::chrono::steady_clock::time_point TimePoint;
+
+   struct Config
+   {
+      Config() : dRefreshRatio(0.75), iDefaultLifetimeMs(3600000), iRetryMs(1000), iWaitMs(5000), iTimeoutMs(5000) {}
+      std::string strTokenUrl;
+      std::string strClientId;
+      std::string strClientSecret;
+      std::string strScope;    // optional, space separated
+      double dRefreshRatio;    // part of the lifetime after which the token is refreshed, in ]0, 1]
+      int iDefaultLifetimeMs;  // lifetime of the tokens without "expires_in"
+      int iRetryMs;            // delay between failed fetches
+      int iWaitMs;             // longest wait of GetToken() for a token
+      int iTimeoutMs;          // limit of a fetch
+   };
+
+   struct Stats
+   {
+      Stats() : ullFetches(0), ullFailures(0), ullWaits(0), ullInvalidations(0) {}
+      unsigned long long ullFetches;       // requests to the token endpoint
+      unsigned long long ullFailures;      // fetches without a token
+      unsigned long long ullWaits;         // GetToken() calls that waited for a fetch
+      unsigned long long ullInvalidations; // tokens rejected by a server
+   };
+
+   CppHTTPOAuth2Provider(const Config &oConfig, LogFnCallback oLogger);
+   virtual ~CppHTTPOAuth2Provider();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPOAuth2Provider(const CppHTTPOAuth2Provider &Copy) = delete;
+   CppHTTPOAuth2Provider &operator=(const CppHTTPOAuth2Provider &Copy) = delete;
+
+   // starts the worker, which fetches the first token at once
+   const bool Start(const bool &bHTTPS = false, const SettingsFlag &SettingsFlags = CppHTTPClient::ALL_FLAGS);
+   // aborts the fetch in flight, GetToken() fails from now on
+   void Stop();
+
+   const bool GetToken(std::string &strToken) override;
+   void Invalidate(const std::string &strToken) override;
+
+   inline const Config &GetConfig() const { return m_oConfig; }
+   const Stats GetStats() const;
+
+   /* parses the JSON answer of a token endpoint, lLifetimeMs is -1 without "expires_in".
+    * false without "access_token", or for a token type other than "Bearer" */
+   static const bool ParseTokenResponse(const std::string &strBody, std::string &strToken, long &lLifetimeMs);
+
+protected:
+   void Worker();
+   const bool Fetch(std::string &strToken, long &lLifetimeMs);
+   static std::string UrlEncode(const std::string &strValue);
+
+   const Config m_oConfig;
+   CppHTTPClient m_oClient; // worker thread only
+   std::thread m_oThread;
+   std::shared_ptr<CppHTTPCancelToken> m_pCancelToken; // aborts the fetch in flight at Stop()
+
+   mutable std::mutex m_mtxToken;     // guards everything below
+   std::condition_variable m_cvWorker; // fetch asked or shutdown
+   std::condition_variable m_cvToken;  // fetch done or shutdown
+   std::string m_strToken;
+   TimePoint m_tpExpiry;
+   TimePoint m_tpRefresh;            // next fetch of the worker
+   unsigned long long m_ullFetchId;  // fetches done, the waiters wait for the next one
+   bool m_bFetchAsked;
+   bool m_bFetching;
+   bool m_bLastFailed;
+   bool m_bRunning;
+   bool m_bStopping;
+   SettingsFlag m_eSettingsFlags;
+   Stats m_oStats;
+
+   // Log printer callback
+   LogFnCallback m_oLog;
+};
+
+// Logs messages
+#define LOG_ERROR_AUTH_ALREADY_STARTED_MSG "[CppHTTPOAuth2Provider][Error] Worker is already started ! Use Stop() before."
+#define LOG_ERROR_AUTH_FETCH_FORMAT "[CppHTTPOAuth2Provider][Error] Unable to fetch a token from '%s' (%s)"
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "httpcanceltoken.h"
+#include "httpclient.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+/* Fire-and-forget sender for requests whose response is not needed (telemetry).
+ *
+ * Enqueue() returns at once, the POST requests are performed by a small pool
+ * of worker threads, each one keeping its own session and so its keep-alive
+ * connections. The queue is bounded: a full queue drops the newest or the
+ * oldest message according to the drop policy. Thread-safe. */
+class CppHTTPBackgroundSender
+{
+public:
+   typedef CppHTTPClient::LogFnCallback LogFnCallback;
+   typedef CppHTTPClient::HeadersMap HeadersMap;
+   typedef CppHTTPClient::SettingsFlag SettingsFlag;
+
+   // message discarded when the queue is full
+   enum DropPolicy
+   {
+      DROP_NEWEST, // Enqueue() fails
+      DROP_OLDEST  // the oldest queued message makes room
+   };
+
+   // delivery statistics
+   struct Stats
+   {
+      Stats() : usQueued(0), ullEnqueued(0), ullSent(0), ullFailed(0), ullDropped(0), ullDiscarded(0) {}
+      size_t usQueued;                 // messages waiting for a worker
+      unsigned long long ullEnqueued;  // messages accepted by Enqueue()
+      unsigned long long ullSent;      // delivered, HTTP status below 400
+      unsigned long long ullFailed;    // transfer failures and HTTP errors
+      unsigned long long ullDropped;   // dropped by the full queue
+      unsigned long long ullDiscarded; // still queued, or aborted, at shutdown
+   };
+
+   CppHTTPBackgroundSender(LogFnCallback oLogger, const size_t usMaxQueued = 1024,
+                           const size_t usSessions = 2, const DropPolicy eDropPolicy = DROP_NEWEST);
+   virtual ~CppHTTPBackgroundSender();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPBackgroundSender(const CppHTTPBackgroundSender &Copy) = delete;
+   CppHTTPBackgroundSender &operator=(const CppHTTPBackgroundSender &Copy) = delete;
+
+   // Setters - Getters, the session settings apply from the next Start()
+   inline void SetTimeout(const int &iTimeout) { m_iCurlTimeout = iTimeout; }
+   inline const int GetTimeout() const { return m_iCurlTimeout; }
+   /* Stop() sends the queued messages for at most iTimeoutMs milliseconds,
+    * otherwise they are discarded and the running requests aborted at once */
+   void SetFlushOnShutdown(const bool bFlush, const int iTimeoutMs = 5000);
+   const bool GetFlushOnShutdown() const;
+
+   // Workers
+   const bool Start(const bool &bHTTPS = false, const SettingsFlag &SettingsFlags = CppHTTPClient::ALL_FLAGS);
+   void Stop();
+   const bool Flush(const int iTimeoutMs);
+
+   // Messages
+   const bool Enqueue(const std::string &strUrl, const HeadersMap &Headers, const std::string &strBody);
+
+   const Stats GetStats() const;
+
+protected:
+   struct Message
+   {
+      std::string strUrl;
+      HeadersMap mapHeaders;
+      std::string strBody;
+   };
+
+   void Worker();
+
+   const size_t m_usMaxQueued;
+   const size_t m_usSessions;
+   const DropPolicy m_eDropPolicy;
+
+   bool m_bHTTPS;
+   SettingsFlag m_eSettingsFlags;
+   int m_iCurlTimeout;
+
+   mutable std::mutex m_mtxQueue; // guards everything below
+   std::condition_variable m_cvQueue; // messages queued or shutdown
+   std::condition_variable m_cvIdle;  // queue emptied or worker exited
+   std::deque<Message> m_dqMessages;
+   std::vector<std::thread> m_vecWorkers;
+   size_t m_usActiveWorkers;
+   size_t m_usSending; // messages being sent
+   bool m_bRunning;
+   bool m_bStopping;
+   bool m_bFlushOnShutdown;
+   int m_iFlushTimeoutMs;
+   std::chrono::steady_clock::time_point m_tpStopDeadline; // the workers exit once reached
+   std::shared_ptr<CppHTTPCancelToken> m_pCancelToken; // aborts the running requests at the deadline
+   Stats m_oStats;
+
+   // Log printer callback
+   LogFnCallback m_oLog;
+};
+
+// Logs messages
+#define LOG_ERROR_SENDER_ALREADY_STARTED_MSG "[CppHTTPBackgroundSender][Error] Workers are already started ! Use Stop() before."
+#define LOG_WARNING_SENDER_DISCARDED_FORMAT "[CppHTTPBackgroundSender][Warning] %u message(s) discarded at shutdown."
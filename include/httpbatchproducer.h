@@ -0,0 +1,111 @@
+#pragma once
+
+#include "httpclient.h"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <thread>
+
+/* Client-side micro-batching of small JSON POST requests.
+ *
+ * Items sent to the same URL are accumulated and posted as one bulk request,
+ * a JSON array or NDJSON, once the batch holds usMaxItems items, usMaxBytes
+ * bytes or its first item waited iLingerMs milliseconds. Each item gets a
+ * future resolved from the bulk response: when the response is an array (or
+ * NDJSON lines) of one result per item, the item receives its own result,
+ * otherwise the whole response. Thread-safe. */
+class CppHTTPBatchProducer
+{
+public:
+   typedef CppHTTPClient::LogFnCallback LogFnCallback;
+   typedef CppHTTPClient::HeadersMap HeadersMap;
+   typedef CppHTTPClient::HttpResponse HttpResponse;
+   typedef CppHTTPClient::SettingsFlag SettingsFlag;
+
+   // body of the bulk requests
+   enum Format
+   {
+      FORMAT_JSON_ARRAY, // [item,item,...], application/json
+      FORMAT_NDJSON      // one item per line, application/x-ndjson
+   };
+
+   struct Stats
+   {
+      Stats() : ullItems(0), ullBatches(0), ullBytes(0), ullFailedBatches(0) {}
+      unsigned long long ullItems;         // items accepted by Send()
+      unsigned long long ullBatches;       // bulk requests performed
+      unsigned long long ullBytes;         // bulk request bodies
+      unsigned long long ullFailedBatches; // transfer failures and HTTP errors
+   };
+
+   CppHTTPBatchProducer(LogFnCallback oLogger, const size_t usMaxItems = 100, const size_t usMaxBytes = 1 << 20,
+                        const int iLingerMs = 5, const Format eFormat = FORMAT_JSON_ARRAY, const size_t usSessions = 1);
+   virtual ~CppHTTPBatchProducer();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPBatchProducer(const CppHTTPBatchProducer &Copy) = delete;
+   CppHTTPBatchProducer &operator=(const CppHTTPBatchProducer &Copy) = delete;
+
+   // Setters - Getters, the session settings apply from the next Start()
+   inline void SetTimeout(const int &iTimeout) { m_iCurlTimeout = iTimeout; }
+   inline const int GetTimeout() const { return m_iCurlTimeout; }
+   // extra headers of the bulk requests, Content-Type is set from the format
+   void SetHeaders(const HeadersMap &Headers);
+
+   // Workers
+   const bool Start(const bool &bHTTPS = false, const SettingsFlag &SettingsFlags = CppHTTPClient::ALL_FLAGS);
+   void Stop();
+
+   // Items
+   std::future<HttpResponse> Send(const std::string &strUrl, const std::string &strJson);
+
+   const Stats GetStats() const;
+
+   // splits a bulk response into usItems results, false if it does not hold one result per item
+   static const bool SplitResponse(const std::string &strBody, const size_t usItems, const Format eFormat,
+                                   std::vector<std::string> &vecResults);
+
+protected:
+   struct Batch
+   {
+      Batch() : usBytes(0) {}
+      std::string strUrl;
+      std::vector<std::string> vecItems;
+      std::vector<std::promise<HttpResponse>> vecPromises;
+      size_t usBytes;
+      std::chrono::steady_clock::time_point tpFirst; // linger start
+   };
+
+   void Seal(const std::string &strUrl);
+   void Worker();
+   void Deliver(CppHTTPClient &oClient, Batch &oBatch, const HeadersMap &Headers);
+
+   const size_t m_usMaxItems;
+   const size_t m_usMaxBytes;
+   const int m_iLingerMs;
+   const Format m_eFormat;
+   const size_t m_usSessions;
+
+   bool m_bHTTPS;
+   SettingsFlag m_eSettingsFlags;
+   int m_iCurlTimeout;
+
+   mutable std::mutex m_mtxBatches; // guards everything below
+   std::condition_variable m_cvBatches; // batch ready, linger start or shutdown
+   HeadersMap m_mapHeaders;
+   std::map<std::string, Batch> m_mapOpen; // accumulating batches, per URL
+   std::deque<Batch> m_dqReady;            // sealed batches waiting for a worker
+   std::vector<std::thread> m_vecWorkers;
+   bool m_bRunning;
+   bool m_bStopping;
+   Stats m_oStats;
+
+   // Log printer callback
+   LogFnCallback m_oLog;
+};
+
+// Logs messages
+#define LOG_ERROR_PRODUCER_ALREADY_STARTED_MSG "[CppHTTPBatchProducer][Error] Workers are already started ! Use Stop() before."
+#define LOG_ERROR_PRODUCER_NOT_STARTED_MSG "[CppHTTPBatchProducer][Error] Workers are not started ! Use Start() before."
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/* Cancellation signal shared between the caller and the requests it started.
+ *
+ * Cancel() can be called from any thread, once cancelled a token stays
+ * cancelled. The clients subscribe a callback to wake their transfer up, so a
+ * request is aborted within milliseconds instead of at its next timeout.
+ *
+ * Example Usage:
+ * @code
+ *    auto pToken = std::make_shared<CppHTTPCancelToken>();
+ *    m_pHTTPClient->SetCancelToken(pToken);
+ *    // another thread, the caller went away
+ *    pToken->Cancel();
+ * @endcode
+ */
+class CppHTTPCancelToken
+{
+public:
+   typedef std::function<void()> CancelFnCallback;
+
+   CppHTTPCancelToken();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPCancelToken(const CppHTTPCancelToken &Copy) = delete;
+   CppHTTPCancelToken &operator=(const CppHTTPCancelToken &Copy) = delete;
+
+   void Cancel();
+   inline const bool IsCancelled() const { return m_bCancelled.load(std::memory_order_acquire); }
+
+   /* oCallback runs once, from the thread calling Cancel(), or immediately when
+    * the token is already cancelled. It must not call the token back. */
+   const unsigned long long Subscribe(CancelFnCallback oCallback);
+   // once it returns, the callback isn't running and won't be called
+   void Unsubscribe(const unsigned long long ullId);
+
+protected:
+   std::atomic<bool> m_bCancelled;
+
+   std::mutex m_mtxCallbacks; // held while the callbacks run
+   std::map<unsigned long long, CancelFnCallback> m_mapCallbacks;
+   unsigned long long m_ullLastId;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Circuit breaker per origin, shared by the clients.
+ *
+ * CLOSED: the requests pass, their failure rate is measured over a sliding
+ * window. Once it reaches dFailurePercent over at least usMinRequests
+ * requests the circuit opens. OPEN: the requests fail at once, without
+ * connecting, for iOpenMs. HALF_OPEN: usProbes requests are let through, the
+ * circuit closes when they all succeed and opens again at the first failure.
+ * The origins are keyed as the connection pools, see CppHTTPClient::GetHostKey().
+ * Thread-safe.
+ *
+ * Example Usage:
+ * @code
+ *    auto pBreaker = std::make_shared<CppHTTPCircuitBreaker>();
+ *    pBreaker->SetTransitionCallback([](const std::string &strHost, CppHTTPCircuitBreaker::State eFrom,
+ *                                       CppHTTPCircuitBreaker::State eTo) { ... });
+ *    m_pHTTPClient->SetCircuitBreaker(pBreaker);
+ * @endcode
+ */
+class CppHTTPCircuitBreaker
+{
+public:
+   typedef std::chrono::steady_clock::time_point TimePoint;
+
+   enum State
+   {
+      STATE_CLOSED,
+      STATE_OPEN,
+      STATE_HALF_OPEN
+   };
+
+   // result of a request allowed by Allow()
+   enum Outcome
+   {
+      OUTCOME_SUCCESS,
+      OUTCOME_FAILURE, // transfer failure or HTTP 5xx
+      OUTCOME_IGNORED  // not sent or cancelled by the caller, tells nothing about the origin
+   };
+
+   struct Policy
+   {
+      Policy() : dFailurePercent(50.), usMinRequests(20), iWindowMs(10000), iOpenMs(5000), usProbes(1) {}
+      double dFailurePercent; // the circuit opens when the failure rate of the window reaches it...
+      size_t usMinRequests;   // ...over at least usMinRequests requests
+      int iWindowMs;          // sliding window of the failure rate
+      int iOpenMs;            // time spent open before probing the origin
+      size_t usProbes;        // half-open: requests let through, all must succeed to close
+   };
+
+   struct HostStats
+   {
+      HostStats() : eState(STATE_CLOSED), usRequests(0), usFailures(0), ullRejected(0), ullOpened(0) {}
+      State eState;
+      size_t usRequests;              // in the window
+      size_t usFailures;              // in the window
+      unsigned long long ullRejected; // requests failed fast
+      unsigned long long ullOpened;   // transitions to OPEN
+   };
+
+   // called on each state change, outside the breaker's lock
+   typedef std::function<void(const std::string &, const State, const State)> TransitionFnCallback;
+
+   explicit CppHTTPCircuitBreaker(const Policy &oPolicy = Policy());
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPCircuitBreaker(const CppHTTPCircuitBreaker &Copy) = delete;
+   CppHTTPCircuitBreaker &operator=(const CppHTTPCircuitBreaker &Copy) = delete;
+
+   void SetTransitionCallback(TransitionFnCallback oTransition);
+
+   /* false when the request must fail fast, otherwise OnResult() must be called once
+    * it ends, with ullProbeCycle as set here: the half-open cycle of a probe, 0 otherwise.
+    * The results of the probes of an earlier cycle are ignored. */
+   const bool Allow(const std::string &strHost, unsigned long long &ullProbeCycle);
+   void OnResult(const std::string &strHost, const Outcome eOutcome, const unsigned long long ullProbeCycle);
+
+   const State GetState(const std::string &strHost) const;
+   const HostStats GetStats(const std::string &strHost) const;
+   static const char *StateName(const State eState);
+
+protected:
+   static const size_t WINDOW_BUCKETS = 10;
+
+   struct Bucket
+   {
+      Bucket() : llSlot(-1), usRequests(0), usFailures(0) {}
+      long long llSlot; // time slot counted, a slot lasts iWindowMs / WINDOW_BUCKETS
+      size_t usRequests;
+      size_t usFailures;
+   };
+
+   struct Host
+   {
+      Host() : eState(STATE_CLOSED), ullCycle(0), usProbesSent(0), usProbesSucceeded(0), ullRejected(0), ullOpened(0),
+               vecWindow(WINDOW_BUCKETS) {}
+      State eState;
+      unsigned long long ullCycle; // bumped by each transition, the probes are tied to it
+      TimePoint tpOpened;
+      size_t usProbesSent;
+      size_t usProbesSucceeded;
+      unsigned long long ullRejected;
+      unsigned long long ullOpened;
+      std::vector<Bucket> vecWindow;
+   };
+
+   const long long GetSlot(const TimePoint &tpNow) const;
+   void CountWindow(const Host &oHost, const long long llSlot, size_t &usRequests, size_t &usFailures) const;
+   void Transition(Host &oHost, const State eState, const TimePoint &tpNow);
+   void Notify(const std::string &strHost, const State eFrom, const State eTo);
+
+   const Policy m_oPolicy;
+
+   mutable std::mutex m_mtxHosts; // guards everything below
+   std::unordered_map<std::string, Host> m_mapHosts;
+   TransitionFnCallback m_oTransition;
+};
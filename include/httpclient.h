@@ -3,6 +3,7 @@
 #define CLIENT_USERAGENT "CppHTTPClient-agent/0.1"
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <vector>
 #include <curl/curl.h>
@@ -14,24 +15,118 @@
 #include <mutex>
 #include <memory>
 #include <cstdarg>
+#include <random>
+
+class CppHTTPCancelToken;
+class CppHTTPSingleFlight;
+class CppHTTPRetryBudget;
+class CppHTTPCircuitBreaker;
+class CppHTTPLoadBalancer;
+class CppHTTPNegativeCache;
+class CppHTTPAuthProvider;
+class CppHTTPRateLimiter;
 
 class CppHTTPClient
 {
+   // shares the cURL global session count, the callbacks and the string helpers
+   friend class CppHTTPAsyncClient;
+   friend class CppHTTPBackgroundSender;
+   friend class CppHTTPOAuth2Provider;
+
 public:
    // Public definitions
    typedef std::function<int(void *, double, double, double, double)> ProgressFnCallback;
    typedef std::function<void(const std::string &)> LogFnCallback;
    typedef std::unordered_map<std::string, std::string> HeadersMap;
    typedef std::vector<char> ByteBuffer;
+   typedef std::chrono::steady_clock::time_point TimePoint;
+
+   // reason of a failed request (HttpResponse::iCode is then -1)
+   enum ErrorCode
+   {
+      ERR_NONE = 0,
+      ERR_CURL,               // transfer failure, see HttpResponse::strError
+      ERR_CANCELLED,          // cancelled through a CppHTTPCancelToken
+      ERR_DEADLINE_EXCEEDED,  // the deadline expired before the transfer started
+      ERR_TIMEOUT_DNS,        // timed out while resolving the host name
+      ERR_TIMEOUT_CONNECT,    // timed out while connecting
+      ERR_TIMEOUT_TLS,        // timed out during the TLS handshake
+      ERR_TIMEOUT_FIRST_BYTE, // timed out waiting for the first response byte
+      ERR_TIMEOUT_TRANSFER,   // timed out while receiving the response
+      ERR_TIMEOUT_LOW_SPEED,  // the transfer was slower than the low speed limit
+      ERR_DRAINED,            // still pending when CppHTTPAsyncClient::Drain() reached its deadline
+      ERR_QUEUE_FULL,         // dropped from the full wait queue of CppHTTPAsyncClient
+      ERR_CIRCUIT_OPEN,       // failed fast, the circuit breaker of the origin is open
+      ERR_NO_ENDPOINT,        // "lb://" URL of an unknown service, or of a service without endpoints
+      ERR_RATE_LIMITED,       // refused, the token bucket of the URL is empty, see CppHTTPRateLimiter
+      ERR_NO_TOKEN            // not sent, the auth provider had no token, see CppHTTPAuthProvider
+   };
+
+   // limits of a request, in milliseconds, 0 means no limit
+   struct TimeoutPolicy
+   {
+      TimeoutPolicy() : lTotalMs(0), lConnectMs(0), lDnsMs(0), lTlsMs(0), lFirstByteMs(0),
+                        lLowSpeedBytes(0), lLowSpeedSeconds(0) {}
+      long lTotalMs;         // whole request (CURLOPT_TIMEOUT_MS)
+      long lConnectMs;       // connection setup, DNS and TLS included (CURLOPT_CONNECTTIMEOUT_MS)
+      long lDnsMs;           // name resolution
+      long lTlsMs;           // TLS handshake
+      long lFirstByteMs;     // from the request sent to the first response byte
+      long lLowSpeedBytes;   // aborts a transfer slower than lLowSpeedBytes per second...
+      long lLowSpeedSeconds; // ...during lLowSpeedSeconds (CURLOPT_LOW_SPEED_LIMIT/TIME)
+   };
+
+   // failures retried by RetryPolicy, combine them with |
+   enum RetryOn
+   {
+      RETRY_CONNECT = 0x01,  // connection refused or failed
+      RETRY_RESET = 0x02,    // connection reset, or closed without a response
+      RETRY_TIMEOUT = 0x04,  // timeouts, the deadline excepted
+      RETRY_HTTP_5XX = 0x08, // HTTP 502, 503 and 504
+      RETRY_DNS = 0x10,      // name resolution failure
+      RETRY_THROTTLED = 0x20, // HTTP 429
+      RETRY_DEFAULT = RETRY_CONNECT | RETRY_RESET | RETRY_TIMEOUT | RETRY_HTTP_5XX | RETRY_THROTTLED
+   };
+
+   // retries of the failed requests, uMaxAttempts = 1 disables them
+   struct RetryPolicy
+   {
+      RetryPolicy() : uMaxAttempts(1), lBaseDelayMs(50), lMaxDelayMs(2000), lMaxRetryAfterMs(60000),
+                      iRetryOn(RETRY_DEFAULT), bNonIdempotent(false) {}
+      unsigned uMaxAttempts; // first attempt included
+      long lBaseDelayMs;     // decorrelated jitter: the delay is drawn in [lBaseDelayMs, 3 x previous delay]...
+      long lMaxDelayMs;      // ...and capped
+      long lMaxRetryAfterMs; // longest Retry-After of a 429 or 503 waited for, a longer one isn't retried
+      int iRetryOn;          // RetryOn flags
+      bool bNonIdempotent;   // POST requests are retried too
+      std::shared_ptr<CppHTTPRetryBudget> pBudget; // optional, caps the retries per origin
+   };
 
    // HTTP response data
    struct HttpResponse
    {
-      HttpResponse() : iCode(0) {}
+      HttpResponse() : iCode(0), eError(ERR_NONE) {}
       int iCode;             // HTTP response code
       HeadersMap mapHeaders; // HTTP response headers fields
       std::string strBody;   // HTTP response body
+      ErrorCode eError;      // why the request failed
+      std::string strError;  // description of the failure
+   };
+   // response shared by the coalesced requests, see SetSingleFlight()
+   typedef std::shared_ptr<const HttpResponse> SharedResponse;
+
+   // pauses asked by an origin through the Retry-After header of its 429 and 503 responses
+   struct ThrottleStats
+   {
+      ThrottleStats() : ullThrottled(0), ullPaced(0), ullPausedMs(0), lLastRetryAfterMs(0) {}
+      unsigned long long ullThrottled; // 429 and 503 responses with a Retry-After
+      unsigned long long ullPaced;     // requests that waited for the end of a pause
+      unsigned long long ullPausedMs;  // sum of the pauses
+      long lLastRetryAfterMs;
+      TimePoint tpPausedUntil;
    };
+   // called for each throttling response, with its origin ("scheme://host:port") and pause
+   typedef std::function<void(const std::string &, const long)> ThrottleFnCallback;
 
    enum SettingsFlag
    {
@@ -53,6 +148,36 @@ public:
 
    // Setters - Getters (just for unit tests)
    inline void SetTimeout(const int &iTimeout) { m_iCurlTimeout = iTimeout; }
+   // per phase limits, TimeoutPolicy::lTotalMs overrides SetTimeout()
+   inline void SetTimeouts(const TimeoutPolicy &oTimeouts) { m_oTimeouts = oTimeouts; }
+   inline const TimeoutPolicy &GetTimeouts() const { return m_oTimeouts; }
+   // the requests performed from now on must end before tpDeadline, TimePoint() for none
+   inline void SetDeadline(const TimePoint &tpDeadline) { m_tpDeadline = tpDeadline; }
+   inline const TimePoint &GetDeadline() const { return m_tpDeadline; }
+   inline void SetRetryPolicy(const RetryPolicy &oRetry) { m_oRetry = oRetry; }
+   inline const RetryPolicy &GetRetryPolicy() const { return m_oRetry; }
+   // requests to an origin whose circuit is open fail at once with ERR_CIRCUIT_OPEN, nullptr disables it
+   inline void SetCircuitBreaker(std::shared_ptr<CppHTTPCircuitBreaker> pBreaker) { m_pCircuitBreaker = pBreaker; }
+   inline const std::shared_ptr<CppHTTPCircuitBreaker> &GetCircuitBreaker() const { return m_pCircuitBreaker; }
+   // "lb://<service>/..." URLs are sent to an endpoint of the service, see CppHTTPLoadBalancer
+   inline void SetLoadBalancer(std::shared_ptr<CppHTTPLoadBalancer> pBalancer) { m_pLoadBalancer = pBalancer; }
+   inline const std::shared_ptr<CppHTTPLoadBalancer> &GetLoadBalancer() const { return m_pLoadBalancer; }
+   // each attempt takes a token of its URL's bucket, or fails at once with ERR_RATE_LIMITED
+   inline void SetRateLimiter(std::shared_ptr<CppHTTPRateLimiter> pLimiter) { m_pRateLimiter = pLimiter; }
+   inline const std::shared_ptr<CppHTTPRateLimiter> &GetRateLimiter() const { return m_pRateLimiter; }
+   // requests to an origin known unreachable fail at once with the cached error, without retries
+   inline void SetNegativeCache(std::shared_ptr<CppHTTPNegativeCache> pCache) { m_pNegativeCache = pCache; }
+   inline const std::shared_ptr<CppHTTPNegativeCache> &GetNegativeCache() const { return m_pNegativeCache; }
+   /* each attempt is sent with the bearer token of pProvider, unless the request has its own
+    * Authorization header. A 401 replaces the token and is retried once, whatever the retry policy. */
+   inline void SetAuthProvider(std::shared_ptr<CppHTTPAuthProvider> pProvider) { m_pAuthProvider = pProvider; }
+   inline const std::shared_ptr<CppHTTPAuthProvider> &GetAuthProvider() const { return m_pAuthProvider; }
+   // attempts made by the last request
+   inline const unsigned GetAttempts() const { return m_uAttempts; }
+   /* an origin answering 429 or 503 with Retry-After is paused: the retries and the
+    * next requests of this client to it wait for the end of the pause */
+   const ThrottleStats GetThrottleStats(const std::string &strHost) const;
+   inline void SetThrottleFnCallback(ThrottleFnCallback oThrottle) { m_oThrottle = oThrottle; }
    inline void SetNoSignal(const bool &bNoSignal) { m_bNoSignal = bNoSignal; }
    inline void SetHTTPS(const bool &bEnableHTTPS) { m_bHTTPS = bEnableHTTPS; }
    inline const int GetTimeout() const { return m_iCurlTimeout; }
@@ -61,6 +186,17 @@ public:
    inline const unsigned char GetSettingsFlags() const { return m_eSettingsFlags; }
    inline const bool GetHTTPS() const { return m_bHTTPS; }
 
+   /* the token cancels the requests performed from now on, from any thread.
+    * The progress callback is called during the transfers, returning non-zero aborts them. */
+   inline void SetCancelToken(std::shared_ptr<CppHTTPCancelToken> pToken) { m_pCancelToken = pToken; }
+   inline const std::shared_ptr<CppHTTPCancelToken> &GetCancelToken() const { return m_pCancelToken; }
+   inline void SetProgressFnCallback(ProgressFnCallback oProgress) { m_oProgress = oProgress; }
+   /* Get() and Head() share the request in flight of the clients sharing pSingleFlight,
+    * which should then have the same session settings. Only the clients with the same auth
+    * provider, or none, share their requests. nullptr disables the coalescing. */
+   inline void SetSingleFlight(std::shared_ptr<CppHTTPSingleFlight> pSingleFlight) { m_pSingleFlight = pSingleFlight; }
+   inline const std::shared_ptr<CppHTTPSingleFlight> &GetSingleFlight() const { return m_pSingleFlight; }
+
    // Session
    const bool InitSession(const bool &bHTTPS = false,
                           const SettingsFlag &SettingsFlags = ALL_FLAGS);
@@ -69,6 +205,12 @@ public:
    static int GetCurlSessionCount() { return s_iCurlSession; }
    const CURL *GetCurlPointer() const { return m_pCurlSession; }
 
+   // "scheme://host:port" of an URL, used to group requests by origin
+   static std::string GetHostKey(const std::string &strURL);
+   /* pause asked by a 429 or 503 response in its Retry-After header (seconds or HTTP date),
+    * in milliseconds, -1 for none */
+   static const long GetRetryAfterMs(const int iCode, const HeadersMap &mapHeaders);
+
    // HTTP requests
    inline void AddHeader(const std::string &strHeader)
    {
@@ -78,6 +220,8 @@ public:
    // REST requests
    const bool Head(const std::string &strUrl, const HeadersMap &Headers, HttpResponse &Response);
    const bool Get(const std::string &strUrl, const HeadersMap &Headers, HttpResponse &Response);
+   // same as Get(), without copying the response shared by the coalesced requests
+   const bool Get(const std::string &strUrl, const HeadersMap &Headers, SharedResponse &pResponse);
    const bool Del(const std::string &strUrl, const HeadersMap &Headers, HttpResponse &Response);
    const bool Post(const std::string &strUrl, const HeadersMap &Headers,
                    const std::string &strPostData, HttpResponse &Response);
@@ -109,8 +253,18 @@ protected:
    };
 
    /* common operations are performed here */
-   inline const CURLcode Perform();
+   inline const CURLcode Perform(HttpResponse &Response, const bool bIdempotent = true,
+                                 UploadObject *pPayload = nullptr);
+   const CURLcode PerformAttempt();
+   const int RetryClass(const CURLcode eResult) const;
+   const bool Backoff(const long lDelayMs);
+   void OnThrottled(const std::string &strHost, const long lRetryAfterMs);
+   const CURLcode PerformMulti();
    inline void CheckURL(const std::string &strURL);
+   const bool PerformHead(const std::string &strUrl, const HeadersMap &Headers, HttpResponse &Response);
+   const bool PerformGet(const std::string &strUrl, const HeadersMap &Headers, HttpResponse &Response);
+   const std::string MakeFlightKey(const std::string &strMethod, const std::string &strUrl,
+                                   const HeadersMap &Headers) const;
    inline const bool InitRestRequest(const std::string &strUrl, const HeadersMap &Headers,
                                      HttpResponse &Response);
    inline const bool PostRestRequest(const CURLcode ePerformCode, HttpResponse &Response);
@@ -119,6 +273,17 @@ protected:
    static size_t RestWriteCallback(void *ptr, size_t size, size_t nmemb, void *userdata);
    static size_t RestHeaderCallback(void *ptr, size_t size, size_t nmemb, void *userdata);
    static size_t RestReadCallback(void *ptr, size_t size, size_t nmemb, void *userdata);
+   static int ProgressCallback(void *pUserData, curl_off_t DlTotal, curl_off_t DlNow, curl_off_t UlTotal, curl_off_t UlNow);
+
+   // Timeouts helpers, shared with CppHTTPAsyncClient
+   static TimeoutPolicy MergeTimeouts(const TimeoutPolicy &oTimeouts, const TimeoutPolicy &oDefaults);
+   static const long RemainingMs(const TimePoint &tpDeadline, const TimePoint &tpNow);
+   static void ApplyTimeouts(CURL *pCurl, const TimeoutPolicy &oTimeouts, const long lBudgetMs);
+   static const long CheckPhaseTimeouts(CURL *pCurl, const TimeoutPolicy &oTimeouts, const long lElapsedMs,
+                                        ErrorCode &eError);
+   static const ErrorCode ClassifyTimeout(CURL *pCurl, const TimeoutPolicy &oTimeouts, const long lElapsedMs,
+                                          const long lBudgetMs);
+   static std::string TimeoutMessage(const ErrorCode eError, const long lElapsedMs);
 
    // String Helpers
    static std::string StringFormat(const std::string strFormat, ...);
@@ -144,6 +309,36 @@ protected:
    CURL *m_pCurlSession;
    int m_iCurlTimeout;
 
+   // cancellation, cancellable requests are performed through m_pCurlMulti to be woken up
+   std::shared_ptr<CppHTTPCancelToken> m_pCancelToken;
+   ProgressFnCallback m_oProgress;
+   CURLM *m_pCurlMulti;
+
+   // request coalescing, shared with other clients
+   std::shared_ptr<CppHTTPSingleFlight> m_pSingleFlight;
+
+   // timeouts of the request being performed
+   TimeoutPolicy m_oTimeouts;
+   TimePoint m_tpDeadline;
+   TimePoint m_tpStart;
+   ErrorCode m_eTimeoutError; // set when the request timed out
+   ErrorCode m_eAbortError;   // reason of a request not sent, decided by the client
+   long m_lBudgetMs;          // effective total limit, deadline included
+   long m_lElapsedMs;
+
+   // retries
+   RetryPolicy m_oRetry;
+   unsigned m_uAttempts;
+   std::mt19937 m_oRandom; // backoff jitter
+   std::shared_ptr<CppHTTPCircuitBreaker> m_pCircuitBreaker;
+   std::shared_ptr<CppHTTPLoadBalancer> m_pLoadBalancer;
+   std::shared_ptr<CppHTTPRateLimiter> m_pRateLimiter;
+   std::shared_ptr<CppHTTPNegativeCache> m_pNegativeCache;
+   bool m_bCachedFailure; // the last request failed from the negative cache
+   std::shared_ptr<CppHTTPAuthProvider> m_pAuthProvider;
+   std::unordered_map<std::string, ThrottleStats> m_mapThrottles; // origins that answered a Retry-After
+   ThrottleFnCallback m_oThrottle;
+
    // Log printer callback
    LogFnCallback m_oLog;
 };
@@ -154,4 +349,12 @@ protected:
 #define LOG_ERROR_CURL_ALREADY_INIT_MSG "[CppHTTPClient][Error] Curl session is already initialized ! Use CleanupSession() to clean the present one."
 #define LOG_ERROR_CURL_NOT_INIT_MSG "[CppHTTPClient][Error] Curl session is not initialized ! Use InitSession() before."
 
-#define LOG_ERROR_CURL_REST_FAILURE_FORMAT "[CppHTTPClient][Error] Unable to perform a REST request from '%s' (Error = %d | %s)"
\ No newline at end of file
+#define LOG_ERROR_CURL_REST_FAILURE_FORMAT "[CppHTTPClient][Error] Unable to perform a REST request from '%s' (Error = %d | %s)"
+#define LOG_WARNING_REST_CANCELLED_FORMAT "[CppHTTPClient][Warning] REST request to '%s' cancelled."
+#define LOG_WARNING_RETRY_FORMAT "[CppHTTPClient][Warning] REST request to '%s' failed, attempt %u in %ld ms."
+#define LOG_WARNING_RETRY_BUDGET_FORMAT "[CppHTTPClient][Warning] Retry budget spent, REST request to '%s' not retried."
+#define LOG_WARNING_CIRCUIT_OPEN_FORMAT "[CppHTTPClient][Warning] Circuit open, REST request to '%s' failed fast."
+#define LOG_ERROR_NO_ENDPOINT_FORMAT "[CppHTTPClient][Error] No endpoint to send the REST request to '%s'."
+#define LOG_WARNING_THROTTLED_FORMAT "[CppHTTPClient][Warning] Origin '%s' throttled the REST requests, paused for %ld ms."
+#define LOG_WARNING_RATE_LIMITED_FORMAT "[CppHTTPClient][Warning] Rate limit reached, REST request to '%s' refused."
+#define LOG_ERROR_NO_TOKEN_FORMAT "[CppHTTPClient][Error] No token from the auth provider, REST request to '%s' not sent."
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "httpasyncclient.h"
+
+#include <atomic>
+#include <condition_variable>
+
+/* Single producer / single consumer ring buffer of completion batches.
+ *
+ * The asynchronous client (producer, loop thread) publishes one batch of
+ * completions per loop iteration, a consumer thread drains every available
+ * batch at once. The consumer is only woken up when it is actually waiting,
+ * so a burst of completions costs a single wakeup. */
+class CppHTTPCompletionQueue
+{
+public:
+   typedef CppHTTPAsyncClient::Completion Completion;
+   typedef std::vector<Completion> Batch;
+
+   // usCapacity is the number of batches, rounded up to a power of two
+   explicit CppHTTPCompletionQueue(const size_t usCapacity = 64);
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPCompletionQueue(const CppHTTPCompletionQueue &Copy) = delete;
+   CppHTTPCompletionQueue &operator=(const CppHTTPCompletionQueue &Copy) = delete;
+
+   // Producer
+   const bool Push(Batch &vecBatch);
+
+   // Consumer
+   const size_t Drain(Batch &vecCompletions, const int iTimeoutMs);
+   void Close();
+   inline const bool IsClosed() const { return m_bClosed.load(); }
+
+   // Statistics
+   inline const unsigned long long GetBatchCount() const { return m_ullBatches.load(std::memory_order_relaxed); }
+   inline const unsigned long long GetCompletionCount() const { return m_ullCompletions.load(std::memory_order_relaxed); }
+   inline const unsigned long long GetWakeupCount() const { return m_ullWakeups.load(std::memory_order_relaxed); }
+
+protected:
+   std::vector<Batch> m_vecSlots;
+   const size_t m_usMask;
+
+   std::atomic<size_t> m_usHead; // next slot to drain, written by the consumer
+   std::atomic<size_t> m_usTail; // next slot to fill, written by the producer
+
+   // consumer sleep
+   std::mutex m_mtxWait;
+   std::condition_variable m_cvWait;
+   std::atomic<bool> m_bWaiting;
+   std::atomic<bool> m_bClosed;
+
+   std::atomic<unsigned long long> m_ullBatches;
+   std::atomic<unsigned long long> m_ullCompletions;
+   std::atomic<unsigned long long> m_ullWakeups;
+};
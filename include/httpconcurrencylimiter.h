@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* Adaptive concurrency limit per origin, in front of the wait queue of CppHTTPAsyncClient.
+ *
+ * The requests in flight to an origin are capped by a limit adjusted from the
+ * latencies and the drops (transfer failures, HTTP 429 and 503, latencies above
+ * iDropLatencyMs) of its requests:
+ *  - LIMIT_AIMD: +1 per response while the limit is used by half at least,
+ *    times dBackoffRatio per drop,
+ *  - LIMIT_GRADIENT: the limit follows the ratio of the long-term latency to
+ *    the short-term one, with sqrt(limit) of headroom, so that a rising latency
+ *    lowers the limit before any failure.
+ * Beyond the limit the requests wait in the queue of the client, and once the
+ * requests in flight and waiting reach (1 + dQueueRatio) times the limit they
+ * are refused at once: a slowing origin sheds load instead of queueing it. The
+ * origins are keyed as the connection pools, see CppHTTPClient::GetHostKey().
+ * Thread-safe.
+ *
+ * Example Usage:
+ * @code
+ *    CppHTTPConcurrencyLimiter::Policy oPolicy;
+ *    oPolicy.eAlgorithm = CppHTTPConcurrencyLimiter::LIMIT_GRADIENT;
+ *    oAsyncClient.SetConcurrencyLimiter(std::make_shared<CppHTTPConcurrencyLimiter>(oPolicy));
+ * @endcode
+ */
+class CppHTTPConcurrencyLimiter
+{
+public:
+   enum Algorithm
+   {
+      LIMIT_AIMD,
+      LIMIT_GRADIENT
+   };
+
+   struct Policy
+   {
+      Policy() : eAlgorithm(LIMIT_AIMD), usInitialLimit(20), usMinLimit(1), usMaxLimit(1000), dQueueRatio(1.),
+                 iDropLatencyMs(0), dBackoffRatio(0.9), dTolerance(1.5), dSmoothing(0.2), usLongWindow(600) {}
+      Algorithm eAlgorithm;
+      size_t usInitialLimit;
+      size_t usMinLimit;
+      size_t usMaxLimit;
+      double dQueueRatio;    // waiting requests allowed per unit of limit, the next ones are refused
+      int iDropLatencyMs;    // a slower response counts as a drop (0: none)
+      double dBackoffRatio;  // LIMIT_AIMD: decrease factor of a drop
+      double dTolerance;     // LIMIT_GRADIENT: short-term latency tolerated, as a factor of the long-term one
+      double dSmoothing;     // LIMIT_GRADIENT: weight of a new limit
+      size_t usLongWindow;   // LIMIT_GRADIENT: responses averaged by the long-term latency
+   };
+
+   struct HostStats
+   {
+      HostStats() : dLimit(0.), usInFlight(0), usWaiting(0), ullShed(0), dShortRttMs(0.), dLongRttMs(0.) {}
+      double dLimit;
+      size_t usInFlight;
+      size_t usWaiting;
+      unsigned long long ullShed; // requests refused by Admit()
+      double dShortRttMs;         // LIMIT_GRADIENT
+      double dLongRttMs;          // LIMIT_GRADIENT
+   };
+
+   explicit CppHTTPConcurrencyLimiter(const Policy &oPolicy = Policy());
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPConcurrencyLimiter(const CppHTTPConcurrencyLimiter &Copy) = delete;
+   CppHTTPConcurrencyLimiter &operator=(const CppHTTPConcurrencyLimiter &Copy) = delete;
+
+   /* life of a request: Admit() when submitted, then Acquire() once HasCapacity()
+    * or Withdraw() if it never starts, then OnComplete() or Release() if it ended
+    * without telling anything about the origin (cancelled...) */
+   const bool Admit(const std::string &strHost);
+   void Withdraw(const std::string &strHost);
+   const bool HasCapacity(const std::string &strHost) const;
+   void Acquire(const std::string &strHost);
+   void OnComplete(const std::string &strHost, const unsigned long long ullLatencyUs, const bool bDropped);
+   void Release(const std::string &strHost);
+
+   const size_t GetLimit(const std::string &strHost) const;
+   const HostStats GetStats(const std::string &strHost) const;
+   inline const Policy &GetPolicy() const { return m_oPolicy; }
+
+protected:
+   HostStats &GetHost(const std::string &strHost);
+   const size_t Floor(const double dLimit) const;
+
+   const Policy m_oPolicy;
+
+   mutable std::mutex m_mtxHosts; // guards everything below
+   std::unordered_map<std::string, HostStats> m_mapHosts;
+};
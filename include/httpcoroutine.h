@@ -0,0 +1,341 @@
+#pragma once
+
+/* C++20 coroutine support for the asynchronous client, requires a C++20 compiler
+ * (cmake -DWITH_COROUTINES=ON ..), the rest of the library stays C++14.
+ *
+ * Example Usage:
+ * @code
+ *    CppHTTPTask<int> Fetch(CppHTTPCoroClient &oClient)
+ *    {
+ *       CppHTTPClient::HttpResponse Response = co_await oClient.Get("http://httpbin.org/get", Headers);
+ *       co_return Response.iCode;
+ *    }
+ *
+ *    CppHTTPCoroClient oClient(oAsyncClient);
+ *    int iCode = oClient.Run(Fetch(oClient));
+ * @endcode
+ */
+
+#include "httpasyncclient.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class CppHTTPTask;
+
+namespace CppHTTPCoroutine
+{
+// promise parts shared by every CppHTTPTask
+struct PromiseBase
+{
+   // resumes the awaiting coroutine, if any, when the task completes
+   struct FinalAwaiter
+   {
+      bool await_ready() const noexcept { return false; }
+
+      template <typename Promise>
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> hTask) noexcept
+      {
+         std::coroutine_handle<> hContinuation = hTask.promise().hContinuation;
+         return hContinuation ? hContinuation : std::noop_coroutine();
+      }
+
+      void await_resume() const noexcept {}
+   };
+
+   std::suspend_always initial_suspend() const noexcept { return {}; }
+   FinalAwaiter final_suspend() const noexcept { return {}; }
+   void unhandled_exception() { pException = std::current_exception(); }
+
+   std::coroutine_handle<> hContinuation;
+   std::exception_ptr pException;
+};
+
+template <typename T>
+struct Promise : PromiseBase
+{
+   CppHTTPTask<T> get_return_object();
+   void return_value(T Value) { oValue.emplace(std::move(Value)); }
+
+   T TakeResult()
+   {
+      if (pException)
+         std::rethrow_exception(pException);
+      return std::move(*oValue);
+   }
+
+   std::optional<T> oValue;
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+   CppHTTPTask<void> get_return_object();
+   void return_void() const noexcept {}
+
+   void TakeResult()
+   {
+      if (pException)
+         std::rethrow_exception(pException);
+   }
+};
+
+// eagerly started coroutine that frees itself on completion
+struct DetachedTask
+{
+   struct promise_type
+   {
+      DetachedTask get_return_object() const noexcept { return {}; }
+      std::suspend_never initial_suspend() const noexcept { return {}; }
+      std::suspend_never final_suspend() const noexcept { return {}; }
+      void return_void() const noexcept {}
+      void unhandled_exception() const noexcept { std::terminate(); }
+   };
+};
+} // namespace CppHTTPCoroutine
+
+/* Lazy coroutine task: the body starts when the task is awaited (or Start()ed)
+ * and the awaiting coroutine is resumed inline when it completes. */
+template <typename T>
+class CppHTTPTask
+{
+public:
+   typedef CppHTTPCoroutine::Promise<T> promise_type;
+   typedef std::coroutine_handle<promise_type> Handle;
+
+   CppHTTPTask() noexcept = default;
+   explicit CppHTTPTask(Handle hCoroutine) noexcept : m_hCoroutine(hCoroutine) {}
+   CppHTTPTask(CppHTTPTask &&Other) noexcept : m_hCoroutine(std::exchange(Other.m_hCoroutine, nullptr)) {}
+   CppHTTPTask &operator=(CppHTTPTask &&Other) noexcept
+   {
+      if (this != &Other)
+      {
+         if (m_hCoroutine)
+            m_hCoroutine.destroy();
+         m_hCoroutine = std::exchange(Other.m_hCoroutine, nullptr);
+      }
+      return *this;
+   }
+   ~CppHTTPTask()
+   {
+      if (m_hCoroutine)
+         m_hCoroutine.destroy();
+   }
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPTask(const CppHTTPTask &Copy) = delete;
+   CppHTTPTask &operator=(const CppHTTPTask &Copy) = delete;
+
+   // starts a top level task, its result is available once IsDone()
+   void Start()
+   {
+      if (m_hCoroutine && !m_hCoroutine.done())
+         m_hCoroutine.resume();
+   }
+   bool IsDone() const { return !m_hCoroutine || m_hCoroutine.done(); }
+   T Result() { return m_hCoroutine.promise().TakeResult(); }
+
+   auto operator co_await() && noexcept
+   {
+      struct Awaiter
+      {
+         Handle hCoroutine;
+
+         bool await_ready() const noexcept { return !hCoroutine || hCoroutine.done(); }
+         std::coroutine_handle<> await_suspend(std::coroutine_handle<> hAwaiting) noexcept
+         {
+            hCoroutine.promise().hContinuation = hAwaiting;
+            return hCoroutine; // symmetric transfer: starts the task
+         }
+         T await_resume() { return hCoroutine.promise().TakeResult(); }
+      };
+      return Awaiter{m_hCoroutine};
+   }
+
+private:
+   Handle m_hCoroutine = nullptr;
+};
+
+template <typename T>
+inline CppHTTPTask<T> CppHTTPCoroutine::Promise<T>::get_return_object()
+{
+   return CppHTTPTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline CppHTTPTask<void> CppHTTPCoroutine::Promise<void>::get_return_object()
+{
+   return CppHTTPTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+/* Awaitable REST requests on top of an asynchronous client,
+ * the awaiting coroutine is resumed from the completion callback (loop thread). */
+class CppHTTPCoroClient
+{
+public:
+   typedef CppHTTPAsyncClient::HeadersMap HeadersMap;
+   typedef CppHTTPAsyncClient::HttpResponse HttpResponse;
+
+   // result of co_await, iCode is -1 when the transfer failed
+   class ResponseAwaitable
+   {
+   public:
+      ResponseAwaitable(CppHTTPAsyncClient &oClient, CppHTTPAsyncClient::Request oRequest)
+          : m_oClient(oClient), m_oRequest(std::move(oRequest)) {}
+
+      bool await_ready() const noexcept { return false; }
+      bool await_suspend(std::coroutine_handle<> hAwaiting)
+      {
+         bool bSubmitted = m_oClient.Submit(m_oRequest, [this, hAwaiting](const bool /*bSuccess*/, HttpResponse &Response) {
+            m_oResponse = std::move(Response);
+            hAwaiting.resume();
+         });
+         if (!bSubmitted)
+            m_oResponse.iCode = -1;
+         return bSubmitted;
+      }
+      HttpResponse await_resume() { return std::move(m_oResponse); }
+
+   private:
+      CppHTTPAsyncClient &m_oClient;
+      CppHTTPAsyncClient::Request m_oRequest;
+      HttpResponse m_oResponse;
+   };
+
+   explicit CppHTTPCoroClient(CppHTTPAsyncClient &oClient) : m_oClient(oClient) {}
+
+   CppHTTPAsyncClient &GetClient() { return m_oClient; }
+
+   // REST requests
+   ResponseAwaitable Submit(CppHTTPAsyncClient::Request oRequest)
+   {
+      return ResponseAwaitable(m_oClient, std::move(oRequest));
+   }
+   ResponseAwaitable Head(const std::string &strUrl, const HeadersMap &Headers)
+   {
+      return Submit(MakeRequest(CppHTTPAsyncClient::HTTP_HEAD, strUrl, Headers, std::string()));
+   }
+   ResponseAwaitable Get(const std::string &strUrl, const HeadersMap &Headers)
+   {
+      return Submit(MakeRequest(CppHTTPAsyncClient::HTTP_GET, strUrl, Headers, std::string()));
+   }
+   ResponseAwaitable Del(const std::string &strUrl, const HeadersMap &Headers)
+   {
+      return Submit(MakeRequest(CppHTTPAsyncClient::HTTP_DELETE, strUrl, Headers, std::string()));
+   }
+   ResponseAwaitable Post(const std::string &strUrl, const HeadersMap &Headers, const std::string &strPostData)
+   {
+      return Submit(MakeRequest(CppHTTPAsyncClient::HTTP_POST, strUrl, Headers, strPostData));
+   }
+   ResponseAwaitable Put(const std::string &strUrl, const HeadersMap &Headers, const std::string &strPutData)
+   {
+      return Submit(MakeRequest(CppHTTPAsyncClient::HTTP_PUT, strUrl, Headers, strPutData));
+   }
+
+   /* starts a top level task and drives the client with Poll() until it completes,
+    * only for clients that are not driven by an external event loop */
+   template <typename T>
+   T Run(CppHTTPTask<T> oTask)
+   {
+      oTask.Start();
+      while (!oTask.IsDone() && m_oClient.Poll(100) >= 0)
+      {
+      }
+      return oTask.Result();
+   }
+
+private:
+   static CppHTTPAsyncClient::Request MakeRequest(const CppHTTPAsyncClient::Method eMethod, const std::string &strUrl,
+                                                  const HeadersMap &Headers, const std::string &strBody)
+   {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.eMethod = eMethod;
+      oRequest.strUrl = strUrl;
+      oRequest.mapHeaders = Headers;
+      oRequest.strBody = strBody;
+      return oRequest;
+   }
+
+   CppHTTPAsyncClient &m_oClient;
+};
+
+namespace CppHTTPCoroutine
+{
+template <typename T>
+struct WhenAllState
+{
+   explicit WhenAllState(const size_t usCount) : usRemaining(usCount + 1), vecResults(usCount) {}
+   std::atomic<size_t> usRemaining; // + 1 held by the launcher
+   std::coroutine_handle<> hParent;
+   std::vector<std::optional<T>> vecResults;
+   std::exception_ptr pException;
+};
+
+template <typename T>
+DetachedTask RunAndNotify(CppHTTPTask<T> &oTask, WhenAllState<T> &oState, const size_t usIndex)
+{
+   try
+   {
+      oState.vecResults[usIndex].emplace(co_await std::move(oTask));
+   }
+   catch (...)
+   {
+      if (!oState.pException)
+         oState.pException = std::current_exception();
+   }
+   if (--oState.usRemaining == 0)
+      oState.hParent.resume();
+}
+
+template <typename T>
+struct WhenAllAwaiter
+{
+   std::vector<CppHTTPTask<T>> &vecTasks;
+   WhenAllState<T> &oState;
+
+   bool await_ready() const noexcept { return vecTasks.empty(); }
+   bool await_suspend(std::coroutine_handle<> hParent)
+   {
+      oState.hParent = hParent;
+      for (size_t i = 0; i < vecTasks.size(); ++i)
+         RunAndNotify(vecTasks[i], oState, i);
+      // stays suspended unless every task already completed
+      return --oState.usRemaining != 0;
+   }
+   void await_resume() const noexcept {}
+};
+} // namespace CppHTTPCoroutine
+
+/**
+ * @brief runs the tasks concurrently and completes when all of them are done
+ *
+ * The results are returned in the order of the tasks, the first exception
+ * thrown by a task is rethrown once all of them completed.
+ *
+ * Example Usage:
+ * @code
+ *    std::vector<CppHTTPTask<CppHTTPClient::HttpResponse>> vecTasks;
+ *    for (const auto &strUrl : vecUrls)
+ *       vecTasks.push_back(FetchOne(oClient, strUrl));
+ *    auto vecResponses = co_await WhenAll(std::move(vecTasks));
+ * @endcode
+ */
+template <typename T>
+CppHTTPTask<std::vector<T>> WhenAll(std::vector<CppHTTPTask<T>> vecTasks)
+{
+   CppHTTPCoroutine::WhenAllState<T> oState(vecTasks.size());
+   co_await CppHTTPCoroutine::WhenAllAwaiter<T>{vecTasks, oState};
+
+   if (oState.pException)
+      std::rethrow_exception(oState.pException);
+
+   std::vector<T> vecResults;
+   vecResults.reserve(oState.vecResults.size());
+   for (auto &oResult : oState.vecResults)
+      vecResults.push_back(std::move(*oResult));
+   co_return vecResults;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "httpasyncclient.h"
+
+#include <unordered_set>
+
+class CppHTTPLoadBalancer;
+
+/* Active health checks of the endpoints of a CppHTTPLoadBalancer.
+ *
+ * Every iIntervalMs, each endpoint is probed with a HEAD or GET request of
+ * strPath through the asynchronous client, whose connection cache keeps the
+ * connections to the endpoints warm. A 2xx or 3xx answer within iTimeoutMs is
+ * healthy. While the checks run, an ejected endpoint is readmitted by a
+ * successful probe only, before any live request is routed to it, and
+ * consecutive failed probes eject an endpoint, see
+ * CppHTTPLoadBalancer::ReportProbe(). Loop thread only, as the timers of the client.
+ *
+ * Example Usage:
+ * @code
+ *    CppHTTPHealthChecker oChecker(oAsyncClient, pBalancer);
+ *    oChecker.Start();
+ *    // drive the loop of oAsyncClient
+ * @endcode
+ */
+class CppHTTPHealthChecker
+{
+public:
+   typedef CppHTTPAsyncClient::HttpResponse HttpResponse;
+
+   struct HealthCheckPolicy
+   {
+      HealthCheckPolicy() : eMethod(CppHTTPAsyncClient::HTTP_HEAD), strPath("/health"), iIntervalMs(5000),
+                            iTimeoutMs(1000) {}
+      CppHTTPAsyncClient::Method eMethod; // HTTP_HEAD or HTTP_GET
+      std::string strPath;                // appended to the base URL of the endpoints
+      int iIntervalMs;
+      int iTimeoutMs;
+   };
+
+   struct Stats
+   {
+      Stats() : ullProbes(0), ullFailures(0) {}
+      unsigned long long ullProbes;
+      unsigned long long ullFailures;
+   };
+
+   CppHTTPHealthChecker(CppHTTPAsyncClient &oClient, std::shared_ptr<CppHTTPLoadBalancer> pBalancer,
+                        const HealthCheckPolicy &oPolicy = HealthCheckPolicy());
+   ~CppHTTPHealthChecker();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPHealthChecker(const CppHTTPHealthChecker &Copy) = delete;
+   CppHTTPHealthChecker &operator=(const CppHTTPHealthChecker &Copy) = delete;
+
+   // probes at once, then every iIntervalMs until Stop()
+   void Start();
+   // cancels the probes in flight, the ejected endpoints are readmitted by time again
+   void Stop();
+   inline const bool IsRunning() const { return m_ullTimerId != 0; }
+
+   inline const HealthCheckPolicy &GetPolicy() const { return m_oPolicy; }
+   inline const Stats &GetStats() const { return m_oStats; }
+
+protected:
+   void RunChecks();
+   void OnProbe(const std::string &strEndpoint, const bool bSuccess, const HttpResponse &Response);
+
+   CppHTTPAsyncClient &m_oClient;
+   std::shared_ptr<CppHTTPLoadBalancer> m_pBalancer;
+   const HealthCheckPolicy m_oPolicy;
+   unsigned long long m_ullTimerId;
+   std::shared_ptr<CppHTTPCancelToken> m_pCancelToken; // probes of the current run
+   std::shared_ptr<int> m_pAlive;                      // watched by the completions of the probes
+   std::unordered_set<std::string> m_setProbing;       // endpoints with a probe in flight
+   Stats m_oStats;
+};
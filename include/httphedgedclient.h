@@ -0,0 +1,102 @@
+#pragma once
+
+#include "httpasyncclient.h"
+
+#include <deque>
+
+/* Hedged requests on top of CppHTTPAsyncClient, against the tail latency of replicated backends.
+ *
+ * A GET or HEAD request still unanswered after the hedge delay is sent a second
+ * time, to the same URL or to an alternate endpoint. The first successful answer
+ * completes the request and the other copy is cancelled. The delay follows a
+ * percentile of the recent latencies, and a budget caps the extra load. The other
+ * methods are submitted once. Loop thread only, as the timers of the client. */
+class CppHTTPHedgedClient
+{
+public:
+   typedef CppHTTPAsyncClient::Request Request;
+   typedef CppHTTPAsyncClient::HeadersMap HeadersMap;
+   typedef CppHTTPAsyncClient::HttpResponse HttpResponse;
+   typedef CppHTTPAsyncClient::CompletionFnCallback CompletionFnCallback;
+
+   struct HedgePolicy
+   {
+      HedgePolicy() : dPercentile(95.), iDefaultDelayMs(50), iMinDelayMs(1), usWindow(1000), usMinSamples(20),
+                      dBudgetPercent(10.) {}
+      double dPercentile;    // the hedge delay is this percentile of the recent latencies
+      int iDefaultDelayMs;   // hedge delay until usMinSamples latencies are known
+      int iMinDelayMs;       // lower bound of the hedge delay
+      size_t usWindow;       // number of recent latencies kept
+      size_t usMinSamples;
+      double dBudgetPercent; // hedges, in percent of the requests
+   };
+
+   struct Stats
+   {
+      Stats() : ullRequests(0), ullHedges(0), ullHedgeWins(0), ullBudgetDenied(0), iDelayMs(0) {}
+      unsigned long long ullRequests;     // hedgeable requests submitted
+      unsigned long long ullHedges;       // second copies sent
+      unsigned long long ullHedgeWins;    // requests answered by their second copy
+      unsigned long long ullBudgetDenied; // hedges not sent, the budget was spent
+      int iDelayMs;                       // current hedge delay
+
+      inline const double GetHedgeRate() const
+      {
+         return (ullRequests == 0) ? 0. : static_cast<double>(ullHedges) / ullRequests;
+      }
+      inline const double GetWinRate() const
+      {
+         return (ullHedges == 0) ? 0. : static_cast<double>(ullHedgeWins) / ullHedges;
+      }
+   };
+
+   explicit CppHTTPHedgedClient(CppHTTPAsyncClient &oClient, const HedgePolicy &oPolicy = HedgePolicy());
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPHedgedClient(const CppHTTPHedgedClient &Copy) = delete;
+   CppHTTPHedgedClient &operator=(const CppHTTPHedgedClient &Copy) = delete;
+
+   // Setters - Getters, the latencies already known are kept
+   void SetPolicy(const HedgePolicy &oPolicy);
+   inline const HedgePolicy &GetPolicy() const { return m_oPolicy; }
+   const Stats GetStats() const;
+
+   // REST requests, the second copy goes to strHedgeUrl when not empty
+   const bool Submit(const Request &oRequest, CompletionFnCallback oCompletion,
+                     const std::string &strHedgeUrl = std::string());
+   const bool Head(const std::string &strUrl, const HeadersMap &Headers, CompletionFnCallback oCompletion,
+                   const std::string &strHedgeUrl = std::string());
+   const bool Get(const std::string &strUrl, const HeadersMap &Headers, CompletionFnCallback oCompletion,
+                  const std::string &strHedgeUrl = std::string());
+
+protected:
+   // request and its copies, shared by their completion callbacks
+   struct Hedge
+   {
+      Hedge() : ullTimerId(0), ullCancelSubscription(0), usPending(0), bDone(false) {}
+      Request oRequest;
+      std::string strHedgeUrl;
+      CompletionFnCallback oCompletion;
+      CppHTTPAsyncClient::TimePoint tpStart;
+      std::shared_ptr<CppHTTPCancelToken> arrTokens[2]; // primary, hedge
+      unsigned long long ullTimerId;            // fires the hedge
+      unsigned long long ullCancelSubscription; // to the caller's token
+      size_t usPending;                         // copies in flight
+      bool bDone;
+   };
+
+   const bool SubmitCopy(std::shared_ptr<Hedge> pHedge, const size_t usCopy);
+   void SendHedge(std::shared_ptr<Hedge> pHedge);
+   void OnCompleted(std::shared_ptr<Hedge> pHedge, const size_t usCopy, const bool bSuccess, HttpResponse &Response);
+   void Finish(std::shared_ptr<Hedge> pHedge, const bool bSuccess, HttpResponse &Response);
+   void AddLatency(const int iLatencyMs);
+   void UpdateDelay();
+   const double GetMaxBudget() const;
+
+   CppHTTPAsyncClient &m_oClient;
+   HedgePolicy m_oPolicy;
+   std::deque<int> m_dqLatencies; // recent latencies, in milliseconds
+   int m_iDelayMs;
+   double m_dBudget; // hedges allowed, earned by the requests
+   Stats m_oStats;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Client-side load balancing of logical services, shared by the clients.
+ *
+ * A service is a set of base URLs ("http://10.0.0.1:8080"). The URLs
+ * "lb://<service>/path?query" given to a client with a load balancer are
+ * resolved per request into "<base URL>/path?query" of the endpoint picked by
+ * the strategy of the service:
+ *  - LB_ROUND_ROBIN: each endpoint in turn,
+ *  - LB_P2C: the least loaded of two random endpoints, by outstanding requests,
+ *  - LB_EWMA: same, the load being the decaying average latency (peak EWMA)
+ *    times the outstanding requests; failures count as iFailurePenaltyMs.
+ * An endpoint is the same origin from one request to the next, so the
+ * connection caches of the clients keep warm connections to each of them.
+ * The endpoint statistics are shared by the services listing the same base URL
+ * and survive the reloads. Thread-safe.
+ *
+ * Outlier ejection, see SetOutlierPolicy(): an endpoint whose error rate or
+ * latency stands out is taken out of its services for an ejection time doubled
+ * at each new ejection, then readmitted. When active health checks run (see
+ * CppHTTPHealthChecker) a readmission waits for a successful probe.
+ *
+ * The services can be read from a JSON file, reloaded when it changes:
+ * @code
+ *    { "users": { "strategy": "ewma", "endpoints": ["http://10.0.0.1:8080", "http://10.0.0.2:8080"] } }
+ * @endcode
+ *
+ * Example Usage:
+ * @code
+ *    auto pBalancer = std::make_shared<CppHTTPLoadBalancer>();
+ *    pBalancer->SetConfigFile("/etc/app/services.json");
+ *    m_pHTTPClient->SetLoadBalancer(pBalancer);
+ *    m_pHTTPClient->Get("lb://users/v1/users/42", mapHeaders, Response);
+ * @endcode
+ */
+class CppHTTPLoadBalancer
+{
+public:
+   enum Strategy
+   {
+      LB_ROUND_ROBIN,
+      LB_P2C,
+      LB_EWMA
+   };
+
+   struct EndpointStats
+   {
+      EndpointStats() : usOutstanding(0), ullRequests(0), ullFailures(0), dEwmaMs(0.), dErrorPercent(0.),
+                        bEjected(false), uEjections(0), ullEjections(0) {}
+      size_t usOutstanding;           // picked, not released yet
+      unsigned long long ullRequests; // released
+      unsigned long long ullFailures; // released as failed
+      double dEwmaMs;                 // decaying average latency, peaks included
+      double dErrorPercent;           // average error rate of the recent requests
+      bool bEjected;
+      unsigned uEjections;            // consecutive ejections, doubling the ejection time
+      unsigned long long ullEjections;
+   };
+
+   struct OutlierPolicy
+   {
+      OutlierPolicy() : bEnabled(true), dMaxErrorPercent(50.), dLatencyFactor(3.), usMinRequests(10),
+                        iBaseEjectionMs(1000), iMaxEjectionMs(30000), dMaxEjectedPercent(50.),
+                        usMaxProbeFailures(2) {}
+      bool bEnabled;
+      double dMaxErrorPercent;   // ejects the endpoints whose error rate reaches it...
+      double dLatencyFactor;     // ...or whose EWMA latency exceeds this factor of the median of the others (0: off)
+      size_t usMinRequests;      // requests measured since the admission before judging an endpoint
+      int iBaseEjectionMs;       // first ejection time, doubled at each consecutive ejection...
+      int iMaxEjectionMs;        // ...up to it, an endpoint admitted that long is forgiven
+      double dMaxEjectedPercent; // at most this part of the endpoints of a service is ejected
+      size_t usMaxProbeFailures; // consecutive failed health checks ejecting an endpoint
+   };
+
+   static const char *const SCHEME; // "lb://"
+
+   explicit CppHTTPLoadBalancer(const int iDecayMs = 10000, const int iFailurePenaltyMs = 1000);
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPLoadBalancer(const CppHTTPLoadBalancer &Copy) = delete;
+   CppHTTPLoadBalancer &operator=(const CppHTTPLoadBalancer &Copy) = delete;
+
+   // Services
+   void SetService(const std::string &strService, const std::vector<std::string> &vecEndpoints,
+                   const Strategy eStrategy = LB_ROUND_ROBIN);
+   void RemoveService(const std::string &strService);
+   const std::vector<std::string> GetEndpoints(const std::string &strService) const;
+   const size_t GetEndpointCount() const;
+
+   // services read from strPath, checked for changes every iCheckMs by Resolve() (0: never)
+   const bool SetConfigFile(const std::string &strPath, const int iCheckMs = 1000);
+   const bool Reload();
+
+   // picks an endpoint for an "lb://" URL, Release() must be called once the request ended
+   static const bool IsServiceUrl(const std::string &strUrl);
+   const bool Resolve(const std::string &strUrl, std::string &strResolved, std::string &strEndpoint);
+   void Release(const std::string &strEndpoint, const unsigned long long ullLatencyUs, const bool bSuccess);
+   // the request was not answered by the endpoint (cancelled, never sent...), only ends it
+   void Release(const std::string &strEndpoint);
+
+   const EndpointStats GetStats(const std::string &strEndpoint) const;
+   static const bool ParseStrategy(const std::string &strName, Strategy &eStrategy);
+
+   // Outlier ejection, disabled until a policy is set
+   void SetOutlierPolicy(const OutlierPolicy &oPolicy);
+   const OutlierPolicy GetOutlierPolicy() const;
+   // base URLs of all the endpoints, for the health checks
+   const std::vector<std::string> GetAllEndpoints() const;
+   // while active, the ejected endpoints wait for a successful probe to be readmitted
+   void SetActiveHealthChecks(const bool bActive);
+   void ReportProbe(const std::string &strEndpoint, const bool bHealthy);
+
+protected:
+   typedef std::chrono::steady_clock::time_point TimePoint;
+   typedef std::unordered_map<std::string, std::pair<Strategy, std::vector<std::string>>> ServiceMap;
+
+   struct Endpoint
+   {
+      Endpoint() : usAdmittedRequests(0), usProbeFailures(0) {}
+      EndpointStats oStats;
+      TimePoint tpUpdated;       // last update of dEwmaMs
+      TimePoint tpAdmitted;      // last readmission
+      TimePoint tpEjectedUntil;
+      size_t usAdmittedRequests; // measured since the last admission
+      size_t usProbeFailures;    // consecutive
+   };
+
+   struct Service
+   {
+      Service() : eStrategy(LB_ROUND_ROBIN), usNext(0) {}
+      Strategy eStrategy;
+      std::vector<std::string> vecEndpoints;
+      size_t usNext; // round-robin position
+   };
+
+   static const bool ReadConfig(const std::string &strPath, ServiceMap &mapServices);
+   const bool LoadConfig(const bool bForce);
+   void SetServiceLocked(const std::string &strService, const std::vector<std::string> &vecEndpoints,
+                         const Strategy eStrategy);
+   void PruneEndpoints();
+   const double GetLoad(const Endpoint &oEndpoint, const Strategy eStrategy, const double dDefaultMs) const;
+   const bool IsAdmitted(Endpoint &oEndpoint, const TimePoint &tpNow);
+   const bool IsOutlier(const std::string &strEndpoint, const Endpoint &oEndpoint) const;
+   const bool CanEject(const std::string &strEndpoint) const;
+   void Eject(Endpoint &oEndpoint, const TimePoint &tpNow);
+   void Readmit(Endpoint &oEndpoint, const TimePoint &tpNow);
+
+   const int m_iDecayMs;
+   const int m_iFailurePenaltyMs;
+
+   mutable std::mutex m_mtxServices; // guards everything below
+   std::unordered_map<std::string, Service> m_mapServices;
+   std::unordered_map<std::string, Endpoint> m_mapEndpoints; // by base URL
+   std::vector<size_t> m_vecAdmitted; // Resolve() scratch, endpoints of the service not ejected
+   std::mt19937 m_oRandom;
+   OutlierPolicy m_oOutlier;
+   bool m_bActiveHealthChecks;
+   std::string m_strConfigFile;
+   int m_iCheckMs;
+   TimePoint m_tpNextCheck;
+   long long m_llConfigMtimeNs; // modification time and size of the file last read
+   long long m_llConfigSize;
+};
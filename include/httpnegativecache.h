@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <curl/curl.h>
+
+/* Negative cache of the unreachable origins, shared by the clients.
+ *
+ * A request to an origin failing with a DNS failure (CURLE_COULDNT_RESOLVE_HOST)
+ * or a refused connection (CURLE_COULDNT_CONNECT) caches the failure for
+ * iDnsTtlMs or iConnectTtlMs. Until then, the requests to the origin fail at
+ * once with the cached error, without resolving nor connecting. Once the TTL
+ * elapsed, a single request re-probes the origin while the others keep
+ * failing fast: a success forgets the origin, a failure caches it again. The
+ * TTLs are drawn within +/- dJitter, so that the clients sharing a bad
+ * configuration don't re-probe together. The origins are keyed as the
+ * connection pools, see CppHTTPClient::GetHostKey(). Thread-safe.
+ *
+ * Example Usage:
+ * @code
+ *    auto pCache = std::make_shared<CppHTTPNegativeCache>();
+ *    oClient.SetNegativeCache(pCache);
+ *    oAsyncClient.SetNegativeCache(pCache);
+ * @endcode
+ */
+class CppHTTPNegativeCache
+{
+public:
+   typedef std::chrono::steady_clock::time_point TimePoint;
+
+   struct Policy
+   {
+      Policy() : iDnsTtlMs(5000), iConnectTtlMs(1000), dJitter(0.2), usMaxHosts(1024) {}
+      int iDnsTtlMs;      // name resolution failures
+      int iConnectTtlMs;  // refused connections
+      double dJitter;     // relative spread of the TTLs, in [0, 1]
+      size_t usMaxHosts;  // origins cached at most, the new ones aren't beyond
+   };
+
+   struct Stats
+   {
+      Stats() : usHosts(0), ullHits(0), ullProbes(0), ullCached(0) {}
+      size_t usHosts;               // origins currently cached
+      unsigned long long ullHits;   // requests failed fast
+      unsigned long long ullProbes; // requests let through to re-probe an origin
+      unsigned long long ullCached; // failures cached
+   };
+
+   explicit CppHTTPNegativeCache(const Policy &oPolicy = Policy());
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPNegativeCache(const CppHTTPNegativeCache &Copy) = delete;
+   CppHTTPNegativeCache &operator=(const CppHTTPNegativeCache &Copy) = delete;
+
+   /* true when the request must fail at once with eCached, otherwise
+    * OnResult() should be called with the result of the request */
+   const bool Check(const std::string &strHost, CURLcode &eCached);
+   void OnResult(const std::string &strHost, const CURLcode eResult);
+
+   const bool IsCached(const std::string &strHost) const;
+   void Clear();
+   const Stats GetStats() const;
+   inline const Policy &GetPolicy() const { return m_oPolicy; }
+
+   // the failures cached: DNS failures and refused connections
+   static const bool IsNegative(const CURLcode eResult);
+
+protected:
+   struct Entry
+   {
+      Entry() : eResult(CURLE_OK) {}
+      CURLcode eResult;
+      TimePoint tpExpiry; // next re-probe
+   };
+
+   const TimePoint NextExpiry(const CURLcode eResult, const TimePoint &tpNow);
+
+   const Policy m_oPolicy;
+
+   mutable std::mutex m_mtxHosts; // guards everything below
+   std::unordered_map<std::string, Entry> m_mapHosts;
+   std::mt19937 m_oRandom;
+   Stats m_oStats;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Token bucket rate limits of the requests, per origin or per URL prefix.
+ *
+ * A rule applies to the URLs starting with its prefix ("https://api.example.com"
+ * or "https://api.example.com/v1/orders"), the longest matching prefix wins and
+ * the URLs without a rule are not limited. For the "lb://" URLs, the rules
+ * match the service URL, before the load balancer picks an endpoint.
+ *
+ * Each rule is a bucket of usBurst tokens refilled at dRatePerSecond, kept as
+ * a single atomic "theoretical arrival time" (GCRA): taking a token is one
+ * compare-and-swap, with no mutex on the hot path.
+ *  - CppHTTPClient refuses a request without a token with ERR_RATE_LIMITED,
+ *  - CppHTTPAsyncClient reserves the next token and keeps the request in its
+ *    wait queue until then, up to iMaxDelayMs, beyond which it is refused.
+ *    The token of a request refused, cancelled or expired before being sent
+ *    is given back with Refund().
+ *
+ * AddRule() must be called before the limiter is shared with the clients,
+ * the rest is thread-safe.
+ *
+ * Example Usage:
+ * @code
+ *    auto pLimiter = std::make_shared<CppHTTPRateLimiter>();
+ *    pLimiter->AddRule("https://api.example.com", CppHTTPRateLimiter::Rule(50., 10));
+ *    oClient.SetRateLimiter(pLimiter);
+ * @endcode
+ */
+class CppHTTPRateLimiter
+{
+public:
+   typedef std::chrono::steady_clock::time_point TimePoint;
+
+   struct Rule
+   {
+      Rule(const double dRate = 10., const size_t usBurstSize = 1, const int iMaxDelay = 1000)
+          : dRatePerSecond(dRate), usBurst(usBurstSize), iMaxDelayMs(iMaxDelay) {}
+      double dRatePerSecond; // tokens refilled per second
+      size_t usBurst;        // tokens the bucket holds, the requests sent back to back
+      int iMaxDelayMs;       // CppHTTPAsyncClient: longest delay before a request is refused
+   };
+
+   struct RuleStats
+   {
+      RuleStats() : ullAdmitted(0), ullDelayed(0), ullRejected(0), ullRefunded(0), ullDelayUs(0) {}
+      unsigned long long ullAdmitted; // requests that took a token, delayed ones included
+      unsigned long long ullDelayed;  // requests that waited for their token
+      unsigned long long ullRejected;
+      unsigned long long ullRefunded; // tokens given back by requests not sent
+      unsigned long long ullDelayUs;  // sum of the delays, in microseconds
+   };
+
+   CppHTTPRateLimiter();
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPRateLimiter(const CppHTTPRateLimiter &Copy) = delete;
+   CppHTTPRateLimiter &operator=(const CppHTTPRateLimiter &Copy) = delete;
+
+   const bool AddRule(const std::string &strPrefix, const Rule &oRule);
+   inline const size_t GetRuleCount() const { return m_vecBuckets.size(); }
+
+   // takes a token at once, false when the bucket of the URL is empty
+   const bool TryAcquire(const std::string &strUrl);
+   /* reserves the next token of the bucket of the URL, tpReady receives the time
+    * it is available (TimePoint() without a rule), false beyond iMaxDelayMs */
+   const bool Reserve(const std::string &strUrl, TimePoint &tpReady);
+   // gives back a token reserved for a request that won't be sent
+   void Refund(const std::string &strUrl);
+
+   const RuleStats GetStats(const std::string &strPrefix) const;
+
+protected:
+   // allocated apart, the buckets of different rules are not packed together
+   struct Bucket
+   {
+      Bucket() : llIntervalNs(0), llBurstNs(0), llMaxDelayNs(0), llTat(0), ullAdmitted(0), ullDelayed(0),
+                 ullRejected(0), ullRefunded(0), ullDelayUs(0) {}
+      std::string strPrefix;
+      long long llIntervalNs; // between two tokens
+      long long llBurstNs;    // llIntervalNs * usBurst
+      long long llMaxDelayNs;
+      std::atomic<long long> llTat; // theoretical arrival time, since m_tpEpoch
+      std::atomic<unsigned long long> ullAdmitted;
+      std::atomic<unsigned long long> ullDelayed;
+      std::atomic<unsigned long long> ullRejected;
+      std::atomic<unsigned long long> ullRefunded;
+      std::atomic<unsigned long long> ullDelayUs;
+   };
+
+   static const unsigned long long HashOrigin(const std::string &strUrl, size_t &usLength);
+   Bucket *Find(const std::string &strUrl) const;
+   const bool Take(Bucket &oBucket, const long long llNowNs, const long long llMaxDelayNs, long long &llDelayNs);
+
+   const TimePoint m_tpEpoch;
+   std::vector<std::unique_ptr<Bucket>> m_vecBuckets; // longest prefix first
+   // hash of the origin of the prefixes -> their buckets, longest prefix first
+   std::unordered_map<unsigned long long, std::vector<Bucket *>> m_mapOrigins;
+};
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// queueing statistics of a priority class or a tenant
+struct CppHTTPQueueStats
+{
+   CppHTTPQueueStats() : usDepth(0), ullQueued(0), ullDispatched(0), ullTotalWaitUs(0), ullMaxWaitUs(0) {}
+   size_t usDepth;                     // requests currently waiting
+   unsigned long long ullQueued;       // requests queued since the creation
+   unsigned long long ullDispatched;   // requests that left the queue
+   unsigned long long ullTotalWaitUs;  // sum of the queueing latencies, in microseconds
+   unsigned long long ullMaxWaitUs;    // highest queueing latency, in microseconds
+};
+
+/* Requests waiting for a connection slot, one queue per priority class.
+ *
+ * Pop() returns the next eligible request of the most urgent class. To avoid
+ * starvation, a request is promoted by one class for every aging period spent
+ * in the queue.
+ *
+ * Inside a class, the tenants sharing the queue are served by deficit round
+ * robin: every turn, a tenant may dispatch as many requests as its weight, so
+ * under contention the slots are split according to the weights whatever the
+ * number of requests each tenant submits. Requests of a tenant are FIFO, kept
+ * in one sub-queue per host: the requests to a host without a free slot are
+ * skipped at once, whatever their number.
+ *
+ * A request pushed with a "not before" time is skipped until then, the
+ * requests after it remain eligible. Thread-safe. */
+template <typename T>
+class CppHTTPRequestQueue
+{
+public:
+   typedef std::chrono::steady_clock::time_point TimePoint;
+
+   explicit CppHTTPRequestQueue(const size_t usClasses)
+       : m_vecClasses(usClasses), m_vecStats(usClasses), m_iAgingMs(1000), m_ullPushed(0) {}
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPRequestQueue(const CppHTTPRequestQueue &Copy) = delete;
+   CppHTTPRequestQueue &operator=(const CppHTTPRequestQueue &Copy) = delete;
+
+   // aging period in milliseconds, 0 disables the promotion
+   inline void SetAgingMs(const int iAgingMs)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      m_iAgingMs = std::max(iAgingMs, 0);
+   }
+   inline const int GetAgingMs() const
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      return m_iAgingMs;
+   }
+
+   // requests a tenant may dispatch per round robin turn (1 by default)
+   void SetWeight(const std::string &strTenant, const unsigned uWeight)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      m_mapWeights[strTenant] = std::max(uWeight, 1u);
+   }
+   const unsigned GetWeight(const std::string &strTenant) const
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      return WeightOf(strTenant);
+   }
+
+   void Push(T Item, const size_t usClass, const std::string &strHostKey,
+             const std::string &strTenant = std::string(), const TimePoint &tpNotBefore = TimePoint())
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      size_t usIndex = std::min(usClass, m_vecClasses.size() - 1);
+      Class &oClass = m_vecClasses[usIndex];
+
+      Tenant &oTenant = oClass.mapTenants[strTenant];
+      if (oTenant.usSize == 0)
+         oClass.dqActive.push_back(strTenant);
+
+      Entry oEntry;
+      oEntry.Item = std::move(Item);
+      oEntry.ullSeq = ++m_ullPushed;
+      oEntry.tpQueued = std::chrono::steady_clock::now();
+      oEntry.tpNotBefore = tpNotBefore;
+      if (tpNotBefore != TimePoint())
+         m_setNotBefore.insert(tpNotBefore);
+      oTenant.mapHosts[strHostKey].push_back(std::move(oEntry));
+      ++oTenant.usSize;
+      ++oClass.usSize;
+
+      for (CppHTTPQueueStats *pStats : {&m_vecStats[usIndex], &m_mapTenantStats[strTenant]})
+      {
+         ++pStats->ullQueued;
+         ++pStats->usDepth;
+      }
+   }
+
+   /**
+    * @brief removes the next request to dispatch
+    *
+    * @param [in] fnEligible bool(const std::string &strHostKey), false when the host has no free slot
+    * @param [out] Item request to dispatch
+    * @param [out] pTenant optional, receives the tenant of the request
+    *
+    * @retval true   A request was removed.
+    * @retval false  No eligible request.
+    */
+   template <typename Predicate>
+   const bool Pop(Predicate fnEligible, T &Item, std::string *pTenant = nullptr)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      TimePoint tpNow = std::chrono::steady_clock::now();
+
+      Candidate oBest;
+      size_t usBestClass = m_vecClasses.size();
+      long long llBestRank = 0;
+
+      for (size_t usClass = 0; usClass < m_vecClasses.size(); ++usClass)
+      {
+         Candidate oCandidate;
+         if (!FindCandidate(m_vecClasses[usClass], fnEligible, tpNow, oCandidate))
+            continue;
+
+         // the next request of the class, promoted by its waiting time
+         long long llRank = static_cast<long long>(usClass);
+         if (m_iAgingMs > 0)
+            llRank -= std::chrono::duration_cast<std::chrono::milliseconds>(tpNow - oCandidate.pEntry->tpQueued).count() / m_iAgingMs;
+
+         if (usBestClass == m_vecClasses.size() || llRank < llBestRank)
+         {
+            oBest = oCandidate;
+            usBestClass = usClass;
+            llBestRank = llRank;
+         }
+      }
+
+      if (usBestClass == m_vecClasses.size())
+         return false;
+
+      Class &oClass = m_vecClasses[usBestClass];
+      const std::string strTenant = oClass.dqActive[oBest.usActive];
+      Tenant &oTenant = oClass.mapTenants[strTenant];
+      unsigned long long ullWaitUs = static_cast<unsigned long long>(
+          std::chrono::duration_cast<std::chrono::microseconds>(tpNow - oBest.pEntry->tpQueued).count());
+
+      for (CppHTTPQueueStats *pStats : {&m_vecStats[usBestClass], &m_mapTenantStats[strTenant]})
+      {
+         --pStats->usDepth;
+         ++pStats->ullDispatched;
+         pStats->ullTotalWaitUs += ullWaitUs;
+         pStats->ullMaxWaitUs = std::max(pStats->ullMaxWaitUs, ullWaitUs);
+      }
+
+      Item = std::move(oBest.pEntry->Item);
+      ForgetNotBefore(*oBest.pEntry);
+      std::deque<Entry> &dqEntries = oBest.itHost->second;
+      dqEntries.erase(dqEntries.begin() + oBest.usEntry);
+      if (dqEntries.empty())
+         oTenant.mapHosts.erase(oBest.itHost);
+      --oTenant.usSize;
+      --oClass.usSize;
+      if (pTenant)
+         *pTenant = strTenant;
+
+      // deficit round robin: the turn of the tenant ends with its credit
+      if (oTenant.uDeficit == 0)
+         oTenant.uDeficit = WeightOf(strTenant);
+      --oTenant.uDeficit;
+
+      if (oTenant.usSize == 0)
+      {
+         oClass.dqActive.erase(oClass.dqActive.begin() + oBest.usActive);
+         oClass.mapTenants.erase(strTenant);
+      }
+      else if (oTenant.uDeficit == 0)
+      {
+         oClass.dqActive.erase(oClass.dqActive.begin() + oBest.usActive);
+         oClass.dqActive.push_back(strTenant);
+      }
+
+      return true;
+   }
+
+   // removes the request that waited the longest, whatever its class and tenant
+   const bool PopOldest(T &Item)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      const Entry *pOldest = nullptr;
+      size_t usBestClass = 0;
+      size_t usBestActive = 0;
+      typename HostMap::iterator itBestHost;
+      for (size_t usClass = 0; usClass < m_vecClasses.size(); ++usClass)
+      {
+         Class &oClass = m_vecClasses[usClass];
+         // the requests to a host are FIFO, its oldest one is the first
+         for (size_t usActive = 0; usActive < oClass.dqActive.size(); ++usActive)
+         {
+            HostMap &mapHosts = oClass.mapTenants[oClass.dqActive[usActive]].mapHosts;
+            for (auto itHost = mapHosts.begin(); itHost != mapHosts.end(); ++itHost)
+            {
+               const Entry &oEntry = itHost->second.front();
+               if (pOldest == nullptr || oEntry.ullSeq < pOldest->ullSeq)
+               {
+                  pOldest = &oEntry;
+                  usBestClass = usClass;
+                  usBestActive = usActive;
+                  itBestHost = itHost;
+               }
+            }
+         }
+      }
+
+      if (pOldest == nullptr)
+         return false;
+
+      Class &oClass = m_vecClasses[usBestClass];
+      const std::string strTenant = oClass.dqActive[usBestActive];
+      Tenant &oTenant = oClass.mapTenants[strTenant];
+      std::deque<Entry> &dqEntries = itBestHost->second;
+      Item = std::move(dqEntries.front().Item);
+      ForgetNotBefore(dqEntries.front());
+      dqEntries.pop_front();
+      if (dqEntries.empty())
+         oTenant.mapHosts.erase(itBestHost);
+      --oTenant.usSize;
+      --oClass.usSize;
+      --m_vecStats[usBestClass].usDepth;
+      --m_mapTenantStats[strTenant].usDepth;
+
+      if (oTenant.usSize == 0)
+      {
+         oClass.mapTenants.erase(strTenant);
+         oClass.dqActive.erase(oClass.dqActive.begin() + usBestActive);
+      }
+      return true;
+   }
+
+   // removes the requests matching fnMatch, bool(const T &Item)
+   template <typename Match>
+   std::vector<T> RemoveIf(Match fnMatch)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      std::vector<T> vecItems;
+      for (size_t usClass = 0; usClass < m_vecClasses.size(); ++usClass)
+      {
+         Class &oClass = m_vecClasses[usClass];
+         for (size_t usActive = 0; usActive < oClass.dqActive.size();)
+         {
+            const std::string strTenant = oClass.dqActive[usActive];
+            Tenant &oTenant = oClass.mapTenants[strTenant];
+            for (auto itHost = oTenant.mapHosts.begin(); itHost != oTenant.mapHosts.end();)
+            {
+               std::deque<Entry> &dqEntries = itHost->second;
+               for (auto it = dqEntries.begin(); it != dqEntries.end();)
+               {
+                  if (!fnMatch(it->Item))
+                  {
+                     ++it;
+                     continue;
+                  }
+
+                  vecItems.push_back(std::move(it->Item));
+                  ForgetNotBefore(*it);
+                  it = dqEntries.erase(it);
+                  --oTenant.usSize;
+                  --oClass.usSize;
+                  --m_vecStats[usClass].usDepth;
+                  --m_mapTenantStats[strTenant].usDepth;
+               }
+
+               if (dqEntries.empty())
+                  itHost = oTenant.mapHosts.erase(itHost);
+               else
+                  ++itHost;
+            }
+
+            if (oTenant.usSize == 0)
+            {
+               oClass.mapTenants.erase(strTenant);
+               oClass.dqActive.erase(oClass.dqActive.begin() + usActive);
+            }
+            else
+               ++usActive;
+         }
+      }
+      return vecItems;
+   }
+
+   // removes every request, in priority order
+   std::vector<T> Clear()
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      std::vector<T> vecItems;
+      for (size_t usClass = 0; usClass < m_vecClasses.size(); ++usClass)
+      {
+         Class &oClass = m_vecClasses[usClass];
+         for (const std::string &strTenant : oClass.dqActive)
+         {
+            // back to the order of submission of the tenant
+            std::vector<Entry *> vecEntries;
+            for (auto &oHost : oClass.mapTenants[strTenant].mapHosts)
+            {
+               for (Entry &oEntry : oHost.second)
+                  vecEntries.push_back(&oEntry);
+            }
+            std::sort(vecEntries.begin(), vecEntries.end(),
+                      [](const Entry *pLeft, const Entry *pRight) { return pLeft->ullSeq < pRight->ullSeq; });
+            for (Entry *pEntry : vecEntries)
+               vecItems.push_back(std::move(pEntry->Item));
+         }
+         oClass.mapTenants.clear();
+         oClass.dqActive.clear();
+         oClass.usSize = 0;
+         m_vecStats[usClass].usDepth = 0;
+      }
+      for (auto &oTenantStats : m_mapTenantStats)
+         oTenantStats.second.usDepth = 0;
+      m_setNotBefore.clear();
+      return vecItems;
+   }
+
+   const size_t Size() const
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      size_t usSize = 0;
+      for (const Class &oClass : m_vecClasses)
+         usSize += oClass.usSize;
+      return usSize;
+   }
+
+   // earliest "not before" time still in the future, TimePoint() for none
+   const TimePoint NextNotBefore() const
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      auto it = m_setNotBefore.upper_bound(std::chrono::steady_clock::now());
+      return (it != m_setNotBefore.end()) ? *it : TimePoint();
+   }
+
+   const CppHTTPQueueStats GetStats(const size_t usClass) const
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      return m_vecStats[std::min(usClass, m_vecStats.size() - 1)];
+   }
+
+   const CppHTTPQueueStats GetTenantStats(const std::string &strTenant) const
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      auto it = m_mapTenantStats.find(strTenant);
+      return (it != m_mapTenantStats.end()) ? it->second : CppHTTPQueueStats();
+   }
+
+protected:
+   struct Entry
+   {
+      T Item;
+      unsigned long long ullSeq; // order of submission
+      TimePoint tpQueued;
+      TimePoint tpNotBefore; // TimePoint() when eligible at once
+   };
+
+   // host key -> requests to the host, FIFO
+   typedef std::map<std::string, std::deque<Entry>> HostMap;
+
+   struct Tenant
+   {
+      Tenant() : usSize(0), uDeficit(0) {}
+      HostMap mapHosts;
+      size_t usSize;
+      unsigned uDeficit; // requests left in the current turn
+   };
+
+   struct Class
+   {
+      Class() : usSize(0) {}
+      std::map<std::string, Tenant> mapTenants;
+      std::deque<std::string> dqActive; // round robin order of the tenants with waiting requests
+      size_t usSize;
+   };
+
+   struct Candidate
+   {
+      Candidate() : usActive(0), usEntry(0), pEntry(nullptr) {}
+      size_t usActive; // index in Class::dqActive
+      typename HostMap::iterator itHost;
+      size_t usEntry;  // index in the requests to the host
+      Entry *pEntry;
+   };
+
+   /* first tenant in round robin order with an eligible request, and its oldest eligible request.
+    * fnEligible is called once per host of a tenant, not per request */
+   template <typename Predicate>
+   static bool FindCandidate(Class &oClass, Predicate &fnEligible, const TimePoint &tpNow, Candidate &oCandidate)
+   {
+      for (size_t usActive = 0; usActive < oClass.dqActive.size(); ++usActive)
+      {
+         HostMap &mapHosts = oClass.mapTenants[oClass.dqActive[usActive]].mapHosts;
+         oCandidate.pEntry = nullptr;
+         for (auto itHost = mapHosts.begin(); itHost != mapHosts.end(); ++itHost)
+         {
+            if (!fnEligible(itHost->first))
+               continue;
+
+            // the paced requests are skipped, the next one to the host is its candidate
+            std::deque<Entry> &dqEntries = itHost->second;
+            for (size_t usEntry = 0; usEntry < dqEntries.size(); ++usEntry)
+            {
+               if (dqEntries[usEntry].tpNotBefore > tpNow)
+                  continue;
+
+               if (oCandidate.pEntry == nullptr || dqEntries[usEntry].ullSeq < oCandidate.pEntry->ullSeq)
+               {
+                  oCandidate.usActive = usActive;
+                  oCandidate.itHost = itHost;
+                  oCandidate.usEntry = usEntry;
+                  oCandidate.pEntry = &dqEntries[usEntry];
+               }
+               break;
+            }
+         }
+         if (oCandidate.pEntry != nullptr)
+            return true;
+      }
+      return false;
+   }
+
+   // the entry leaves the queue
+   inline void ForgetNotBefore(const Entry &oEntry)
+   {
+      if (oEntry.tpNotBefore == TimePoint())
+         return;
+      auto it = m_setNotBefore.find(oEntry.tpNotBefore);
+      if (it != m_setNotBefore.end())
+         m_setNotBefore.erase(it);
+   }
+
+   const unsigned WeightOf(const std::string &strTenant) const
+   {
+      auto it = m_mapWeights.find(strTenant);
+      return (it != m_mapWeights.end()) ? it->second : 1u;
+   }
+
+   mutable std::mutex m_mtxQueue;
+   std::vector<Class> m_vecClasses;
+   std::vector<CppHTTPQueueStats> m_vecStats;
+   std::map<std::string, CppHTTPQueueStats> m_mapTenantStats;
+   std::map<std::string, unsigned> m_mapWeights;
+   int m_iAgingMs;
+   unsigned long long m_ullPushed;
+   std::multiset<TimePoint> m_setNotBefore; // "not before" times of the queued requests, for NextNotBefore()
+};
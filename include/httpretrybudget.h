@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* Retry budget, a token bucket per origin shared by the clients.
+ *
+ * Each request deposits dRetryPercent / 100 token in the bucket of its origin
+ * and each retry withdraws one, so the retries can't exceed dRetryPercent % of
+ * the traffic, whatever the number of clients retrying against a failing host.
+ * dMinRetriesPerSec tokens are added every second, and a new origin starts with
+ * them, so that a low traffic can still retry. A bucket holds at most the
+ * tokens of 100 requests and one second. Thread-safe.
+ *
+ * Example Usage:
+ * @code
+ *    CppHTTPClient::RetryPolicy oRetry;
+ *    oRetry.uMaxAttempts = 3;
+ *    oRetry.pBudget = std::make_shared<CppHTTPRetryBudget>(10.);
+ *    m_pHTTPClient->SetRetryPolicy(oRetry);
+ * @endcode
+ */
+class CppHTTPRetryBudget
+{
+public:
+   struct Stats
+   {
+      Stats() : ullRequests(0), ullRetries(0), ullDenied(0) {}
+      unsigned long long ullRequests; // requests deposited
+      unsigned long long ullRetries;  // retries allowed
+      unsigned long long ullDenied;   // retries refused, the bucket was empty
+   };
+
+   explicit CppHTTPRetryBudget(const double dRetryPercent = 10., const double dMinRetriesPerSec = 1.);
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPRetryBudget(const CppHTTPRetryBudget &Copy) = delete;
+   CppHTTPRetryBudget &operator=(const CppHTTPRetryBudget &Copy) = delete;
+
+   // strHost is the origin, see CppHTTPClient::GetHostKey()
+   void Deposit(const std::string &strHost);
+   const bool TryWithdraw(const std::string &strHost);
+
+   const double GetTokens(const std::string &strHost) const;
+   const Stats GetStats() const;
+
+protected:
+   struct Bucket
+   {
+      Bucket() : dTokens(0.) {}
+      double dTokens;
+      std::chrono::steady_clock::time_point tpRefill; // last time based refill
+   };
+
+   Bucket &Refill(const std::string &strHost);
+
+   const double m_dRetryRatio;
+   const double m_dMinRetriesPerSec;
+   const double m_dMaxTokens;
+
+   mutable std::mutex m_mtxBuckets; // guards everything below
+   std::unordered_map<std::string, Bucket> m_mapBuckets;
+   Stats m_oStats;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "httpclient.h"
+
+#include <future>
+#include <map>
+
+/* Coalescing of identical concurrent requests (singleflight).
+ *
+ * The first caller of a key performs the request, the callers arriving while
+ * it is in flight wait for it and get the same response, shared and
+ * immutable. The key is removed once the request completed, so a later call
+ * performs a new request: nothing is cached. Thread-safe, a single instance
+ * is shared by the clients through CppHTTPClient::SetSingleFlight(). */
+class CppHTTPSingleFlight
+{
+public:
+   typedef CppHTTPClient::HeadersMap HeadersMap;
+   typedef CppHTTPClient::HttpResponse HttpResponse;
+   typedef CppHTTPClient::SharedResponse SharedResponse;
+   typedef std::function<const bool(HttpResponse &)> FetchFnCallback;
+
+   struct Stats
+   {
+      Stats() : ullRequests(0), ullTransfers(0), ullCoalesced(0), usInFlight(0) {}
+      unsigned long long ullRequests;  // calls of Do()
+      unsigned long long ullTransfers; // requests actually performed
+      unsigned long long ullCoalesced; // calls served by a request in flight
+      size_t usInFlight;               // keys in flight
+
+      // part of the calls served without a request of their own
+      inline const double GetCoalescingRatio() const
+      {
+         return (ullRequests == 0) ? 0. : static_cast<double>(ullCoalesced) / ullRequests;
+      }
+   };
+
+   /* the key of a request is its method, its URL and the values of vecKeyHeaders
+    * (case-insensitive names), all the headers when vecKeyHeaders is empty */
+   explicit CppHTTPSingleFlight(const std::vector<std::string> &vecKeyHeaders = std::vector<std::string>());
+
+   // copy constructor and assignment operator are disabled
+   CppHTTPSingleFlight(const CppHTTPSingleFlight &Copy) = delete;
+   CppHTTPSingleFlight &operator=(const CppHTTPSingleFlight &Copy) = delete;
+
+   const std::string MakeKey(const std::string &strMethod, const std::string &strUrl,
+                             const HeadersMap &Headers) const;
+
+   // runs oFetch, or waits for the call of the same key in flight
+   const bool Do(const std::string &strKey, FetchFnCallback oFetch, SharedResponse &pResponse);
+
+   const Stats GetStats() const;
+
+protected:
+   typedef std::pair<bool, SharedResponse> Result;
+
+   std::vector<std::string> m_vecKeyHeaders; // lower case
+
+   mutable std::mutex m_mtxFlights; // guards everything below
+   std::map<std::string, std::shared_future<Result>> m_mapFlights;
+   Stats m_oStats;
+};
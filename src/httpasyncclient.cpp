@@ -0,0 +1,1975 @@
+#include "httpasyncclient.h"
+#include "httpcompletionqueue.h"
+#include "httpconcurrencylimiter.h"
+#include "httploadbalancer.h"
+#include "httpnegativecache.h"
+#include "httpratelimiter.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <unordered_set>
+
+/**
+ * @brief constructor of the asynchronous HTTP client object
+ *
+ * @param Logger - a callabck to a logger function void(const std::string&)
+ *
+ */
+CppHTTPAsyncClient::CppHTTPAsyncClient(LogFnCallback Logger) : m_bHTTPS(false),
+                                                               m_eSettingsFlags(CppHTTPClient::ALL_FLAGS),
+                                                               m_iCurlTimeout(0),
+                                                               m_pCurlMulti(nullptr),
+                                                               m_lMaxRetryAfterMs(60000),
+                                                               m_usMaxInFlight(0),
+                                                               m_usMaxHostInFlight(0),
+                                                               m_oQueue(PRIORITY_COUNT),
+                                                               m_usMaxQueued(0),
+                                                               m_eOverflowPolicy(OVERFLOW_REJECT),
+                                                               m_bWakeupPending(false),
+                                                               m_bCancelPending(false),
+                                                               m_bDraining(false),
+                                                               m_bDrainExpired(false),
+                                                               m_idLoopThread(std::thread::id()),
+                                                               m_ullDeadlineTimerId(0),
+                                                               m_ullPacingTimerId(0),
+                                                               m_bCurlTimerArmed(false),
+                                                               m_ullLastTimerId(0),
+                                                               m_bTimerArmed(false),
+                                                               m_usMaxBatch(64),
+                                                               m_iMaxBatchDelayMs(0),
+                                                               m_ullFlushTimerId(0),
+                                                               m_oLog(Logger)
+{
+   m_arrWakeupPipe[0] = m_arrWakeupPipe[1] = -1;
+
+   CppHTTPClient::s_mtxCurlSession.lock();
+   if (CppHTTPClient::s_iCurlSession++ == 0)
+   {
+      curl_global_init(CURL_GLOBAL_ALL);
+   }
+   CppHTTPClient::s_mtxCurlSession.unlock();
+}
+
+/**
+ * @brief destructor of the asynchronous HTTP client object
+ *
+ */
+CppHTTPAsyncClient::~CppHTTPAsyncClient()
+{
+   if (m_pCurlMulti != nullptr)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_WARNING_ASYNC_OBJECT_NOT_CLEANED);
+
+      CleanupSession();
+   }
+
+   CppHTTPClient::s_mtxCurlSession.lock();
+   if (--CppHTTPClient::s_iCurlSession <= 0)
+   {
+      curl_global_cleanup();
+   }
+   CppHTTPClient::s_mtxCurlSession.unlock();
+}
+
+/**
+ * @brief Starts a new asynchronous session, initializes the cURL multi handle
+ *
+ * The read end of the wakeup pipe is reported to the socket callback, the event
+ * loop must watch it like any other socket.
+ *
+ * @param [in] bHTTPS Enable/Disable HTTPS (disabled by default)
+ * @param [in] eSettingsFlags optional use | operator to choose multiple options
+ *
+ * @retval true   Successfully initialized the session.
+ * @retval false  The session is already initialized or the multi handle could not be created.
+ *
+ * Example Usage:
+ * @code
+ *    m_pAsyncClient->SetSocketCallback([&](curl_socket_t s, int ev) { WatchSocket(s, ev); });
+ *    m_pAsyncClient->SetTimerCallback([&](long ms) { ArmTimer(ms); });
+ *    m_pAsyncClient->InitSession();
+ * @endcode
+ */
+const bool CppHTTPAsyncClient::InitSession(const bool &bHTTPS /* = false */,
+                                           const SettingsFlag &eSettingsFlags /* = ALL_FLAGS */)
+{
+   if (m_pCurlMulti)
+   {
+      if (eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_ALREADY_INIT_MSG);
+
+      return false;
+   }
+
+   if (pipe(m_arrWakeupPipe) != 0)
+      return false;
+
+   for (int fd : m_arrWakeupPipe)
+   {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+   }
+
+   m_pCurlMulti = curl_multi_init();
+   if (m_pCurlMulti == nullptr)
+   {
+      close(m_arrWakeupPipe[0]);
+      close(m_arrWakeupPipe[1]);
+      m_arrWakeupPipe[0] = m_arrWakeupPipe[1] = -1;
+      return false;
+   }
+
+   curl_multi_setopt(m_pCurlMulti, CURLMOPT_SOCKETFUNCTION, &CppHTTPAsyncClient::SocketCallback);
+   curl_multi_setopt(m_pCurlMulti, CURLMOPT_SOCKETDATA, this);
+   curl_multi_setopt(m_pCurlMulti, CURLMOPT_TIMERFUNCTION, &CppHTTPAsyncClient::TimerCallback);
+   curl_multi_setopt(m_pCurlMulti, CURLMOPT_TIMERDATA, this);
+
+   m_bHTTPS = bHTTPS;
+   m_eSettingsFlags = eSettingsFlags;
+
+   m_mapSockets[m_arrWakeupPipe[0]] = EVENT_IN;
+   if (m_oSocket)
+      m_oSocket(m_arrWakeupPipe[0], EVENT_IN);
+
+   return true;
+}
+
+/**
+ * @brief Cleans the current asynchronous session
+ *
+ * Pending requests are aborted, their completion callbacks are called with a failure.
+ *
+ * @retval true   Successfully cleaned the current session.
+ * @retval false  The session is not already initialized.
+ */
+const bool CppHTTPAsyncClient::CleanupSession()
+{
+   if (!m_pCurlMulti)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   // new requests are refused, the blocked Submit() calls give up
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      m_bDraining = true;
+      m_cvQueueSpace.notify_all();
+   }
+
+   size_t usAborted = AbortPending();
+   if (usAborted > 0 && (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG))
+      m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_ABORTED_FORMAT, static_cast<unsigned>(usAborted)));
+   m_mapHostInFlight.clear();
+   m_mapHostPausedUntil.clear();
+
+   FlushBatch(true);
+   m_mapTimers.clear();
+   m_ullFlushTimerId = 0;
+
+   curl_multi_cleanup(m_pCurlMulti);
+   m_pCurlMulti = nullptr;
+
+   if (m_oSocket)
+      m_oSocket(m_arrWakeupPipe[0], EVENT_NONE);
+   if (m_oTimer && m_bTimerArmed)
+      m_oTimer(-1);
+
+   close(m_arrWakeupPipe[0]);
+   close(m_arrWakeupPipe[1]);
+   m_arrWakeupPipe[0] = m_arrWakeupPipe[1] = -1;
+
+   m_mapSockets.clear();
+   m_bCurlTimerArmed = false;
+   m_bTimerArmed = false;
+   m_bWakeupPending = false;
+   m_bCancelPending = false;
+   m_tpNextExpiry = TimePoint();
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      m_bDraining = false;
+   }
+   m_ullDeadlineTimerId = 0;
+   m_tpDeadlineTimer = TimePoint();
+   m_ullPacingTimerId = 0;
+   m_tpPacingTimer = TimePoint();
+
+   return true;
+}
+
+/**
+ * @brief Drains then cleans the current asynchronous session (loop thread)
+ *
+ * New requests are refused at once. The running and queued requests go on,
+ * driven by Poll(), until they are all completed or tpDeadline is reached:
+ * the remaining ones are then aborted, their completion callbacks receive
+ * Response.eError == ERR_DRAINED. The pooled connections are closed by
+ * CleanupSession() before returning, so Drain() returns by tpDeadline plus
+ * the time of the last completion callbacks.
+ *
+ * @param [in] tpDeadline time after which the pending requests are aborted
+ *
+ * @retval true   Every pending request completed before the deadline.
+ * @retval false  Requests were aborted, or the session is not initialized.
+ *
+ * Example Usage:
+ * @code
+ *    m_pAsyncClient->Drain(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+ * @endcode
+ */
+const bool CppHTTPAsyncClient::Drain(const TimePoint &tpDeadline)
+{
+   if (!m_pCurlMulti)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      m_bDraining = true;
+      m_cvQueueSpace.notify_all();
+   }
+
+   while (GetPendingCount() > 0)
+   {
+      long lRemainingMs = CppHTTPClient::RemainingMs(tpDeadline, std::chrono::steady_clock::now());
+      if (lRemainingMs <= 0 || Poll(static_cast<int>(std::min(lRemainingMs, 1000L))) < 0)
+         break;
+   }
+
+   m_bDrainExpired = true;
+   size_t usAborted = AbortPending();
+   m_bDrainExpired = false;
+   if (usAborted > 0 && (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG))
+      m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_DRAINED_FORMAT, static_cast<unsigned>(usAborted)));
+
+   CleanupSession();
+
+   return usAborted == 0;
+}
+
+/**
+ * @brief sets the queue receiving the completions of the requests submitted
+ * without completion callback
+ *
+ * @param [in] pQueue completion queue, nullptr to disable the batched delivery
+ * @param [in] usMaxBatch maximum number of completions per batch
+ * @param [in] iMaxDelayMs maximum time a completion waits for its batch to be published
+ *
+ * Example Usage:
+ * @code
+ *    auto pQueue = std::make_shared<CppHTTPCompletionQueue>();
+ *    m_pAsyncClient->SetCompletionQueue(pQueue, 256, 5);
+ *    m_pAsyncClient->Get(strUrl, Headers, nullptr);
+ *    // consumer thread
+ *    CppHTTPCompletionQueue::Batch vecCompletions;
+ *    pQueue->Drain(vecCompletions, -1);
+ * @endcode
+ */
+void CppHTTPAsyncClient::SetCompletionQueue(std::shared_ptr<CppHTTPCompletionQueue> pQueue,
+                                            const size_t usMaxBatch /* = 64 */, const int iMaxDelayMs /* = 0 */)
+{
+   FlushBatch(true);
+
+   m_pCompletionQueue = pQueue;
+   m_usMaxBatch = std::max<size_t>(usMaxBatch, 1);
+   m_iMaxBatchDelayMs = std::max(iMaxDelayMs, 0);
+   m_vecBatch.reserve(m_usMaxBatch);
+}
+
+/**
+ * @brief bounds the wait queue, can be called from any thread
+ *
+ * Requests wait in the queue while SetMaxInFlight()/SetMaxHostInFlight() slots
+ * are busy. Bounding it keeps the memory in check when the backends slow down.
+ *
+ * @param [in] usMaxQueued maximum number of waiting requests, 0 for unlimited
+ * @param [in] ePolicy behaviour of Submit() on a full queue
+ */
+void CppHTTPAsyncClient::SetQueueLimit(const size_t usMaxQueued, const OverflowPolicy ePolicy /* = OVERFLOW_REJECT */)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   m_usMaxQueued = usMaxQueued;
+   m_eOverflowPolicy = ePolicy;
+   m_cvQueueSpace.notify_all();
+}
+
+const size_t CppHTTPAsyncClient::GetMaxQueued() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   return m_usMaxQueued;
+}
+
+const CppHTTPAsyncClient::OverflowPolicy CppHTTPAsyncClient::GetOverflowPolicy() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   return m_eOverflowPolicy;
+}
+
+/**
+ * @brief returns the admission control statistics, can be called from any thread
+ */
+const CppHTTPAsyncClient::AdmissionStats CppHTTPAsyncClient::GetAdmissionStats() const
+{
+   AdmissionStats oStats;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      oStats = m_oAdmission;
+      oStats.usInFlight = m_mapRunning.size();
+   }
+
+   for (size_t usClass = 0; usClass < PRIORITY_COUNT; ++usClass)
+   {
+      CppHTTPQueueStats oClass = m_oQueue.GetStats(usClass);
+      oStats.oQueue.usDepth += oClass.usDepth;
+      oStats.oQueue.ullQueued += oClass.ullQueued;
+      oStats.oQueue.ullDispatched += oClass.ullDispatched;
+      oStats.oQueue.ullTotalWaitUs += oClass.ullTotalWaitUs;
+      oStats.oQueue.ullMaxWaitUs = std::max(oStats.oQueue.ullMaxWaitUs, oClass.ullMaxWaitUs);
+   }
+   return oStats;
+}
+
+/**
+ * @brief returns the statistics of a tenant, can be called from any thread
+ *
+ * @param [in] strTenant tenant, see Request::strTenant
+ */
+const CppHTTPAsyncClient::TenantStats CppHTTPAsyncClient::GetTenantStats(const std::string &strTenant) const
+{
+   TenantStats oStats;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      auto it = m_mapTenantStats.find(strTenant);
+      if (it != m_mapTenantStats.end())
+         oStats = it->second;
+   }
+   oStats.oQueue = m_oQueue.GetTenantStats(strTenant);
+   return oStats;
+}
+
+/**
+ * @brief returns the pauses asked by an origin through Retry-After
+ *
+ * @param [in] strHost origin, see CppHTTPClient::GetHostKey()
+ */
+const CppHTTPAsyncClient::ThrottleStats CppHTTPAsyncClient::GetThrottleStats(const std::string &strHost) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   auto it = m_mapThrottles.find(strHost);
+   return (it != m_mapThrottles.end()) ? it->second : ThrottleStats();
+}
+
+/**
+ * @brief returns the number of submitted requests that are not completed yet
+ */
+const size_t CppHTTPAsyncClient::GetPendingCount() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   return m_mapRunning.size() + m_oQueue.Size() + m_vecDropped.size();
+}
+
+// REST REQUESTS
+
+/**
+ * @brief submits a request, can be called from any thread
+ *
+ * The request waits in the queue of its priority class until the loop thread
+ * processes the wakeup pipe and a connection slot is free, oCompletion is then
+ * called from the loop thread. A full wait queue is handled according to the
+ * policy set by SetQueueLimit().
+ *
+ * @param [in] oRequest request to perform
+ * @param [in] oCompletion completion callback
+ *
+ * @retval true   Successfully submitted the request.
+ * @retval false  Encountered a problem (empty URL, session not initialized, draining or full queue).
+ */
+const bool CppHTTPAsyncClient::Submit(const Request &oRequest, CompletionFnCallback oCompletion)
+{
+   return Enqueue(oRequest, oCompletion, false);
+}
+
+/**
+ * @brief submits a request if the wait queue has room, can be called from any thread
+ *
+ * Unlike Submit(), never waits nor drops a waiting request: fails at once,
+ * before building the request, when the queue is full.
+ *
+ * @param [in] oRequest request to perform
+ * @param [in] oCompletion completion callback
+ *
+ * @retval true   Successfully submitted the request.
+ * @retval false  The queue is full, or Submit() would have failed.
+ */
+const bool CppHTTPAsyncClient::TrySubmit(const Request &oRequest, CompletionFnCallback oCompletion)
+{
+   return Enqueue(oRequest, oCompletion, true);
+}
+
+/**
+ * @brief admission control then queueing of a request
+ *
+ * @param [in] oRequest request to perform
+ * @param [in] oCompletion completion callback
+ * @param [in] bTry fail at once on a full queue, whatever the overflow policy
+ */
+const bool CppHTTPAsyncClient::Enqueue(const Request &oRequest, CompletionFnCallback oCompletion, const bool bTry)
+{
+   if (oRequest.strUrl.empty())
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_EMPTY_HOST_MSG);
+
+      return false;
+   }
+   if (!m_pCurlMulti)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_NOT_INIT_MSG);
+
+      return false;
+   }
+
+   // only the loop thread frees places: a completion callback, a timer or a coroutine
+   // submitting from it would wait forever, it is refused as with OVERFLOW_REJECT
+   const bool bLoopThread = std::this_thread::get_id() == m_idLoopThread.load(std::memory_order_relaxed);
+
+   // refused before building the easy handle
+   size_t usMaxQueued = 0;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      if ((bTry || m_eOverflowPolicy == OVERFLOW_REJECT || (bLoopThread && m_eOverflowPolicy == OVERFLOW_BLOCK)) &&
+          IsQueueFull())
+      {
+         ++m_oAdmission.ullRejected;
+         usMaxQueued = m_usMaxQueued;
+      }
+   }
+   if (usMaxQueued > 0)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_QUEUE_FULL_FORMAT, static_cast<unsigned>(usMaxQueued),
+                                            oRequest.strUrl.c_str()));
+      return false;
+   }
+
+   std::unique_ptr<Transfer> pTransfer(CreateTransfer(oRequest, oCompletion));
+   if (!pTransfer)
+      return false;
+
+   // a slowing origin sheds its load here rather than in the queue
+   if (m_pConcurrencyLimiter)
+   {
+      if (!m_pConcurrencyLimiter->Admit(pTransfer->strHostKey))
+      {
+         {
+            std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+            ++m_oAdmission.ullRejected;
+         }
+         if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+            m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_SHED_FORMAT,
+                                               static_cast<unsigned>(m_pConcurrencyLimiter->GetLimit(pTransfer->strHostKey)),
+                                               oRequest.strUrl.c_str()));
+         DestroyTransfer(pTransfer.release());
+         return false;
+      }
+      pTransfer->eLimiterSlot = LIMITER_WAITING;
+   }
+
+   // the request waits in the queue for its token, rather than bursting to the origin.
+   // As for CppHTTPClient, the rules of a service apply to its URL, not to the endpoint's
+   if (m_pRateLimiter)
+      pTransfer->strRateUrl = CppHTTPLoadBalancer::IsServiceUrl(oRequest.strUrl) ? oRequest.strUrl : pTransfer->strURL;
+   if (m_pRateLimiter && !m_pRateLimiter->Reserve(pTransfer->strRateUrl, pTransfer->tpNotBefore))
+   {
+      {
+         std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+         ++m_oAdmission.ullRejected;
+      }
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_RATE_LIMITED_FORMAT, oRequest.strUrl.c_str()));
+      DestroyTransfer(pTransfer.release());
+      return false;
+   }
+   pTransfer->bRateReserved = m_pRateLimiter != nullptr;
+
+   // the loop thread looks for the cancelled requests once woken up
+   if (oRequest.pCancelToken)
+      pTransfer->ullCancelSubscription = oRequest.pCancelToken->Subscribe([this]() {
+         std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+         m_bCancelPending = true;
+         Wakeup();
+      });
+
+   std::string strDroppedUrl;
+   bool bDraining = false;
+   {
+      // pushed under the lock, so that Drain() can't miss the request
+      std::unique_lock<std::mutex> oLock(m_mtxSubmitted);
+      if (!m_bDraining && IsQueueFull())
+      {
+         if (bTry || m_eOverflowPolicy == OVERFLOW_REJECT || (bLoopThread && m_eOverflowPolicy == OVERFLOW_BLOCK))
+         {
+            ++m_oAdmission.ullRejected;
+            usMaxQueued = m_usMaxQueued;
+         }
+         else if (m_eOverflowPolicy == OVERFLOW_BLOCK)
+         {
+            TimePoint tpBlocked = std::chrono::steady_clock::now();
+            ++m_oAdmission.ullBlocked;
+            m_cvQueueSpace.wait(oLock, [this]() { return m_bDraining || !IsQueueFull(); });
+            m_oAdmission.ullBlockedUs += static_cast<unsigned long long>(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tpBlocked).count());
+         }
+         else
+         {
+            // completed by the loop thread, woken up below
+            std::unique_ptr<Transfer> pDropped;
+            if (m_oQueue.PopOldest(pDropped))
+            {
+               pDropped->eAbortError = CppHTTPClient::ERR_QUEUE_FULL;
+               strDroppedUrl = pDropped->strURL;
+               m_vecDropped.push_back(std::move(pDropped));
+               ++m_oAdmission.ullDropped;
+            }
+         }
+      }
+
+      bDraining = m_bDraining;
+      if (!bDraining && usMaxQueued == 0)
+      {
+         std::string strHostKey = pTransfer->strHostKey;
+         TimePoint tpNotBefore = pTransfer->tpNotBefore;
+         m_oQueue.Push(std::move(pTransfer), oRequest.ePriority, strHostKey, oRequest.strTenant, tpNotBefore);
+         ++m_oAdmission.ullAccepted;
+
+         if (oRequest.tpDeadline != TimePoint() && (m_tpNextExpiry == TimePoint() || oRequest.tpDeadline < m_tpNextExpiry))
+            m_tpNextExpiry = oRequest.tpDeadline;
+         Wakeup();
+      }
+   }
+
+   if (!strDroppedUrl.empty() && (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG))
+      m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_DROPPED_FORMAT, strDroppedUrl.c_str()));
+   if (!pTransfer)
+      return true;
+
+   // outside of the lock, the cancel token callback takes it
+   DestroyTransfer(pTransfer.release());
+   if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+   {
+      if (bDraining)
+         m_oLog(LOG_ERROR_ASYNC_DRAINING_MSG);
+      else
+         m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_QUEUE_FULL_FORMAT, static_cast<unsigned>(usMaxQueued),
+                                            oRequest.strUrl.c_str()));
+   }
+
+   return false;
+}
+
+/**
+ * @brief true when the wait queue reached its bound, m_mtxSubmitted must be held
+ */
+const bool CppHTTPAsyncClient::IsQueueFull() const
+{
+   return m_usMaxQueued > 0 && m_oQueue.Size() >= m_usMaxQueued;
+}
+
+/**
+ * @brief submits a HEAD request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] oCompletion completion callback
+ */
+const bool CppHTTPAsyncClient::Head(const std::string &strUrl, const HeadersMap &Headers,
+                                    CompletionFnCallback oCompletion)
+{
+   Request oRequest;
+   oRequest.eMethod = HTTP_HEAD;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+
+   return Submit(oRequest, oCompletion);
+}
+
+/**
+ * @brief submits a GET request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] oCompletion completion callback
+ */
+const bool CppHTTPAsyncClient::Get(const std::string &strUrl, const HeadersMap &Headers,
+                                   CompletionFnCallback oCompletion)
+{
+   Request oRequest;
+   oRequest.eMethod = HTTP_GET;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+
+   return Submit(oRequest, oCompletion);
+}
+
+/**
+ * @brief submits a DELETE request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] oCompletion completion callback
+ */
+const bool CppHTTPAsyncClient::Del(const std::string &strUrl, const HeadersMap &Headers,
+                                   CompletionFnCallback oCompletion)
+{
+   Request oRequest;
+   oRequest.eMethod = HTTP_DELETE;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+
+   return Submit(oRequest, oCompletion);
+}
+
+/**
+ * @brief submits a POST request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] strPostData data to post
+ * @param [in] oCompletion completion callback
+ */
+const bool CppHTTPAsyncClient::Post(const std::string &strUrl, const HeadersMap &Headers,
+                                    const std::string &strPostData, CompletionFnCallback oCompletion)
+{
+   Request oRequest;
+   oRequest.eMethod = HTTP_POST;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+   oRequest.strBody = strPostData;
+
+   return Submit(oRequest, oCompletion);
+}
+
+/**
+ * @brief submits a PUT request with a string
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] strPutData data to upload
+ * @param [in] oCompletion completion callback
+ */
+const bool CppHTTPAsyncClient::Put(const std::string &strUrl, const HeadersMap &Headers,
+                                   const std::string &strPutData, CompletionFnCallback oCompletion)
+{
+   Request oRequest;
+   oRequest.eMethod = HTTP_PUT;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+   oRequest.strBody = strPutData;
+
+   return Submit(oRequest, oCompletion);
+}
+
+/**
+ * @brief performs a batch of independent requests and waits for all of them (loop thread)
+ *
+ * At most usMaxParallel requests of the batch are submitted at once, the next
+ * ones as the previous complete. The event loop is driven by Poll() until the
+ * whole batch is completed, the other pending requests progress meanwhile.
+ * tpDeadline applies to every request of the batch: the requests still running
+ * fail with a timeout error and those not started yet with ERR_DEADLINE_EXCEEDED,
+ * the results of the completed ones are kept.
+ *
+ * @param [in] vecRequests requests to perform
+ * @param [out] vecResults completions, in the order of vecRequests
+ * @param [in] usMaxParallel maximum number of requests of the batch in progress (0: unlimited)
+ * @param [in] tpDeadline deadline of the whole batch (TimePoint(): none)
+ *
+ * @retval number of successful requests
+ *
+ * Example Usage:
+ * @code
+ *    std::vector<CppHTTPAsyncClient::Completion> vecResults;
+ *    m_pAsyncClient->ExecuteBatch(vecRequests, vecResults, 32,
+ *                                 std::chrono::steady_clock::now() + std::chrono::seconds(2));
+ * @endcode
+ */
+const size_t CppHTTPAsyncClient::ExecuteBatch(const std::vector<Request> &vecRequests,
+                                              std::vector<Completion> &vecResults,
+                                              const size_t usMaxParallel /* = 0 */,
+                                              const TimePoint &tpDeadline /* = TimePoint() */)
+{
+   vecResults.assign(vecRequests.size(), Completion());
+   if (!m_pCurlMulti)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_NOT_INIT_MSG);
+
+      for (size_t usIndex = 0; usIndex < vecRequests.size(); ++usIndex)
+      {
+         vecResults[usIndex].oRequest = vecRequests[usIndex];
+         vecResults[usIndex].oResponse.iCode = -1;
+         vecResults[usIndex].oResponse.eError = CppHTTPClient::ERR_CURL;
+         vecResults[usIndex].oResponse.strError = LOG_ERROR_ASYNC_NOT_INIT_MSG;
+      }
+      return 0;
+   }
+
+   size_t usNext = 0;
+   size_t usDone = 0;
+   size_t usSucceeded = 0;
+   std::vector<bool> vecDone(vecRequests.size(), false);
+   // the completions arriving after a failure of the loop are ignored
+   auto pAlive = std::make_shared<int>(0);
+   std::weak_ptr<int> wpAlive = pAlive;
+
+   // called again by the completions, to keep usMaxParallel requests in progress
+   std::function<void()> SubmitNext;
+   SubmitNext = [&]() {
+      while (usNext < vecRequests.size() && (usMaxParallel == 0 || usNext - usDone < usMaxParallel))
+      {
+         size_t usIndex = usNext++;
+         Completion &oResult = vecResults[usIndex];
+         oResult.oRequest = vecRequests[usIndex];
+
+         Request &oRequest = oResult.oRequest;
+         if (tpDeadline != TimePoint() && (oRequest.tpDeadline == TimePoint() || tpDeadline < oRequest.tpDeadline))
+            oRequest.tpDeadline = tpDeadline;
+
+         // the batch expired: the remaining requests are not sent
+         if (oRequest.tpDeadline != TimePoint() && oRequest.tpDeadline <= std::chrono::steady_clock::now())
+         {
+            oResult.oResponse.iCode = -1;
+            oResult.oResponse.eError = CppHTTPClient::ERR_DEADLINE_EXCEEDED;
+            oResult.oResponse.strError = CppHTTPClient::TimeoutMessage(CppHTTPClient::ERR_DEADLINE_EXCEEDED, 0);
+            vecDone[usIndex] = true;
+            ++usDone;
+            continue;
+         }
+
+         auto OnCompletion = [&, usIndex, wpAlive](const bool bSuccess, HttpResponse &Response) {
+            if (!wpAlive.lock())
+               return;
+            vecDone[usIndex] = true;
+            vecResults[usIndex].bSuccess = bSuccess;
+            vecResults[usIndex].oResponse = std::move(Response);
+            ++usDone;
+            if (bSuccess)
+               ++usSucceeded;
+            SubmitNext();
+         };
+         if (!Submit(oRequest, OnCompletion))
+         {
+            oResult.oResponse.iCode = -1;
+            oResult.oResponse.eError = CppHTTPClient::ERR_CURL;
+            oResult.oResponse.strError = "Request could not be submitted";
+            vecDone[usIndex] = true;
+            ++usDone;
+         }
+      }
+   };
+
+   SubmitNext();
+   while (usDone < vecRequests.size())
+   {
+      if (Poll(100) >= 0)
+         continue;
+
+      // the loop failed, the requests left never complete
+      pAlive.reset();
+      for (size_t usIndex = 0; usIndex < vecRequests.size(); ++usIndex)
+      {
+         if (vecDone[usIndex])
+            continue;
+         vecResults[usIndex].oRequest = vecRequests[usIndex];
+         vecResults[usIndex].bSuccess = false;
+         vecResults[usIndex].oResponse.iCode = -1;
+         vecResults[usIndex].oResponse.eError = CppHTTPClient::ERR_CURL;
+         vecResults[usIndex].oResponse.strError = LOG_ERROR_ASYNC_POLL_FAILED_MSG;
+      }
+      break;
+   }
+
+   return usSucceeded;
+}
+
+/**
+ * @brief scatter-gather: sends the same request to several endpoints and waits for their answers
+ *
+ * Every request is submitted at once. With FANOUT_ALL the call returns when every
+ * endpoint answered, with FANOUT_QUORUM as soon as usQuorum endpoints answered or
+ * when the quorum can't be reached anymore: the requests still running are then
+ * cancelled. tpDeadline bounds both modes, the endpoints that did not answer in
+ * time fail with a timeout error and the answers received are kept. An endpoint
+ * answered when its transfer succeeded with an HTTP status below 500.
+ *
+ * @param [in] oTemplate request sent to every endpoint, its URL is appended to the endpoints
+ * @param [in] vecEndpoints "scheme://host:port" of the endpoints, or full URLs with an empty template URL
+ * @param [out] vecResults answers, in the order of vecEndpoints
+ * @param [in] oPolicy completion policy
+ *
+ * @retval number of endpoints that answered
+ *
+ * Example Usage:
+ * @code
+ *    CppHTTPAsyncClient::FanOutPolicy oPolicy;
+ *    oPolicy.eMode = CppHTTPAsyncClient::FANOUT_QUORUM;
+ *    oPolicy.usQuorum = 2;
+ *    oRequest.strUrl = "/search?q=term";
+ *    m_pAsyncClient->FanOut(oRequest, {"http://shard1", "http://shard2", "http://shard3"}, vecResults, oPolicy);
+ * @endcode
+ */
+const size_t CppHTTPAsyncClient::FanOut(const Request &oTemplate, const std::vector<std::string> &vecEndpoints,
+                                        std::vector<FanOutResult> &vecResults,
+                                        const FanOutPolicy &oPolicy /* = FanOutPolicy() */)
+{
+   const size_t usEndpoints = vecEndpoints.size();
+   vecResults.assign(usEndpoints, FanOutResult());
+   for (size_t usIndex = 0; usIndex < usEndpoints; ++usIndex)
+      vecResults[usIndex].strUrl = vecEndpoints[usIndex] + oTemplate.strUrl;
+
+   if (!m_pCurlMulti)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_NOT_INIT_MSG);
+
+      for (auto &oResult : vecResults)
+      {
+         oResult.oResponse.iCode = -1;
+         oResult.oResponse.eError = CppHTTPClient::ERR_CURL;
+         oResult.oResponse.strError = LOG_ERROR_ASYNC_NOT_INIT_MSG;
+      }
+      return 0;
+   }
+
+   const size_t usQuorum = (oPolicy.eMode == FANOUT_QUORUM)
+                               ? std::min(std::max<size_t>(oPolicy.usQuorum, 1), usEndpoints)
+                               : usEndpoints;
+
+   // cancels the stragglers, and follows the caller's token
+   auto pStragglers = std::make_shared<CppHTTPCancelToken>();
+   unsigned long long ullSubscription = 0;
+   if (oTemplate.pCancelToken)
+      ullSubscription = oTemplate.pCancelToken->Subscribe([pStragglers]() { pStragglers->Cancel(); });
+
+   size_t usDone = 0;
+   size_t usAnswered = 0;
+   std::vector<bool> vecDone(usEndpoints, false);
+   // the completions arriving after a failure of the loop are ignored
+   auto pAlive = std::make_shared<int>(0);
+   std::weak_ptr<int> wpAlive = pAlive;
+   auto Settle = [&]() {
+      // the quorum is reached, or can't be reached anymore
+      if (usAnswered >= usQuorum || usDone - usAnswered > usEndpoints - usQuorum)
+         pStragglers->Cancel();
+   };
+
+   const TimePoint tpStart = std::chrono::steady_clock::now();
+   for (size_t usIndex = 0; usIndex < usEndpoints; ++usIndex)
+   {
+      FanOutResult &oResult = vecResults[usIndex];
+
+      Request oRequest = oTemplate;
+      oRequest.strUrl = oResult.strUrl;
+      oRequest.pCancelToken = pStragglers;
+      if (oPolicy.tpDeadline != TimePoint() &&
+          (oRequest.tpDeadline == TimePoint() || oPolicy.tpDeadline < oRequest.tpDeadline))
+         oRequest.tpDeadline = oPolicy.tpDeadline;
+
+      auto OnCompletion = [&, usIndex, wpAlive](const bool bSuccess, HttpResponse &Response) {
+         if (!wpAlive.lock())
+            return;
+         vecDone[usIndex] = true;
+         FanOutResult &oDone = vecResults[usIndex];
+         oDone.bSuccess = bSuccess;
+         oDone.ullLatencyUs = static_cast<unsigned long long>(
+             std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tpStart).count());
+         if (bSuccess && Response.iCode < 500)
+            ++usAnswered;
+         oDone.oResponse = std::move(Response);
+         ++usDone;
+         Settle();
+      };
+      if (!Submit(oRequest, OnCompletion))
+      {
+         oResult.oResponse.iCode = -1;
+         oResult.oResponse.eError = CppHTTPClient::ERR_CURL;
+         oResult.oResponse.strError = "Request could not be submitted";
+         vecDone[usIndex] = true;
+         ++usDone;
+         Settle();
+      }
+   }
+
+   // the cancelled stragglers complete within milliseconds
+   while (usDone < usEndpoints)
+   {
+      if (Poll(100) >= 0)
+         continue;
+
+      // the loop failed, the stragglers never complete
+      pAlive.reset();
+      pStragglers->Cancel();
+      for (size_t usIndex = 0; usIndex < usEndpoints; ++usIndex)
+      {
+         if (vecDone[usIndex])
+            continue;
+         vecResults[usIndex].bSuccess = false;
+         vecResults[usIndex].oResponse.iCode = -1;
+         vecResults[usIndex].oResponse.eError = CppHTTPClient::ERR_CURL;
+         vecResults[usIndex].oResponse.strError = LOG_ERROR_ASYNC_POLL_FAILED_MSG;
+      }
+      break;
+   }
+
+   if (ullSubscription != 0)
+      oTemplate.pCancelToken->Unsubscribe(ullSubscription);
+
+   return usAnswered;
+}
+
+// EVENT LOOP
+
+/**
+ * @brief to be called by the event loop when a watched socket is ready
+ *
+ * Completions of the finished transfers are delivered before returning.
+ *
+ * @param [in] Socket ready socket
+ * @param [in] iEvents combination of SocketEvent flags
+ */
+void CppHTTPAsyncClient::OnSocketReady(const curl_socket_t Socket, const int iEvents)
+{
+   if (!m_pCurlMulti)
+      return;
+   m_idLoopThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+   if (Socket == m_arrWakeupPipe[0])
+   {
+      DrainWakeup();
+      CancelRequests();
+      CompleteDropped();
+      Dispatch();
+   }
+   else
+   {
+      int iCurlEvents = 0;
+      if (iEvents & EVENT_IN)
+         iCurlEvents |= CURL_CSELECT_IN;
+      if (iEvents & EVENT_OUT)
+         iCurlEvents |= CURL_CSELECT_OUT;
+      if (iEvents & EVENT_ERROR)
+         iCurlEvents |= CURL_CSELECT_ERR;
+
+      SocketAction(Socket, iCurlEvents);
+   }
+
+   FlushBatch(false);
+   ArmTimer();
+}
+
+/**
+ * @brief to be called by the event loop when the timer set by the timer callback expires
+ */
+void CppHTTPAsyncClient::OnTimeout()
+{
+   if (!m_pCurlMulti)
+      return;
+   m_idLoopThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+   // the event loop timer is consumed
+   m_bTimerArmed = false;
+   Dispatch();
+
+   if (m_bCurlTimerArmed && std::chrono::steady_clock::now() >= m_tpCurlDeadline)
+   {
+      m_bCurlTimerArmed = false;
+      SocketAction(CURL_SOCKET_TIMEOUT, 0);
+   }
+   RunTimers();
+
+   // the slots released by the timers go to the waiting requests
+   Dispatch();
+
+   FlushBatch(false);
+   ArmTimer();
+}
+
+/**
+ * @brief built-in event loop iteration, for callers without an event loop
+ *
+ * Waits at most iTimeoutMs for socket activity or the cURL timer
+ * and processes it.
+ *
+ * @param [in] iTimeoutMs maximum time to wait, in milliseconds
+ *
+ * @retval number of pending requests after the iteration, -1 on error
+ *
+ * Example Usage:
+ * @code
+ *    while (m_pAsyncClient->Poll(100) > 0) {}
+ * @endcode
+ */
+const int CppHTTPAsyncClient::Poll(const int iTimeoutMs)
+{
+   if (!m_pCurlMulti)
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_ASYNC_NOT_INIT_MSG);
+
+      return -1;
+   }
+   m_idLoopThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+   int iWaitMs = iTimeoutMs;
+   if (m_bTimerArmed)
+   {
+      auto lRemainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              m_tpTimerDeadline - std::chrono::steady_clock::now() + std::chrono::microseconds(999))
+                              .count();
+      if (lRemainingMs < iWaitMs || iWaitMs < 0)
+         iWaitMs = static_cast<int>(std::max<long long>(lRemainingMs, 0));
+   }
+
+   std::vector<struct pollfd> vecPollFds;
+   vecPollFds.reserve(m_mapSockets.size());
+   for (const auto &Socket : m_mapSockets)
+   {
+      struct pollfd oPollFd;
+      oPollFd.fd = Socket.first;
+      oPollFd.events = ((Socket.second & EVENT_IN) ? POLLIN : 0) | ((Socket.second & EVENT_OUT) ? POLLOUT : 0);
+      oPollFd.revents = 0;
+      vecPollFds.push_back(oPollFd);
+   }
+
+   int iReady = poll(vecPollFds.data(), vecPollFds.size(), iWaitMs);
+   if (iReady < 0 && errno != EINTR)
+      return -1;
+
+   for (size_t i = 0; iReady > 0 && i < vecPollFds.size(); ++i)
+   {
+      if (vecPollFds[i].revents == 0)
+         continue;
+
+      int iEvents = EVENT_NONE;
+      if (vecPollFds[i].revents & (POLLIN | POLLHUP))
+         iEvents |= EVENT_IN;
+      if (vecPollFds[i].revents & POLLOUT)
+         iEvents |= EVENT_OUT;
+      if (vecPollFds[i].revents & (POLLERR | POLLNVAL))
+         iEvents |= EVENT_ERROR;
+
+      OnSocketReady(vecPollFds[i].fd, iEvents);
+   }
+
+   if (m_bTimerArmed && std::chrono::steady_clock::now() >= m_tpTimerDeadline)
+      OnTimeout();
+
+   return static_cast<int>(GetPendingCount());
+}
+
+/**
+ * @brief schedules a task on the loop thread
+ *
+ * @param [in] iDelayMs delay before running the task, in milliseconds
+ * @param [in] oTask task to run from OnTimeout()
+ *
+ * @retval identifier of the timer, to be used with CancelTimer()
+ */
+const unsigned long long CppHTTPAsyncClient::ScheduleTimer(const int iDelayMs, TaskFnCallback oTask)
+{
+   unsigned long long ullTimerId = ++m_ullLastTimerId;
+   m_mapTimers.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(iDelayMs, 0)),
+                       std::make_pair(ullTimerId, oTask));
+   ArmTimer();
+
+   return ullTimerId;
+}
+
+/**
+ * @brief cancels a timer scheduled by ScheduleTimer()
+ *
+ * @param [in] ullTimerId identifier of the timer
+ *
+ * @retval true   The timer was cancelled.
+ * @retval false  The timer already ran or does not exist.
+ */
+const bool CppHTTPAsyncClient::CancelTimer(const unsigned long long ullTimerId)
+{
+   for (auto it = m_mapTimers.begin(); it != m_mapTimers.end(); ++it)
+   {
+      if (it->second.first == ullTimerId)
+      {
+         m_mapTimers.erase(it);
+         ArmTimer();
+         return true;
+      }
+   }
+   return false;
+}
+
+// INTERNALS
+
+/**
+ * @brief creates and configures the easy handle of a request
+ *
+ * @param [in] oRequest request to perform
+ * @param [in] oCompletion completion callback
+ *
+ * @retval the transfer, nullptr if the easy handle could not be created
+ */
+CppHTTPAsyncClient::Transfer *CppHTTPAsyncClient::CreateTransfer(const Request &oRequest,
+                                                                 CompletionFnCallback oCompletion)
+{
+   std::string strUrl = oRequest.strUrl;
+   std::string strEndpoint;
+   std::shared_ptr<CppHTTPLoadBalancer> pBalancer = m_pLoadBalancer;
+   if (pBalancer && CppHTTPLoadBalancer::IsServiceUrl(oRequest.strUrl) &&
+       !pBalancer->Resolve(oRequest.strUrl, strUrl, strEndpoint))
+   {
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(CppHTTPClient::StringFormat(LOG_ERROR_ASYNC_NO_ENDPOINT_FORMAT, oRequest.strUrl.c_str()));
+      return nullptr;
+   }
+
+   CURL *pCurl = curl_easy_init();
+   if (pCurl == nullptr)
+   {
+      if (!strEndpoint.empty())
+         pBalancer->Release(strEndpoint);
+      return nullptr;
+   }
+
+   Transfer *pTransfer = new Transfer;
+   pTransfer->pCurl = pCurl;
+   pTransfer->oRequest = oRequest;
+   pTransfer->oCompletion = oCompletion;
+   pTransfer->tpSubmitted = std::chrono::steady_clock::now();
+   pTransfer->strEndpoint = strEndpoint;
+
+   // adds the proper protocol scheme, see CppHTTPClient::CheckURL
+   std::string strTmp = strUrl;
+   std::transform(strTmp.begin(), strTmp.end(), strTmp.begin(), ::toupper);
+   bool bHTTPS = m_bHTTPS;
+   if (strTmp.compare(0, 7, "HTTP://") == 0)
+      bHTTPS = false;
+   else if (strTmp.compare(0, 8, "HTTPS://") == 0)
+      bHTTPS = true;
+   else
+      pTransfer->strURL = (bHTTPS) ? "https://" : "http://";
+   pTransfer->strURL += strUrl;
+   pTransfer->strHostKey = CppHTTPClient::GetHostKey(pTransfer->strURL);
+
+   curl_easy_setopt(pCurl, CURLOPT_PRIVATE, pTransfer);
+   curl_easy_setopt(pCurl, CURLOPT_URL, pTransfer->strURL.c_str());
+
+   curl_easy_setopt(pCurl, CURLOPT_WRITEFUNCTION, &CppHTTPClient::RestWriteCallback);
+   curl_easy_setopt(pCurl, CURLOPT_WRITEDATA, &pTransfer->oResponse);
+   curl_easy_setopt(pCurl, CURLOPT_HEADERFUNCTION, &CppHTTPClient::RestHeaderCallback);
+   curl_easy_setopt(pCurl, CURLOPT_HEADERDATA, &pTransfer->oResponse);
+
+   for (HeadersMap::const_iterator it = oRequest.mapHeaders.cbegin();
+        it != oRequest.mapHeaders.cend();
+        ++it)
+   {
+      pTransfer->pHeaderlist = curl_slist_append(pTransfer->pHeaderlist, (it->first + ": " + it->second).c_str());
+   }
+   if (pTransfer->pHeaderlist != nullptr)
+      curl_easy_setopt(pCurl, CURLOPT_HTTPHEADER, pTransfer->pHeaderlist);
+
+   curl_easy_setopt(pCurl, CURLOPT_USERAGENT, CLIENT_USERAGENT);
+   curl_easy_setopt(pCurl, CURLOPT_AUTOREFERER, 1L);
+   curl_easy_setopt(pCurl, CURLOPT_FOLLOWLOCATION, 1L);
+   curl_easy_setopt(pCurl, CURLOPT_NOSIGNAL, 1L);
+
+   // relative share of a multiplexed HTTP/2 connection
+   static const long s_arrStreamWeights[PRIORITY_COUNT] = {256, 16, 1};
+   curl_easy_setopt(pCurl, CURLOPT_STREAM_WEIGHT,
+                    s_arrStreamWeights[std::min<int>(oRequest.ePriority, PRIORITY_LOW)]);
+
+   // the total limit is applied by Dispatch(), once the queueing time is known
+   TimeoutPolicy oDefaults = m_oTimeouts;
+   if (oDefaults.lTotalMs <= 0)
+      oDefaults.lTotalMs = m_iCurlTimeout * 1000L;
+   pTransfer->oTimeouts = CppHTTPClient::MergeTimeouts(oRequest.oTimeouts, oDefaults);
+
+   switch (oRequest.eMethod)
+   {
+   case HTTP_HEAD:
+      curl_easy_setopt(pCurl, CURLOPT_CUSTOMREQUEST, "HEAD");
+      curl_easy_setopt(pCurl, CURLOPT_NOBODY, 1L);
+      break;
+   case HTTP_GET:
+      curl_easy_setopt(pCurl, CURLOPT_HTTPGET, 1L);
+      break;
+   case HTTP_DELETE:
+      curl_easy_setopt(pCurl, CURLOPT_CUSTOMREQUEST, "DELETE");
+      break;
+   case HTTP_POST:
+      curl_easy_setopt(pCurl, CURLOPT_POST, 1L);
+      curl_easy_setopt(pCurl, CURLOPT_POSTFIELDS, pTransfer->oRequest.strBody.c_str());
+      curl_easy_setopt(pCurl, CURLOPT_POSTFIELDSIZE, static_cast<long>(pTransfer->oRequest.strBody.size()));
+      break;
+   case HTTP_PUT:
+      pTransfer->oPayload.pszData = pTransfer->oRequest.strBody.c_str();
+      pTransfer->oPayload.usLength = pTransfer->oRequest.strBody.size();
+      curl_easy_setopt(pCurl, CURLOPT_UPLOAD, 1L);
+      curl_easy_setopt(pCurl, CURLOPT_READFUNCTION, &CppHTTPClient::RestReadCallback);
+      curl_easy_setopt(pCurl, CURLOPT_READDATA, &pTransfer->oPayload);
+      curl_easy_setopt(pCurl, CURLOPT_INFILESIZE, static_cast<long>(pTransfer->oPayload.usLength));
+      break;
+   }
+
+   // SSL
+   if (bHTTPS)
+   {
+      curl_easy_setopt(pCurl, CURLOPT_USE_SSL, CURLUSESSL_ALL);
+
+      if (!(m_eSettingsFlags & CppHTTPClient::VERIFY_PEER))
+         curl_easy_setopt(pCurl, CURLOPT_SSL_VERIFYPEER, 0L);
+      if (!(m_eSettingsFlags & CppHTTPClient::VERIFY_HOST))
+         curl_easy_setopt(pCurl, CURLOPT_SSL_VERIFYHOST, 0L);
+      if (!CppHTTPClient::GetCertificateFile().empty())
+         curl_easy_setopt(pCurl, CURLOPT_CAINFO, CppHTTPClient::GetCertificateFile().c_str());
+      if (!m_strSSLCertFile.empty())
+         curl_easy_setopt(pCurl, CURLOPT_SSLCERT, m_strSSLCertFile.c_str());
+      if (!m_strSSLKeyFile.empty())
+         curl_easy_setopt(pCurl, CURLOPT_SSLKEY, m_strSSLKeyFile.c_str());
+      if (!m_strSSLKeyPwd.empty())
+         curl_easy_setopt(pCurl, CURLOPT_KEYPASSWD, m_strSSLKeyPwd.c_str());
+   }
+
+   return pTransfer;
+}
+
+/**
+ * @brief frees the easy handle and the header list of a transfer
+ *
+ * @param [in] pTransfer transfer to free, must not be in the multi handle
+ */
+void CppHTTPAsyncClient::DestroyTransfer(Transfer *pTransfer)
+{
+   // not completed by the endpoint
+   if (!pTransfer->strEndpoint.empty() && m_pLoadBalancer)
+      m_pLoadBalancer->Release(pTransfer->strEndpoint);
+   // refused, cancelled or expired before being sent
+   if (pTransfer->bRateReserved && m_pRateLimiter)
+      m_pRateLimiter->Refund(pTransfer->strRateUrl);
+   if (pTransfer->eLimiterSlot == LIMITER_WAITING && m_pConcurrencyLimiter)
+      m_pConcurrencyLimiter->Withdraw(pTransfer->strHostKey);
+   else if (pTransfer->eLimiterSlot == LIMITER_RUNNING && m_pConcurrencyLimiter)
+      m_pConcurrencyLimiter->Release(pTransfer->strHostKey);
+
+   if (pTransfer->oRequest.pCancelToken)
+      pTransfer->oRequest.pCancelToken->Unsubscribe(pTransfer->ullCancelSubscription);
+
+   curl_easy_cleanup(pTransfer->pCurl);
+   if (pTransfer->pHeaderlist)
+      curl_slist_free_all(pTransfer->pHeaderlist);
+   delete pTransfer;
+}
+
+/**
+ * @brief adds the queued requests to the multi handle while connection slots
+ * are free, most urgent first (loop thread)
+ */
+void CppHTTPAsyncClient::Dispatch()
+{
+   TimePoint tpNow = std::chrono::steady_clock::now();
+   // a host found full isn't asked again by this dispatch, which only adds to its load
+   std::unordered_set<std::string> setFull;
+   auto HasFreeSlot = [this, &tpNow, &setFull](const std::string &strHostKey) -> bool {
+      if (!setFull.empty() && setFull.count(strHostKey) != 0)
+         return false;
+
+      bool bFree = true;
+      if (!m_mapHostPausedUntil.empty())
+      {
+         auto itPause = m_mapHostPausedUntil.find(strHostKey);
+         bFree = itPause == m_mapHostPausedUntil.end() || itPause->second <= tpNow;
+      }
+      if (bFree && m_pConcurrencyLimiter)
+         bFree = m_pConcurrencyLimiter->HasCapacity(strHostKey);
+      if (bFree && m_usMaxHostInFlight > 0)
+      {
+         auto it = m_mapHostInFlight.find(strHostKey);
+         bFree = it == m_mapHostInFlight.end() || it->second < m_usMaxHostInFlight;
+      }
+      if (!bFree)
+         setFull.insert(strHostKey);
+      return bFree;
+   };
+
+   ExpireQueued();
+
+   std::unique_ptr<Transfer> pTransfer;
+   while ((m_usMaxInFlight == 0 || m_mapRunning.size() < m_usMaxInFlight) && m_oQueue.Pop(HasFreeSlot, pTransfer))
+   {
+      if (pTransfer->eLimiterSlot == LIMITER_WAITING && m_pConcurrencyLimiter)
+      {
+         m_pConcurrencyLimiter->Acquire(pTransfer->strHostKey);
+         pTransfer->eLimiterSlot = LIMITER_RUNNING;
+      }
+
+      // cancelled before its wakeup was processed
+      if (pTransfer->oRequest.pCancelToken && pTransfer->oRequest.pCancelToken->IsCancelled())
+      {
+         Complete(std::move(pTransfer), CURLE_ABORTED_BY_CALLBACK);
+         continue;
+      }
+
+      // a known unreachable origin isn't resolved nor connected again
+      CURLcode eCached = CURLE_OK;
+      if (m_pNegativeCache && m_pNegativeCache->Check(pTransfer->strHostKey, eCached))
+      {
+         pTransfer->bCachedFailure = true;
+         Complete(std::move(pTransfer), eCached);
+         continue;
+      }
+
+      // the total limit is the closest of the timeout and the deadline
+      pTransfer->tpStarted = std::chrono::steady_clock::now();
+      pTransfer->lBudgetMs = pTransfer->oTimeouts.lTotalMs;
+      if (pTransfer->oRequest.tpDeadline != TimePoint())
+      {
+         long lRemainingMs = CppHTTPClient::RemainingMs(pTransfer->oRequest.tpDeadline, pTransfer->tpStarted);
+         if (lRemainingMs <= 0)
+         {
+            pTransfer->eTimeoutError = CppHTTPClient::ERR_DEADLINE_EXCEEDED;
+            Complete(std::move(pTransfer), CURLE_OPERATION_TIMEDOUT);
+            continue;
+         }
+         if (pTransfer->lBudgetMs <= 0 || lRemainingMs < pTransfer->lBudgetMs)
+            pTransfer->lBudgetMs = lRemainingMs;
+      }
+      CppHTTPClient::ApplyTimeouts(pTransfer->pCurl, pTransfer->oTimeouts, pTransfer->lBudgetMs);
+      pTransfer->bRateReserved = false;
+
+      Transfer *pStarted = pTransfer.get();
+      CURL *pCurl = pTransfer->pCurl;
+      ++m_mapHostInFlight[pTransfer->strHostKey];
+      auto itPause = m_mapHostPausedUntil.find(pTransfer->strHostKey);
+      {
+         std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+         ++m_mapTenantStats[pTransfer->oRequest.strTenant].usInFlight;
+         if (itPause != m_mapHostPausedUntil.end() && pTransfer->tpSubmitted < itPause->second)
+            ++m_mapThrottles[pTransfer->strHostKey].ullPaced;
+         m_mapRunning[pCurl] = std::move(pTransfer);
+      }
+
+      // the timer callback asks the event loop to start the transfer
+      curl_multi_add_handle(m_pCurlMulti, pCurl);
+      ArmWatchdog(pStarted);
+   }
+
+   // the loop wakes up when the next token of a paced request is available, or a pause ends
+   TimePoint tpNextPaced = m_pRateLimiter ? m_oQueue.NextNotBefore() : TimePoint();
+   tpNow = std::chrono::steady_clock::now();
+   for (const auto &oPause : m_mapHostPausedUntil)
+   {
+      if (oPause.second > tpNow && (tpNextPaced == TimePoint() || oPause.second < tpNextPaced))
+         tpNextPaced = oPause.second;
+   }
+   if (tpNextPaced != m_tpPacingTimer)
+   {
+      if (m_ullPacingTimerId != 0)
+         CancelTimer(m_ullPacingTimerId);
+      m_ullPacingTimerId = 0;
+      m_tpPacingTimer = tpNextPaced;
+
+      // OnTimeout() dispatches once the timer ran
+      if (tpNextPaced != TimePoint())
+         m_ullPacingTimerId = ScheduleTimer(CppHTTPClient::RemainingMs(tpNextPaced, std::chrono::steady_clock::now()), [this]() {
+            m_ullPacingTimerId = 0;
+            m_tpPacingTimer = TimePoint();
+         });
+   }
+
+   // the Submit() calls blocked by a full queue check it again
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   m_cvQueueSpace.notify_all();
+}
+
+/**
+ * @brief completes the queued requests whose deadline passed, and wakes the loop
+ * up at the next deadline (loop thread)
+ */
+void CppHTTPAsyncClient::ExpireQueued()
+{
+   TimePoint tpNow = std::chrono::steady_clock::now();
+   TimePoint tpNextExpiry;
+   bool bExpired = false;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      tpNextExpiry = m_tpNextExpiry;
+      bExpired = (tpNextExpiry != TimePoint() && tpNextExpiry <= tpNow);
+      if (bExpired)
+         m_tpNextExpiry = TimePoint();
+   }
+
+   if (bExpired)
+   {
+      TimePoint tpEarliest;
+      auto IsExpired = [&tpNow, &tpEarliest](const std::unique_ptr<Transfer> &pTransfer) {
+         const TimePoint &tpDeadline = pTransfer->oRequest.tpDeadline;
+         if (tpDeadline == TimePoint())
+            return false;
+         if (tpDeadline <= tpNow)
+            return true;
+         if (tpEarliest == TimePoint() || tpDeadline < tpEarliest)
+            tpEarliest = tpDeadline;
+         return false;
+      };
+
+      for (auto &pTransfer : m_oQueue.RemoveIf(IsExpired))
+      {
+         pTransfer->eTimeoutError = CppHTTPClient::ERR_DEADLINE_EXCEEDED;
+         Complete(std::move(pTransfer), CURLE_OPERATION_TIMEDOUT);
+      }
+
+      // requests may have been submitted meanwhile
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      if (tpEarliest != TimePoint() && (m_tpNextExpiry == TimePoint() || tpEarliest < m_tpNextExpiry))
+         m_tpNextExpiry = tpEarliest;
+      tpNextExpiry = m_tpNextExpiry;
+   }
+
+   if (tpNextExpiry == m_tpDeadlineTimer)
+      return;
+
+   if (m_ullDeadlineTimerId != 0)
+      CancelTimer(m_ullDeadlineTimerId);
+   m_ullDeadlineTimerId = 0;
+   m_tpDeadlineTimer = tpNextExpiry;
+
+   // OnTimeout() dispatches, and so expires, once the timer ran
+   if (tpNextExpiry != TimePoint())
+      m_ullDeadlineTimerId = ScheduleTimer(CppHTTPClient::RemainingMs(tpNextExpiry, tpNow), [this]() {
+         m_ullDeadlineTimerId = 0;
+         m_tpDeadlineTimer = TimePoint();
+      });
+}
+
+/**
+ * @brief schedules the next check of the DNS, TLS and first byte limits of a running transfer
+ *
+ * @param [in] pTransfer running transfer
+ *
+ * @retval false  A limit is already exceeded, pTransfer->eTimeoutError is set.
+ */
+const bool CppHTTPAsyncClient::ArmWatchdog(Transfer *pTransfer)
+{
+   const TimeoutPolicy &oTimeouts = pTransfer->oTimeouts;
+   if (oTimeouts.lDnsMs <= 0 && oTimeouts.lTlsMs <= 0 && oTimeouts.lFirstByteMs <= 0)
+      return true;
+
+   long lElapsedMs = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                           std::chrono::steady_clock::now() - pTransfer->tpStarted)
+                                           .count());
+   long lNextCheckMs = CppHTTPClient::CheckPhaseTimeouts(pTransfer->pCurl, oTimeouts, lElapsedMs,
+                                                         pTransfer->eTimeoutError);
+   if (pTransfer->eTimeoutError != CppHTTPClient::ERR_NONE)
+      return false;
+
+   if (lNextCheckMs >= 0)
+   {
+      CURL *pCurl = pTransfer->pCurl;
+      pTransfer->ullWatchdogTimerId = ScheduleTimer(static_cast<int>(lNextCheckMs) + 1, [this, pCurl]() { CheckWatchdog(pCurl); });
+   }
+   return true;
+}
+
+/**
+ * @brief aborts a running transfer that exceeded a phase limit (loop thread)
+ *
+ * @param [in] pCurl easy handle of the transfer
+ */
+void CppHTTPAsyncClient::CheckWatchdog(CURL *pCurl)
+{
+   auto it = m_mapRunning.find(pCurl);
+   if (it == m_mapRunning.end())
+      return;
+
+   it->second->ullWatchdogTimerId = 0;
+   if (!ArmWatchdog(it->second.get()))
+      Complete(Detach(pCurl), CURLE_OPERATION_TIMEDOUT);
+}
+
+/**
+ * @brief completes the queued and running requests whose cancel token was triggered (loop thread)
+ */
+void CppHTTPAsyncClient::CancelRequests()
+{
+   std::vector<CURL *> vecCancelled;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      if (!m_bCancelPending)
+         return;
+      m_bCancelPending = false;
+
+      for (const auto &oRunning : m_mapRunning)
+      {
+         const auto &pToken = oRunning.second->oRequest.pCancelToken;
+         if (pToken && pToken->IsCancelled())
+            vecCancelled.push_back(oRunning.first);
+      }
+   }
+
+   for (CURL *pCurl : vecCancelled)
+   {
+      std::unique_ptr<Transfer> pTransfer = Detach(pCurl);
+      if (pTransfer)
+         Complete(std::move(pTransfer), CURLE_ABORTED_BY_CALLBACK);
+   }
+
+   auto IsCancelled = [](const std::unique_ptr<Transfer> &pTransfer) {
+      return pTransfer->oRequest.pCancelToken && pTransfer->oRequest.pCancelToken->IsCancelled();
+   };
+   for (auto &pTransfer : m_oQueue.RemoveIf(IsCancelled))
+      Complete(std::move(pTransfer), CURLE_ABORTED_BY_CALLBACK);
+}
+
+/**
+ * @brief completes the requests dropped by Submit() from the full queue (loop thread)
+ */
+void CppHTTPAsyncClient::CompleteDropped()
+{
+   std::vector<std::unique_ptr<Transfer>> vecDropped;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      vecDropped.swap(m_vecDropped);
+   }
+
+   for (auto &pTransfer : vecDropped)
+      Complete(std::move(pTransfer), CURLE_ABORTED_BY_CALLBACK);
+}
+
+/**
+ * @brief aborts the running then the queued requests, their completion callbacks are called
+ *
+ * @retval number of aborted requests
+ */
+const size_t CppHTTPAsyncClient::AbortPending()
+{
+   std::vector<std::unique_ptr<Transfer>> vecQueued = m_oQueue.Clear();
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      for (auto &pTransfer : m_vecDropped)
+         vecQueued.push_back(std::move(pTransfer));
+      m_vecDropped.clear();
+   }
+   size_t usAborted = m_mapRunning.size() + vecQueued.size();
+
+   while (!m_mapRunning.empty())
+      Complete(Detach(m_mapRunning.begin()->first), CURLE_ABORTED_BY_CALLBACK);
+   for (auto &pTransfer : vecQueued)
+      Complete(std::move(pTransfer), CURLE_ABORTED_BY_CALLBACK);
+
+   return usAborted;
+}
+
+/**
+ * @brief removes a running transfer from the multi handle and releases its slot
+ *
+ * @param [in] pCurl easy handle of the transfer
+ *
+ * @retval the transfer, nullptr if it is not running
+ */
+std::unique_ptr<CppHTTPAsyncClient::Transfer> CppHTTPAsyncClient::Detach(CURL *pCurl)
+{
+   std::unique_ptr<Transfer> pTransfer;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      auto it = m_mapRunning.find(pCurl);
+      if (it == m_mapRunning.end())
+         return pTransfer;
+
+      pTransfer = std::move(it->second);
+      m_mapRunning.erase(it);
+      --m_mapTenantStats[pTransfer->oRequest.strTenant].usInFlight;
+   }
+
+   curl_multi_remove_handle(m_pCurlMulti, pCurl);
+
+   if (pTransfer->ullWatchdogTimerId != 0)
+   {
+      CancelTimer(pTransfer->ullWatchdogTimerId);
+      pTransfer->ullWatchdogTimerId = 0;
+   }
+
+   auto itHost = m_mapHostInFlight.find(pTransfer->strHostKey);
+   if (itHost != m_mapHostInFlight.end() && --itHost->second == 0)
+      m_mapHostInFlight.erase(itHost);
+
+   return pTransfer;
+}
+
+/**
+ * @brief lets cURL process a socket event (or its timeout) and delivers the completions
+ *
+ * @param [in] Socket ready socket or CURL_SOCKET_TIMEOUT
+ * @param [in] iCurlEvents combination of CURL_CSELECT_* flags
+ */
+void CppHTTPAsyncClient::SocketAction(const curl_socket_t Socket, const int iCurlEvents)
+{
+   int iRunning = 0;
+   curl_multi_socket_action(m_pCurlMulti, Socket, iCurlEvents, &iRunning);
+   CheckCompleted();
+
+   // the slots released by the completions go to the waiting requests
+   Dispatch();
+}
+
+/**
+ * @brief reads the finished transfers and delivers their completion
+ */
+void CppHTTPAsyncClient::CheckCompleted()
+{
+   CURLMsg *pMsg = nullptr;
+   int iMsgsLeft = 0;
+
+   while ((pMsg = curl_multi_info_read(m_pCurlMulti, &iMsgsLeft)) != nullptr)
+   {
+      if (pMsg->msg != CURLMSG_DONE)
+         continue;
+
+      // pMsg is invalidated by the removal of the handle
+      CURLcode eResult = pMsg->data.result;
+      std::unique_ptr<Transfer> pTransfer = Detach(pMsg->easy_handle);
+      if (pTransfer)
+         Complete(std::move(pTransfer), eResult);
+   }
+}
+
+/**
+ * @brief calls the completion callback of a detached or queued transfer and frees it
+ *
+ * @param [in] pTransfer finished transfer
+ * @param [in] eResult cURL result of the transfer
+ */
+void CppHTTPAsyncClient::Complete(std::unique_ptr<Transfer> pTransfer, const CURLcode eResult)
+{
+
+   HttpResponse &Response = pTransfer->oResponse;
+   bool bSuccess = (eResult == CURLE_OK);
+   if (bSuccess)
+   {
+      long lHttpCode = 0;
+      curl_easy_getinfo(pTransfer->pCurl, CURLINFO_RESPONSE_CODE, &lHttpCode);
+      Response.iCode = static_cast<int>(lHttpCode);
+   }
+   else
+   {
+      Response.strBody.clear();
+      Response.iCode = -1;
+
+      const auto &pToken = pTransfer->oRequest.pCancelToken;
+      if (pTransfer->eTimeoutError != CppHTTPClient::ERR_NONE || eResult == CURLE_OPERATION_TIMEDOUT)
+      {
+         TimePoint tpStart = (pTransfer->tpStarted != TimePoint()) ? pTransfer->tpStarted : pTransfer->tpSubmitted;
+         long lElapsedMs = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                 std::chrono::steady_clock::now() - tpStart)
+                                                 .count());
+         if (pTransfer->eTimeoutError == CppHTTPClient::ERR_NONE)
+            pTransfer->eTimeoutError = CppHTTPClient::ClassifyTimeout(pTransfer->pCurl, pTransfer->oTimeouts,
+                                                                      lElapsedMs, pTransfer->lBudgetMs);
+
+         Response.eError = pTransfer->eTimeoutError;
+         Response.strError = CppHTTPClient::TimeoutMessage(Response.eError, lElapsedMs);
+
+         if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+            m_oLog(CppHTTPClient::StringFormat(LOG_ERROR_ASYNC_REST_FAILURE_FORMAT, pTransfer->strURL.c_str(),
+                                               eResult, Response.strError.c_str()));
+      }
+      else if (eResult == CURLE_ABORTED_BY_CALLBACK && pToken && pToken->IsCancelled())
+      {
+         Response.eError = CppHTTPClient::ERR_CANCELLED;
+         Response.strError = "Request cancelled";
+
+         if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+            m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_CANCELLED_FORMAT, pTransfer->strURL.c_str()));
+      }
+      else if (eResult == CURLE_ABORTED_BY_CALLBACK && pTransfer->eAbortError == CppHTTPClient::ERR_QUEUE_FULL)
+      {
+         Response.eError = CppHTTPClient::ERR_QUEUE_FULL;
+         Response.strError = "Request dropped from the full wait queue";
+      }
+      else if (eResult == CURLE_ABORTED_BY_CALLBACK && m_bDrainExpired)
+      {
+         Response.eError = CppHTTPClient::ERR_DRAINED;
+         Response.strError = "Request aborted by the drain of the session";
+      }
+      else
+      {
+         Response.eError = CppHTTPClient::ERR_CURL;
+         Response.strError = curl_easy_strerror(eResult);
+         if (pTransfer->bCachedFailure)
+            Response.strError += " (cached)";
+
+         if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+            m_oLog(CppHTTPClient::StringFormat(LOG_ERROR_ASYNC_REST_FAILURE_FORMAT, pTransfer->strURL.c_str(),
+                                               eResult, curl_easy_strerror(eResult)));
+      }
+   }
+
+   {
+      unsigned long long ullLatencyUs = static_cast<unsigned long long>(
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pTransfer->tpSubmitted).count());
+
+      std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+      TenantStats &oStats = m_mapTenantStats[pTransfer->oRequest.strTenant];
+      ++oStats.ullCompleted;
+      if (!bSuccess)
+         ++oStats.ullFailed;
+      oStats.ullBytesReceived += Response.strBody.size();
+      oStats.ullTotalLatencyUs += ullLatencyUs;
+      oStats.ullMaxLatencyUs = std::max(oStats.ullMaxLatencyUs, ullLatencyUs);
+   }
+
+   // the origin is measured by the transfers it answered, failed or timed out, from their start
+   const bool bMeasured = pTransfer->tpStarted != TimePoint() &&
+                          (eResult != CURLE_ABORTED_BY_CALLBACK || pTransfer->eTimeoutError != CppHTTPClient::ERR_NONE) &&
+                          pTransfer->eTimeoutError != CppHTTPClient::ERR_DEADLINE_EXCEEDED;
+   if (bMeasured)
+   {
+      unsigned long long ullServiceUs = static_cast<unsigned long long>(
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pTransfer->tpStarted).count());
+      if (!pTransfer->strEndpoint.empty() && m_pLoadBalancer)
+      {
+         m_pLoadBalancer->Release(pTransfer->strEndpoint, ullServiceUs, bSuccess && Response.iCode < 500);
+         pTransfer->strEndpoint.clear();
+      }
+      if (m_pNegativeCache)
+         m_pNegativeCache->OnResult(pTransfer->strHostKey, eResult);
+      if (pTransfer->eLimiterSlot == LIMITER_RUNNING && m_pConcurrencyLimiter)
+      {
+         m_pConcurrencyLimiter->OnComplete(pTransfer->strHostKey, ullServiceUs,
+                                           !bSuccess || Response.iCode == 429 || Response.iCode == 503);
+         pTransfer->eLimiterSlot = LIMITER_NONE;
+      }
+   }
+
+   // the origin asked for a pause, its queued requests wait for its end
+   long lRetryAfterMs = (bSuccess && m_lMaxRetryAfterMs > 0) ? CppHTTPClient::GetRetryAfterMs(Response.iCode, Response.mapHeaders) : -1;
+   if (lRetryAfterMs >= 0)
+   {
+      const long lPauseMs = std::min(lRetryAfterMs, m_lMaxRetryAfterMs);
+      TimePoint &tpPausedUntil = m_mapHostPausedUntil[pTransfer->strHostKey];
+      tpPausedUntil = std::max(tpPausedUntil, std::chrono::steady_clock::now() + std::chrono::milliseconds(lPauseMs));
+      {
+         std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+         ThrottleStats &oStats = m_mapThrottles[pTransfer->strHostKey];
+         ++oStats.ullThrottled;
+         oStats.ullPausedMs += static_cast<unsigned long long>(lPauseMs);
+         oStats.lLastRetryAfterMs = lRetryAfterMs;
+         oStats.tpPausedUntil = tpPausedUntil;
+      }
+
+      if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_ASYNC_THROTTLED_FORMAT, pTransfer->strHostKey.c_str(), lPauseMs));
+      if (m_oThrottle)
+         m_oThrottle(pTransfer->strHostKey, lPauseMs);
+   }
+
+   if (pTransfer->oCompletion)
+      pTransfer->oCompletion(bSuccess, Response);
+   else if (m_pCompletionQueue)
+   {
+      if (m_vecBatch.empty())
+         m_tpBatchStart = std::chrono::steady_clock::now();
+
+      m_vecBatch.emplace_back();
+      Completion &oCompletion = m_vecBatch.back();
+      oCompletion.oRequest = std::move(pTransfer->oRequest);
+      oCompletion.bSuccess = bSuccess;
+      oCompletion.oResponse = std::move(Response);
+
+      if (m_vecBatch.size() >= m_usMaxBatch)
+         FlushBatch(true);
+   }
+
+   DestroyTransfer(pTransfer.release());
+}
+
+/**
+ * @brief wakes the loop thread up, m_mtxSubmitted must be held
+ */
+void CppHTTPAsyncClient::Wakeup()
+{
+   if (m_bWakeupPending)
+      return;
+
+   const char cByte = 0;
+   if (write(m_arrWakeupPipe[1], &cByte, 1) == 1 || errno == EAGAIN)
+      m_bWakeupPending = true;
+}
+
+/**
+ * @brief empties the wakeup pipe (loop thread)
+ */
+void CppHTTPAsyncClient::DrainWakeup()
+{
+   char arrBuffer[64];
+   std::lock_guard<std::mutex> oLock(m_mtxSubmitted);
+   while (read(m_arrWakeupPipe[0], arrBuffer, sizeof(arrBuffer)) > 0)
+   {
+   }
+   m_bWakeupPending = false;
+}
+
+/**
+ * @brief reports the earliest of the cURL timer and the scheduled timers
+ * to the event loop when it changed
+ */
+void CppHTTPAsyncClient::ArmTimer()
+{
+   bool bArmed = m_bCurlTimerArmed || !m_mapTimers.empty();
+   TimePoint tpDeadline = m_tpCurlDeadline;
+   if (!m_mapTimers.empty() && (!m_bCurlTimerArmed || m_mapTimers.begin()->first < tpDeadline))
+      tpDeadline = m_mapTimers.begin()->first;
+
+   if (!bArmed)
+   {
+      if (m_bTimerArmed && m_oTimer)
+         m_oTimer(-1);
+      m_bTimerArmed = false;
+      return;
+   }
+
+   if (m_bTimerArmed && tpDeadline == m_tpTimerDeadline)
+      return;
+
+   m_bTimerArmed = true;
+   m_tpTimerDeadline = tpDeadline;
+
+   if (m_oTimer)
+   {
+      // rounded up, an early OnTimeout() would have nothing to do
+      auto lTimeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            tpDeadline - std::chrono::steady_clock::now() + std::chrono::microseconds(999))
+                            .count();
+      m_oTimer(static_cast<long>(std::max<long long>(lTimeoutMs, 0)));
+   }
+}
+
+/**
+ * @brief runs the expired timers
+ */
+void CppHTTPAsyncClient::RunTimers()
+{
+   TimePoint tpNow = std::chrono::steady_clock::now();
+
+   // tasks may schedule new timers, they run at the next expiry at the earliest
+   std::vector<TaskFnCallback> vecExpired;
+   while (!m_mapTimers.empty() && m_mapTimers.begin()->first <= tpNow)
+   {
+      vecExpired.push_back(std::move(m_mapTimers.begin()->second.second));
+      m_mapTimers.erase(m_mapTimers.begin());
+   }
+
+   for (auto &oTask : vecExpired)
+      oTask();
+}
+
+/**
+ * @brief publishes the pending batch of completions
+ *
+ * @param [in] bForce publish even if the oldest completion waited less than the maximum delay
+ */
+void CppHTTPAsyncClient::FlushBatch(const bool bForce)
+{
+   if (m_vecBatch.empty() || !m_pCompletionQueue)
+      return;
+
+   if (!bForce && m_iMaxBatchDelayMs > 0 &&
+       std::chrono::steady_clock::now() - m_tpBatchStart < std::chrono::milliseconds(m_iMaxBatchDelayMs))
+   {
+      if (m_ullFlushTimerId == 0)
+         m_ullFlushTimerId = ScheduleTimer(m_iMaxBatchDelayMs, [this]() {
+            m_ullFlushTimerId = 0;
+            FlushBatch(true);
+         });
+      return;
+   }
+
+   if (m_ullFlushTimerId != 0)
+   {
+      CancelTimer(m_ullFlushTimerId);
+      m_ullFlushTimerId = 0;
+   }
+
+   // the consumer lags behind: retry soon, the batch keeps growing meanwhile
+   if (!m_pCompletionQueue->Push(m_vecBatch) && m_pCurlMulti)
+      m_ullFlushTimerId = ScheduleTimer(1, [this]() {
+         m_ullFlushTimerId = 0;
+         FlushBatch(true);
+      });
+}
+
+// CURL MULTI CALLBACKS
+
+/**
+ * @brief socket callback for libcurl
+ * tracks the interest set and forwards its changes to the event loop
+ *
+ * @param pCurl easy handle owning the socket
+ * @param Socket socket whose interest changed
+ * @param iWhat CURL_POLL_IN, CURL_POLL_OUT, CURL_POLL_INOUT or CURL_POLL_REMOVE
+ * @param pUserData pointer to the asynchronous client
+ * @param pSocketData data assigned to the socket (unused)
+ *
+ * @return 0
+ */
+int CppHTTPAsyncClient::SocketCallback(CURL * /*pCurl*/, curl_socket_t Socket, int iWhat,
+                                       void *pUserData, void * /*pSocketData*/)
+{
+   CppHTTPAsyncClient *pClient = reinterpret_cast<CppHTTPAsyncClient *>(pUserData);
+
+   int iEvents = EVENT_NONE;
+   if (iWhat == CURL_POLL_IN || iWhat == CURL_POLL_INOUT)
+      iEvents |= EVENT_IN;
+   if (iWhat == CURL_POLL_OUT || iWhat == CURL_POLL_INOUT)
+      iEvents |= EVENT_OUT;
+
+   if (iEvents == EVENT_NONE)
+      pClient->m_mapSockets.erase(Socket);
+   else
+      pClient->m_mapSockets[Socket] = iEvents;
+
+   if (pClient->m_oSocket)
+      pClient->m_oSocket(Socket, iEvents);
+
+   return 0;
+}
+
+/**
+ * @brief timer callback for libcurl
+ * records the deadline, the event loop is asked for the earliest timer
+ *
+ * @param pMulti multi handle
+ * @param lTimeoutMs delay before OnTimeout() must be called, -1 to delete the timer
+ * @param pUserData pointer to the asynchronous client
+ *
+ * @return 0
+ */
+int CppHTTPAsyncClient::TimerCallback(CURLM * /*pMulti*/, long lTimeoutMs, void *pUserData)
+{
+   CppHTTPAsyncClient *pClient = reinterpret_cast<CppHTTPAsyncClient *>(pUserData);
+
+   pClient->m_bCurlTimerArmed = (lTimeoutMs >= 0);
+   if (pClient->m_bCurlTimerArmed)
+      pClient->m_tpCurlDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(lTimeoutMs);
+
+   pClient->ArmTimer();
+
+   return 0;
+}
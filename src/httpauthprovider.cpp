@@ -0,0 +1,324 @@
+#include "httpauthprovider.h"
+#include "document.h" // rapidjson's DOM-style API
+
+#include <strings.h>
+
+/**
+ * @brief constructor of the OAuth2 token provider
+ *
+ * @param [in] oConfig token endpoint, client credentials and refresh schedule
+ * @param [in] Logger a callabck to a logger function void(const std::string&)
+ */
+CppHTTPOAuth2Provider::CppHTTPOAuth2Provider(const Config &oConfig, LogFnCallback Logger)
+    : m_oConfig(oConfig),
+      m_oClient(Logger),
+      m_ullFetchId(0),
+      m_bFetchAsked(false),
+      m_bFetching(false),
+      m_bLastFailed(false),
+      m_bRunning(false),
+      m_bStopping(false),
+      m_eSettingsFlags(CppHTTPClient::ALL_FLAGS),
+      m_oLog(Logger)
+{
+}
+
+/**
+ * @brief destructor of the OAuth2 token provider, stops the worker
+ */
+CppHTTPOAuth2Provider::~CppHTTPOAuth2Provider()
+{
+   Stop();
+}
+
+/**
+ * @brief opens the session of the worker and starts it, the first token is fetched at once
+ *
+ * @param [in] bHTTPS Enable/Disable HTTPS (disabled by default)
+ * @param [in] eSettingsFlags optional use | operator to choose multiple options
+ *
+ * @retval true   Successfully started the worker.
+ * @retval false  The worker is already started, or the session couldn't be opened.
+ */
+const bool CppHTTPOAuth2Provider::Start(const bool &bHTTPS /* = false */,
+                                        const SettingsFlag &eSettingsFlags /* = ALL_FLAGS */)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxToken);
+   if (m_bRunning)
+   {
+      if (eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_AUTH_ALREADY_STARTED_MSG);
+
+      return false;
+   }
+   if (!m_oClient.InitSession(bHTTPS, eSettingsFlags))
+      return false;
+
+   CppHTTPClient::TimeoutPolicy oTimeouts;
+   oTimeouts.lTotalMs = std::max(m_oConfig.iTimeoutMs, 0);
+   m_oClient.SetTimeouts(oTimeouts);
+   m_pCancelToken = std::make_shared<CppHTTPCancelToken>();
+   m_oClient.SetCancelToken(m_pCancelToken);
+
+   m_eSettingsFlags = eSettingsFlags;
+   m_strToken.clear();
+   m_tpExpiry = TimePoint();
+   m_tpRefresh = TimePoint();
+   m_bFetchAsked = true;
+   m_bLastFailed = false;
+   m_bRunning = true;
+   m_bStopping = false;
+   m_oThread = std::thread(&CppHTTPOAuth2Provider::Worker, this);
+
+   return true;
+}
+
+/**
+ * @brief stops the worker, the fetch in flight is aborted and the waiting callers fail
+ */
+void CppHTTPOAuth2Provider::Stop()
+{
+   std::shared_ptr<CppHTTPCancelToken> pCancelToken;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxToken);
+      if (!m_bRunning || m_bStopping)
+         return;
+
+      m_bStopping = true;
+      pCancelToken = m_pCancelToken;
+   }
+   m_cvWorker.notify_all();
+   m_cvToken.notify_all();
+   pCancelToken->Cancel();
+
+   m_oThread.join();
+   m_oClient.CleanupSession();
+
+   std::lock_guard<std::mutex> oLock(m_mtxToken);
+   m_strToken.clear();
+   m_bRunning = false;
+   m_bStopping = false;
+}
+
+/**
+ * @brief returns the cached token, or waits for the token being fetched
+ *
+ * @param [out] strToken bearer token
+ *
+ * @retval true   A valid token was returned.
+ * @retval false  Not started, the token endpoint failed, or no token within iWaitMs.
+ */
+const bool CppHTTPOAuth2Provider::GetToken(std::string &strToken)
+{
+   std::unique_lock<std::mutex> oLock(m_mtxToken);
+   if (!m_bRunning || m_bStopping)
+      return false;
+
+   TimePoint tpNow = std::chrono::steady_clock::now();
+   if (!m_strToken.empty() && tpNow < m_tpExpiry)
+   {
+      strToken = m_strToken;
+      return true;
+   }
+
+   // the token endpoint just failed, it isn't asked again before iRetryMs
+   if (m_bLastFailed && !m_bFetchAsked && !m_bFetching && tpNow < m_tpRefresh)
+      return false;
+
+   // the callers waiting together share the next fetch
+   ++m_oStats.ullWaits;
+   if (!m_bFetchAsked && !m_bFetching)
+   {
+      m_bFetchAsked = true;
+      m_cvWorker.notify_one();
+   }
+   const unsigned long long ullFetchId = m_ullFetchId;
+   m_cvToken.wait_until(oLock, tpNow + std::chrono::milliseconds(std::max(m_oConfig.iWaitMs, 0)),
+                        [this, ullFetchId]() { return m_bStopping || m_ullFetchId != ullFetchId; });
+
+   if (m_bStopping || m_strToken.empty() || std::chrono::steady_clock::now() >= m_tpExpiry)
+      return false;
+
+   strToken = m_strToken;
+   return true;
+}
+
+/**
+ * @brief drops a token rejected by a server and fetches another one
+ *
+ * @param [in] strToken token sent with the rejected request
+ */
+void CppHTTPOAuth2Provider::Invalidate(const std::string &strToken)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxToken);
+   if (strToken.empty() || strToken != m_strToken)
+      return;
+
+   m_strToken.clear();
+   ++m_oStats.ullInvalidations;
+   if (m_bRunning && !m_bStopping && !m_bFetchAsked && !m_bFetching)
+   {
+      m_bFetchAsked = true;
+      m_cvWorker.notify_one();
+   }
+}
+
+const CppHTTPOAuth2Provider::Stats CppHTTPOAuth2Provider::GetStats() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxToken);
+   return m_oStats;
+}
+
+/**
+ * @brief parses the answer of a token endpoint
+ *
+ * @param [in] strBody JSON body of the answer
+ * @param [out] strToken "access_token"
+ * @param [out] lLifetimeMs "expires_in" in milliseconds, -1 when absent
+ *
+ * @retval true   A bearer token was found.
+ * @retval false  Invalid JSON, no "access_token", or a token type other than "Bearer".
+ */
+const bool CppHTTPOAuth2Provider::ParseTokenResponse(const std::string &strBody, std::string &strToken, long &lLifetimeMs)
+{
+   rapidjson::Document oDocument;
+   oDocument.Parse(strBody.c_str());
+   if (oDocument.HasParseError() || !oDocument.IsObject())
+      return false;
+
+   auto itToken = oDocument.FindMember("access_token");
+   if (itToken == oDocument.MemberEnd() || !itToken->value.IsString() || itToken->value.GetStringLength() == 0)
+      return false;
+
+   auto itType = oDocument.FindMember("token_type");
+   if (itType != oDocument.MemberEnd() && (!itType->value.IsString() || strcasecmp(itType->value.GetString(), "bearer") != 0))
+      return false;
+
+   // some servers send the lifetime as a string
+   lLifetimeMs = -1;
+   auto itExpires = oDocument.FindMember("expires_in");
+   if (itExpires != oDocument.MemberEnd())
+   {
+      if (itExpires->value.IsNumber() && itExpires->value.GetDouble() >= 0.)
+         lLifetimeMs = static_cast<long>(std::min(itExpires->value.GetDouble(), 31536000.) * 1000.);
+      else if (itExpires->value.IsString())
+      {
+         char *pszEnd = nullptr;
+         long lSeconds = strtol(itExpires->value.GetString(), &pszEnd, 10);
+         if (pszEnd != itExpires->value.GetString() && *pszEnd == '\0' && lSeconds >= 0)
+            lLifetimeMs = std::min(lSeconds, 31536000L) * 1000L;
+      }
+   }
+
+   strToken.assign(itToken->value.GetString(), itToken->value.GetStringLength());
+   return true;
+}
+
+// INTERNALS
+
+/**
+ * @brief fetches the tokens when asked or when the refresh is due, until Stop()
+ */
+void CppHTTPOAuth2Provider::Worker()
+{
+   std::unique_lock<std::mutex> oLock(m_mtxToken);
+   while (!m_bStopping)
+   {
+      if (!m_bFetchAsked && std::chrono::steady_clock::now() < m_tpRefresh)
+      {
+         m_cvWorker.wait_until(oLock, m_tpRefresh);
+         continue;
+      }
+
+      m_bFetchAsked = false;
+      m_bFetching = true;
+      oLock.unlock();
+
+      std::string strToken;
+      long lLifetimeMs = -1;
+      const bool bFetched = Fetch(strToken, lLifetimeMs);
+      TimePoint tpNow = std::chrono::steady_clock::now();
+
+      oLock.lock();
+      m_bFetching = false;
+      ++m_oStats.ullFetches;
+      if (bFetched)
+      {
+         if (lLifetimeMs < 0)
+            lLifetimeMs = std::max(m_oConfig.iDefaultLifetimeMs, 0);
+         const double dRatio = (m_oConfig.dRefreshRatio > 0. && m_oConfig.dRefreshRatio <= 1.) ? m_oConfig.dRefreshRatio : 1.;
+         // a token living a few milliseconds must not make the worker spin
+         const long lRefreshMs = std::max(static_cast<long>(lLifetimeMs * dRatio), 100L);
+
+         m_strToken = strToken;
+         m_tpExpiry = tpNow + std::chrono::milliseconds(lLifetimeMs);
+         m_tpRefresh = tpNow + std::chrono::milliseconds(lRefreshMs);
+         m_bLastFailed = false;
+      }
+      else
+      {
+         // the current token is kept until it expires
+         ++m_oStats.ullFailures;
+         m_tpRefresh = tpNow + std::chrono::milliseconds(std::max(m_oConfig.iRetryMs, 1));
+         m_bLastFailed = true;
+      }
+      ++m_ullFetchId;
+      m_cvToken.notify_all();
+   }
+}
+
+/**
+ * @brief requests a token from the token endpoint, worker thread only
+ *
+ * @param [out] strToken bearer token
+ * @param [out] lLifetimeMs lifetime of the token, -1 when unknown
+ */
+const bool CppHTTPOAuth2Provider::Fetch(std::string &strToken, long &lLifetimeMs)
+{
+   CppHTTPClient::HeadersMap mapHeaders;
+   mapHeaders["Content-Type"] = "application/x-www-form-urlencoded";
+   mapHeaders["Accept"] = "application/json";
+
+   std::string strBody = "grant_type=client_credentials&client_id=" + UrlEncode(m_oConfig.strClientId) +
+                         "&client_secret=" + UrlEncode(m_oConfig.strClientSecret);
+   if (!m_oConfig.strScope.empty())
+      strBody += "&scope=" + UrlEncode(m_oConfig.strScope);
+
+   CppHTTPClient::HttpResponse Response;
+   if (!m_oClient.Post(m_oConfig.strTokenUrl, mapHeaders, strBody, Response))
+      return false; // logged by the client
+
+   std::string strError;
+   if (Response.iCode < 200 || Response.iCode >= 300)
+      strError = "HTTP " + std::to_string(Response.iCode);
+   else if (!ParseTokenResponse(Response.strBody, strToken, lLifetimeMs))
+      strError = "invalid token response";
+   else
+      return true;
+
+   if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+      m_oLog(CppHTTPClient::StringFormat(LOG_ERROR_AUTH_FETCH_FORMAT, m_oConfig.strTokenUrl.c_str(), strError.c_str()));
+   return false;
+}
+
+/**
+ * @brief percent-encodes a form value, only the unreserved characters are kept
+ */
+std::string CppHTTPOAuth2Provider::UrlEncode(const std::string &strValue)
+{
+   static const char szHex[] = "0123456789ABCDEF";
+   std::string strEncoded;
+   strEncoded.reserve(strValue.size());
+   for (const char c : strValue)
+   {
+      if (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.' || c == '_' || c == '~')
+         strEncoded += c;
+      else
+      {
+         strEncoded += '%';
+         strEncoded += szHex[static_cast<unsigned char>(c) >> 4];
+         strEncoded += szHex[static_cast<unsigned char>(c) & 0x0F];
+      }
+   }
+   return strEncoded;
+}
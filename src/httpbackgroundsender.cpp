@@ -0,0 +1,248 @@
+#include "httpbackgroundsender.h"
+
+/**
+ * @brief constructor of the background sender
+ *
+ * @param [in] Logger a callabck to a logger function void(const std::string&)
+ * @param [in] usMaxQueued maximum number of queued messages
+ * @param [in] usSessions number of worker threads, and so of sessions
+ * @param [in] eDropPolicy message discarded when the queue is full
+ */
+CppHTTPBackgroundSender::CppHTTPBackgroundSender(LogFnCallback Logger, const size_t usMaxQueued /* = 1024 */,
+                                                 const size_t usSessions /* = 2 */,
+                                                 const DropPolicy eDropPolicy /* = DROP_NEWEST */)
+    : m_usMaxQueued(std::max<size_t>(usMaxQueued, 1)),
+      m_usSessions(std::max<size_t>(usSessions, 1)),
+      m_eDropPolicy(eDropPolicy),
+      m_bHTTPS(false),
+      m_eSettingsFlags(CppHTTPClient::ALL_FLAGS),
+      m_iCurlTimeout(0),
+      m_usActiveWorkers(0),
+      m_usSending(0),
+      m_bRunning(false),
+      m_bStopping(false),
+      m_bFlushOnShutdown(false),
+      m_iFlushTimeoutMs(5000),
+      m_oLog(Logger)
+{
+}
+
+/**
+ * @brief destructor of the background sender, stops the workers
+ */
+CppHTTPBackgroundSender::~CppHTTPBackgroundSender()
+{
+   Stop();
+}
+
+void CppHTTPBackgroundSender::SetFlushOnShutdown(const bool bFlush, const int iTimeoutMs /* = 5000 */)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxQueue);
+   m_bFlushOnShutdown = bFlush;
+   m_iFlushTimeoutMs = std::max(iTimeoutMs, 0);
+}
+
+const bool CppHTTPBackgroundSender::GetFlushOnShutdown() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxQueue);
+   return m_bFlushOnShutdown;
+}
+
+/**
+ * @brief starts the worker threads, each one opens its session
+ *
+ * @param [in] bHTTPS Enable/Disable HTTPS (disabled by default)
+ * @param [in] eSettingsFlags optional use | operator to choose multiple options
+ *
+ * @retval true   Successfully started the workers.
+ * @retval false  The workers are already started.
+ */
+const bool CppHTTPBackgroundSender::Start(const bool &bHTTPS /* = false */,
+                                          const SettingsFlag &eSettingsFlags /* = ALL_FLAGS */)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxQueue);
+   if (m_bRunning)
+   {
+      if (eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_SENDER_ALREADY_STARTED_MSG);
+
+      return false;
+   }
+
+   m_bHTTPS = bHTTPS;
+   m_eSettingsFlags = eSettingsFlags;
+   m_pCancelToken = std::make_shared<CppHTTPCancelToken>();
+   m_bRunning = true;
+   m_bStopping = false;
+
+   m_usActiveWorkers = m_usSessions;
+   for (size_t i = 0; i < m_usSessions; ++i)
+      m_vecWorkers.emplace_back(&CppHTTPBackgroundSender::Worker, this);
+
+   return true;
+}
+
+/**
+ * @brief stops the worker threads
+ *
+ * With the flush on shutdown, the queued messages are sent until the flush
+ * timeout. The messages left are then discarded and the running requests
+ * aborted, so Stop() returns in bounded time.
+ */
+void CppHTTPBackgroundSender::Stop()
+{
+   std::shared_ptr<CppHTTPCancelToken> pCancelToken;
+   std::chrono::steady_clock::time_point tpDeadline;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      if (!m_bRunning || m_bStopping)
+         return;
+
+      m_bStopping = true;
+      m_tpStopDeadline = std::chrono::steady_clock::now() +
+                         std::chrono::milliseconds(m_bFlushOnShutdown ? m_iFlushTimeoutMs : 0);
+      tpDeadline = m_tpStopDeadline;
+      pCancelToken = m_pCancelToken;
+   }
+   m_cvQueue.notify_all();
+
+   {
+      std::unique_lock<std::mutex> oLock(m_mtxQueue);
+      m_cvIdle.wait_until(oLock, tpDeadline, [this]() { return m_usActiveWorkers == 0; });
+   }
+   pCancelToken->Cancel();
+
+   for (auto &Worker : m_vecWorkers)
+      Worker.join();
+
+   size_t usDiscarded = 0;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      m_vecWorkers.clear();
+      usDiscarded = m_dqMessages.size();
+      m_oStats.ullDiscarded += usDiscarded;
+      m_dqMessages.clear();
+      m_bRunning = false;
+      m_bStopping = false;
+   }
+   m_cvIdle.notify_all();
+
+   if (usDiscarded > 0 && (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG))
+      m_oLog(CppHTTPClient::StringFormat(LOG_WARNING_SENDER_DISCARDED_FORMAT, static_cast<unsigned>(usDiscarded)));
+}
+
+/**
+ * @brief waits until every queued message was sent
+ *
+ * @param [in] iTimeoutMs maximum time to wait, in milliseconds
+ *
+ * @retval true   The queue is empty and no message is being sent.
+ * @retval false  Timed out, or the workers are not running.
+ */
+const bool CppHTTPBackgroundSender::Flush(const int iTimeoutMs)
+{
+   std::unique_lock<std::mutex> oLock(m_mtxQueue);
+   return m_cvIdle.wait_for(oLock, std::chrono::milliseconds(std::max(iTimeoutMs, 0)), [this]() {
+      return !m_bRunning || (m_dqMessages.empty() && m_usSending == 0);
+   }) && m_bRunning;
+}
+
+/**
+ * @brief queues a POST request, returns at once
+ *
+ * @param [in] strUrl url to post to
+ * @param [in] Headers headers to send
+ * @param [in] strBody data to post
+ *
+ * @retval true   The message is queued.
+ * @retval false  The workers are not running, or the queue is full with DROP_NEWEST.
+ */
+const bool CppHTTPBackgroundSender::Enqueue(const std::string &strUrl, const HeadersMap &Headers,
+                                            const std::string &strBody)
+{
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxQueue);
+      if (!m_bRunning || m_bStopping)
+         return false;
+
+      if (m_dqMessages.size() >= m_usMaxQueued)
+      {
+         ++m_oStats.ullDropped;
+         if (m_eDropPolicy == DROP_NEWEST)
+            return false;
+         m_dqMessages.pop_front();
+      }
+
+      Message oMessage;
+      oMessage.strUrl = strUrl;
+      oMessage.mapHeaders = Headers;
+      oMessage.strBody = strBody;
+      m_dqMessages.push_back(std::move(oMessage));
+      ++m_oStats.ullEnqueued;
+   }
+   m_cvQueue.notify_one();
+
+   return true;
+}
+
+/**
+ * @brief returns the delivery statistics
+ */
+const CppHTTPBackgroundSender::Stats CppHTTPBackgroundSender::GetStats() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxQueue);
+   Stats oStats = m_oStats;
+   oStats.usQueued = m_dqMessages.size();
+   return oStats;
+}
+
+/**
+ * @brief worker thread, sends the queued messages through its own session
+ */
+void CppHTTPBackgroundSender::Worker()
+{
+   CppHTTPClient oClient(m_oLog);
+   std::unique_lock<std::mutex> oLock(m_mtxQueue);
+   oClient.SetTimeout(m_iCurlTimeout);
+   oClient.SetCancelToken(m_pCancelToken);
+   const bool bHTTPS = m_bHTTPS;
+   const SettingsFlag eSettingsFlags = m_eSettingsFlags;
+   oLock.unlock();
+
+   oClient.InitSession(bHTTPS, eSettingsFlags);
+   oLock.lock();
+
+   for (;;)
+   {
+      m_cvQueue.wait(oLock, [this]() { return m_bStopping || !m_dqMessages.empty(); });
+      if (m_dqMessages.empty() || (m_bStopping && std::chrono::steady_clock::now() >= m_tpStopDeadline))
+         break;
+
+      Message oMessage = std::move(m_dqMessages.front());
+      m_dqMessages.pop_front();
+      ++m_usSending;
+      oLock.unlock();
+
+      CppHTTPClient::HttpResponse oResponse;
+      bool bSent = oClient.Post(oMessage.strUrl, oMessage.mapHeaders, oMessage.strBody, oResponse) &&
+                   oResponse.iCode < 400;
+
+      oLock.lock();
+      --m_usSending;
+      if (bSent)
+         ++m_oStats.ullSent;
+      else if (oResponse.eError == CppHTTPClient::ERR_CANCELLED)
+         ++m_oStats.ullDiscarded;
+      else
+         ++m_oStats.ullFailed;
+
+      if (m_dqMessages.empty() && m_usSending == 0)
+         m_cvIdle.notify_all();
+   }
+
+   --m_usActiveWorkers;
+   m_cvIdle.notify_all();
+   oLock.unlock();
+
+   oClient.CleanupSession();
+}
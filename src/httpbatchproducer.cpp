@@ -0,0 +1,363 @@
+#include "httpbatchproducer.h"
+
+#include "document.h"
+#include "stringbuffer.h"
+#include "writer.h"
+
+/**
+ * @brief constructor of the batching producer
+ *
+ * @param [in] Logger a callabck to a logger function void(const std::string&)
+ * @param [in] usMaxItems items per bulk request
+ * @param [in] usMaxBytes maximum size of a bulk request body, a larger item is sent alone
+ * @param [in] iLingerMs maximum time the first item of a batch waits for the next ones
+ * @param [in] eFormat body of the bulk requests
+ * @param [in] usSessions number of worker threads, and so of sessions
+ */
+CppHTTPBatchProducer::CppHTTPBatchProducer(LogFnCallback Logger, const size_t usMaxItems /* = 100 */,
+                                           const size_t usMaxBytes /* = 1 << 20 */, const int iLingerMs /* = 5 */,
+                                           const Format eFormat /* = FORMAT_JSON_ARRAY */,
+                                           const size_t usSessions /* = 1 */)
+    : m_usMaxItems(std::max<size_t>(usMaxItems, 1)),
+      m_usMaxBytes(std::max<size_t>(usMaxBytes, 1)),
+      m_iLingerMs(std::max(iLingerMs, 0)),
+      m_eFormat(eFormat),
+      m_usSessions(std::max<size_t>(usSessions, 1)),
+      m_bHTTPS(false),
+      m_eSettingsFlags(CppHTTPClient::ALL_FLAGS),
+      m_iCurlTimeout(0),
+      m_bRunning(false),
+      m_bStopping(false),
+      m_oLog(Logger)
+{
+}
+
+/**
+ * @brief destructor of the batching producer, sends the pending items and stops the workers
+ */
+CppHTTPBatchProducer::~CppHTTPBatchProducer()
+{
+   Stop();
+}
+
+void CppHTTPBatchProducer::SetHeaders(const HeadersMap &Headers)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBatches);
+   m_mapHeaders = Headers;
+}
+
+/**
+ * @brief starts the worker threads, each one opens its session
+ *
+ * @param [in] bHTTPS Enable/Disable HTTPS (disabled by default)
+ * @param [in] eSettingsFlags optional use | operator to choose multiple options
+ *
+ * @retval true   Successfully started the workers.
+ * @retval false  The workers are already started.
+ */
+const bool CppHTTPBatchProducer::Start(const bool &bHTTPS /* = false */,
+                                       const SettingsFlag &eSettingsFlags /* = ALL_FLAGS */)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBatches);
+   if (m_bRunning)
+   {
+      if (eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+         m_oLog(LOG_ERROR_PRODUCER_ALREADY_STARTED_MSG);
+
+      return false;
+   }
+
+   m_bHTTPS = bHTTPS;
+   m_eSettingsFlags = eSettingsFlags;
+   m_bRunning = true;
+   m_bStopping = false;
+
+   for (size_t i = 0; i < m_usSessions; ++i)
+      m_vecWorkers.emplace_back(&CppHTTPBatchProducer::Worker, this);
+
+   return true;
+}
+
+/**
+ * @brief sends the pending batches without waiting for their linger time,
+ * then stops the workers
+ */
+void CppHTTPBatchProducer::Stop()
+{
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxBatches);
+      if (!m_bRunning || m_bStopping)
+         return;
+
+      m_bStopping = true;
+   }
+   m_cvBatches.notify_all();
+
+   for (auto &Worker : m_vecWorkers)
+      Worker.join();
+
+   std::lock_guard<std::mutex> oLock(m_mtxBatches);
+   m_vecWorkers.clear();
+   m_bRunning = false;
+   m_bStopping = false;
+}
+
+/**
+ * @brief adds an item to the batch of its URL
+ *
+ * @param [in] strUrl bulk endpoint
+ * @param [in] strJson item, a JSON document
+ *
+ * @retval future resolved once the bulk request is performed, with the result
+ * of the item or the whole bulk response. Response.iCode is -1 when the
+ * transfer failed or the workers are not started.
+ *
+ * Example Usage:
+ * @code
+ *    auto oFuture = m_pProducer->Send("http://collector/bulk", "{\"event\":\"click\"}");
+ *    CppHTTPClient::HttpResponse Response = oFuture.get();
+ * @endcode
+ */
+std::future<CppHTTPBatchProducer::HttpResponse> CppHTTPBatchProducer::Send(const std::string &strUrl,
+                                                                          const std::string &strJson)
+{
+   std::promise<HttpResponse> oPromise;
+   std::future<HttpResponse> oFuture = oPromise.get_future();
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxBatches);
+      if (m_bRunning && !m_bStopping)
+      {
+         // an item larger than the limit is sent alone
+         size_t usItemBytes = strJson.size() + 1; // separator
+         auto it = m_mapOpen.find(strUrl);
+         if (it != m_mapOpen.end() && it->second.usBytes + usItemBytes > m_usMaxBytes)
+            Seal(strUrl);
+
+         Batch &oBatch = m_mapOpen[strUrl];
+         bool bFirst = oBatch.vecItems.empty();
+         if (bFirst)
+         {
+            oBatch.strUrl = strUrl;
+            oBatch.tpFirst = std::chrono::steady_clock::now();
+         }
+         oBatch.vecItems.push_back(strJson);
+         oBatch.vecPromises.push_back(std::move(oPromise));
+         oBatch.usBytes += usItemBytes;
+         ++m_oStats.ullItems;
+
+         bool bSealed = (oBatch.vecItems.size() >= m_usMaxItems || oBatch.usBytes >= m_usMaxBytes);
+         if (bSealed)
+            Seal(strUrl);
+
+         // a new linger time or a ready batch
+         if (bFirst || bSealed)
+            m_cvBatches.notify_one();
+
+         return oFuture;
+      }
+   }
+
+   if (m_eSettingsFlags & CppHTTPClient::ENABLE_LOG)
+      m_oLog(LOG_ERROR_PRODUCER_NOT_STARTED_MSG);
+
+   HttpResponse Response;
+   Response.iCode = -1;
+   Response.eError = CppHTTPClient::ERR_CURL;
+   Response.strError = LOG_ERROR_PRODUCER_NOT_STARTED_MSG;
+   oPromise.set_value(std::move(Response));
+
+   return oFuture;
+}
+
+/**
+ * @brief returns the batching statistics
+ */
+const CppHTTPBatchProducer::Stats CppHTTPBatchProducer::GetStats() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBatches);
+   return m_oStats;
+}
+
+/**
+ * @brief splits a bulk response into one result per item
+ *
+ * @param [in] strBody body of the bulk response
+ * @param [in] usItems number of items of the bulk request
+ * @param [in] eFormat FORMAT_JSON_ARRAY expects a JSON array, FORMAT_NDJSON one line per result
+ * @param [out] vecResults results, serialized JSON values or NDJSON lines
+ *
+ * @retval true   The response holds exactly one result per item.
+ * @retval false  The response can't be split, vecResults is empty.
+ */
+const bool CppHTTPBatchProducer::SplitResponse(const std::string &strBody, const size_t usItems, const Format eFormat,
+                                               std::vector<std::string> &vecResults)
+{
+   vecResults.clear();
+   if (eFormat == FORMAT_NDJSON)
+   {
+      size_t usStart = 0;
+      while (usStart < strBody.size())
+      {
+         size_t usEnd = strBody.find('\n', usStart);
+         if (usEnd == std::string::npos)
+            usEnd = strBody.size();
+
+         std::string strLine = strBody.substr(usStart, usEnd - usStart);
+         if (!strLine.empty() && strLine.back() == '\r')
+            strLine.pop_back();
+         if (!strLine.empty())
+            vecResults.push_back(strLine);
+         usStart = usEnd + 1;
+      }
+   }
+   else
+   {
+      rapidjson::Document oDocument;
+      if (oDocument.Parse(strBody.c_str()).HasParseError() || !oDocument.IsArray())
+         return false;
+
+      for (rapidjson::Value::ConstValueIterator it = oDocument.Begin(); it != oDocument.End(); ++it)
+      {
+         rapidjson::StringBuffer oBuffer;
+         rapidjson::Writer<rapidjson::StringBuffer> oWriter(oBuffer);
+         it->Accept(oWriter);
+         vecResults.push_back(oBuffer.GetString());
+      }
+   }
+
+   if (vecResults.size() != usItems)
+   {
+      vecResults.clear();
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief moves the open batch of a URL to the ready ones, m_mtxBatches must be held
+ *
+ * @param [in] strUrl URL of the batch
+ */
+void CppHTTPBatchProducer::Seal(const std::string &strUrl)
+{
+   auto it = m_mapOpen.find(strUrl);
+   if (it == m_mapOpen.end())
+      return;
+
+   m_dqReady.push_back(std::move(it->second));
+   m_mapOpen.erase(it);
+}
+
+/**
+ * @brief worker thread, seals the batches whose linger time elapsed and sends
+ * the ready ones through its own session
+ */
+void CppHTTPBatchProducer::Worker()
+{
+   CppHTTPClient oClient(m_oLog);
+   std::unique_lock<std::mutex> oLock(m_mtxBatches);
+   oClient.SetTimeout(m_iCurlTimeout);
+   const bool bHTTPS = m_bHTTPS;
+   const SettingsFlag eSettingsFlags = m_eSettingsFlags;
+   oLock.unlock();
+
+   oClient.InitSession(bHTTPS, eSettingsFlags);
+   oLock.lock();
+
+   for (;;)
+   {
+      auto tpNow = std::chrono::steady_clock::now();
+      auto tpWake = std::chrono::steady_clock::time_point::max();
+      for (auto it = m_mapOpen.begin(); it != m_mapOpen.end();)
+      {
+         auto tpLinger = it->second.tpFirst + std::chrono::milliseconds(m_iLingerMs);
+         if (m_bStopping || tpLinger <= tpNow)
+         {
+            m_dqReady.push_back(std::move(it->second));
+            it = m_mapOpen.erase(it);
+         }
+         else
+         {
+            tpWake = std::min(tpWake, tpLinger);
+            ++it;
+         }
+      }
+
+      if (!m_dqReady.empty())
+      {
+         Batch oBatch = std::move(m_dqReady.front());
+         m_dqReady.pop_front();
+         HeadersMap mapHeaders = m_mapHeaders;
+         oLock.unlock();
+
+         mapHeaders["Content-Type"] = (m_eFormat == FORMAT_NDJSON) ? "application/x-ndjson" : "application/json";
+         Deliver(oClient, oBatch, mapHeaders);
+
+         oLock.lock();
+         continue;
+      }
+
+      if (m_bStopping)
+         break;
+      if (m_mapOpen.empty())
+         m_cvBatches.wait(oLock);
+      else
+         m_cvBatches.wait_until(oLock, tpWake);
+   }
+   oLock.unlock();
+
+   oClient.CleanupSession();
+}
+
+/**
+ * @brief performs a bulk request and resolves the futures of its items
+ *
+ * @param [in] oClient session of the worker
+ * @param [in] oBatch sealed batch
+ * @param [in] Headers headers of the bulk request
+ */
+void CppHTTPBatchProducer::Deliver(CppHTTPClient &oClient, Batch &oBatch, const HeadersMap &Headers)
+{
+   std::string strBody;
+   strBody.reserve(oBatch.usBytes + 2);
+   if (m_eFormat == FORMAT_NDJSON)
+   {
+      for (const std::string &strItem : oBatch.vecItems)
+         strBody.append(strItem).push_back('\n');
+   }
+   else
+   {
+      strBody.push_back('[');
+      for (size_t i = 0; i < oBatch.vecItems.size(); ++i)
+      {
+         if (i > 0)
+            strBody.push_back(',');
+         strBody.append(oBatch.vecItems[i]);
+      }
+      strBody.push_back(']');
+   }
+
+   HttpResponse Response;
+   bool bSuccess = oClient.Post(oBatch.strUrl, Headers, strBody, Response) && Response.iCode < 400;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxBatches);
+      ++m_oStats.ullBatches;
+      m_oStats.ullBytes += strBody.size();
+      if (!bSuccess)
+         ++m_oStats.ullFailedBatches;
+   }
+
+   std::vector<std::string> vecResults;
+   bool bSplit = Response.eError == CppHTTPClient::ERR_NONE &&
+                 SplitResponse(Response.strBody, oBatch.vecItems.size(), m_eFormat, vecResults);
+   for (size_t i = 0; i < oBatch.vecPromises.size(); ++i)
+   {
+      HttpResponse ItemResponse;
+      ItemResponse.iCode = Response.iCode;
+      ItemResponse.mapHeaders = Response.mapHeaders;
+      ItemResponse.strBody = bSplit ? vecResults[i] : Response.strBody;
+      ItemResponse.eError = Response.eError;
+      ItemResponse.strError = Response.strError;
+      oBatch.vecPromises[i].set_value(std::move(ItemResponse));
+   }
+}
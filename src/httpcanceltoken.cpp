@@ -0,0 +1,53 @@
+#include "httpcanceltoken.h"
+
+/**
+ * @brief constructor of the cancellation token, not cancelled
+ */
+CppHTTPCancelToken::CppHTTPCancelToken() : m_bCancelled(false), m_ullLastId(0)
+{
+}
+
+/**
+ * @brief cancels the token and runs the subscribed callbacks, can be called from any thread
+ */
+void CppHTTPCancelToken::Cancel()
+{
+   std::lock_guard<std::mutex> oLock(m_mtxCallbacks);
+   if (m_bCancelled.exchange(true, std::memory_order_acq_rel))
+      return;
+
+   for (auto &oCallback : m_mapCallbacks)
+      oCallback.second();
+   m_mapCallbacks.clear();
+}
+
+/**
+ * @brief registers a callback run on cancellation
+ *
+ * @param [in] oCallback callback, run inline when the token is already cancelled
+ *
+ * @retval identifier of the subscription, 0 when the callback already ran
+ */
+const unsigned long long CppHTTPCancelToken::Subscribe(CancelFnCallback oCallback)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxCallbacks);
+   if (m_bCancelled.load(std::memory_order_acquire))
+   {
+      oCallback();
+      return 0;
+   }
+
+   m_mapCallbacks.emplace(++m_ullLastId, oCallback);
+   return m_ullLastId;
+}
+
+/**
+ * @brief removes a callback, waits for it when Cancel() is running it
+ *
+ * @param [in] ullId identifier returned by Subscribe()
+ */
+void CppHTTPCancelToken::Unsubscribe(const unsigned long long ullId)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxCallbacks);
+   m_mapCallbacks.erase(ullId);
+}
@@ -0,0 +1,232 @@
+#include "httpcircuitbreaker.h"
+
+#include <algorithm>
+
+/**
+ * @brief constructor of the circuit breaker
+ *
+ * @param [in] oPolicy failure rate window, open time and probes
+ */
+CppHTTPCircuitBreaker::CppHTTPCircuitBreaker(const Policy &oPolicy /* = Policy() */) : m_oPolicy(oPolicy)
+{
+}
+
+void CppHTTPCircuitBreaker::SetTransitionCallback(TransitionFnCallback oTransition)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   m_oTransition = oTransition;
+}
+
+/**
+ * @brief tells whether a request to an origin may be sent
+ *
+ * @param [in] strHost origin of the request
+ * @param [out] ullProbeCycle half-open cycle probed by the request, 0 when it is not a probe
+ *
+ * @retval true   The request may be sent.
+ * @retval false  The circuit is open, the request must fail fast.
+ */
+const bool CppHTTPCircuitBreaker::Allow(const std::string &strHost, unsigned long long &ullProbeCycle)
+{
+   ullProbeCycle = 0;
+   State eFrom = STATE_CLOSED;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxHosts);
+      Host &oHost = m_mapHosts[strHost];
+      if (oHost.eState == STATE_CLOSED)
+         return true;
+
+      eFrom = oHost.eState;
+      auto tpNow = std::chrono::steady_clock::now();
+      if (oHost.eState == STATE_OPEN)
+      {
+         if (tpNow - oHost.tpOpened < std::chrono::milliseconds(m_oPolicy.iOpenMs))
+         {
+            ++oHost.ullRejected;
+            return false;
+         }
+         Transition(oHost, STATE_HALF_OPEN, tpNow);
+      }
+
+      if (oHost.usProbesSent >= std::max<size_t>(m_oPolicy.usProbes, 1))
+      {
+         ++oHost.ullRejected;
+         return false;
+      }
+      ++oHost.usProbesSent;
+      ullProbeCycle = oHost.ullCycle;
+   }
+
+   if (eFrom == STATE_OPEN)
+      Notify(strHost, STATE_OPEN, STATE_HALF_OPEN);
+   return true;
+}
+
+/**
+ * @brief records the result of a request allowed by Allow()
+ *
+ * @param [in] strHost origin of the request
+ * @param [in] eOutcome result of the request
+ * @param [in] ullProbeCycle as set by Allow()
+ */
+void CppHTTPCircuitBreaker::OnResult(const std::string &strHost, const Outcome eOutcome,
+                                     const unsigned long long ullProbeCycle)
+{
+   State eFrom = STATE_CLOSED;
+   State eTo = STATE_CLOSED;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxHosts);
+      Host &oHost = m_mapHosts[strHost];
+      eFrom = eTo = oHost.eState;
+      auto tpNow = std::chrono::steady_clock::now();
+
+      if (ullProbeCycle != 0)
+      {
+         // a probe of an earlier half-open cycle tells nothing about this one
+         if (oHost.eState != STATE_HALF_OPEN || oHost.ullCycle != ullProbeCycle)
+            return;
+
+         if (eOutcome == OUTCOME_IGNORED)
+         {
+            if (oHost.usProbesSent > 0)
+               --oHost.usProbesSent;
+         }
+         else if (eOutcome == OUTCOME_FAILURE)
+            Transition(oHost, STATE_OPEN, tpNow);
+         else if (++oHost.usProbesSucceeded >= std::max<size_t>(m_oPolicy.usProbes, 1))
+            Transition(oHost, STATE_CLOSED, tpNow);
+      }
+      // the requests sent before the circuit opened don't count anymore
+      else if (oHost.eState == STATE_CLOSED && eOutcome != OUTCOME_IGNORED)
+      {
+         long long llSlot = GetSlot(tpNow);
+         Bucket &oBucket = oHost.vecWindow[static_cast<size_t>(llSlot % WINDOW_BUCKETS)];
+         if (oBucket.llSlot != llSlot)
+            oBucket = Bucket();
+         oBucket.llSlot = llSlot;
+         ++oBucket.usRequests;
+         if (eOutcome == OUTCOME_FAILURE)
+            ++oBucket.usFailures;
+
+         size_t usRequests = 0;
+         size_t usFailures = 0;
+         CountWindow(oHost, llSlot, usRequests, usFailures);
+         if (usRequests >= std::max<size_t>(m_oPolicy.usMinRequests, 1) &&
+             usFailures * 100. >= m_oPolicy.dFailurePercent * usRequests)
+            Transition(oHost, STATE_OPEN, tpNow);
+      }
+      eTo = oHost.eState;
+   }
+
+   if (eFrom != eTo)
+      Notify(strHost, eFrom, eTo);
+}
+
+/**
+ * @brief returns the state of the circuit of an origin
+ */
+const CppHTTPCircuitBreaker::State CppHTTPCircuitBreaker::GetState(const std::string &strHost) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   auto itHost = m_mapHosts.find(strHost);
+   return (itHost == m_mapHosts.end()) ? STATE_CLOSED : itHost->second.eState;
+}
+
+/**
+ * @brief returns the state and the counters of the circuit of an origin
+ */
+const CppHTTPCircuitBreaker::HostStats CppHTTPCircuitBreaker::GetStats(const std::string &strHost) const
+{
+   HostStats oStats;
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   auto itHost = m_mapHosts.find(strHost);
+   if (itHost == m_mapHosts.end())
+      return oStats;
+
+   const Host &oHost = itHost->second;
+   oStats.eState = oHost.eState;
+   oStats.ullRejected = oHost.ullRejected;
+   oStats.ullOpened = oHost.ullOpened;
+   CountWindow(oHost, GetSlot(std::chrono::steady_clock::now()), oStats.usRequests, oStats.usFailures);
+   return oStats;
+}
+
+/**
+ * @brief returns the name of a state, for the logs and the metrics
+ */
+const char *CppHTTPCircuitBreaker::StateName(const State eState)
+{
+   switch (eState)
+   {
+   case STATE_CLOSED:
+      return "closed";
+   case STATE_OPEN:
+      return "open";
+   case STATE_HALF_OPEN:
+      return "half-open";
+   }
+   return "";
+}
+
+// INTERNALS
+
+/**
+ * @brief returns the time slot of the sliding window tpNow belongs to
+ */
+const long long CppHTTPCircuitBreaker::GetSlot(const TimePoint &tpNow) const
+{
+   long long llSlotMs = std::max<long long>(m_oPolicy.iWindowMs / static_cast<long long>(WINDOW_BUCKETS), 1);
+   return std::chrono::duration_cast<std::chrono::milliseconds>(tpNow.time_since_epoch()).count() / llSlotMs;
+}
+
+/**
+ * @brief sums the requests and the failures of the window ending at llSlot, m_mtxHosts must be held
+ */
+void CppHTTPCircuitBreaker::CountWindow(const Host &oHost, const long long llSlot, size_t &usRequests,
+                                        size_t &usFailures) const
+{
+   usRequests = 0;
+   usFailures = 0;
+   for (const auto &oBucket : oHost.vecWindow)
+   {
+      if (oBucket.llSlot > llSlot - static_cast<long long>(WINDOW_BUCKETS))
+      {
+         usRequests += oBucket.usRequests;
+         usFailures += oBucket.usFailures;
+      }
+   }
+}
+
+/**
+ * @brief changes the state of a circuit, m_mtxHosts must be held
+ */
+void CppHTTPCircuitBreaker::Transition(Host &oHost, const State eState, const TimePoint &tpNow)
+{
+   oHost.eState = eState;
+   ++oHost.ullCycle;
+   oHost.usProbesSent = 0;
+   oHost.usProbesSucceeded = 0;
+
+   if (eState == STATE_OPEN)
+   {
+      oHost.tpOpened = tpNow;
+      ++oHost.ullOpened;
+   }
+   // a closed circuit starts a new window
+   else if (eState == STATE_CLOSED)
+      oHost.vecWindow.assign(WINDOW_BUCKETS, Bucket());
+}
+
+/**
+ * @brief reports a state change to the transition callback
+ */
+void CppHTTPCircuitBreaker::Notify(const std::string &strHost, const State eFrom, const State eTo)
+{
+   TransitionFnCallback oTransition;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxHosts);
+      oTransition = m_oTransition;
+   }
+   if (oTransition)
+      oTransition(strHost, eFrom, eTo);
+}
@@ -1,10 +1,87 @@
 #include "httpclient.h"
+#include "httpcanceltoken.h"
+#include "httpcircuitbreaker.h"
+#include "httploadbalancer.h"
+#include "httpnegativecache.h"
+#include "httpauthprovider.h"
+#include "httpratelimiter.h"
+#include "httpretrybudget.h"
+#include "httpsingleflight.h"
+
+#include <condition_variable>
+#include <ctime>
+#include <strings.h>
+#include <thread>
 
 // Static members initialization
 volatile int CppHTTPClient::s_iCurlSession = 0;
 std::string CppHTTPClient::s_strCertificationAuthorityFile;
 std::mutex CppHTTPClient::s_mtxCurlSession;
 
+namespace
+{
+// request phases, in order
+enum Phase
+{
+   PHASE_DNS,
+   PHASE_CONNECT,
+   PHASE_TLS,
+   PHASE_FIRST_BYTE,
+   PHASE_TRANSFER,
+   PHASE_COUNT
+};
+
+/**
+ * @brief finds the current phase of a transfer from its timing information
+ *
+ * @param [in] pCurl easy handle of the transfer
+ * @param [out] lPhaseStartMs start of the phase, relative to the start of the transfer
+ */
+Phase GetPhase(CURL *pCurl, long &lPhaseStartMs)
+{
+   curl_off_t llDns = 0, llConnect = 0, llTls = 0, llPreTransfer = 0, llStart = 0;
+   curl_easy_getinfo(pCurl, CURLINFO_NAMELOOKUP_TIME_T, &llDns);
+   curl_easy_getinfo(pCurl, CURLINFO_CONNECT_TIME_T, &llConnect);
+   curl_easy_getinfo(pCurl, CURLINFO_APPCONNECT_TIME_T, &llTls);
+   curl_easy_getinfo(pCurl, CURLINFO_PRETRANSFER_TIME_T, &llPreTransfer);
+   curl_easy_getinfo(pCurl, CURLINFO_STARTTRANSFER_TIME_T, &llStart);
+
+   char *pszUrl = nullptr;
+   curl_easy_getinfo(pCurl, CURLINFO_EFFECTIVE_URL, &pszUrl);
+   bool bTLS = (pszUrl != nullptr && strncasecmp(pszUrl, "https:", 6) == 0);
+
+   Phase ePhase = PHASE_FIRST_BYTE;
+   curl_off_t llPhaseStart = std::max(std::max(llConnect, llTls), llPreTransfer);
+   if (llStart != 0)
+   {
+      ePhase = PHASE_TRANSFER;
+      llPhaseStart = llStart;
+   }
+   // a reused connection has no connect time, the request is sent once pretransfer is set
+   else if (llPreTransfer == 0)
+   {
+      if (llDns == 0 && llConnect == 0)
+      {
+         ePhase = PHASE_DNS;
+         llPhaseStart = 0;
+      }
+      else if (llConnect == 0)
+      {
+         ePhase = PHASE_CONNECT;
+         llPhaseStart = llDns;
+      }
+      else if (bTLS && llTls == 0)
+      {
+         ePhase = PHASE_TLS;
+         llPhaseStart = llConnect;
+      }
+   }
+
+   lPhaseStartMs = static_cast<long>(llPhaseStart / 1000);
+   return ePhase;
+}
+} // namespace
+
 /**
  * @brief constructor of the HTTP client object
  *
@@ -17,7 +94,15 @@ CppHTTPClient::CppHTTPClient(LogFnCallback Logger) : m_oLog(Logger),
                                                      m_bNoSignal(false),
                                                      m_eSettingsFlags(ALL_FLAGS),
                                                      m_pCurlSession(nullptr),
-                                                     m_pHeaderlist(nullptr)
+                                                     m_pHeaderlist(nullptr),
+                                                     m_pCurlMulti(nullptr),
+                                                     m_eTimeoutError(ERR_NONE),
+                                                     m_eAbortError(ERR_NONE),
+                                                     m_lBudgetMs(0),
+                                                     m_lElapsedMs(0),
+                                                     m_uAttempts(0),
+                                                     m_oRandom(std::random_device()()),
+                                                     m_bCachedFailure(false)
 {
    s_mtxCurlSession.lock();
    if (s_iCurlSession++ == 0)
@@ -107,6 +192,12 @@ const bool CppHTTPClient::CleanupSession()
       return false;
    }
 
+   if (m_pCurlMulti)
+   {
+      curl_multi_cleanup(m_pCurlMulti);
+      m_pCurlMulti = nullptr;
+   }
+
    curl_easy_cleanup(m_pCurlSession);
    m_pCurlSession = nullptr;
 
@@ -138,7 +229,7 @@ inline void CppHTTPClient::CheckURL(const std::string &strURL)
       m_bHTTPS = false;
    else if (strTmp.compare(0, 8, "HTTPS://") == 0)
       m_bHTTPS = true;
-   else
+   else if (!CppHTTPLoadBalancer::IsServiceUrl(strURL))
    {
       m_strURL = ((m_bHTTPS) ? "https://" : "http://") + strURL;
       return;
@@ -148,12 +239,254 @@ inline void CppHTTPClient::CheckURL(const std::string &strURL)
 
 /**
  *  @brief performs the chosen HTTP request
+ * retries it according to the retry policy
+ *
+ * @param [out] Response response data, reset before each retry
+ * @param [in] bIdempotent false for the requests retried only with RetryPolicy::bNonIdempotent
+ * @param [in] pPayload data uploaded by the request, rewound before each retry
+ *
+ * @retval CURLcode of the last attempt
+ */
+const CURLcode CppHTTPClient::Perform(HttpResponse &Response, const bool bIdempotent /* = true */,
+                                      UploadObject *pPayload /* = nullptr */)
+{
+   m_uAttempts = 0;
+   m_eAbortError = ERR_NONE;
+   m_bCachedFailure = false;
+
+   // the rate limits of a service apply to its URL, not to the endpoint's
+   std::shared_ptr<CppHTTPRateLimiter> pRateLimiter = m_pRateLimiter;
+   const std::string strRateUrl = pRateLimiter ? m_strURL : std::string();
+
+   // a service URL is resolved once, the retries go to the same endpoint
+   std::shared_ptr<CppHTTPLoadBalancer> pBalancer = m_pLoadBalancer;
+   std::string strEndpoint;
+   if (pBalancer && CppHTTPLoadBalancer::IsServiceUrl(m_strURL))
+   {
+      const std::string strServiceUrl = m_strURL;
+      if (!pBalancer->Resolve(strServiceUrl, m_strURL, strEndpoint))
+      {
+         m_eAbortError = ERR_NO_ENDPOINT;
+         if (m_pHeaderlist)
+         {
+            curl_slist_free_all(m_pHeaderlist);
+            m_pHeaderlist = nullptr;
+         }
+         return CURLE_COULDNT_RESOLVE_HOST;
+      }
+      CheckURL(m_strURL);
+
+      // keeps a warm connection to each endpoint, the default cache holds 5 of them
+      curl_easy_setopt(m_pCurlSession, CURLOPT_MAXCONNECTS,
+                       static_cast<long>(std::max<size_t>(pBalancer->GetEndpointCount(), 5)));
+   }
+
+   std::shared_ptr<CppHTTPRetryBudget> pBudget = m_oRetry.pBudget;
+   std::shared_ptr<CppHTTPCircuitBreaker> pBreaker = m_pCircuitBreaker;
+   std::shared_ptr<CppHTTPNegativeCache> pNegativeCache = m_pNegativeCache;
+   std::string strHost = (pBudget || pBreaker || pNegativeCache || !m_mapThrottles.empty()) ? GetHostKey(m_strURL) : std::string();
+   if (pBudget)
+      pBudget->Deposit(strHost);
+
+   const UploadObject oPayload = pPayload ? *pPayload : UploadObject();
+   long lDelayMs = m_oRetry.lBaseDelayMs;
+
+   // the request's own Authorization header takes precedence
+   std::shared_ptr<CppHTTPAuthProvider> pAuthProvider = m_pAuthProvider;
+   for (curl_slist *pHeader = m_pHeaderlist; pAuthProvider && pHeader; pHeader = pHeader->next)
+      if (strncasecmp(pHeader->data, "Authorization:", 14) == 0)
+         pAuthProvider.reset();
+   std::string strToken;
+   bool bReauthenticated = false;
+
+   CURLcode res = CURLE_OK;
+   for (;;)
+   {
+      // a known unreachable origin isn't resolved nor connected again
+      if (pNegativeCache && m_uAttempts == 0 && pNegativeCache->Check(strHost, res))
+      {
+         m_bCachedFailure = true;
+         break;
+      }
+
+      // each attempt gets the current token, a retry after a 401 gets the new one
+      if (pAuthProvider)
+      {
+         if (!pAuthProvider->GetToken(strToken))
+         {
+            m_eAbortError = ERR_NO_TOKEN;
+            res = CURLE_LOGIN_DENIED;
+            break;
+         }
+         curl_easy_setopt(m_pCurlSession, CURLOPT_HTTPAUTH, CURLAUTH_BEARER);
+         curl_easy_setopt(m_pCurlSession, CURLOPT_XOAUTH2_BEARER, strToken.c_str());
+      }
+
+      // a paused origin is paced rather than refused, the deadline bounds the wait
+      auto itThrottle = m_mapThrottles.find(strHost);
+      if (itThrottle != m_mapThrottles.end())
+      {
+         TimePoint tpNow = std::chrono::steady_clock::now();
+         long lPauseMs = static_cast<long>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(itThrottle->second.tpPausedUntil - tpNow).count());
+         // a retry already waited for the Retry-After
+         if (lPauseMs > 0)
+         {
+            if (m_tpDeadline != TimePoint())
+               lPauseMs = std::max(std::min(lPauseMs, RemainingMs(m_tpDeadline, tpNow)), 0L);
+            ++itThrottle->second.ullPaced;
+            if (!Backoff(lPauseMs))
+            {
+               res = CURLE_ABORTED_BY_CALLBACK;
+               break;
+            }
+         }
+      }
+
+      if (pRateLimiter && !pRateLimiter->TryAcquire(strRateUrl))
+      {
+         m_eAbortError = ERR_RATE_LIMITED;
+         res = CURLE_COULDNT_CONNECT;
+         break;
+      }
+
+      unsigned long long ullProbeCycle = 0;
+      if (pBreaker && !pBreaker->Allow(strHost, ullProbeCycle))
+      {
+         // nothing is sent, the fail-fast calls of an outage don't empty the bucket
+         if (pRateLimiter)
+            pRateLimiter->Refund(strRateUrl);
+         m_eAbortError = ERR_CIRCUIT_OPEN;
+         res = CURLE_COULDNT_CONNECT;
+         break;
+      }
+
+      res = PerformAttempt();
+      ++m_uAttempts;
+
+      // the caller's cancellations and deadlines tell nothing about the origin
+      if (pNegativeCache && res != CURLE_ABORTED_BY_CALLBACK && m_eTimeoutError != ERR_DEADLINE_EXCEEDED)
+         pNegativeCache->OnResult(strHost, res);
+
+      if (pBreaker)
+      {
+         // the caller's cancellations and deadlines tell nothing about the origin
+         CppHTTPCircuitBreaker::Outcome eOutcome = CppHTTPCircuitBreaker::OUTCOME_FAILURE;
+         if (res == CURLE_ABORTED_BY_CALLBACK || m_eTimeoutError == ERR_DEADLINE_EXCEEDED)
+            eOutcome = CppHTTPCircuitBreaker::OUTCOME_IGNORED;
+         else if (res == CURLE_OK)
+         {
+            long lHttpCode = 0;
+            curl_easy_getinfo(m_pCurlSession, CURLINFO_RESPONSE_CODE, &lHttpCode);
+            if (lHttpCode < 500)
+               eOutcome = CppHTTPCircuitBreaker::OUTCOME_SUCCESS;
+         }
+         pBreaker->OnResult(strHost, eOutcome, ullProbeCycle);
+      }
+
+      // the origin asked for a pause, the next requests wait for its end too
+      long lRetryAfterMs = -1;
+      if (res == CURLE_OK)
+      {
+         long lHttpCode = 0;
+         curl_easy_getinfo(m_pCurlSession, CURLINFO_RESPONSE_CODE, &lHttpCode);
+         lRetryAfterMs = GetRetryAfterMs(static_cast<int>(lHttpCode), Response.mapHeaders);
+         if (lRetryAfterMs >= 0)
+         {
+            if (strHost.empty())
+               strHost = GetHostKey(m_strURL);
+            OnThrottled(strHost, lRetryAfterMs);
+         }
+      }
+
+      // a rejected token is replaced and the request sent again at once, the server didn't process it
+      if (pAuthProvider && !bReauthenticated && res == CURLE_OK)
+      {
+         long lHttpCode = 0;
+         curl_easy_getinfo(m_pCurlSession, CURLINFO_RESPONSE_CODE, &lHttpCode);
+         if (lHttpCode == 401)
+         {
+            pAuthProvider->Invalidate(strToken);
+            bReauthenticated = true;
+            Response = HttpResponse();
+            if (pPayload)
+               *pPayload = oPayload;
+            continue;
+         }
+      }
+
+      if (m_uAttempts >= m_oRetry.uMaxAttempts || (!bIdempotent && !m_oRetry.bNonIdempotent) ||
+          !(RetryClass(res) & m_oRetry.iRetryOn))
+         break;
+      // the retries would fail from the negative cache until its TTL elapsed
+      if (pNegativeCache && CppHTTPNegativeCache::IsNegative(res))
+         break;
+
+      // decorrelated jitter, the retries of the clients don't synchronize
+      long lBaseMs = std::max(m_oRetry.lBaseDelayMs, 0L);
+      long lUpperMs = std::max(lBaseMs, std::min(m_oRetry.lMaxDelayMs, lDelayMs * 3));
+      lDelayMs = std::uniform_int_distribution<long>(lBaseMs, lUpperMs)(m_oRandom);
+      if (lRetryAfterMs >= 0)
+      {
+         // not worth waiting for
+         if (lRetryAfterMs > std::max(m_oRetry.lMaxRetryAfterMs, 0L))
+            break;
+         lDelayMs = std::max(lDelayMs, lRetryAfterMs);
+      }
+
+      if (m_tpDeadline != TimePoint() &&
+          RemainingMs(m_tpDeadline, std::chrono::steady_clock::now()) <= lDelayMs)
+         break;
+      if (pBudget && !pBudget->TryWithdraw(strHost))
+      {
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_WARNING_RETRY_BUDGET_FORMAT, m_strURL.c_str()));
+         break;
+      }
+
+      if (m_eSettingsFlags & ENABLE_LOG)
+         m_oLog(StringFormat(LOG_WARNING_RETRY_FORMAT, m_strURL.c_str(), m_uAttempts + 1, lDelayMs));
+      if (!Backoff(lDelayMs))
+         break;
+
+      Response = HttpResponse();
+      if (pPayload)
+         *pPayload = oPayload;
+   }
+
+   if (!strEndpoint.empty())
+   {
+      // the endpoint is measured by the last attempt it answered
+      if (m_uAttempts == 0 || res == CURLE_ABORTED_BY_CALLBACK || m_eTimeoutError == ERR_DEADLINE_EXCEEDED)
+         pBalancer->Release(strEndpoint);
+      else
+      {
+         long lHttpCode = 0;
+         curl_off_t llTotalUs = 0;
+         curl_easy_getinfo(m_pCurlSession, CURLINFO_RESPONSE_CODE, &lHttpCode);
+         curl_easy_getinfo(m_pCurlSession, CURLINFO_TOTAL_TIME_T, &llTotalUs);
+         pBalancer->Release(strEndpoint, static_cast<unsigned long long>(llTotalUs),
+                            res == CURLE_OK && lHttpCode < 500);
+      }
+   }
+
+   if (m_pHeaderlist)
+   {
+      curl_slist_free_all(m_pHeaderlist);
+      m_pHeaderlist = nullptr;
+   }
+
+   return res;
+}
+
+/**
+ * @brief performs one attempt of the chosen HTTP request
  * sets up the common settings (Timeout, proxy,...)
  *
- * @retval true   Successfully performed the request.
- * @retval false  An error occured while CURL was performing the request.
+ * @retval CURLE_OK  Successfully performed the request.
+ * @retval other     An error occured while CURL was performing the request.
  */
-const CURLcode CppHTTPClient::Perform()
+const CURLcode CppHTTPClient::PerformAttempt()
 {
    if (!m_pCurlSession)
    {
@@ -165,6 +498,23 @@ const CURLcode CppHTTPClient::Perform()
 
    CURLcode res = CURLE_OK;
 
+   // the total limit is the closest of the timeout and the deadline
+   m_tpStart = std::chrono::steady_clock::now();
+   m_eTimeoutError = ERR_NONE;
+   m_lElapsedMs = 0;
+   m_lBudgetMs = (m_oTimeouts.lTotalMs > 0) ? m_oTimeouts.lTotalMs : m_iCurlTimeout * 1000L;
+   if (m_tpDeadline != TimePoint())
+   {
+      long lRemainingMs = RemainingMs(m_tpDeadline, m_tpStart);
+      if (lRemainingMs <= 0)
+      {
+         m_eTimeoutError = ERR_DEADLINE_EXCEEDED;
+         return CURLE_OPERATION_TIMEDOUT;
+      }
+      if (m_lBudgetMs <= 0 || lRemainingMs < m_lBudgetMs)
+         m_lBudgetMs = lRemainingMs;
+   }
+
    curl_easy_setopt(m_pCurlSession, CURLOPT_URL, m_strURL.c_str());
 
    if (m_pHeaderlist != nullptr)
@@ -174,12 +524,7 @@ const CURLcode CppHTTPClient::Perform()
    curl_easy_setopt(m_pCurlSession, CURLOPT_AUTOREFERER, 1L);
    curl_easy_setopt(m_pCurlSession, CURLOPT_FOLLOWLOCATION, 1L);
 
-   if (m_iCurlTimeout > 0)
-   {
-      curl_easy_setopt(m_pCurlSession, CURLOPT_TIMEOUT, m_iCurlTimeout);
-      // don't want to get a sig alarm on timeout
-      curl_easy_setopt(m_pCurlSession, CURLOPT_NOSIGNAL, 1);
-   }
+   ApplyTimeouts(m_pCurlSession, m_oTimeouts, m_lBudgetMs);
 
    if (m_bNoSignal)
    {
@@ -210,16 +555,205 @@ const CURLcode CppHTTPClient::Perform()
    if (m_bHTTPS && !m_strSSLKeyPwd.empty())
       curl_easy_setopt(m_pCurlSession, CURLOPT_KEYPASSWD, m_strSSLKeyPwd.c_str());
 
+   if (m_pCancelToken || m_oProgress)
+   {
+      curl_easy_setopt(m_pCurlSession, CURLOPT_XFERINFOFUNCTION, &CppHTTPClient::ProgressCallback);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_XFERINFODATA, this);
+      curl_easy_setopt(m_pCurlSession, CURLOPT_NOPROGRESS, 0L);
+   }
+
    // Perform the requested operation
-   res = curl_easy_perform(m_pCurlSession);
+   bool bPhaseTimeouts = m_oTimeouts.lDnsMs > 0 || m_oTimeouts.lTlsMs > 0 || m_oTimeouts.lFirstByteMs > 0;
+   res = (m_pCancelToken || bPhaseTimeouts) ? PerformMulti() : curl_easy_perform(m_pCurlSession);
 
-   if (m_pHeaderlist)
+   m_lElapsedMs = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        std::chrono::steady_clock::now() - m_tpStart)
+                                        .count());
+   if (res == CURLE_OPERATION_TIMEDOUT && m_eTimeoutError == ERR_NONE)
+      m_eTimeoutError = ClassifyTimeout(m_pCurlSession, m_oTimeouts, m_lElapsedMs, m_lBudgetMs);
+
+   return res;
+}
+
+/**
+ * @brief tells which RetryOn class an attempt failed with
+ *
+ * @param [in] eResult result of the attempt
+ *
+ * @retval RetryOn flag, 0 when the attempt must not be retried
+ */
+const int CppHTTPClient::RetryClass(const CURLcode eResult) const
+{
+   switch (eResult)
    {
-      curl_slist_free_all(m_pHeaderlist);
-      m_pHeaderlist = nullptr;
+   case CURLE_OK:
+   {
+      long lHttpCode = 0;
+      curl_easy_getinfo(m_pCurlSession, CURLINFO_RESPONSE_CODE, &lHttpCode);
+      if (lHttpCode == 429)
+         return RETRY_THROTTLED;
+      return (lHttpCode == 502 || lHttpCode == 503 || lHttpCode == 504) ? RETRY_HTTP_5XX : 0;
    }
+   case CURLE_COULDNT_CONNECT:
+      return RETRY_CONNECT;
+   case CURLE_SEND_ERROR:
+   case CURLE_RECV_ERROR:
+   case CURLE_GOT_NOTHING:
+   case CURLE_PARTIAL_FILE:
+      return RETRY_RESET;
+   case CURLE_OPERATION_TIMEDOUT:
+      return (m_eTimeoutError == ERR_DEADLINE_EXCEEDED) ? 0 : RETRY_TIMEOUT;
+   case CURLE_COULDNT_RESOLVE_HOST:
+      return RETRY_DNS;
+   default:
+      // cancellations, bad URLs, TLS and protocol errors
+      return 0;
+   }
+}
 
-   return res;
+/**
+ * @brief waits before a retry
+ *
+ * @param [in] lDelayMs delay, in milliseconds
+ *
+ * @retval true   The delay elapsed.
+ * @retval false  The cancel token was triggered meanwhile.
+ */
+const bool CppHTTPClient::Backoff(const long lDelayMs)
+{
+   if (!m_pCancelToken)
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(lDelayMs));
+      return true;
+   }
+
+   std::shared_ptr<std::mutex> pMutex = std::make_shared<std::mutex>();
+   std::shared_ptr<std::condition_variable> pCondition = std::make_shared<std::condition_variable>();
+   unsigned long long ullSubscription = m_pCancelToken->Subscribe([pMutex, pCondition]() {
+      std::lock_guard<std::mutex> oLock(*pMutex);
+      pCondition->notify_all();
+   });
+
+   std::shared_ptr<CppHTTPCancelToken> pToken = m_pCancelToken;
+   {
+      std::unique_lock<std::mutex> oLock(*pMutex);
+      pCondition->wait_for(oLock, std::chrono::milliseconds(lDelayMs), [pToken]() { return pToken->IsCancelled(); });
+   }
+   m_pCancelToken->Unsubscribe(ullSubscription);
+
+   return !m_pCancelToken->IsCancelled();
+}
+
+/**
+ * @brief pauses an origin that answered a Retry-After
+ *
+ * @param [in] strHost origin, see GetHostKey()
+ * @param [in] lRetryAfterMs pause asked, capped by RetryPolicy::lMaxRetryAfterMs
+ */
+void CppHTTPClient::OnThrottled(const std::string &strHost, const long lRetryAfterMs)
+{
+   const long lPauseMs = std::min(lRetryAfterMs, std::max(m_oRetry.lMaxRetryAfterMs, 0L));
+   ThrottleStats &oStats = m_mapThrottles[strHost];
+   ++oStats.ullThrottled;
+   oStats.ullPausedMs += static_cast<unsigned long long>(lPauseMs);
+   oStats.lLastRetryAfterMs = lRetryAfterMs;
+   oStats.tpPausedUntil = std::max(oStats.tpPausedUntil, std::chrono::steady_clock::now() + std::chrono::milliseconds(lPauseMs));
+
+   if (m_eSettingsFlags & ENABLE_LOG)
+      m_oLog(StringFormat(LOG_WARNING_THROTTLED_FORMAT, strHost.c_str(), lPauseMs));
+   if (m_oThrottle)
+      m_oThrottle(strHost, lPauseMs);
+}
+
+/**
+ * @brief returns the pauses asked by an origin to this client
+ *
+ * @param [in] strHost origin, see GetHostKey()
+ */
+const CppHTTPClient::ThrottleStats CppHTTPClient::GetThrottleStats(const std::string &strHost) const
+{
+   auto it = m_mapThrottles.find(strHost);
+   return (it != m_mapThrottles.end()) ? it->second : ThrottleStats();
+}
+
+/**
+ * @brief performs the request through the session multi handle, so that
+ * a cancellation wakes the transfer up instead of waiting for its next progress call
+ * and the DNS, TLS and first byte limits are checked on time
+ *
+ * @retval CURLE_ABORTED_BY_CALLBACK when the cancel token was triggered
+ * @retval CURLE_OPERATION_TIMEDOUT when a phase limit is exceeded (m_eTimeoutError is set)
+ */
+const CURLcode CppHTTPClient::PerformMulti()
+{
+   // kept for the whole session so that the connections are reused
+   if (!m_pCurlMulti)
+      m_pCurlMulti = curl_multi_init();
+   if (!m_pCurlMulti)
+      return CURLE_OUT_OF_MEMORY;
+
+   if (curl_multi_add_handle(m_pCurlMulti, m_pCurlSession) != CURLM_OK)
+      return CURLE_FAILED_INIT;
+
+   CURLM *pMulti = m_pCurlMulti;
+   std::shared_ptr<CppHTTPCancelToken> pToken = m_pCancelToken;
+   unsigned long long ullSubscription = 0;
+   if (pToken)
+      ullSubscription = pToken->Subscribe([pMulti]() { curl_multi_wakeup(pMulti); });
+
+   CURLcode eResult = CURLE_OK;
+   bool bDone = false;
+   while (!bDone)
+   {
+      if (pToken && pToken->IsCancelled())
+      {
+         eResult = CURLE_ABORTED_BY_CALLBACK;
+         break;
+      }
+
+      int iRunning = 0;
+      if (curl_multi_perform(m_pCurlMulti, &iRunning) != CURLM_OK)
+      {
+         eResult = CURLE_FAILED_INIT;
+         break;
+      }
+
+      CURLMsg *pMsg = nullptr;
+      int iMsgsLeft = 0;
+      while ((pMsg = curl_multi_info_read(m_pCurlMulti, &iMsgsLeft)) != nullptr)
+      {
+         if (pMsg->msg == CURLMSG_DONE && pMsg->easy_handle == m_pCurlSession)
+         {
+            eResult = pMsg->data.result;
+            bDone = true;
+         }
+      }
+
+      if (bDone)
+         break;
+
+      long lElapsedMs = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                              std::chrono::steady_clock::now() - m_tpStart)
+                                              .count());
+      long lNextCheckMs = CheckPhaseTimeouts(m_pCurlSession, m_oTimeouts, lElapsedMs, m_eTimeoutError);
+      if (m_eTimeoutError != ERR_NONE)
+      {
+         eResult = CURLE_OPERATION_TIMEDOUT;
+         break;
+      }
+
+      if (iRunning > 0)
+      {
+         int iWaitMs = (lNextCheckMs >= 0 && lNextCheckMs < 1000) ? static_cast<int>(lNextCheckMs) + 1 : 1000;
+         curl_multi_poll(m_pCurlMulti, nullptr, 0, iWaitMs, nullptr);
+      }
+   }
+
+   if (pToken)
+      pToken->Unsubscribe(ullSubscription);
+   curl_multi_remove_handle(m_pCurlMulti, m_pCurlSession);
+
+   return eResult;
 }
 
 // REST REQUESTS
@@ -294,9 +828,73 @@ inline const bool CppHTTPClient::PostRestRequest(const CURLcode ePerformCode,
       Response.strBody.clear();
       Response.iCode = -1;
 
-      if (m_eSettingsFlags & ENABLE_LOG)
-         m_oLog(StringFormat(LOG_ERROR_CURL_REST_FAILURE_FORMAT, m_strURL.c_str(), ePerformCode,
-                             curl_easy_strerror(ePerformCode)));
+      if (m_eAbortError == ERR_NO_ENDPOINT)
+      {
+         Response.eError = ERR_NO_ENDPOINT;
+         Response.strError = "No endpoint for the service";
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_ERROR_NO_ENDPOINT_FORMAT, m_strURL.c_str()));
+      }
+      else if (m_eAbortError == ERR_RATE_LIMITED)
+      {
+         Response.eError = ERR_RATE_LIMITED;
+         Response.strError = "Rate limit reached, request not sent";
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_WARNING_RATE_LIMITED_FORMAT, m_strURL.c_str()));
+      }
+      else if (m_eAbortError == ERR_NO_TOKEN)
+      {
+         Response.eError = ERR_NO_TOKEN;
+         Response.strError = "No token from the auth provider, request not sent";
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_ERROR_NO_TOKEN_FORMAT, m_strURL.c_str()));
+      }
+      else if (m_eAbortError == ERR_CIRCUIT_OPEN)
+      {
+         Response.eError = ERR_CIRCUIT_OPEN;
+         Response.strError = "Circuit open, request not sent";
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_WARNING_CIRCUIT_OPEN_FORMAT, m_strURL.c_str()));
+      }
+      else if (m_eTimeoutError != ERR_NONE)
+      {
+         Response.eError = m_eTimeoutError;
+         Response.strError = TimeoutMessage(m_eTimeoutError, m_lElapsedMs);
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_ERROR_CURL_REST_FAILURE_FORMAT, m_strURL.c_str(), ePerformCode,
+                                Response.strError.c_str()));
+      }
+      else if (m_bCachedFailure)
+      {
+         Response.eError = ERR_CURL;
+         Response.strError = std::string(curl_easy_strerror(ePerformCode)) + " (cached)";
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_ERROR_CURL_REST_FAILURE_FORMAT, m_strURL.c_str(), ePerformCode,
+                                Response.strError.c_str()));
+      }
+      else if (ePerformCode == CURLE_ABORTED_BY_CALLBACK && m_pCancelToken && m_pCancelToken->IsCancelled())
+      {
+         Response.eError = ERR_CANCELLED;
+         Response.strError = "Request cancelled";
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_WARNING_REST_CANCELLED_FORMAT, m_strURL.c_str()));
+      }
+      else
+      {
+         Response.eError = ERR_CURL;
+         Response.strError = curl_easy_strerror(ePerformCode);
+
+         if (m_eSettingsFlags & ENABLE_LOG)
+            m_oLog(StringFormat(LOG_ERROR_CURL_REST_FAILURE_FORMAT, m_strURL.c_str(), ePerformCode,
+                                curl_easy_strerror(ePerformCode)));
+      }
 
       return false;
    }
@@ -320,6 +918,84 @@ inline const bool CppHTTPClient::PostRestRequest(const CURLcode ePerformCode,
 const bool CppHTTPClient::Head(const std::string &strUrl,
                                const CppHTTPClient::HeadersMap &Headers,
                                CppHTTPClient::HttpResponse &Response)
+{
+   if (!m_pSingleFlight)
+      return PerformHead(strUrl, Headers, Response);
+
+   SharedResponse pShared;
+   bool bSuccess = m_pSingleFlight->Do(
+       MakeFlightKey("HEAD", strUrl, Headers),
+       [&](HttpResponse &Fetched) { return PerformHead(strUrl, Headers, Fetched); }, pShared);
+   Response = *pShared;
+
+   return bSuccess;
+}
+
+/**
+ * @brief performs a GET request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [out] Response response data
+ *
+ * @retval true   Successfully requested the URI.
+ * @retval false  Encountered a problem.
+ */
+const bool CppHTTPClient::Get(const std::string &strUrl,
+                              const CppHTTPClient::HeadersMap &Headers,
+                              CppHTTPClient::HttpResponse &Response)
+{
+   if (!m_pSingleFlight)
+      return PerformGet(strUrl, Headers, Response);
+
+   SharedResponse pShared;
+   bool bSuccess = Get(strUrl, Headers, pShared);
+   Response = *pShared;
+
+   return bSuccess;
+}
+
+/**
+ * @brief performs a GET request, coalesced with the identical requests in flight
+ * when a CppHTTPSingleFlight is set
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [out] pResponse response data, shared by the coalesced requests
+ *
+ * @retval true   Successfully requested the URI.
+ * @retval false  Encountered a problem.
+ */
+const bool CppHTTPClient::Get(const std::string &strUrl,
+                              const CppHTTPClient::HeadersMap &Headers,
+                              CppHTTPClient::SharedResponse &pResponse)
+{
+   if (!m_pSingleFlight)
+   {
+      HttpResponse Response;
+      bool bSuccess = PerformGet(strUrl, Headers, Response);
+      pResponse = std::make_shared<const HttpResponse>(std::move(Response));
+      return bSuccess;
+   }
+
+   return m_pSingleFlight->Do(
+       MakeFlightKey("GET", strUrl, Headers),
+       [&](HttpResponse &Fetched) { return PerformGet(strUrl, Headers, Fetched); }, pResponse);
+}
+
+/**
+ * @brief performs a HEAD request through the session, never coalesced
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [out] Response response data
+ *
+ * @retval true   Successfully requested the URI.
+ * @retval false  Encountered a problem.
+ */
+const bool CppHTTPClient::PerformHead(const std::string &strUrl,
+                                      const CppHTTPClient::HeadersMap &Headers,
+                                      CppHTTPClient::HttpResponse &Response)
 {
    if (InitRestRequest(strUrl, Headers, Response))
    {
@@ -327,7 +1003,7 @@ const bool CppHTTPClient::Head(const std::string &strUrl,
       curl_easy_setopt(m_pCurlSession, CURLOPT_CUSTOMREQUEST, "HEAD");
       curl_easy_setopt(m_pCurlSession, CURLOPT_NOBODY, 1L);
 
-      CURLcode res = Perform();
+      CURLcode res = Perform(Response);
 
       return PostRestRequest(res, Response);
    }
@@ -336,7 +1012,7 @@ const bool CppHTTPClient::Head(const std::string &strUrl,
 }
 
 /**
- * @brief performs a GET request
+ * @brief performs a GET request through the session, never coalesced
  *
  * @param [in] strUrl url to request
  * @param [in] Headers headers to send
@@ -345,16 +1021,16 @@ const bool CppHTTPClient::Head(const std::string &strUrl,
  * @retval true   Successfully requested the URI.
  * @retval false  Encountered a problem.
  */
-const bool CppHTTPClient::Get(const std::string &strUrl,
-                              const CppHTTPClient::HeadersMap &Headers,
-                              CppHTTPClient::HttpResponse &Response)
+const bool CppHTTPClient::PerformGet(const std::string &strUrl,
+                                     const CppHTTPClient::HeadersMap &Headers,
+                                     CppHTTPClient::HttpResponse &Response)
 {
    if (InitRestRequest(strUrl, Headers, Response))
    {
       // specify a GET request
       curl_easy_setopt(m_pCurlSession, CURLOPT_HTTPGET, 1L);
 
-      CURLcode res = Perform();
+      CURLcode res = Perform(Response);
 
       return PostRestRequest(res, Response);
    }
@@ -362,6 +1038,25 @@ const bool CppHTTPClient::Get(const std::string &strUrl,
       return false;
 }
 
+/**
+ * @brief returns the singleflight key of a request of this client
+ *
+ * The bearer token isn't a header of the request: the auth provider is part of the
+ * key, so that a response is never shared with a client sending other credentials.
+ *
+ * @param [in] strMethod HTTP method
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ */
+const std::string CppHTTPClient::MakeFlightKey(const std::string &strMethod, const std::string &strUrl,
+                                               const HeadersMap &Headers) const
+{
+   std::string strKey = m_pSingleFlight->MakeKey(strMethod, strUrl, Headers);
+   if (m_pAuthProvider)
+      strKey += StringFormat("\n[auth %p]", static_cast<const void *>(m_pAuthProvider.get()));
+   return strKey;
+}
+
 /**
  * @brief performs a DELETE request
  *
@@ -380,7 +1075,7 @@ const bool CppHTTPClient::Del(const std::string &strUrl,
    {
       curl_easy_setopt(m_pCurlSession, CURLOPT_CUSTOMREQUEST, "DELETE");
 
-      CURLcode res = Perform();
+      CURLcode res = Perform(Response);
 
       return PostRestRequest(res, Response);
    }
@@ -402,7 +1097,8 @@ const bool CppHTTPClient::Post(const std::string &strUrl,
       curl_easy_setopt(m_pCurlSession, CURLOPT_POSTFIELDS, strPostData.c_str());
       curl_easy_setopt(m_pCurlSession, CURLOPT_POSTFIELDSIZE, strPostData.size());
 
-      CURLcode res = Perform();
+      // POST is not idempotent
+      CURLcode res = Perform(Response, false);
 
       return PostRestRequest(res, Response);
    }
@@ -442,7 +1138,7 @@ const bool CppHTTPClient::Put(const std::string &strUrl, const CppHTTPClient::He
       // set data size
       curl_easy_setopt(m_pCurlSession, CURLOPT_INFILESIZE, static_cast<long>(Payload.usLength));
 
-      CURLcode res = Perform();
+      CURLcode res = Perform(Response, true, &Payload);
 
       return PostRestRequest(res, Response);
    }
@@ -482,7 +1178,7 @@ const bool CppHTTPClient::Put(const std::string &strUrl, const CppHTTPClient::He
       // set data size
       curl_easy_setopt(m_pCurlSession, CURLOPT_INFILESIZE, static_cast<long>(Payload.usLength));
 
-      CURLcode res = Perform();
+      CURLcode res = Perform(Response, true, &Payload);
 
       return PostRestRequest(res, Response);
    }
@@ -557,6 +1253,263 @@ inline void CppHTTPClient::TrimSpaces(std::string &str)
              str.end());
 }
 
+/**
+ * @brief returns the pause asked by a throttling response
+ *
+ * Only the 429 (Too Many Requests) and 503 (Service Unavailable) responses are
+ * considered. Retry-After holds either a number of seconds or an HTTP date, a
+ * date in the past is no pause.
+ *
+ * @param [in] iCode HTTP status code of the response
+ * @param [in] mapHeaders headers of the response, the name is matched whatever its case
+ *
+ * @retval long pause in milliseconds, -1 without a valid Retry-After
+ */
+const long CppHTTPClient::GetRetryAfterMs(const int iCode, const HeadersMap &mapHeaders)
+{
+   if (iCode != 429 && iCode != 503)
+      return -1;
+
+   for (const auto &oHeader : mapHeaders)
+   {
+      if (oHeader.first.size() != 11 || strncasecmp(oHeader.first.c_str(), "Retry-After", 11) != 0)
+         continue;
+
+      const std::string &strValue = oHeader.second;
+      if (!strValue.empty() && std::all_of(strValue.begin(), strValue.end(), ::isdigit))
+      {
+         // a day at most, against overflows
+         return (strValue.size() > 5) ? 86400000L : std::stol(strValue) * 1000L;
+      }
+
+      time_t tDate = curl_getdate(strValue.c_str(), nullptr);
+      if (tDate < 0)
+         return -1;
+      return std::max(static_cast<long>(difftime(tDate, time(nullptr)) * 1000.), 0L);
+   }
+   return -1;
+}
+
+/**
+ * @brief returns the origin of an URL
+ *
+ * A missing scheme is guessed (http for most hosts) and the port to the default port of the scheme,
+ * so "httpbin.org/get" and "http://HTTPBIN.org:80/" share the same key.
+ *
+ * @param [in] strURL URL, with or without its protocol scheme
+ *
+ * @retval string "scheme://host:port" in lower case, empty if the URL can't be parsed
+ */
+std::string CppHTTPClient::GetHostKey(const std::string &strURL)
+{
+   std::string strKey;
+   CURLU *pUrl = curl_url();
+   if (pUrl == nullptr)
+      return strKey;
+
+   if (curl_url_set(pUrl, CURLUPART_URL, strURL.c_str(), CURLU_GUESS_SCHEME) == CURLUE_OK)
+   {
+      char *pszScheme = nullptr;
+      char *pszHost = nullptr;
+      char *pszPort = nullptr;
+      if (curl_url_get(pUrl, CURLUPART_SCHEME, &pszScheme, 0) == CURLUE_OK &&
+          curl_url_get(pUrl, CURLUPART_HOST, &pszHost, 0) == CURLUE_OK &&
+          curl_url_get(pUrl, CURLUPART_PORT, &pszPort, CURLU_DEFAULT_PORT) == CURLUE_OK)
+      {
+         strKey = std::string(pszScheme) + "://" + pszHost + ":" + pszPort;
+         std::transform(strKey.begin(), strKey.end(), strKey.begin(), ::tolower);
+      }
+      curl_free(pszScheme);
+      curl_free(pszHost);
+      curl_free(pszPort);
+   }
+
+   curl_url_cleanup(pUrl);
+   return strKey;
+}
+
+// TIMEOUTS
+
+/**
+ * @brief merges the limits of a request with the default ones
+ *
+ * @param [in] oTimeouts limits of the request, 0 fields use the default
+ * @param [in] oDefaults default limits
+ */
+CppHTTPClient::TimeoutPolicy CppHTTPClient::MergeTimeouts(const TimeoutPolicy &oTimeouts, const TimeoutPolicy &oDefaults)
+{
+   TimeoutPolicy oMerged = oTimeouts;
+   if (oMerged.lTotalMs <= 0)
+      oMerged.lTotalMs = oDefaults.lTotalMs;
+   if (oMerged.lConnectMs <= 0)
+      oMerged.lConnectMs = oDefaults.lConnectMs;
+   if (oMerged.lDnsMs <= 0)
+      oMerged.lDnsMs = oDefaults.lDnsMs;
+   if (oMerged.lTlsMs <= 0)
+      oMerged.lTlsMs = oDefaults.lTlsMs;
+   if (oMerged.lFirstByteMs <= 0)
+      oMerged.lFirstByteMs = oDefaults.lFirstByteMs;
+   if (oMerged.lLowSpeedBytes <= 0 || oMerged.lLowSpeedSeconds <= 0)
+   {
+      oMerged.lLowSpeedBytes = oDefaults.lLowSpeedBytes;
+      oMerged.lLowSpeedSeconds = oDefaults.lLowSpeedSeconds;
+   }
+   return oMerged;
+}
+
+/**
+ * @brief returns the milliseconds left before a deadline, rounded up
+ */
+const long CppHTTPClient::RemainingMs(const TimePoint &tpDeadline, const TimePoint &tpNow)
+{
+   return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                tpDeadline - tpNow + std::chrono::microseconds(999))
+                                .count());
+}
+
+/**
+ * @brief sets the limits enforced by cURL itself
+ *
+ * @param [in] pCurl easy handle
+ * @param [in] oTimeouts limits of the request
+ * @param [in] lBudgetMs total limit, deadline included (0: none)
+ */
+void CppHTTPClient::ApplyTimeouts(CURL *pCurl, const TimeoutPolicy &oTimeouts, const long lBudgetMs)
+{
+   bool bLimited = false;
+   if (lBudgetMs > 0)
+   {
+      curl_easy_setopt(pCurl, CURLOPT_TIMEOUT_MS, lBudgetMs);
+      bLimited = true;
+   }
+   if (oTimeouts.lConnectMs > 0)
+   {
+      curl_easy_setopt(pCurl, CURLOPT_CONNECTTIMEOUT_MS, oTimeouts.lConnectMs);
+      bLimited = true;
+   }
+   if (oTimeouts.lLowSpeedBytes > 0 && oTimeouts.lLowSpeedSeconds > 0)
+   {
+      curl_easy_setopt(pCurl, CURLOPT_LOW_SPEED_LIMIT, oTimeouts.lLowSpeedBytes);
+      curl_easy_setopt(pCurl, CURLOPT_LOW_SPEED_TIME, oTimeouts.lLowSpeedSeconds);
+      bLimited = true;
+   }
+
+   // don't want to get a sig alarm on timeout
+   if (bLimited)
+      curl_easy_setopt(pCurl, CURLOPT_NOSIGNAL, 1L);
+}
+
+/**
+ * @brief checks the DNS, TLS and first byte limits, that cURL doesn't enforce
+ *
+ * @param [in] pCurl easy handle of the running transfer
+ * @param [in] oTimeouts limits of the request
+ * @param [in] lElapsedMs time since the start of the transfer
+ * @param [out] eError phase that exceeded its limit, ERR_NONE otherwise
+ *
+ * @retval milliseconds before the next check is needed, -1 if no limit is left
+ */
+const long CppHTTPClient::CheckPhaseTimeouts(CURL *pCurl, const TimeoutPolicy &oTimeouts, const long lElapsedMs,
+                                             ErrorCode &eError)
+{
+   const long arrLimits[PHASE_COUNT] = {oTimeouts.lDnsMs, 0, oTimeouts.lTlsMs, oTimeouts.lFirstByteMs, 0};
+   const ErrorCode arrErrors[PHASE_COUNT] = {ERR_TIMEOUT_DNS, ERR_TIMEOUT_CONNECT, ERR_TIMEOUT_TLS,
+                                             ERR_TIMEOUT_FIRST_BYTE, ERR_TIMEOUT_TRANSFER};
+   eError = ERR_NONE;
+
+   long lPhaseStartMs = 0;
+   Phase ePhase = GetPhase(pCurl, lPhaseStartMs);
+
+   long lNextCheckMs = -1;
+   if (arrLimits[ePhase] > 0)
+   {
+      lNextCheckMs = lPhaseStartMs + arrLimits[ePhase] - lElapsedMs;
+      if (lNextCheckMs < 0)
+      {
+         eError = arrErrors[ePhase];
+         return -1;
+      }
+   }
+
+   // a later phase can't exceed its limit before its whole limit elapsed
+   for (int iPhase = ePhase + 1; iPhase < PHASE_COUNT; ++iPhase)
+   {
+      if (arrLimits[iPhase] > 0 && (lNextCheckMs < 0 || arrLimits[iPhase] < lNextCheckMs))
+         lNextCheckMs = arrLimits[iPhase];
+   }
+
+   return lNextCheckMs;
+}
+
+/**
+ * @brief finds the phase of a transfer that failed with CURLE_OPERATION_TIMEDOUT
+ *
+ * @param [in] pCurl easy handle of the transfer
+ * @param [in] oTimeouts limits of the request
+ * @param [in] lElapsedMs duration of the transfer
+ * @param [in] lBudgetMs total limit of the transfer (0: none)
+ */
+const CppHTTPClient::ErrorCode CppHTTPClient::ClassifyTimeout(CURL *pCurl, const TimeoutPolicy &oTimeouts,
+                                                              const long lElapsedMs, const long lBudgetMs)
+{
+   long lPhaseStartMs = 0;
+   Phase ePhase = GetPhase(pCurl, lPhaseStartMs);
+   switch (ePhase)
+   {
+   case PHASE_DNS:
+      return ERR_TIMEOUT_DNS;
+   case PHASE_CONNECT:
+      return ERR_TIMEOUT_CONNECT;
+   case PHASE_TLS:
+      return ERR_TIMEOUT_TLS;
+   default:
+      break;
+   }
+
+   // cURL reports the low speed abort as a timeout, before the total limit
+   bool bLowSpeed = oTimeouts.lLowSpeedBytes > 0 && oTimeouts.lLowSpeedSeconds > 0;
+   if (bLowSpeed && (lBudgetMs <= 0 || lElapsedMs < lBudgetMs))
+      return ERR_TIMEOUT_LOW_SPEED;
+
+   return (ePhase == PHASE_FIRST_BYTE) ? ERR_TIMEOUT_FIRST_BYTE : ERR_TIMEOUT_TRANSFER;
+}
+
+/**
+ * @brief describes a timeout
+ *
+ * @param [in] eError kind of timeout
+ * @param [in] lElapsedMs duration of the request
+ */
+std::string CppHTTPClient::TimeoutMessage(const ErrorCode eError, const long lElapsedMs)
+{
+   const char *pszPhase = "Request";
+   switch (eError)
+   {
+   case ERR_DEADLINE_EXCEEDED:
+      return "Deadline exceeded before the request started";
+   case ERR_TIMEOUT_DNS:
+      pszPhase = "DNS resolution";
+      break;
+   case ERR_TIMEOUT_CONNECT:
+      pszPhase = "Connection";
+      break;
+   case ERR_TIMEOUT_TLS:
+      pszPhase = "TLS handshake";
+      break;
+   case ERR_TIMEOUT_FIRST_BYTE:
+      pszPhase = "Waiting for the first byte";
+      break;
+   case ERR_TIMEOUT_TRANSFER:
+      pszPhase = "Response transfer";
+      break;
+   case ERR_TIMEOUT_LOW_SPEED:
+      return StringFormat("Transfer below the low speed limit, aborted after %ld ms", lElapsedMs);
+   default:
+      break;
+   }
+   return StringFormat("%s timed out after %ld ms", pszPhase, lElapsedMs);
+}
+
 // CURL CALLBACKS
 // REST CALLBACKS
 
@@ -656,3 +1609,26 @@ size_t CppHTTPClient::RestReadCallback(void *pCurlData, size_t usBlockCount, siz
    /** return copied size */
    return usCopySize;
 }
+
+/**
+ * @brief transfer progress callback, aborts the transfer when the request is cancelled
+ * or when the user progress callback returns non-zero
+ *
+ * @param pUserData the CppHTTPClient object
+ * @param DlTotal, DlNow, UlTotal, UlNow bytes to download/downloaded, to upload/uploaded
+ *
+ * @retval 0 to continue, non-zero to abort the transfer with CURLE_ABORTED_BY_CALLBACK
+ */
+int CppHTTPClient::ProgressCallback(void *pUserData, curl_off_t DlTotal, curl_off_t DlNow, curl_off_t UlTotal, curl_off_t UlNow)
+{
+   CppHTTPClient *pClient = reinterpret_cast<CppHTTPClient *>(pUserData);
+
+   if (pClient->m_pCancelToken && pClient->m_pCancelToken->IsCancelled())
+      return 1;
+
+   if (pClient->m_oProgress)
+      return pClient->m_oProgress(pClient, static_cast<double>(DlTotal), static_cast<double>(DlNow),
+                                  static_cast<double>(UlTotal), static_cast<double>(UlNow));
+
+   return 0;
+}
@@ -0,0 +1,118 @@
+#include "httpcompletionqueue.h"
+
+namespace
+{
+size_t RoundUpPowerOfTwo(size_t usValue)
+{
+   size_t usPower = 1;
+   while (usPower < usValue)
+      usPower <<= 1;
+   return usPower;
+}
+} // namespace
+
+/**
+ * @brief constructor of the completion queue
+ *
+ * @param [in] usCapacity maximum number of batches not drained yet
+ */
+CppHTTPCompletionQueue::CppHTTPCompletionQueue(const size_t usCapacity /* = 64 */)
+    : m_vecSlots(RoundUpPowerOfTwo(std::max<size_t>(usCapacity, 2))),
+      m_usMask(m_vecSlots.size() - 1),
+      m_usHead(0),
+      m_usTail(0),
+      m_bWaiting(false),
+      m_bClosed(false),
+      m_ullBatches(0),
+      m_ullCompletions(0),
+      m_ullWakeups(0)
+{
+}
+
+/**
+ * @brief publishes a batch of completions (producer thread)
+ *
+ * @param [in/out] vecBatch batch to publish, emptied on success
+ *
+ * @retval true   The batch was published.
+ * @retval false  The ring buffer is full, the batch is left untouched.
+ */
+const bool CppHTTPCompletionQueue::Push(Batch &vecBatch)
+{
+   if (vecBatch.empty())
+      return true;
+
+   size_t usTail = m_usTail.load(std::memory_order_relaxed);
+   if (usTail - m_usHead.load(std::memory_order_acquire) > m_usMask)
+      return false;
+
+   m_ullCompletions.fetch_add(vecBatch.size(), std::memory_order_relaxed);
+   m_ullBatches.fetch_add(1, std::memory_order_relaxed);
+
+   m_vecSlots[usTail & m_usMask].swap(vecBatch);
+   vecBatch.clear();
+   m_usTail.store(usTail + 1, std::memory_order_seq_cst);
+
+   // only pay for a wakeup when the consumer sleeps
+   if (m_bWaiting.load(std::memory_order_seq_cst))
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxWait);
+      m_cvWait.notify_one();
+   }
+
+   return true;
+}
+
+/**
+ * @brief takes every published completion (consumer thread)
+ *
+ * @param [out] vecCompletions receives the completions, appended in completion order
+ * @param [in] iTimeoutMs maximum time to wait when the queue is empty (0: don't wait, -1: forever)
+ *
+ * @retval number of completions appended, 0 on timeout or when the queue is closed
+ */
+const size_t CppHTTPCompletionQueue::Drain(Batch &vecCompletions, const int iTimeoutMs)
+{
+   size_t usHead = m_usHead.load(std::memory_order_relaxed);
+
+   if (usHead == m_usTail.load(std::memory_order_acquire) && iTimeoutMs != 0)
+   {
+      std::unique_lock<std::mutex> oLock(m_mtxWait);
+      m_bWaiting.store(true, std::memory_order_seq_cst);
+
+      auto Ready = [&]() { return m_usTail.load(std::memory_order_seq_cst) != usHead || m_bClosed.load(); };
+      if (iTimeoutMs < 0)
+         m_cvWait.wait(oLock, Ready);
+      else
+         m_cvWait.wait_for(oLock, std::chrono::milliseconds(iTimeoutMs), Ready);
+
+      m_bWaiting.store(false, std::memory_order_relaxed);
+      m_ullWakeups.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   size_t usTail = m_usTail.load(std::memory_order_acquire);
+   size_t usCount = 0;
+   for (; usHead != usTail; ++usHead)
+   {
+      Batch &vecSlot = m_vecSlots[usHead & m_usMask];
+      usCount += vecSlot.size();
+      if (vecCompletions.empty())
+         vecCompletions.swap(vecSlot);
+      else
+         std::move(vecSlot.begin(), vecSlot.end(), std::back_inserter(vecCompletions));
+      vecSlot.clear();
+   }
+   m_usHead.store(usTail, std::memory_order_release);
+
+   return usCount;
+}
+
+/**
+ * @brief wakes the consumer up for good, Drain() does not wait anymore
+ */
+void CppHTTPCompletionQueue::Close()
+{
+   std::lock_guard<std::mutex> oLock(m_mtxWait);
+   m_bClosed.store(true);
+   m_cvWait.notify_all();
+}
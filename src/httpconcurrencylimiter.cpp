@@ -0,0 +1,187 @@
+#include "httpconcurrencylimiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief constructor of the concurrency limiter
+ *
+ * @param [in] oPolicy algorithm and bounds of the limits
+ */
+CppHTTPConcurrencyLimiter::CppHTTPConcurrencyLimiter(const Policy &oPolicy /* = Policy() */) : m_oPolicy(oPolicy)
+{
+}
+
+/**
+ * @brief admits a request to an origin in the wait queue
+ *
+ * @param [in] strHost origin of the request
+ *
+ * @retval true   The request waits for Acquire() or Withdraw().
+ * @retval false  Too many requests already wait for the origin, the request is shed.
+ */
+const bool CppHTTPConcurrencyLimiter::Admit(const std::string &strHost)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   HostStats &oHost = GetHost(strHost);
+   if (oHost.usInFlight + oHost.usWaiting >=
+       Floor(oHost.dLimit) + static_cast<size_t>(std::max(m_oPolicy.dQueueRatio, 0.) * oHost.dLimit))
+   {
+      ++oHost.ullShed;
+      return false;
+   }
+
+   ++oHost.usWaiting;
+   return true;
+}
+
+/**
+ * @brief removes an admitted request that will not start
+ */
+void CppHTTPConcurrencyLimiter::Withdraw(const std::string &strHost)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   HostStats &oHost = GetHost(strHost);
+   if (oHost.usWaiting > 0)
+      --oHost.usWaiting;
+}
+
+/**
+ * @brief tells whether a request to an origin may start
+ */
+const bool CppHTTPConcurrencyLimiter::HasCapacity(const std::string &strHost) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   auto itHost = m_mapHosts.find(strHost);
+   return itHost == m_mapHosts.end() || itHost->second.usInFlight < Floor(itHost->second.dLimit);
+}
+
+/**
+ * @brief starts an admitted request
+ */
+void CppHTTPConcurrencyLimiter::Acquire(const std::string &strHost)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   HostStats &oHost = GetHost(strHost);
+   if (oHost.usWaiting > 0)
+      --oHost.usWaiting;
+   ++oHost.usInFlight;
+}
+
+/**
+ * @brief ends a started request and adjusts the limit of its origin
+ *
+ * @param [in] strHost origin of the request
+ * @param [in] ullLatencyUs start to completion latency, in microseconds
+ * @param [in] bDropped the request failed or was refused by the origin
+ */
+void CppHTTPConcurrencyLimiter::OnComplete(const std::string &strHost, const unsigned long long ullLatencyUs,
+                                           const bool bDropped)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   HostStats &oHost = GetHost(strHost);
+   // the requests in flight with this one tell how much of the limit is used
+   const size_t usInFlight = oHost.usInFlight;
+   if (oHost.usInFlight > 0)
+      --oHost.usInFlight;
+
+   const double dLatencyMs = ullLatencyUs / 1000.;
+   const bool bDrop = bDropped || (m_oPolicy.iDropLatencyMs > 0 && dLatencyMs > m_oPolicy.iDropLatencyMs);
+   const double dMinLimit = static_cast<double>(std::max<size_t>(m_oPolicy.usMinLimit, 1));
+   const double dMaxLimit = std::max(static_cast<double>(m_oPolicy.usMaxLimit), dMinLimit);
+   double dLimit = oHost.dLimit;
+
+   if (m_oPolicy.eAlgorithm == LIMIT_AIMD)
+   {
+      if (bDrop)
+         dLimit *= m_oPolicy.dBackoffRatio;
+      else if (usInFlight * 2 >= Floor(dLimit))
+         dLimit += 1.;
+   }
+   else
+   {
+      // short-term latency over ~10 responses, long-term over usLongWindow
+      const double dShortAlpha = 2. / 11.;
+      const double dLongAlpha = 2. / (std::max<size_t>(m_oPolicy.usLongWindow, 1) + 1.);
+      if (oHost.dLongRttMs <= 0.)
+         oHost.dShortRttMs = oHost.dLongRttMs = dLatencyMs;
+      else
+      {
+         oHost.dShortRttMs += (dLatencyMs - oHost.dShortRttMs) * dShortAlpha;
+         oHost.dLongRttMs += (dLatencyMs - oHost.dLongRttMs) * dLongAlpha;
+         // a long-term latency far above the current one drifts down to the new normal
+         if (oHost.dLongRttMs > 2. * oHost.dShortRttMs)
+            oHost.dLongRttMs *= 0.95;
+      }
+
+      // an origin used below half of its limit tells nothing about a higher one
+      if (bDrop || usInFlight * 2 >= Floor(dLimit))
+      {
+         double dGradient = 0.5;
+         if (!bDrop && oHost.dShortRttMs > 0.)
+            dGradient = std::max(0.5, std::min(1., m_oPolicy.dTolerance * oHost.dLongRttMs / oHost.dShortRttMs));
+         double dNewLimit = dLimit * dGradient + std::sqrt(dLimit);
+         dLimit = dLimit * (1. - m_oPolicy.dSmoothing) + dNewLimit * m_oPolicy.dSmoothing;
+      }
+   }
+
+   oHost.dLimit = std::min(std::max(dLimit, dMinLimit), dMaxLimit);
+}
+
+/**
+ * @brief ends a started request without adjusting the limit
+ */
+void CppHTTPConcurrencyLimiter::Release(const std::string &strHost)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   HostStats &oHost = GetHost(strHost);
+   if (oHost.usInFlight > 0)
+      --oHost.usInFlight;
+}
+
+/**
+ * @brief returns the current limit of the requests in flight to an origin
+ */
+const size_t CppHTTPConcurrencyLimiter::GetLimit(const std::string &strHost) const
+{
+   return Floor(GetStats(strHost).dLimit);
+}
+
+/**
+ * @brief returns the limit and the counters of an origin
+ */
+const CppHTTPConcurrencyLimiter::HostStats CppHTTPConcurrencyLimiter::GetStats(const std::string &strHost) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   auto itHost = m_mapHosts.find(strHost);
+   if (itHost != m_mapHosts.end())
+      return itHost->second;
+
+   HostStats oStats;
+   oStats.dLimit = static_cast<double>(std::max(m_oPolicy.usInitialLimit, std::max<size_t>(m_oPolicy.usMinLimit, 1)));
+   return oStats;
+}
+
+// INTERNALS
+
+/**
+ * @brief returns the state of an origin, created on first use, m_mtxHosts must be held
+ */
+CppHTTPConcurrencyLimiter::HostStats &CppHTTPConcurrencyLimiter::GetHost(const std::string &strHost)
+{
+   auto itHost = m_mapHosts.find(strHost);
+   if (itHost != m_mapHosts.end())
+      return itHost->second;
+
+   HostStats &oHost = m_mapHosts[strHost];
+   oHost.dLimit = static_cast<double>(std::max(m_oPolicy.usInitialLimit, std::max<size_t>(m_oPolicy.usMinLimit, 1)));
+   return oHost;
+}
+
+/**
+ * @brief returns the requests allowed in flight by a limit, one at least
+ */
+const size_t CppHTTPConcurrencyLimiter::Floor(const double dLimit) const
+{
+   return std::max<size_t>(static_cast<size_t>(dLimit), 1);
+}
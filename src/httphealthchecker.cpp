@@ -0,0 +1,99 @@
+#include "httphealthchecker.h"
+#include "httploadbalancer.h"
+
+/**
+ * @brief constructor of the health checker
+ *
+ * @param [in] oClient asynchronous client performing the probes, must outlive the checker
+ * @param [in] pBalancer load balancer whose endpoints are probed
+ * @param [in] oPolicy probe request and interval
+ */
+CppHTTPHealthChecker::CppHTTPHealthChecker(CppHTTPAsyncClient &oClient, std::shared_ptr<CppHTTPLoadBalancer> pBalancer,
+                                           const HealthCheckPolicy &oPolicy /* = HealthCheckPolicy() */)
+    : m_oClient(oClient),
+      m_pBalancer(pBalancer),
+      m_oPolicy(oPolicy),
+      m_ullTimerId(0),
+      m_pAlive(std::make_shared<int>(0))
+{
+}
+
+CppHTTPHealthChecker::~CppHTTPHealthChecker()
+{
+   Stop();
+}
+
+void CppHTTPHealthChecker::Start()
+{
+   if (IsRunning() || !m_pBalancer)
+      return;
+
+   m_pCancelToken = std::make_shared<CppHTTPCancelToken>();
+   m_pBalancer->SetActiveHealthChecks(true);
+   RunChecks();
+}
+
+void CppHTTPHealthChecker::Stop()
+{
+   if (!IsRunning())
+      return;
+
+   m_oClient.CancelTimer(m_ullTimerId);
+   m_ullTimerId = 0;
+   m_pCancelToken->Cancel();
+   m_pCancelToken.reset();
+   m_setProbing.clear();
+   // the completions of the cancelled probes are ignored
+   m_pAlive = std::make_shared<int>(0);
+   m_pBalancer->SetActiveHealthChecks(false);
+}
+
+// INTERNALS
+
+/**
+ * @brief probes the endpoints without a probe in flight and schedules the next run
+ */
+void CppHTTPHealthChecker::RunChecks()
+{
+   std::weak_ptr<int> wpAlive = m_pAlive;
+   for (const auto &strEndpoint : m_pBalancer->GetAllEndpoints())
+   {
+      if (!m_setProbing.insert(strEndpoint).second)
+         continue;
+
+      CppHTTPAsyncClient::Request oProbe;
+      oProbe.eMethod = m_oPolicy.eMethod;
+      oProbe.strUrl = strEndpoint + m_oPolicy.strPath;
+      oProbe.ePriority = CppHTTPAsyncClient::PRIORITY_HIGH;
+      oProbe.oTimeouts.lTotalMs = m_oPolicy.iTimeoutMs;
+      oProbe.pCancelToken = m_pCancelToken;
+
+      // TrySubmit: a probe waiting in a full queue would report the client's load, not the endpoint's health
+      if (!m_oClient.TrySubmit(oProbe, [this, wpAlive, strEndpoint](const bool bSuccess, HttpResponse &Response) {
+             if (wpAlive.lock())
+                OnProbe(strEndpoint, bSuccess, Response);
+          }))
+         m_setProbing.erase(strEndpoint);
+   }
+
+   m_ullTimerId = m_oClient.ScheduleTimer(std::max(m_oPolicy.iIntervalMs, 1), [this]() { RunChecks(); });
+}
+
+/**
+ * @brief reports the result of a probe to the load balancer
+ *
+ * @param [in] strEndpoint endpoint probed
+ * @param [in] bSuccess false if the transfer failed
+ * @param [in] Response answer of the endpoint
+ */
+void CppHTTPHealthChecker::OnProbe(const std::string &strEndpoint, const bool bSuccess, const HttpResponse &Response)
+{
+   m_setProbing.erase(strEndpoint);
+
+   const bool bHealthy = bSuccess && Response.iCode >= 200 && Response.iCode < 400;
+   ++m_oStats.ullProbes;
+   if (!bHealthy)
+      ++m_oStats.ullFailures;
+
+   m_pBalancer->ReportProbe(strEndpoint, bHealthy);
+}
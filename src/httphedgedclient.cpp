@@ -0,0 +1,284 @@
+#include "httphedgedclient.h"
+
+/**
+ * @brief constructor of the hedged client
+ *
+ * @param [in] oClient asynchronous client performing the requests, must outlive the hedged client
+ * @param [in] oPolicy hedge delay and budget
+ */
+CppHTTPHedgedClient::CppHTTPHedgedClient(CppHTTPAsyncClient &oClient, const HedgePolicy &oPolicy /* = HedgePolicy() */)
+    : m_oClient(oClient),
+      m_oPolicy(oPolicy),
+      m_iDelayMs(0),
+      m_dBudget(0.)
+{
+   UpdateDelay();
+}
+
+void CppHTTPHedgedClient::SetPolicy(const HedgePolicy &oPolicy)
+{
+   m_oPolicy = oPolicy;
+   m_dBudget = std::min(m_dBudget, GetMaxBudget());
+   while (m_dqLatencies.size() > std::max<size_t>(m_oPolicy.usWindow, 1))
+      m_dqLatencies.pop_front();
+   UpdateDelay();
+}
+
+/**
+ * @brief returns the hedging statistics
+ */
+const CppHTTPHedgedClient::Stats CppHTTPHedgedClient::GetStats() const
+{
+   Stats oStats = m_oStats;
+   oStats.iDelayMs = m_iDelayMs;
+   return oStats;
+}
+
+// REST REQUESTS
+
+/**
+ * @brief submits a request, hedged when it is a GET or a HEAD request
+ *
+ * oCompletion is called once, with the first successful answer (HTTP status below 500)
+ * or, when no copy succeeded, with the answer of the last copy. The caller's cancel
+ * token cancels both copies.
+ *
+ * @param [in] oRequest request to perform
+ * @param [in] oCompletion completion callback
+ * @param [in] strHedgeUrl URL of the second copy, the request's URL if empty
+ *
+ * @retval true   The request is submitted.
+ * @retval false  The client refused the request.
+ */
+const bool CppHTTPHedgedClient::Submit(const Request &oRequest, CompletionFnCallback oCompletion,
+                                       const std::string &strHedgeUrl /* = std::string() */)
+{
+   if (oRequest.eMethod != CppHTTPAsyncClient::HTTP_GET && oRequest.eMethod != CppHTTPAsyncClient::HTTP_HEAD)
+      return m_oClient.Submit(oRequest, oCompletion);
+
+   auto pHedge = std::make_shared<Hedge>();
+   pHedge->oRequest = oRequest;
+   pHedge->strHedgeUrl = strHedgeUrl;
+   pHedge->oCompletion = oCompletion;
+   pHedge->tpStart = std::chrono::steady_clock::now();
+   pHedge->arrTokens[0] = std::make_shared<CppHTTPCancelToken>();
+   pHedge->arrTokens[1] = std::make_shared<CppHTTPCancelToken>();
+
+   if (!SubmitCopy(pHedge, 0))
+      return false;
+
+   ++m_oStats.ullRequests;
+   m_dBudget = std::min(m_dBudget + m_oPolicy.dBudgetPercent / 100., GetMaxBudget());
+
+   if (oRequest.pCancelToken)
+   {
+      // the tokens, not the hedge, are captured: the caller's token may outlive the request
+      std::shared_ptr<CppHTTPCancelToken> pPrimary = pHedge->arrTokens[0];
+      std::shared_ptr<CppHTTPCancelToken> pSecond = pHedge->arrTokens[1];
+      pHedge->ullCancelSubscription = oRequest.pCancelToken->Subscribe([pPrimary, pSecond]() {
+         pPrimary->Cancel();
+         pSecond->Cancel();
+      });
+   }
+
+   pHedge->ullTimerId = m_oClient.ScheduleTimer(m_iDelayMs, [this, pHedge]() {
+      pHedge->ullTimerId = 0;
+      SendHedge(pHedge);
+   });
+
+   return true;
+}
+
+/**
+ * @brief submits a hedged HEAD request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] oCompletion completion callback
+ * @param [in] strHedgeUrl URL of the second copy, strUrl if empty
+ */
+const bool CppHTTPHedgedClient::Head(const std::string &strUrl, const HeadersMap &Headers,
+                                     CompletionFnCallback oCompletion,
+                                     const std::string &strHedgeUrl /* = std::string() */)
+{
+   Request oRequest;
+   oRequest.eMethod = CppHTTPAsyncClient::HTTP_HEAD;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+
+   return Submit(oRequest, oCompletion, strHedgeUrl);
+}
+
+/**
+ * @brief submits a hedged GET request
+ *
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ * @param [in] oCompletion completion callback
+ * @param [in] strHedgeUrl URL of the second copy, strUrl if empty
+ */
+const bool CppHTTPHedgedClient::Get(const std::string &strUrl, const HeadersMap &Headers,
+                                    CompletionFnCallback oCompletion,
+                                    const std::string &strHedgeUrl /* = std::string() */)
+{
+   Request oRequest;
+   oRequest.eMethod = CppHTTPAsyncClient::HTTP_GET;
+   oRequest.strUrl = strUrl;
+   oRequest.mapHeaders = Headers;
+
+   return Submit(oRequest, oCompletion, strHedgeUrl);
+}
+
+// INTERNALS
+
+/**
+ * @brief submits a copy of a request
+ *
+ * @param [in] pHedge request
+ * @param [in] usCopy 0 for the primary copy, 1 for the hedge
+ *
+ * @retval false  The client refused the copy.
+ */
+const bool CppHTTPHedgedClient::SubmitCopy(std::shared_ptr<Hedge> pHedge, const size_t usCopy)
+{
+   Request oCopy = pHedge->oRequest;
+   if (usCopy == 1 && !pHedge->strHedgeUrl.empty())
+      oCopy.strUrl = pHedge->strHedgeUrl;
+   oCopy.pCancelToken = pHedge->arrTokens[usCopy];
+
+   auto oCompleted = [this, pHedge, usCopy](const bool bSuccess, HttpResponse &Response) {
+      OnCompleted(pHedge, usCopy, bSuccess, Response);
+   };
+
+   // the hedge is extra load: it never waits for, nor takes, a place in a full queue
+   if (!((usCopy == 0) ? m_oClient.Submit(oCopy, oCompleted) : m_oClient.TrySubmit(oCopy, oCompleted)))
+      return false;
+
+   ++pHedge->usPending;
+   return true;
+}
+
+/**
+ * @brief sends the second copy of a request still unanswered after the hedge delay
+ *
+ * @param [in] pHedge request
+ */
+void CppHTTPHedgedClient::SendHedge(std::shared_ptr<Hedge> pHedge)
+{
+   if (pHedge->bDone || pHedge->arrTokens[0]->IsCancelled())
+      return;
+
+   if (m_dBudget < 1.)
+   {
+      ++m_oStats.ullBudgetDenied;
+      return;
+   }
+
+   if (SubmitCopy(pHedge, 1))
+   {
+      m_dBudget -= 1.;
+      ++m_oStats.ullHedges;
+   }
+}
+
+/**
+ * @brief completion of a copy, the first answer wins
+ *
+ * @param [in] pHedge request
+ * @param [in] usCopy copy that completed
+ * @param [in] bSuccess false if the transfer failed
+ * @param [in] Response response of the copy
+ */
+void CppHTTPHedgedClient::OnCompleted(std::shared_ptr<Hedge> pHedge, const size_t usCopy, const bool bSuccess,
+                                      HttpResponse &Response)
+{
+   --pHedge->usPending;
+   if (pHedge->bDone)
+      return;
+
+   // a server error of one replica isn't an answer while the other copy runs
+   bool bAnswered = bSuccess && Response.iCode < 500;
+   if (!bAnswered && pHedge->usPending > 0)
+      return;
+
+   if (bAnswered)
+   {
+      AddLatency(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      std::chrono::steady_clock::now() - pHedge->tpStart)
+                                      .count()));
+      if (usCopy == 1)
+         ++m_oStats.ullHedgeWins;
+
+      if (pHedge->usPending > 0)
+         pHedge->arrTokens[1 - usCopy]->Cancel();
+   }
+
+   Finish(pHedge, bSuccess, Response);
+}
+
+/**
+ * @brief completes a request, once
+ *
+ * @param [in] pHedge request
+ * @param [in] bSuccess false if the transfer failed
+ * @param [in] Response response delivered to the caller
+ */
+void CppHTTPHedgedClient::Finish(std::shared_ptr<Hedge> pHedge, const bool bSuccess, HttpResponse &Response)
+{
+   pHedge->bDone = true;
+
+   if (pHedge->ullTimerId != 0)
+   {
+      m_oClient.CancelTimer(pHedge->ullTimerId);
+      pHedge->ullTimerId = 0;
+   }
+   if (pHedge->ullCancelSubscription != 0)
+   {
+      pHedge->oRequest.pCancelToken->Unsubscribe(pHedge->ullCancelSubscription);
+      pHedge->ullCancelSubscription = 0;
+   }
+
+   if (pHedge->oCompletion)
+      pHedge->oCompletion(bSuccess, Response);
+}
+
+/**
+ * @brief returns the hedges that can be saved up, the budget of 100 requests
+ */
+const double CppHTTPHedgedClient::GetMaxBudget() const
+{
+   return (m_oPolicy.dBudgetPercent > 0.) ? std::max(m_oPolicy.dBudgetPercent, 1.) : 0.;
+}
+
+/**
+ * @brief records the latency of an answered request
+ *
+ * @param [in] iLatencyMs submission to answer latency, in milliseconds
+ */
+void CppHTTPHedgedClient::AddLatency(const int iLatencyMs)
+{
+   m_dqLatencies.push_back(iLatencyMs);
+   while (m_dqLatencies.size() > std::max<size_t>(m_oPolicy.usWindow, 1))
+      m_dqLatencies.pop_front();
+
+   UpdateDelay();
+}
+
+/**
+ * @brief computes the hedge delay from the recent latencies
+ */
+void CppHTTPHedgedClient::UpdateDelay()
+{
+   if (m_dqLatencies.empty() || m_dqLatencies.size() < m_oPolicy.usMinSamples)
+   {
+      m_iDelayMs = std::max(m_oPolicy.iDefaultDelayMs, m_oPolicy.iMinDelayMs);
+      return;
+   }
+
+   std::vector<int> vecLatencies(m_dqLatencies.begin(), m_dqLatencies.end());
+   double dRank = std::min(std::max(m_oPolicy.dPercentile, 0.), 100.) / 100. * (vecLatencies.size() - 1);
+   auto itRank = vecLatencies.begin() + static_cast<size_t>(dRank + 0.5);
+   std::nth_element(vecLatencies.begin(), itRank, vecLatencies.end());
+
+   m_iDelayMs = std::max(*itRank, m_oPolicy.iMinDelayMs);
+}
@@ -0,0 +1,670 @@
+#include "httploadbalancer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "document.h"
+
+const char *const CppHTTPLoadBalancer::SCHEME = "lb://";
+
+namespace
+{
+// base URLs are compared without their trailing slashes
+std::string TrimEndpoint(const std::string &strEndpoint)
+{
+   size_t usEnd = strEndpoint.find_last_not_of('/');
+   return (usEnd == std::string::npos) ? std::string() : strEndpoint.substr(0, usEnd + 1);
+}
+} // namespace
+
+/**
+ * @brief constructor of the load balancer
+ *
+ * @param [in] iDecayMs time constant of the EWMA latencies
+ * @param [in] iFailurePenaltyMs latency accounted for a failed request by LB_EWMA
+ */
+CppHTTPLoadBalancer::CppHTTPLoadBalancer(const int iDecayMs /* = 10000 */, const int iFailurePenaltyMs /* = 1000 */)
+    : m_iDecayMs(std::max(iDecayMs, 1)),
+      m_iFailurePenaltyMs(std::max(iFailurePenaltyMs, 0)),
+      m_oRandom(std::random_device()()),
+      m_bActiveHealthChecks(false),
+      m_iCheckMs(0),
+      m_llConfigMtimeNs(-1),
+      m_llConfigSize(-1)
+{
+   m_oOutlier.bEnabled = false;
+}
+
+// SERVICES
+
+/**
+ * @brief adds or replaces a service
+ *
+ * @param [in] strService name of the service, the host of its "lb://" URLs
+ * @param [in] vecEndpoints base URLs of the endpoints
+ * @param [in] eStrategy balancing strategy
+ */
+void CppHTTPLoadBalancer::SetService(const std::string &strService, const std::vector<std::string> &vecEndpoints,
+                                     const Strategy eStrategy /* = LB_ROUND_ROBIN */)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   SetServiceLocked(strService, vecEndpoints, eStrategy);
+   PruneEndpoints();
+}
+
+void CppHTTPLoadBalancer::RemoveService(const std::string &strService)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   m_mapServices.erase(strService);
+   PruneEndpoints();
+}
+
+/**
+ * @brief returns the base URLs of a service, empty if the service is unknown
+ */
+const std::vector<std::string> CppHTTPLoadBalancer::GetEndpoints(const std::string &strService) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   auto itService = m_mapServices.find(strService);
+   return (itService == m_mapServices.end()) ? std::vector<std::string>() : itService->second.vecEndpoints;
+}
+
+/**
+ * @brief returns the number of distinct endpoints, all services included
+ */
+const size_t CppHTTPLoadBalancer::GetEndpointCount() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   return m_mapEndpoints.size();
+}
+
+/**
+ * @brief reads the services from a JSON file, which then replaces all of them
+ *
+ * @param [in] strPath path of the file
+ * @param [in] iCheckMs interval of the checks for changes, done by Resolve(), 0 to never reload
+ *
+ * @retval true   The services were read.
+ * @retval false  The file can't be read or parsed, the services are unchanged.
+ */
+const bool CppHTTPLoadBalancer::SetConfigFile(const std::string &strPath, const int iCheckMs /* = 1000 */)
+{
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxServices);
+      m_strConfigFile = strPath;
+      m_iCheckMs = std::max(iCheckMs, 0);
+      m_tpNextCheck = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_iCheckMs);
+      m_llConfigMtimeNs = -1;
+      m_llConfigSize = -1;
+   }
+   return LoadConfig(true);
+}
+
+/**
+ * @brief reads the services from the file set by SetConfigFile() again, changed or not
+ */
+const bool CppHTTPLoadBalancer::Reload()
+{
+   return LoadConfig(true);
+}
+
+// RESOLUTION
+
+/**
+ * @brief tells whether an URL names a service, "lb://<service>..."
+ */
+const bool CppHTTPLoadBalancer::IsServiceUrl(const std::string &strUrl)
+{
+   static const size_t s_usLength = std::char_traits<char>::length(SCHEME);
+   if (strUrl.size() < s_usLength)
+      return false;
+
+   return std::equal(SCHEME, SCHEME + s_usLength, strUrl.begin(),
+                     [](const char cScheme, const char cUrl) { return cScheme == ::tolower(cUrl); });
+}
+
+/**
+ * @brief picks an endpoint of the service of an URL
+ *
+ * @param [in] strUrl "lb://<service>/path?query"
+ * @param [out] strResolved "<base URL>/path?query"
+ * @param [out] strEndpoint base URL of the endpoint, to give to Release()
+ *
+ * @retval true   An endpoint was picked, Release() must be called once the request ended.
+ * @retval false  Not a service URL, unknown service or service without endpoints.
+ */
+const bool CppHTTPLoadBalancer::Resolve(const std::string &strUrl, std::string &strResolved, std::string &strEndpoint)
+{
+   if (!IsServiceUrl(strUrl))
+      return false;
+
+   LoadConfig(false);
+
+   const size_t usStart = std::char_traits<char>::length(SCHEME);
+   size_t usEnd = strUrl.find_first_of("/?#", usStart);
+   if (usEnd == std::string::npos)
+      usEnd = strUrl.size();
+   const std::string strService = strUrl.substr(usStart, usEnd - usStart);
+
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   auto itService = m_mapServices.find(strService);
+   if (itService == m_mapServices.end() || itService->second.vecEndpoints.empty())
+      return false;
+
+   Service &oService = itService->second;
+   auto tpNow = std::chrono::steady_clock::now();
+   m_vecAdmitted.clear();
+   for (size_t usIndex = 0; usIndex < oService.vecEndpoints.size(); ++usIndex)
+      if (IsAdmitted(m_mapEndpoints[oService.vecEndpoints[usIndex]], tpNow))
+         m_vecAdmitted.push_back(usIndex);
+   // all ejected: the service is better served by all its endpoints than by none
+   if (m_vecAdmitted.empty())
+      for (size_t usIndex = 0; usIndex < oService.vecEndpoints.size(); ++usIndex)
+         m_vecAdmitted.push_back(usIndex);
+
+   const size_t usCount = m_vecAdmitted.size();
+   size_t usPicked = 0;
+   if (usCount == 1)
+      usPicked = m_vecAdmitted[0];
+   else if (oService.eStrategy == LB_ROUND_ROBIN)
+      usPicked = m_vecAdmitted[oService.usNext++ % usCount];
+   else
+   {
+      // power of two choices: two distinct endpoints at random, the least loaded wins
+      size_t usFirst = std::uniform_int_distribution<size_t>(0, usCount - 1)(m_oRandom);
+      size_t usSecond = std::uniform_int_distribution<size_t>(0, usCount - 2)(m_oRandom);
+      if (usSecond >= usFirst)
+         ++usSecond;
+      usFirst = m_vecAdmitted[usFirst];
+      usSecond = m_vecAdmitted[usSecond];
+
+      // an endpoint not measured yet is taken as the average of the others
+      double dDefaultMs = 0.;
+      if (oService.eStrategy == LB_EWMA)
+      {
+         size_t usMeasured = 0;
+         for (const auto &strBase : oService.vecEndpoints)
+         {
+            const EndpointStats &oStats = m_mapEndpoints[strBase].oStats;
+            if (oStats.ullRequests > 0)
+            {
+               dDefaultMs += oStats.dEwmaMs;
+               ++usMeasured;
+            }
+         }
+         dDefaultMs = (usMeasured > 0) ? dDefaultMs / usMeasured : 0.;
+      }
+
+      const double dFirst = GetLoad(m_mapEndpoints[oService.vecEndpoints[usFirst]], oService.eStrategy, dDefaultMs);
+      const double dSecond = GetLoad(m_mapEndpoints[oService.vecEndpoints[usSecond]], oService.eStrategy, dDefaultMs);
+      usPicked = (dSecond < dFirst) ? usSecond : usFirst;
+   }
+
+   strEndpoint = oService.vecEndpoints[usPicked];
+   strResolved = strEndpoint + strUrl.substr(usEnd);
+   ++m_mapEndpoints[strEndpoint].oStats.usOutstanding;
+   return true;
+}
+
+/**
+ * @brief ends a request sent to an endpoint picked by Resolve()
+ *
+ * @param [in] strEndpoint endpoint given by Resolve()
+ * @param [in] ullLatencyUs latency of the request, in microseconds
+ * @param [in] bSuccess false if the transfer failed or the endpoint answered with a 5xx status
+ */
+void CppHTTPLoadBalancer::Release(const std::string &strEndpoint, const unsigned long long ullLatencyUs,
+                                  const bool bSuccess)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   auto itEndpoint = m_mapEndpoints.find(strEndpoint);
+   if (itEndpoint == m_mapEndpoints.end())
+      return;
+
+   Endpoint &oEndpoint = itEndpoint->second;
+   EndpointStats &oStats = oEndpoint.oStats;
+   if (oStats.usOutstanding > 0)
+      --oStats.usOutstanding;
+   ++oStats.ullRequests;
+   if (!bSuccess)
+      ++oStats.ullFailures;
+
+   // peak EWMA: a slower request is taken at once, a faster one decays the average
+   auto tpNow = std::chrono::steady_clock::now();
+   double dLatencyMs = ullLatencyUs / 1000.;
+   if (!bSuccess)
+      dLatencyMs = std::max(dLatencyMs, static_cast<double>(m_iFailurePenaltyMs));
+
+   if (oStats.ullRequests == 1 || dLatencyMs > oStats.dEwmaMs)
+      oStats.dEwmaMs = dLatencyMs;
+   else
+   {
+      double dElapsedMs = std::chrono::duration<double, std::milli>(tpNow - oEndpoint.tpUpdated).count();
+      double dWeight = std::exp(-dElapsedMs / m_iDecayMs);
+      oStats.dEwmaMs = oStats.dEwmaMs * dWeight + dLatencyMs * (1. - dWeight);
+   }
+   oEndpoint.tpUpdated = tpNow;
+
+   // error rate of about the last usMinRequests requests
+   double dAlpha = 1. / std::max<size_t>(m_oOutlier.usMinRequests, 1);
+   oStats.dErrorPercent = oStats.dErrorPercent * (1. - dAlpha) + (bSuccess ? 0. : 100. * dAlpha);
+
+   // a request picked before the ejection tells nothing new
+   if (oStats.bEjected)
+      return;
+
+   ++oEndpoint.usAdmittedRequests;
+   if (m_oOutlier.bEnabled && oEndpoint.usAdmittedRequests >= std::max<size_t>(m_oOutlier.usMinRequests, 1) &&
+       IsOutlier(strEndpoint, oEndpoint) && CanEject(strEndpoint))
+      Eject(oEndpoint, tpNow);
+   else if (bSuccess && oStats.uEjections > 0 &&
+            tpNow - oEndpoint.tpAdmitted >= std::chrono::milliseconds(m_oOutlier.iMaxEjectionMs))
+      oStats.uEjections = 0;
+}
+
+/**
+ * @brief ends a request picked by Resolve() without measuring the endpoint
+ *
+ * @param [in] strEndpoint endpoint given by Resolve()
+ */
+void CppHTTPLoadBalancer::Release(const std::string &strEndpoint)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   auto itEndpoint = m_mapEndpoints.find(strEndpoint);
+   if (itEndpoint != m_mapEndpoints.end() && itEndpoint->second.oStats.usOutstanding > 0)
+      --itEndpoint->second.oStats.usOutstanding;
+}
+
+/**
+ * @brief returns the statistics of an endpoint
+ */
+const CppHTTPLoadBalancer::EndpointStats CppHTTPLoadBalancer::GetStats(const std::string &strEndpoint) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   auto itEndpoint = m_mapEndpoints.find(TrimEndpoint(strEndpoint));
+   return (itEndpoint == m_mapEndpoints.end()) ? EndpointStats() : itEndpoint->second.oStats;
+}
+
+/**
+ * @brief converts the name of a strategy, "round_robin", "p2c" or "ewma"
+ *
+ * @retval false  Unknown strategy.
+ */
+const bool CppHTTPLoadBalancer::ParseStrategy(const std::string &strName, Strategy &eStrategy)
+{
+   if (strName == "round_robin")
+      eStrategy = LB_ROUND_ROBIN;
+   else if (strName == "p2c")
+      eStrategy = LB_P2C;
+   else if (strName == "ewma")
+      eStrategy = LB_EWMA;
+   else
+      return false;
+   return true;
+}
+
+// OUTLIER EJECTION
+
+/**
+ * @brief enables the outlier ejection, or disables it and readmits the ejected endpoints
+ *
+ * @param [in] oPolicy ejection thresholds and times
+ */
+void CppHTTPLoadBalancer::SetOutlierPolicy(const OutlierPolicy &oPolicy)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   m_oOutlier = oPolicy;
+   if (m_oOutlier.bEnabled)
+      return;
+
+   auto tpNow = std::chrono::steady_clock::now();
+   for (auto &prEndpoint : m_mapEndpoints)
+      if (prEndpoint.second.oStats.bEjected)
+         Readmit(prEndpoint.second, tpNow);
+}
+
+const CppHTTPLoadBalancer::OutlierPolicy CppHTTPLoadBalancer::GetOutlierPolicy() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   return m_oOutlier;
+}
+
+/**
+ * @brief returns the base URLs of the endpoints of all the services
+ */
+const std::vector<std::string> CppHTTPLoadBalancer::GetAllEndpoints() const
+{
+   std::vector<std::string> vecEndpoints;
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   vecEndpoints.reserve(m_mapEndpoints.size());
+   for (const auto &prEndpoint : m_mapEndpoints)
+      vecEndpoints.push_back(prEndpoint.first);
+   return vecEndpoints;
+}
+
+void CppHTTPLoadBalancer::SetActiveHealthChecks(const bool bActive)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   m_bActiveHealthChecks = bActive;
+}
+
+/**
+ * @brief records the result of a health check
+ *
+ * A successful probe readmits an endpoint whose ejection time elapsed. Failed
+ * probes eject an endpoint after usMaxProbeFailures in a row, and eject again,
+ * for twice as long, an endpoint whose ejection time elapsed.
+ *
+ * @param [in] strEndpoint base URL of the endpoint
+ * @param [in] bHealthy result of the probe
+ */
+void CppHTTPLoadBalancer::ReportProbe(const std::string &strEndpoint, const bool bHealthy)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   auto itEndpoint = m_mapEndpoints.find(strEndpoint);
+   if (itEndpoint == m_mapEndpoints.end())
+      return;
+
+   Endpoint &oEndpoint = itEndpoint->second;
+   auto tpNow = std::chrono::steady_clock::now();
+   if (bHealthy)
+   {
+      oEndpoint.usProbeFailures = 0;
+      if (oEndpoint.oStats.bEjected && tpNow >= oEndpoint.tpEjectedUntil)
+         Readmit(oEndpoint, tpNow);
+      return;
+   }
+
+   ++oEndpoint.usProbeFailures;
+   if (oEndpoint.oStats.bEjected)
+   {
+      if (tpNow >= oEndpoint.tpEjectedUntil)
+         Eject(oEndpoint, tpNow);
+   }
+   else if (oEndpoint.usProbeFailures >= std::max<size_t>(m_oOutlier.usMaxProbeFailures, 1) && CanEject(strEndpoint))
+      Eject(oEndpoint, tpNow);
+}
+
+// INTERNALS
+
+/**
+ * @brief parses a services file
+ *
+ * @param [in] strPath path of the file
+ * @param [out] mapServices services read, by name
+ *
+ * @retval false  The file can't be read or isn't valid.
+ */
+const bool CppHTTPLoadBalancer::ReadConfig(const std::string &strPath, ServiceMap &mapServices)
+{
+   std::ifstream oFile(strPath);
+   if (!oFile)
+      return false;
+   std::stringstream ssContent;
+   ssContent << oFile.rdbuf();
+
+   rapidjson::Document oDocument;
+   if (oDocument.Parse(ssContent.str().c_str()).HasParseError() || !oDocument.IsObject())
+      return false;
+
+   for (auto itService = oDocument.MemberBegin(); itService != oDocument.MemberEnd(); ++itService)
+   {
+      const rapidjson::Value &oService = itService->value;
+      if (!oService.IsObject())
+         return false;
+
+      Strategy eStrategy = LB_ROUND_ROBIN;
+      auto itStrategy = oService.FindMember("strategy");
+      if (itStrategy != oService.MemberEnd() &&
+          (!itStrategy->value.IsString() || !ParseStrategy(itStrategy->value.GetString(), eStrategy)))
+         return false;
+
+      auto itEndpoints = oService.FindMember("endpoints");
+      if (itEndpoints == oService.MemberEnd() || !itEndpoints->value.IsArray())
+         return false;
+
+      std::vector<std::string> vecEndpoints;
+      for (auto itEndpoint = itEndpoints->value.Begin(); itEndpoint != itEndpoints->value.End(); ++itEndpoint)
+      {
+         if (!itEndpoint->IsString())
+            return false;
+         vecEndpoints.push_back(itEndpoint->GetString());
+      }
+      mapServices[itService->name.GetString()] = std::make_pair(eStrategy, vecEndpoints);
+   }
+   return true;
+}
+
+/**
+ * @brief reads the services file when it changed, the checks are spaced by m_iCheckMs
+ *
+ * @param [in] bForce read the file now, changed or not
+ *
+ * @retval false  The file couldn't be read, the services are unchanged.
+ */
+const bool CppHTTPLoadBalancer::LoadConfig(const bool bForce)
+{
+   std::string strPath;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxServices);
+      if (m_strConfigFile.empty())
+         return false;
+      if (!bForce)
+      {
+         auto tpNow = std::chrono::steady_clock::now();
+         if (m_iCheckMs <= 0 || tpNow < m_tpNextCheck)
+            return true;
+         m_tpNextCheck = tpNow + std::chrono::milliseconds(m_iCheckMs);
+      }
+      strPath = m_strConfigFile;
+   }
+
+   // the file is read without the lock, the requests keep resolving meanwhile
+   struct stat oStat;
+   if (stat(strPath.c_str(), &oStat) != 0)
+      return false;
+   const long long llMtimeNs = static_cast<long long>(oStat.st_mtim.tv_sec) * 1000000000LL + oStat.st_mtim.tv_nsec;
+   const long long llSize = static_cast<long long>(oStat.st_size);
+   if (!bForce)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxServices);
+      if (llMtimeNs == m_llConfigMtimeNs && llSize == m_llConfigSize)
+         return true;
+   }
+
+   ServiceMap mapServices;
+   if (!ReadConfig(strPath, mapServices))
+      return false;
+
+   std::lock_guard<std::mutex> oLock(m_mtxServices);
+   if (strPath != m_strConfigFile)
+      return false;
+   m_llConfigMtimeNs = llMtimeNs;
+   m_llConfigSize = llSize;
+
+   for (auto itService = m_mapServices.begin(); itService != m_mapServices.end();)
+   {
+      if (mapServices.find(itService->first) == mapServices.end())
+         itService = m_mapServices.erase(itService);
+      else
+         ++itService;
+   }
+   for (const auto &prService : mapServices)
+      SetServiceLocked(prService.first, prService.second.second, prService.second.first);
+   PruneEndpoints();
+   return true;
+}
+
+/**
+ * @brief adds or replaces a service, m_mtxServices must be held
+ */
+void CppHTTPLoadBalancer::SetServiceLocked(const std::string &strService, const std::vector<std::string> &vecEndpoints,
+                                           const Strategy eStrategy)
+{
+   Service &oService = m_mapServices[strService];
+   oService.eStrategy = eStrategy;
+   oService.vecEndpoints.clear();
+   for (const auto &strEndpoint : vecEndpoints)
+   {
+      std::string strBase = TrimEndpoint(strEndpoint);
+      if (strBase.empty() ||
+          std::find(oService.vecEndpoints.begin(), oService.vecEndpoints.end(), strBase) != oService.vecEndpoints.end())
+         continue;
+
+      oService.vecEndpoints.push_back(strBase);
+      m_mapEndpoints[strBase]; // the statistics of a known endpoint are kept
+   }
+}
+
+/**
+ * @brief forgets the idle endpoints no service lists anymore, m_mtxServices must be held
+ */
+void CppHTTPLoadBalancer::PruneEndpoints()
+{
+   for (auto itEndpoint = m_mapEndpoints.begin(); itEndpoint != m_mapEndpoints.end();)
+   {
+      bool bListed = itEndpoint->second.oStats.usOutstanding > 0;
+      for (auto itService = m_mapServices.cbegin(); !bListed && itService != m_mapServices.cend(); ++itService)
+         bListed = std::find(itService->second.vecEndpoints.cbegin(), itService->second.vecEndpoints.cend(),
+                             itEndpoint->first) != itService->second.vecEndpoints.cend();
+
+      if (bListed)
+         ++itEndpoint;
+      else
+         itEndpoint = m_mapEndpoints.erase(itEndpoint);
+   }
+}
+
+/**
+ * @brief returns the load of an endpoint, lower is better, m_mtxServices must be held
+ *
+ * @param [in] oEndpoint endpoint
+ * @param [in] eStrategy strategy of the service
+ * @param [in] dDefaultMs latency of an endpoint not measured yet (LB_EWMA)
+ */
+const double CppHTTPLoadBalancer::GetLoad(const Endpoint &oEndpoint, const Strategy eStrategy,
+                                          const double dDefaultMs) const
+{
+   const EndpointStats &oStats = oEndpoint.oStats;
+   if (eStrategy != LB_EWMA)
+      return static_cast<double>(oStats.usOutstanding);
+
+   // the floor keeps the outstanding requests in the balance of the fastest endpoints
+   double dLatencyMs = (oStats.ullRequests > 0) ? oStats.dEwmaMs : dDefaultMs;
+   return std::max(dLatencyMs, 0.001) * (oStats.usOutstanding + 1);
+}
+
+/**
+ * @brief tells whether an endpoint receives requests, m_mtxServices must be held
+ *
+ * An endpoint whose ejection time elapsed is readmitted here, unless the health
+ * checks readmit it.
+ */
+const bool CppHTTPLoadBalancer::IsAdmitted(Endpoint &oEndpoint, const TimePoint &tpNow)
+{
+   if (!oEndpoint.oStats.bEjected)
+      return true;
+   if (m_bActiveHealthChecks || tpNow < oEndpoint.tpEjectedUntil)
+      return false;
+
+   Readmit(oEndpoint, tpNow);
+   return true;
+}
+
+/**
+ * @brief tells whether the error rate or the latency of an endpoint stands out, m_mtxServices must be held
+ */
+const bool CppHTTPLoadBalancer::IsOutlier(const std::string &strEndpoint, const Endpoint &oEndpoint) const
+{
+   const EndpointStats &oStats = oEndpoint.oStats;
+   if (oStats.dErrorPercent >= m_oOutlier.dMaxErrorPercent)
+      return true;
+   if (m_oOutlier.dLatencyFactor <= 0.)
+      return false;
+
+   // median latency of the other admitted endpoints of its services
+   std::vector<double> vecPeers;
+   std::vector<const std::string *> vecSeen;
+   for (const auto &prService : m_mapServices)
+   {
+      const std::vector<std::string> &vecEndpoints = prService.second.vecEndpoints;
+      if (std::find(vecEndpoints.cbegin(), vecEndpoints.cend(), strEndpoint) == vecEndpoints.cend())
+         continue;
+
+      for (const auto &strPeer : vecEndpoints)
+      {
+         if (strPeer == strEndpoint ||
+             std::find_if(vecSeen.cbegin(), vecSeen.cend(),
+                          [&strPeer](const std::string *pstrSeen) { return *pstrSeen == strPeer; }) != vecSeen.cend())
+            continue;
+         vecSeen.push_back(&strPeer);
+
+         auto itPeer = m_mapEndpoints.find(strPeer);
+         if (itPeer != m_mapEndpoints.end() && !itPeer->second.oStats.bEjected && itPeer->second.oStats.ullRequests > 0)
+            vecPeers.push_back(itPeer->second.oStats.dEwmaMs);
+      }
+   }
+   if (vecPeers.empty())
+      return false;
+
+   auto itMedian = vecPeers.begin() + vecPeers.size() / 2;
+   std::nth_element(vecPeers.begin(), itMedian, vecPeers.end());
+   return oStats.dEwmaMs > m_oOutlier.dLatencyFactor * *itMedian;
+}
+
+/**
+ * @brief tells whether ejecting an endpoint keeps enough endpoints in its services, m_mtxServices must be held
+ */
+const bool CppHTTPLoadBalancer::CanEject(const std::string &strEndpoint) const
+{
+   for (const auto &prService : m_mapServices)
+   {
+      const std::vector<std::string> &vecEndpoints = prService.second.vecEndpoints;
+      if (std::find(vecEndpoints.cbegin(), vecEndpoints.cend(), strEndpoint) == vecEndpoints.cend())
+         continue;
+
+      size_t usEjected = 0;
+      for (const auto &strPeer : vecEndpoints)
+      {
+         auto itPeer = m_mapEndpoints.find(strPeer);
+         if (itPeer != m_mapEndpoints.end() && itPeer->second.oStats.bEjected)
+            ++usEjected;
+      }
+      if ((usEjected + 1) * 100. > m_oOutlier.dMaxEjectedPercent * vecEndpoints.size())
+         return false;
+   }
+   return true;
+}
+
+/**
+ * @brief takes an endpoint out of its services, m_mtxServices must be held
+ */
+void CppHTTPLoadBalancer::Eject(Endpoint &oEndpoint, const TimePoint &tpNow)
+{
+   EndpointStats &oStats = oEndpoint.oStats;
+   oStats.bEjected = true;
+   ++oStats.uEjections;
+   ++oStats.ullEjections;
+
+   long long llEjectionMs = static_cast<long long>(std::max(m_oOutlier.iBaseEjectionMs, 0))
+                            << std::min(oStats.uEjections - 1, 20u);
+   llEjectionMs = std::min(llEjectionMs, static_cast<long long>(std::max(m_oOutlier.iMaxEjectionMs, 0)));
+   oEndpoint.tpEjectedUntil = tpNow + std::chrono::milliseconds(llEjectionMs);
+   oEndpoint.usProbeFailures = 0;
+}
+
+/**
+ * @brief brings an ejected endpoint back, judged again from scratch, m_mtxServices must be held
+ */
+void CppHTTPLoadBalancer::Readmit(Endpoint &oEndpoint, const TimePoint &tpNow)
+{
+   oEndpoint.oStats.bEjected = false;
+   oEndpoint.oStats.dErrorPercent = 0.;
+   oEndpoint.tpAdmitted = tpNow;
+   oEndpoint.usAdmittedRequests = 0;
+   oEndpoint.usProbeFailures = 0;
+}
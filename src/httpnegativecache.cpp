@@ -0,0 +1,137 @@
+#include "httpnegativecache.h"
+
+#include <algorithm>
+
+/**
+ * @brief constructor of the negative cache
+ *
+ * @param [in] oPolicy TTLs of the failures
+ */
+CppHTTPNegativeCache::CppHTTPNegativeCache(const Policy &oPolicy /* = Policy() */)
+    : m_oPolicy(oPolicy),
+      m_oRandom(std::random_device()())
+{
+}
+
+/**
+ * @brief looks an origin up before sending a request to it
+ *
+ * @param [in] strHost origin of the request
+ * @param [out] eCached cached failure of the origin
+ *
+ * @retval true   The origin is known unreachable, the request must fail with eCached.
+ * @retval false  The request may be sent, it may be the re-probe of the origin.
+ */
+const bool CppHTTPNegativeCache::Check(const std::string &strHost, CURLcode &eCached)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   if (m_mapHosts.empty())
+      return false;
+
+   auto itHost = m_mapHosts.find(strHost);
+   if (itHost == m_mapHosts.end())
+      return false;
+
+   TimePoint tpNow = std::chrono::steady_clock::now();
+   Entry &oEntry = itHost->second;
+   if (oEntry.tpExpiry <= tpNow)
+   {
+      // this request re-probes, the next one waits for another TTL if it never reports
+      oEntry.tpExpiry = NextExpiry(oEntry.eResult, tpNow);
+      ++m_oStats.ullProbes;
+      return false;
+   }
+
+   eCached = oEntry.eResult;
+   ++m_oStats.ullHits;
+   return true;
+}
+
+/**
+ * @brief caches or forgets the failure of an origin
+ *
+ * @param [in] strHost origin of the request
+ * @param [in] eResult result of the transfer, the cancelled ones should not be reported
+ */
+void CppHTTPNegativeCache::OnResult(const std::string &strHost, const CURLcode eResult)
+{
+   const bool bNegative = IsNegative(eResult);
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   if (!bNegative)
+   {
+      if (!m_mapHosts.empty())
+         m_mapHosts.erase(strHost);
+      return;
+   }
+
+   TimePoint tpNow = std::chrono::steady_clock::now();
+   auto itHost = m_mapHosts.find(strHost);
+   if (itHost == m_mapHosts.end())
+   {
+      if (m_mapHosts.size() >= m_oPolicy.usMaxHosts)
+      {
+         for (auto it = m_mapHosts.begin(); it != m_mapHosts.end();)
+            it = (it->second.tpExpiry <= tpNow) ? m_mapHosts.erase(it) : std::next(it);
+         if (m_mapHosts.size() >= m_oPolicy.usMaxHosts)
+            return;
+      }
+      itHost = m_mapHosts.emplace(strHost, Entry()).first;
+   }
+
+   itHost->second.eResult = eResult;
+   itHost->second.tpExpiry = NextExpiry(eResult, tpNow);
+   ++m_oStats.ullCached;
+}
+
+/**
+ * @brief tells whether the requests to an origin currently fail fast
+ */
+const bool CppHTTPNegativeCache::IsCached(const std::string &strHost) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   auto itHost = m_mapHosts.find(strHost);
+   return itHost != m_mapHosts.end() && itHost->second.tpExpiry > std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief forgets every origin, after a configuration change for instance
+ */
+void CppHTTPNegativeCache::Clear()
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   m_mapHosts.clear();
+}
+
+const CppHTTPNegativeCache::Stats CppHTTPNegativeCache::GetStats() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxHosts);
+   Stats oStats = m_oStats;
+   oStats.usHosts = m_mapHosts.size();
+   return oStats;
+}
+
+/**
+ * @brief tells whether a transfer result is cached
+ *
+ * @param [in] eResult result of a transfer
+ *
+ * @retval true   Name resolution failure or refused connection.
+ */
+const bool CppHTTPNegativeCache::IsNegative(const CURLcode eResult)
+{
+   return eResult == CURLE_COULDNT_RESOLVE_HOST || eResult == CURLE_COULDNT_CONNECT;
+}
+
+// INTERNALS
+
+/**
+ * @brief returns the jittered end of the TTL of a failure, m_mtxHosts must be held
+ */
+const CppHTTPNegativeCache::TimePoint CppHTTPNegativeCache::NextExpiry(const CURLcode eResult, const TimePoint &tpNow)
+{
+   const double dTtlMs = std::max((eResult == CURLE_COULDNT_RESOLVE_HOST) ? m_oPolicy.iDnsTtlMs : m_oPolicy.iConnectTtlMs, 0);
+   const double dJitter = std::min(std::max(m_oPolicy.dJitter, 0.), 1.);
+   const double dFactor = std::uniform_real_distribution<double>(1. - dJitter, 1. + dJitter)(m_oRandom);
+
+   return tpNow + std::chrono::microseconds(static_cast<long long>(dTtlMs * dFactor * 1000.));
+}
@@ -0,0 +1,243 @@
+#include "httpratelimiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+CppHTTPRateLimiter::CppHTTPRateLimiter() : m_tpEpoch(std::chrono::steady_clock::now())
+{
+}
+
+/**
+ * @brief adds the rate limit of the URLs starting with a prefix
+ *
+ * @param [in] strPrefix origin ("https://host") or URL prefix, replaces the rule of the same prefix
+ * @param [in] oRule rate, burst and longest delay of the requests
+ *
+ * @retval true   The rule was added.
+ * @retval false  Empty prefix or rate not positive.
+ */
+const bool CppHTTPRateLimiter::AddRule(const std::string &strPrefix, const Rule &oRule)
+{
+   if (strPrefix.empty() || !(oRule.dRatePerSecond > 0.))
+      return false;
+
+   std::unique_ptr<Bucket> pBucket(new Bucket);
+   pBucket->strPrefix = strPrefix;
+   pBucket->llIntervalNs = std::max(static_cast<long long>(std::llround(1e9 / oRule.dRatePerSecond)), 1LL);
+   pBucket->llBurstNs = pBucket->llIntervalNs * static_cast<long long>(std::max<size_t>(oRule.usBurst, 1));
+   pBucket->llMaxDelayNs = static_cast<long long>(std::max(oRule.iMaxDelayMs, 0)) * 1000000LL;
+
+   auto itSame = std::find_if(m_vecBuckets.begin(), m_vecBuckets.end(),
+                              [&strPrefix](const std::unique_ptr<Bucket> &pOther) { return pOther->strPrefix == strPrefix; });
+   if (itSame != m_vecBuckets.end())
+      m_vecBuckets.erase(itSame);
+
+   // the longest prefix is tried first
+   auto itPos = std::find_if(m_vecBuckets.begin(), m_vecBuckets.end(), [&strPrefix](const std::unique_ptr<Bucket> &pOther) {
+      return pOther->strPrefix.size() < strPrefix.size();
+   });
+   m_vecBuckets.insert(itPos, std::move(pBucket));
+
+   m_mapOrigins.clear();
+   for (const auto &pOther : m_vecBuckets)
+   {
+      size_t usLength = 0;
+      m_mapOrigins[HashOrigin(pOther->strPrefix, usLength)].push_back(pOther.get());
+   }
+   return true;
+}
+
+/**
+ * @brief takes a token of the bucket of a URL, without waiting
+ *
+ * @param [in] strUrl URL of the request
+ *
+ * @retval true   The request may be sent now, or the URL has no rule.
+ * @retval false  The bucket is empty, the request must not be sent.
+ */
+const bool CppHTTPRateLimiter::TryAcquire(const std::string &strUrl)
+{
+   Bucket *pBucket = Find(strUrl);
+   if (pBucket == nullptr)
+      return true;
+
+   const long long llNowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_tpEpoch).count();
+   long long llDelayNs = 0;
+   return Take(*pBucket, llNowNs, 0, llDelayNs);
+}
+
+/**
+ * @brief reserves the next token of the bucket of a URL
+ *
+ * @param [in] strUrl URL of the request
+ * @param [out] tpReady time the request may be sent, TimePoint() when the URL has no rule
+ *
+ * @retval true   The token is reserved, the request must wait until tpReady.
+ * @retval false  The token would come after the longest delay of the rule, nothing is reserved.
+ */
+const bool CppHTTPRateLimiter::Reserve(const std::string &strUrl, TimePoint &tpReady)
+{
+   tpReady = TimePoint();
+   Bucket *pBucket = Find(strUrl);
+   if (pBucket == nullptr)
+      return true;
+
+   const TimePoint tpNow = std::chrono::steady_clock::now();
+   const long long llNowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tpNow - m_tpEpoch).count();
+   long long llDelayNs = 0;
+   if (!Take(*pBucket, llNowNs, pBucket->llMaxDelayNs, llDelayNs))
+      return false;
+
+   tpReady = tpNow + std::chrono::duration_cast<TimePoint::duration>(std::chrono::nanoseconds(llDelayNs));
+   return true;
+}
+
+/**
+ * @brief gives back a token reserved for a request that won't be sent
+ *
+ * Moves the TAT one interval back, never before the current time: a bucket
+ * refilled in the meantime has nothing to take back. The requests already
+ * delayed keep their time, the token goes to the next one.
+ *
+ * @param [in] strUrl URL the token was reserved for
+ */
+void CppHTTPRateLimiter::Refund(const std::string &strUrl)
+{
+   Bucket *pBucket = Find(strUrl);
+   if (pBucket == nullptr)
+      return;
+
+   const long long llNowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_tpEpoch).count();
+   long long llTat = pBucket->llTat.load(std::memory_order_relaxed);
+   while (llTat > llNowNs)
+   {
+      // on failure llTat is reloaded
+      if (pBucket->llTat.compare_exchange_weak(llTat, std::max(llTat - pBucket->llIntervalNs, llNowNs), std::memory_order_relaxed))
+         break;
+   }
+   pBucket->ullRefunded.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief returns the counters of the rule of a prefix, zeros for an unknown prefix
+ */
+const CppHTTPRateLimiter::RuleStats CppHTTPRateLimiter::GetStats(const std::string &strPrefix) const
+{
+   RuleStats oStats;
+   for (const auto &pBucket : m_vecBuckets)
+   {
+      if (pBucket->strPrefix != strPrefix)
+         continue;
+
+      oStats.ullAdmitted = pBucket->ullAdmitted.load(std::memory_order_relaxed);
+      oStats.ullDelayed = pBucket->ullDelayed.load(std::memory_order_relaxed);
+      oStats.ullRejected = pBucket->ullRejected.load(std::memory_order_relaxed);
+      oStats.ullRefunded = pBucket->ullRefunded.load(std::memory_order_relaxed);
+      oStats.ullDelayUs = pBucket->ullDelayUs.load(std::memory_order_relaxed);
+      break;
+   }
+   return oStats;
+}
+
+// INTERNALS
+
+/**
+ * @brief FNV-1a hash of the origin of a URL, up to the first '/', '?' or '#' after the scheme
+ *
+ * @param [in] strUrl URL or prefix
+ * @param [out] usLength length of the origin
+ */
+const unsigned long long CppHTTPRateLimiter::HashOrigin(const std::string &strUrl, size_t &usLength)
+{
+   // a single pass, the lookup is on the path of every request
+   unsigned long long ullHash = 14695981039346656037ULL;
+   bool bAuthority = false;
+   for (usLength = 0; usLength < strUrl.size(); ++usLength)
+   {
+      const char c = strUrl[usLength];
+      if (!bAuthority && c == ':' && strUrl.compare(usLength, 3, "://") == 0)
+      {
+         // the slashes of the scheme separator are part of the origin
+         bAuthority = true;
+         ullHash = ((((ullHash ^ ':') * 1099511628211ULL) ^ '/') * 1099511628211ULL ^ '/') * 1099511628211ULL;
+         usLength += 2;
+         continue;
+      }
+      if (c == '/' || c == '?' || c == '#')
+         break;
+
+      ullHash ^= static_cast<unsigned char>(c);
+      ullHash *= 1099511628211ULL;
+   }
+   return ullHash;
+}
+
+/**
+ * @brief returns the bucket of the longest prefix of a URL, nullptr for none
+ *
+ * A prefix ends at a '/', '?' or '#' of the URL, or with it:
+ * "https://api.example.com" doesn't match "https://api.example.community".
+ * Only the prefixes of the same origin are compared, whatever the number of rules.
+ */
+CppHTTPRateLimiter::Bucket *CppHTTPRateLimiter::Find(const std::string &strUrl) const
+{
+   if (m_mapOrigins.empty())
+      return nullptr;
+
+   size_t usLength = 0;
+   auto itOrigin = m_mapOrigins.find(HashOrigin(strUrl, usLength));
+   if (itOrigin == m_mapOrigins.end())
+      return nullptr;
+
+   for (Bucket *pBucket : itOrigin->second)
+   {
+      const std::string &strPrefix = pBucket->strPrefix;
+      if (strUrl.compare(0, strPrefix.size(), strPrefix) != 0)
+         continue;
+      if (strUrl.size() == strPrefix.size() || strPrefix.back() == '/' ||
+          strUrl[strPrefix.size()] == '/' || strUrl[strPrefix.size()] == '?' || strUrl[strPrefix.size()] == '#')
+         return pBucket;
+   }
+   return nullptr;
+}
+
+/**
+ * @brief GCRA: takes the next token of a bucket if it comes within a delay
+ *
+ * The theoretical arrival time (TAT) is the time the bucket would be full again.
+ * A request moves it one interval forward, and may be sent once the TAT is less
+ * than a burst ahead of the clock.
+ *
+ * @param [in] oBucket bucket of the request
+ * @param [in] llNowNs current time, since m_tpEpoch
+ * @param [in] llMaxDelayNs longest wait accepted for the token, 0 for none
+ * @param [out] llDelayNs wait before the token is available
+ *
+ * @retval false  The token comes after llMaxDelayNs, the TAT is unchanged.
+ */
+const bool CppHTTPRateLimiter::Take(Bucket &oBucket, const long long llNowNs, const long long llMaxDelayNs,
+                                    long long &llDelayNs)
+{
+   long long llTat = oBucket.llTat.load(std::memory_order_relaxed);
+   for (;;)
+   {
+      const long long llNewTat = std::max(llTat, llNowNs) + oBucket.llIntervalNs;
+      llDelayNs = std::max(llNewTat - oBucket.llBurstNs - llNowNs, 0LL);
+      if (llDelayNs > llMaxDelayNs)
+      {
+         oBucket.ullRejected.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+      // on failure llTat is reloaded, the token is computed again
+      if (oBucket.llTat.compare_exchange_weak(llTat, llNewTat, std::memory_order_relaxed))
+         break;
+   }
+
+   oBucket.ullAdmitted.fetch_add(1, std::memory_order_relaxed);
+   if (llDelayNs > 0)
+   {
+      oBucket.ullDelayed.fetch_add(1, std::memory_order_relaxed);
+      oBucket.ullDelayUs.fetch_add(static_cast<unsigned long long>(llDelayNs / 1000), std::memory_order_relaxed);
+   }
+   return true;
+}
@@ -0,0 +1,99 @@
+#include "httpretrybudget.h"
+
+#include <algorithm>
+
+/**
+ * @brief constructor of the retry budget
+ *
+ * @param [in] dRetryPercent retries allowed, in percent of the requests
+ * @param [in] dMinRetriesPerSec retries allowed per second and per origin whatever the traffic
+ */
+CppHTTPRetryBudget::CppHTTPRetryBudget(const double dRetryPercent /* = 10. */,
+                                       const double dMinRetriesPerSec /* = 1. */)
+    : m_dRetryRatio(std::max(dRetryPercent, 0.) / 100.),
+      m_dMinRetriesPerSec(std::max(dMinRetriesPerSec, 0.)),
+      m_dMaxTokens(std::max(std::max(dRetryPercent, 0.) + std::max(dMinRetriesPerSec, 0.), 1.))
+{
+}
+
+/**
+ * @brief earns the share of a retry of a request
+ *
+ * @param [in] strHost origin of the request
+ */
+void CppHTTPRetryBudget::Deposit(const std::string &strHost)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBuckets);
+   Bucket &oBucket = Refill(strHost);
+   oBucket.dTokens = std::min(oBucket.dTokens + m_dRetryRatio, m_dMaxTokens);
+   ++m_oStats.ullRequests;
+}
+
+/**
+ * @brief spends a retry
+ *
+ * @param [in] strHost origin of the request
+ *
+ * @retval true   The retry is allowed.
+ * @retval false  The budget of the origin is spent.
+ */
+const bool CppHTTPRetryBudget::TryWithdraw(const std::string &strHost)
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBuckets);
+   Bucket &oBucket = Refill(strHost);
+   if (oBucket.dTokens < 1.)
+   {
+      ++m_oStats.ullDenied;
+      return false;
+   }
+
+   oBucket.dTokens -= 1.;
+   ++m_oStats.ullRetries;
+   return true;
+}
+
+/**
+ * @brief returns the retries left to an origin
+ */
+const double CppHTTPRetryBudget::GetTokens(const std::string &strHost) const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBuckets);
+   auto itBucket = m_mapBuckets.find(strHost);
+   return (itBucket == m_mapBuckets.end()) ? 0. : itBucket->second.dTokens;
+}
+
+/**
+ * @brief returns the budget statistics, all origins included
+ */
+const CppHTTPRetryBudget::Stats CppHTTPRetryBudget::GetStats() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxBuckets);
+   return m_oStats;
+}
+
+/**
+ * @brief adds the time based tokens to the bucket of an origin, m_mtxBuckets must be held
+ *
+ * @param [in] strHost origin
+ *
+ * @retval bucket of the origin, created on first use
+ */
+CppHTTPRetryBudget::Bucket &CppHTTPRetryBudget::Refill(const std::string &strHost)
+{
+   auto tpNow = std::chrono::steady_clock::now();
+   auto itBucket = m_mapBuckets.find(strHost);
+   if (itBucket == m_mapBuckets.end())
+   {
+      // a new origin starts with the retries of one second
+      Bucket &oBucket = m_mapBuckets[strHost];
+      oBucket.dTokens = std::min(m_dMinRetriesPerSec, m_dMaxTokens);
+      oBucket.tpRefill = tpNow;
+      return oBucket;
+   }
+
+   Bucket &oBucket = itBucket->second;
+   double dElapsedSec = std::chrono::duration<double>(tpNow - oBucket.tpRefill).count();
+   oBucket.dTokens = std::min(oBucket.dTokens + dElapsedSec * m_dMinRetriesPerSec, m_dMaxTokens);
+   oBucket.tpRefill = tpNow;
+   return oBucket;
+}
@@ -0,0 +1,132 @@
+#include "httpsingleflight.h"
+
+namespace
+{
+std::string ToLower(std::string str)
+{
+   std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+   return str;
+}
+} // namespace
+
+/**
+ * @brief constructor of the request coalescing layer
+ *
+ * @param [in] vecKeyHeaders names of the headers distinguishing the requests, all of them if empty
+ */
+CppHTTPSingleFlight::CppHTTPSingleFlight(const std::vector<std::string> &vecKeyHeaders /* = {} */)
+{
+   for (const auto &strName : vecKeyHeaders)
+      m_vecKeyHeaders.push_back(ToLower(strName));
+   std::sort(m_vecKeyHeaders.begin(), m_vecKeyHeaders.end());
+   m_vecKeyHeaders.erase(std::unique(m_vecKeyHeaders.begin(), m_vecKeyHeaders.end()), m_vecKeyHeaders.end());
+}
+
+/**
+ * @brief builds the key of a request
+ *
+ * @param [in] strMethod HTTP method
+ * @param [in] strUrl url to request
+ * @param [in] Headers headers to send
+ *
+ * @retval key, equal for the requests sharing a response
+ */
+const std::string CppHTTPSingleFlight::MakeKey(const std::string &strMethod, const std::string &strUrl,
+                                               const HeadersMap &Headers) const
+{
+   // the header names are compared case-insensitively, and sorted as HeadersMap is unordered
+   std::map<std::string, std::string> mapKeyHeaders;
+   for (const auto &Header : Headers)
+   {
+      std::string strName = ToLower(Header.first);
+      if (m_vecKeyHeaders.empty() ||
+          std::binary_search(m_vecKeyHeaders.begin(), m_vecKeyHeaders.end(), strName))
+         mapKeyHeaders[strName] = Header.second;
+   }
+
+   std::string strKey = strMethod + ' ' + strUrl;
+   for (const auto &Header : mapKeyHeaders)
+   {
+      strKey += '\n';
+      strKey += Header.first;
+      strKey += ": ";
+      strKey += Header.second;
+   }
+   return strKey;
+}
+
+/**
+ * @brief performs a request unless the same one is in flight
+ *
+ * The waiters are not cancellable: they get the response of the caller performing the request.
+ *
+ * @param [in] strKey key of the request, see MakeKey()
+ * @param [in] oFetch performs the request, called by the first caller of the key only
+ * @param [out] pResponse response, shared by all the callers of the same request
+ *
+ * @retval true   Successfully requested the URI.
+ * @retval false  Encountered a problem.
+ */
+const bool CppHTTPSingleFlight::Do(const std::string &strKey, FetchFnCallback oFetch, SharedResponse &pResponse)
+{
+   std::shared_future<Result> oFlight;
+   std::promise<Result> oPromise;
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxFlights);
+      ++m_oStats.ullRequests;
+
+      auto itFlight = m_mapFlights.find(strKey);
+      if (itFlight != m_mapFlights.end())
+      {
+         ++m_oStats.ullCoalesced;
+         oFlight = itFlight->second;
+      }
+      else
+      {
+         ++m_oStats.ullTransfers;
+         m_mapFlights.emplace(strKey, oPromise.get_future().share());
+      }
+   }
+
+   if (oFlight.valid())
+   {
+      const Result &oResult = oFlight.get();
+      pResponse = oResult.second;
+      return oResult.first;
+   }
+
+   HttpResponse oResponse;
+   bool bSuccess = false;
+   try
+   {
+      bSuccess = oFetch(oResponse);
+   }
+   catch (...)
+   {
+      std::lock_guard<std::mutex> oLock(m_mtxFlights);
+      m_mapFlights.erase(strKey);
+      oPromise.set_exception(std::current_exception());
+      throw;
+   }
+   pResponse = std::make_shared<const HttpResponse>(std::move(oResponse));
+
+   {
+      // the callers arriving from now on perform a new request
+      std::lock_guard<std::mutex> oLock(m_mtxFlights);
+      m_mapFlights.erase(strKey);
+   }
+   oPromise.set_value(Result(bSuccess, pResponse));
+
+   return bSuccess;
+}
+
+/**
+ * @brief returns the coalescing statistics
+ */
+const CppHTTPSingleFlight::Stats CppHTTPSingleFlight::GetStats() const
+{
+   std::lock_guard<std::mutex> oLock(m_mtxFlights);
+   Stats oStats = m_oStats;
+   oStats.usInFlight = m_mapFlights.size();
+   return oStats;
+}
@@ -1,13 +1,40 @@
 #include "gtest/gtest.h" // Google Test Framework
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
 #include <mutex>
+#include <set>
 #include <thread>
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "stringbuffer.h"
 #include "writer.h"
 #include "document.h"     // rapidjson's DOM-style API
 #include "prettywriter.h" // for stringify JSON
 #include "httpclient.h"
+#include "httpasyncclient.h"
+#include "httpbackgroundsender.h"
+#include "httpbatchproducer.h"
+#include "httpcanceltoken.h"
+#include "httpcompletionqueue.h"
+#include "httpconcurrencylimiter.h"
+#include "httpnegativecache.h"
+#include "httpauthprovider.h"
+#include "httpratelimiter.h"
+#include "httpretrybudget.h"
+#include "httpcircuitbreaker.h"
+#include "httploadbalancer.h"
+#include "httphedgedclient.h"
+#include "httphealthchecker.h"
+#include "httpsingleflight.h"
 #include "restwrapper.h"
 
 #define PRINT_LOG [](const std::string &strLogMsg) { std::cout << strLogMsg << std::endl; }
@@ -76,6 +103,132 @@ protected:
    }
 };
 
+// Fixture for asynchronous REST tests
+class AsyncClientTest : public ::testing::Test
+{
+protected:
+   std::unique_ptr<CppHTTPAsyncClient> m_pAsyncClient;
+   CppHTTPClient::HeadersMap m_mapHeader;
+
+   AsyncClientTest() : m_pAsyncClient(nullptr)
+   {
+      m_mapHeader.emplace("User-Agent", CLIENT_USERAGENT);
+   }
+
+   virtual ~AsyncClientTest() {}
+
+   virtual void SetUp()
+   {
+      m_pAsyncClient.reset(new CppHTTPAsyncClient(PRINT_LOG));
+
+      m_pAsyncClient->InitSession();
+   }
+
+   virtual void TearDown()
+   {
+      m_pAsyncClient->CleanupSession();
+      m_pAsyncClient.reset();
+   }
+
+   // drives the built-in event loop until every request is completed
+   void RunLoop()
+   {
+      while (m_pAsyncClient->Poll(100) > 0)
+      {
+      }
+   }
+};
+
+/* HTTP/1.1 server on a free port of the loopback, for the answers httpbin can't give.
+ * The handler receives the request head (request line and headers), followed by
+ * "\r\n\r\n" and the body if any, and returns the raw response, see Reply().
+ * One request per connection. */
+class StubServer
+{
+public:
+   typedef std::function<std::string(const std::string &)> HandlerFn;
+
+   explicit StubServer(HandlerFn oHandler) : m_oHandler(oHandler), m_iSocket(-1), m_usPort(0)
+   {
+      m_iSocket = socket(AF_INET, SOCK_STREAM, 0);
+      int iReuse = 1;
+      setsockopt(m_iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+      sockaddr_in oAddr = {};
+      oAddr.sin_family = AF_INET;
+      oAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      socklen_t iLength = sizeof(oAddr);
+      if (bind(m_iSocket, reinterpret_cast<sockaddr *>(&oAddr), sizeof(oAddr)) == 0 && listen(m_iSocket, 64) == 0 &&
+          getsockname(m_iSocket, reinterpret_cast<sockaddr *>(&oAddr), &iLength) == 0)
+         m_usPort = ntohs(oAddr.sin_port);
+      m_oThread = std::thread([this]() { Serve(); });
+   }
+
+   ~StubServer()
+   {
+      // wakes accept() up
+      shutdown(m_iSocket, SHUT_RDWR);
+      m_oThread.join();
+      close(m_iSocket);
+   }
+
+   std::string Url(const std::string &strPath) const
+   {
+      return "http://127.0.0.1:" + std::to_string(m_usPort) + strPath;
+   }
+   std::string Origin() const { return "http://127.0.0.1:" + std::to_string(m_usPort); }
+
+   static std::string Reply(const int iCode, const std::string &strHeaders = std::string(),
+                            const std::string &strBody = std::string())
+   {
+      return "HTTP/1.1 " + std::to_string(iCode) + " Stub\r\nContent-Length: " + std::to_string(strBody.size()) +
+             "\r\nConnection: close\r\n" + strHeaders + "\r\n" + strBody;
+   }
+
+private:
+   void Serve()
+   {
+      for (;;)
+      {
+         int iClient = accept(m_iSocket, nullptr, nullptr);
+         if (iClient < 0)
+            return;
+
+         std::string strRequest;
+         char szBuffer[4096];
+         ssize_t lRead = 0;
+         while (strRequest.find("\r\n\r\n") == std::string::npos && (lRead = read(iClient, szBuffer, sizeof(szBuffer))) > 0)
+            strRequest.append(szBuffer, static_cast<size_t>(lRead));
+
+         // the body is read, an unread one would reset the connection at close()
+         size_t usHeadEnd = strRequest.find("\r\n\r\n");
+         std::string strHead = strRequest.substr(0, usHeadEnd);
+         std::string strLowerHead = strHead;
+         std::transform(strLowerHead.begin(), strLowerHead.end(), strLowerHead.begin(), ::tolower);
+         size_t usLength = strLowerHead.find("\r\ncontent-length:");
+         size_t usBodySize = (usLength == std::string::npos) ? 0 : std::stoul(strHead.substr(usLength + 17));
+         while (usHeadEnd != std::string::npos && strRequest.size() < usHeadEnd + 4 + usBodySize &&
+                (lRead = read(iClient, szBuffer, sizeof(szBuffer))) > 0)
+            strRequest.append(szBuffer, static_cast<size_t>(lRead));
+
+         std::string strResponse = m_oHandler((usBodySize == 0) ? strHead : strRequest);
+         size_t usSent = 0;
+         while (usSent < strResponse.size())
+         {
+            ssize_t lWritten = write(iClient, strResponse.data() + usSent, strResponse.size() - usSent);
+            if (lWritten <= 0)
+               break;
+            usSent += static_cast<size_t>(lWritten);
+         }
+         close(iClient);
+      }
+   }
+
+   HandlerFn m_oHandler;
+   int m_iSocket;
+   unsigned short m_usPort;
+   std::thread m_oThread;
+};
+
 class RestWrapperTest : public ::testing::Test
 {
 protected:
@@ -216,6 +369,246 @@ TEST(HTTPClient, TestMultithreading)
    ASSERT_EQ(uInitialCount, CppHTTPClient::GetCurlSessionCount());
 }
 
+TEST(HTTPAsyncClient, TestSession)
+{
+   unsigned uInitialCount = CppHTTPClient::GetCurlSessionCount();
+   {
+      CppHTTPAsyncClient AsyncClient(PRINT_LOG);
+
+      EXPECT_EQ(uInitialCount + 1, CppHTTPClient::GetCurlSessionCount());
+      EXPECT_TRUE(AsyncClient.GetCurlMultiPointer() == nullptr);
+      EXPECT_EQ(-1, AsyncClient.Poll(0));
+      EXPECT_FALSE(AsyncClient.Get("http://httpbin.org/get", CppHTTPClient::HeadersMap(), nullptr));
+
+      ASSERT_TRUE(AsyncClient.InitSession(false, CppHTTPClient::ENABLE_LOG));
+      EXPECT_FALSE(AsyncClient.InitSession());
+      EXPECT_EQ(CppHTTPClient::ENABLE_LOG, AsyncClient.GetSettingsFlags());
+      EXPECT_TRUE(AsyncClient.GetCurlMultiPointer() != nullptr);
+      EXPECT_EQ(0u, AsyncClient.GetPendingCount());
+      EXPECT_FALSE(AsyncClient.Get("", CppHTTPClient::HeadersMap(), nullptr));
+
+      EXPECT_TRUE(AsyncClient.CleanupSession());
+      EXPECT_FALSE(AsyncClient.CleanupSession());
+   }
+   ASSERT_EQ(uInitialCount, CppHTTPClient::GetCurlSessionCount());
+}
+
+TEST(HTTPAsyncClient, TestCleanupAbortsPending)
+{
+   CppHTTPAsyncClient AsyncClient(PRINT_LOG);
+   ASSERT_TRUE(AsyncClient.InitSession());
+
+   int iCompleted = 0;
+   ASSERT_TRUE(AsyncClient.Get("http://httpbin.org/delay/1", CppHTTPClient::HeadersMap(),
+                               [&](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+                                  EXPECT_FALSE(bSuccess);
+                                  EXPECT_EQ(-1, Response.iCode);
+                                  ++iCompleted;
+                               }));
+   EXPECT_EQ(1u, AsyncClient.GetPendingCount());
+
+   EXPECT_TRUE(AsyncClient.CleanupSession());
+   EXPECT_EQ(1, iCompleted);
+}
+
+TEST(HTTPAsyncClient, TestTimers)
+{
+   CppHTTPAsyncClient AsyncClient(PRINT_LOG);
+   ASSERT_TRUE(AsyncClient.InitSession());
+
+   std::vector<int> vecFired;
+   AsyncClient.ScheduleTimer(20, [&]() { vecFired.push_back(2); });
+   AsyncClient.ScheduleTimer(5, [&]() { vecFired.push_back(1); });
+   unsigned long long ullCancelled = AsyncClient.ScheduleTimer(10, [&]() { vecFired.push_back(3); });
+   EXPECT_TRUE(AsyncClient.CancelTimer(ullCancelled));
+   EXPECT_FALSE(AsyncClient.CancelTimer(ullCancelled));
+
+   auto tpStart = std::chrono::steady_clock::now();
+   while (vecFired.size() < 2 && std::chrono::steady_clock::now() - tpStart < std::chrono::seconds(2))
+      AsyncClient.Poll(100);
+
+   ASSERT_EQ(2u, vecFired.size());
+   EXPECT_EQ(1, vecFired[0]);
+   EXPECT_EQ(2, vecFired[1]);
+   EXPECT_GE(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(20));
+
+   EXPECT_TRUE(AsyncClient.CleanupSession());
+}
+
+TEST(HTTPRequestQueue, TestPriorityAndAging)
+{
+   CppHTTPRequestQueue<int> Queue(3);
+   auto AnyHost = [](const std::string &) { return true; };
+   int iItem = -1;
+
+   Queue.Push(20, 2, "http://a:80");
+   Queue.Push(10, 1, "http://a:80");
+   Queue.Push(0, 0, "http://b:80");
+   Queue.Push(11, 1, "http://b:80");
+   EXPECT_EQ(4u, Queue.Size());
+
+   // FIFO within a class, most urgent class first
+   ASSERT_TRUE(Queue.Pop(AnyHost, iItem));
+   EXPECT_EQ(0, iItem);
+   ASSERT_TRUE(Queue.Pop(AnyHost, iItem));
+   EXPECT_EQ(10, iItem);
+
+   // a busy host doesn't block the others
+   ASSERT_TRUE(Queue.Pop([](const std::string &strHost) { return strHost != "http://b:80"; }, iItem));
+   EXPECT_EQ(20, iItem);
+   EXPECT_FALSE(Queue.Pop([](const std::string &) { return false; }, iItem));
+   ASSERT_TRUE(Queue.Pop(AnyHost, iItem));
+   EXPECT_EQ(11, iItem);
+
+   // an old low priority request overtakes a new high priority one
+   Queue.SetAgingMs(5);
+   Queue.Push(21, 2, "http://a:80");
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   Queue.Push(1, 0, "http://a:80");
+   ASSERT_TRUE(Queue.Pop(AnyHost, iItem));
+   EXPECT_EQ(21, iItem);
+
+   CppHTTPQueueStats oStats = Queue.GetStats(2);
+   EXPECT_EQ(2u, oStats.ullQueued);
+   EXPECT_EQ(2u, oStats.ullDispatched);
+   EXPECT_EQ(0u, oStats.usDepth);
+   EXPECT_GE(oStats.ullMaxWaitUs, 20000u);
+
+   EXPECT_EQ(std::vector<int>({1}), Queue.Clear());
+   EXPECT_EQ(0u, Queue.Size());
+}
+
+TEST(HTTPRequestQueue, TestTenantFairness)
+{
+   CppHTTPRequestQueue<std::string> Queue(1);
+   auto AnyHost = [](const std::string &) { return true; };
+   Queue.SetWeight("A", 3);
+   EXPECT_EQ(3u, Queue.GetWeight("A"));
+   EXPECT_EQ(1u, Queue.GetWeight("B"));
+
+   // the noisy tenant submits first and more
+   for (int i = 0; i < 8; ++i)
+      Queue.Push("A", 0, "http://a:80", "A");
+   for (int i = 0; i < 4; ++i)
+      Queue.Push("B", 0, "http://a:80", "B");
+
+   std::string strOrder;
+   std::string strItem;
+   std::string strTenant;
+   while (Queue.Pop(AnyHost, strItem, &strTenant))
+   {
+      EXPECT_EQ(strItem, strTenant);
+      strOrder += strItem;
+   }
+   EXPECT_EQ("AAABAAABAABB", strOrder);
+
+   CppHTTPQueueStats oStats = Queue.GetTenantStats("B");
+   EXPECT_EQ(4u, oStats.ullQueued);
+   EXPECT_EQ(4u, oStats.ullDispatched);
+   EXPECT_EQ(0u, oStats.usDepth);
+   EXPECT_EQ(0u, Queue.GetTenantStats("C").ullQueued);
+}
+
+TEST(HTTPRequestQueue, TestBusyHost)
+{
+   CppHTTPRequestQueue<int> Queue(1);
+   for (int i = 0; i < 1000; ++i)
+      Queue.Push(i, 0, "http://busy:80");
+   Queue.Push(1000, 0, "http://idle:80");
+   Queue.Push(1001, 0, "http://busy:80");
+   Queue.Push(1002, 0, "http://idle:80");
+
+   // the backlog of a full host costs a single check
+   size_t usChecks = 0;
+   auto IdleOnly = [&usChecks](const std::string &strHost) {
+      ++usChecks;
+      return strHost == "http://idle:80";
+   };
+   int iItem = -1;
+   ASSERT_TRUE(Queue.Pop(IdleOnly, iItem));
+   EXPECT_EQ(1000, iItem);
+   EXPECT_EQ(2u, usChecks);
+
+   // FIFO between the hosts of a tenant
+   auto AnyHost = [](const std::string &) { return true; };
+   ASSERT_TRUE(Queue.Pop(AnyHost, iItem));
+   EXPECT_EQ(0, iItem);
+   ASSERT_TRUE(Queue.PopOldest(iItem));
+   EXPECT_EQ(1, iItem);
+   std::vector<int> vecLeft = Queue.Clear();
+   ASSERT_EQ(1000u, vecLeft.size());
+   EXPECT_EQ(2, vecLeft[0]);
+   EXPECT_EQ(999, vecLeft[997]);
+   EXPECT_EQ(1001, vecLeft[998]);
+   EXPECT_EQ(1002, vecLeft[999]);
+
+   // the earliest future "not before" time, whichever request leaves
+   auto tpNow = std::chrono::steady_clock::now();
+   EXPECT_EQ(CppHTTPRequestQueue<int>::TimePoint(), Queue.NextNotBefore());
+   Queue.Push(1, 0, "http://a:80", std::string(), tpNow + std::chrono::seconds(20));
+   Queue.Push(2, 0, "http://a:80", std::string(), tpNow + std::chrono::seconds(10));
+   Queue.Push(3, 0, "http://b:80", std::string(), tpNow - std::chrono::seconds(1));
+   EXPECT_EQ(tpNow + std::chrono::seconds(10), Queue.NextNotBefore());
+   EXPECT_EQ(1u, Queue.RemoveIf([](const int &iValue) { return iValue == 2; }).size());
+   EXPECT_EQ(tpNow + std::chrono::seconds(20), Queue.NextNotBefore());
+   ASSERT_TRUE(Queue.Pop(AnyHost, iItem));
+   EXPECT_EQ(3, iItem);
+   ASSERT_TRUE(Queue.PopOldest(iItem));
+   EXPECT_EQ(CppHTTPRequestQueue<int>::TimePoint(), Queue.NextNotBefore());
+}
+
+TEST(HTTPClient, TestHostKey)
+{
+   EXPECT_EQ("http://httpbin.org:80", CppHTTPClient::GetHostKey("httpbin.org/get"));
+   EXPECT_EQ("http://httpbin.org:80", CppHTTPClient::GetHostKey("http://HTTPBIN.org:80/anything"));
+   EXPECT_EQ("https://httpbin.org:443", CppHTTPClient::GetHostKey("https://httpbin.org/get"));
+   EXPECT_EQ("http://127.0.0.1:8080", CppHTTPClient::GetHostKey("http://127.0.0.1:8080"));
+   EXPECT_TRUE(CppHTTPClient::GetHostKey("http://").empty());
+}
+
+TEST(HTTPCompletionQueue, TestRingBuffer)
+{
+   CppHTTPCompletionQueue Queue(2);
+   CppHTTPCompletionQueue::Batch vecBatch;
+
+   for (unsigned long long i = 0; i < 2; ++i)
+   {
+      vecBatch.resize(3);
+      for (auto &oCompletion : vecBatch)
+         oCompletion.oRequest.ullTag = i;
+      ASSERT_TRUE(Queue.Push(vecBatch));
+      EXPECT_TRUE(vecBatch.empty());
+   }
+
+   // full: the batch is left to the producer
+   vecBatch.resize(1);
+   EXPECT_FALSE(Queue.Push(vecBatch));
+   EXPECT_EQ(1u, vecBatch.size());
+
+   CppHTTPCompletionQueue::Batch vecCompletions;
+   ASSERT_EQ(6u, Queue.Drain(vecCompletions, 0));
+   ASSERT_EQ(6u, vecCompletions.size());
+   EXPECT_EQ(0u, vecCompletions.front().oRequest.ullTag);
+   EXPECT_EQ(1u, vecCompletions.back().oRequest.ullTag);
+   EXPECT_EQ(2u, Queue.GetBatchCount());
+   EXPECT_EQ(6u, Queue.GetCompletionCount());
+
+   EXPECT_TRUE(Queue.Push(vecBatch));
+   vecCompletions.clear();
+   EXPECT_EQ(1u, Queue.Drain(vecCompletions, 0));
+   EXPECT_EQ(0u, Queue.Drain(vecCompletions, 0));
+
+   // a waiting consumer is woken up by Close()
+   std::thread Consumer([&]() {
+      CppHTTPCompletionQueue::Batch vecNone;
+      EXPECT_EQ(0u, Queue.Drain(vecNone, -1));
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   Queue.Close();
+   Consumer.join();
+   EXPECT_TRUE(Queue.IsClosed());
+}
+
 #pragma endregion Unit Tests
 
 #pragma region REST Tests
@@ -265,6 +658,483 @@ TEST_F(RestClientTest, TestRestClientGETFailureCode)
    EXPECT_FALSE(m_pRESTClient->Get(strInvalidUrl, m_mapHeader, m_Response));
    EXPECT_TRUE(m_Response.strBody.empty());
    EXPECT_EQ(-1, m_Response.iCode);
+   EXPECT_EQ(CppHTTPClient::ERR_CURL, m_Response.eError);
+   EXPECT_FALSE(m_Response.strError.empty());
+}
+
+TEST_F(RestClientTest, TestRestClientCancel)
+{
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   m_pRESTClient->SetCancelToken(pToken);
+
+   // the token is triggered while the server is still thinking
+   std::thread Canceller([pToken]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      pToken->Cancel();
+   });
+
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/delay/3", m_mapHeader, m_Response));
+   auto llElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+   Canceller.join();
+
+   EXPECT_LT(llElapsedMs, 500);
+   EXPECT_EQ(-1, m_Response.iCode);
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, m_Response.eError);
+
+   // a cancelled token stays cancelled
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, m_Response.eError);
+
+   m_pRESTClient->SetCancelToken(nullptr);
+   CppHTTPClient::HttpResponse Response;
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, Response));
+   EXPECT_EQ(200, Response.iCode);
+   EXPECT_EQ(CppHTTPClient::ERR_NONE, Response.eError);
+}
+
+TEST_F(RestClientTest, TestRestClientPhaseTimeouts)
+{
+   CppHTTPClient::TimeoutPolicy oTimeouts;
+   oTimeouts.lFirstByteMs = 200;
+   m_pRESTClient->SetTimeouts(oTimeouts);
+
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/delay/2", m_mapHeader, m_Response));
+   auto llElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, m_Response.eError);
+   EXPECT_GE(llElapsedMs, 200);
+   EXPECT_LT(llElapsedMs, 1000);
+
+   // a slow body is aborted by the low speed limit, not by the first byte limit
+   oTimeouts = CppHTTPClient::TimeoutPolicy();
+   oTimeouts.lLowSpeedBytes = 100;
+   oTimeouts.lLowSpeedSeconds = 1;
+   m_pRESTClient->SetTimeouts(oTimeouts);
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/drip?numbytes=5&duration=5", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_LOW_SPEED, m_Response.eError);
+
+   oTimeouts = CppHTTPClient::TimeoutPolicy();
+   oTimeouts.lTotalMs = 300;
+   m_pRESTClient->SetTimeouts(oTimeouts);
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/drip?numbytes=5&duration=2", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_TRANSFER, m_Response.eError);
+   EXPECT_FALSE(m_Response.strError.empty());
+
+   m_pRESTClient->SetTimeouts(CppHTTPClient::TimeoutPolicy());
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+
+   // a reused connection has no connect time, its slow answer is still a first byte timeout
+   oTimeouts = CppHTTPClient::TimeoutPolicy();
+   oTimeouts.lFirstByteMs = 200;
+   m_pRESTClient->SetTimeouts(oTimeouts);
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/delay/2", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, m_Response.eError);
+}
+
+TEST_F(RestClientTest, TestRestClientDeadline)
+{
+   // the deadline is shorter than the whole request timeout
+   m_pRESTClient->SetTimeout(10);
+   m_pRESTClient->SetDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(200));
+
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/delay/2", m_mapHeader, m_Response));
+   auto llElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, m_Response.eError);
+   EXPECT_LT(llElapsedMs, 1000);
+
+   // expired: nothing is sent
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_DEADLINE_EXCEEDED, m_Response.eError);
+
+   m_pRESTClient->SetDeadline(CppHTTPClient::TimePoint());
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+}
+
+TEST_F(RestClientTest, TestRestClientRetry)
+{
+   CppHTTPClient::RetryPolicy oRetry;
+   oRetry.uMaxAttempts = 3;
+   oRetry.lBaseDelayMs = 10;
+   oRetry.lMaxDelayMs = 50;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+
+   // 503 and connection refused are retried, not 404
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/503", m_mapHeader, m_Response));
+   EXPECT_EQ(503, m_Response.iCode);
+   EXPECT_EQ(3u, m_pRESTClient->GetAttempts());
+   EXPECT_FALSE(m_pRESTClient->Get("http://127.0.0.1:1/get", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_CURL, m_Response.eError);
+   EXPECT_EQ(3u, m_pRESTClient->GetAttempts());
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/404", m_mapHeader, m_Response));
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+   EXPECT_TRUE(m_pRESTClient->Put("http://httpbin.org/status/504", m_mapHeader, std::string("data"), m_Response));
+   EXPECT_EQ(3u, m_pRESTClient->GetAttempts());
+
+   // POST isn't idempotent
+   EXPECT_TRUE(m_pRESTClient->Post("http://httpbin.org/status/503", m_mapHeader, "{}", m_Response));
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+   oRetry.bNonIdempotent = true;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+   EXPECT_TRUE(m_pRESTClient->Post("http://httpbin.org/status/503", m_mapHeader, "{}", m_Response));
+   EXPECT_EQ(3u, m_pRESTClient->GetAttempts());
+
+   // the error classes are selectable
+   oRetry.iRetryOn = CppHTTPClient::RETRY_CONNECT;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/503", m_mapHeader, m_Response));
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+
+   // a cancellation interrupts the backoff
+   oRetry.iRetryOn = CppHTTPClient::RETRY_DEFAULT;
+   oRetry.lBaseDelayMs = 5000;
+   oRetry.lMaxDelayMs = 5000;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   m_pRESTClient->SetCancelToken(pToken);
+   std::thread oCanceller([pToken]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      pToken->Cancel();
+   });
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/503", m_mapHeader, m_Response));
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(1000));
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+   oCanceller.join();
+}
+
+TEST_F(RestClientTest, TestRestClientRetryBudget)
+{
+   // 10 % of the traffic, a new origin starts with 1 retry
+   auto pBudget = std::make_shared<CppHTTPRetryBudget>(10., 1.);
+   CppHTTPClient::RetryPolicy oRetry;
+   oRetry.uMaxAttempts = 3;
+   oRetry.lBaseDelayMs = 1;
+   oRetry.lMaxDelayMs = 5;
+   oRetry.pBudget = pBudget;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/503", m_mapHeader, m_Response));
+   EXPECT_EQ(2u, m_pRESTClient->GetAttempts());
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/503", m_mapHeader, m_Response));
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+
+   CppHTTPRetryBudget::Stats oStats = pBudget->GetStats();
+   EXPECT_EQ(2u, oStats.ullRequests);
+   EXPECT_EQ(1u, oStats.ullRetries);
+   EXPECT_EQ(2u, oStats.ullDenied);
+   EXPECT_LT(pBudget->GetTokens("http://httpbin.org:80"), 1.);
+
+   // the successful requests earn retries
+   for (int i = 0; i < 10; ++i)
+      EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_GE(pBudget->GetTokens("http://httpbin.org:80"), 1.);
+}
+
+TEST_F(RestClientTest, TestRestClientCircuitBreaker)
+{
+   CppHTTPCircuitBreaker::Policy oPolicy;
+   oPolicy.usMinRequests = 3;
+   oPolicy.iOpenMs = 300;
+   auto pBreaker = std::make_shared<CppHTTPCircuitBreaker>(oPolicy);
+
+   std::mutex mtxTransitions;
+   std::vector<std::string> vecTransitions;
+   pBreaker->SetTransitionCallback([&](const std::string &strHost, CppHTTPCircuitBreaker::State eFrom,
+                                       CppHTTPCircuitBreaker::State eTo) {
+      std::lock_guard<std::mutex> oLock(mtxTransitions);
+      vecTransitions.push_back(strHost + " " + CppHTTPCircuitBreaker::StateName(eFrom) + "->" +
+                               CppHTTPCircuitBreaker::StateName(eTo));
+   });
+   m_pRESTClient->SetCircuitBreaker(pBreaker);
+
+   // 3 server errors open the circuit
+   for (int i = 0; i < 3; ++i)
+   {
+      EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/status/503", m_mapHeader, m_Response));
+      EXPECT_EQ(503, m_Response.iCode);
+   }
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_OPEN, pBreaker->GetState("http://httpbin.org:80"));
+
+   // the requests fail fast, without connecting
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(50));
+   EXPECT_EQ(CppHTTPClient::ERR_CIRCUIT_OPEN, m_Response.eError);
+   EXPECT_EQ(0u, m_pRESTClient->GetAttempts());
+   EXPECT_EQ(1u, pBreaker->GetStats("http://httpbin.org:80").ullRejected);
+
+   // other origins aren't affected
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_CLOSED, pBreaker->GetState("http://127.0.0.1:80"));
+
+   // once the open time elapsed, a successful probe closes the circuit
+   std::this_thread::sleep_for(std::chrono::milliseconds(350));
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_CLOSED, pBreaker->GetState("http://httpbin.org:80"));
+
+   std::lock_guard<std::mutex> oLock(mtxTransitions);
+   ASSERT_EQ(3u, vecTransitions.size());
+   EXPECT_EQ("http://httpbin.org:80 closed->open", vecTransitions[0]);
+   EXPECT_EQ("http://httpbin.org:80 open->half-open", vecTransitions[1]);
+   EXPECT_EQ("http://httpbin.org:80 half-open->closed", vecTransitions[2]);
+}
+
+TEST_F(RestClientTest, TestRestClientRetryAfter)
+{
+   std::atomic<int> iRequests(0);
+   StubServer oServer([&iRequests](const std::string &strRequest) {
+      ++iRequests;
+      if (strRequest.find("GET /busy ") == 0)
+         return StubServer::Reply(503, "Retry-After: 2\r\n");
+      return StubServer::Reply((iRequests == 1) ? 429 : 200, "Retry-After: 1\r\n");
+   });
+   CppHTTPClient::RetryPolicy oRetry;
+   oRetry.uMaxAttempts = 2;
+   oRetry.lBaseDelayMs = 10;
+   oRetry.lMaxDelayMs = 20;
+   oRetry.lMaxRetryAfterMs = 1500;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+   std::vector<long> vecPauses;
+   m_pRESTClient->SetThrottleFnCallback([&vecPauses](const std::string &, const long lPauseMs) { vecPauses.push_back(lPauseMs); });
+
+   // the retry of a 429 waits for its Retry-After, not for the backoff
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/get"), m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+   EXPECT_EQ(2u, m_pRESTClient->GetAttempts());
+   EXPECT_GE(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(990));
+
+   // a pause longer than lMaxRetryAfterMs isn't retried, but paces the next request
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/busy"), m_mapHeader, m_Response));
+   EXPECT_EQ(503, m_Response.iCode);
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+   tpStart = std::chrono::steady_clock::now();
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/get"), m_mapHeader, m_Response));
+   EXPECT_GE(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(1400));
+
+   CppHTTPClient::ThrottleStats oStats = m_pRESTClient->GetThrottleStats(oServer.Origin());
+   EXPECT_EQ(2u, oStats.ullThrottled);
+   EXPECT_EQ(1u, oStats.ullPaced);
+   EXPECT_EQ(2000, oStats.lLastRetryAfterMs);
+   EXPECT_EQ(2500u, oStats.ullPausedMs);
+   ASSERT_EQ(2u, vecPauses.size());
+   EXPECT_EQ(1500, vecPauses[1]);
+   EXPECT_EQ(4, iRequests.load());
+
+   // other origins aren't paused
+   EXPECT_EQ(0u, m_pRESTClient->GetThrottleStats("http://httpbin.org:80").ullThrottled);
+}
+
+TEST_F(RestClientTest, TestRestClientNegativeCache)
+{
+   CppHTTPNegativeCache::Policy oPolicy;
+   oPolicy.iConnectTtlMs = 300;
+   oPolicy.dJitter = 0.;
+   auto pCache = std::make_shared<CppHTTPNegativeCache>(oPolicy);
+   m_pRESTClient->SetNegativeCache(pCache);
+   CppHTTPClient::RetryPolicy oRetry;
+   oRetry.uMaxAttempts = 3;
+   oRetry.lBaseDelayMs = 10;
+   m_pRESTClient->SetRetryPolicy(oRetry);
+
+   // nothing listens on the port 1: the refused connection isn't retried
+   EXPECT_FALSE(m_pRESTClient->Get("http://127.0.0.1:1/get", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_CURL, m_Response.eError);
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+   EXPECT_TRUE(pCache->IsCached("http://127.0.0.1:1"));
+
+   // then fails at once with the cached error
+   EXPECT_FALSE(m_pRESTClient->Get("http://127.0.0.1:1/status/200", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_CURL, m_Response.eError);
+   EXPECT_EQ(0u, m_pRESTClient->GetAttempts());
+   EXPECT_NE(std::string::npos, m_Response.strError.find("(cached)"));
+
+   // other origins aren't affected
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+
+   // once the TTL elapsed the origin is probed again
+   std::this_thread::sleep_for(std::chrono::milliseconds(350));
+   EXPECT_FALSE(m_pRESTClient->Get("http://127.0.0.1:1/get", m_mapHeader, m_Response));
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+   EXPECT_EQ(std::string::npos, m_Response.strError.find("(cached)"));
+
+   CppHTTPNegativeCache::Stats oStats = pCache->GetStats();
+   EXPECT_EQ(1u, oStats.usHosts);
+   EXPECT_EQ(1u, oStats.ullHits);
+   EXPECT_EQ(1u, oStats.ullProbes);
+   EXPECT_EQ(2u, oStats.ullCached);
+}
+
+TEST_F(RestClientTest, TestRestClientAuthProvider)
+{
+   // tokens "tok-<n>" living 2 s, the API rejects the tokens below iMinValid
+   std::atomic<int> iIssued(0), iMinValid(1), iRejected(0);
+   std::string strTokenRequest;
+   StubServer oServer([&](const std::string &strRequest) {
+      if (strRequest.find("POST /token ") == 0)
+      {
+         strTokenRequest = strRequest.substr(strRequest.find("\r\n\r\n") + 4);
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+         return StubServer::Reply(200, "Content-Type: application/json\r\n",
+                                  "{\"access_token\":\"tok-" + std::to_string(++iIssued) +
+                                      "\",\"token_type\":\"Bearer\",\"expires_in\":2}");
+      }
+      size_t usAuth = strRequest.find("Authorization: Bearer tok-");
+      if (usAuth != std::string::npos && std::stoi(strRequest.substr(usAuth + 26)) >= iMinValid)
+         return StubServer::Reply(200);
+      ++iRejected;
+      return StubServer::Reply(401);
+   });
+
+   CppHTTPOAuth2Provider::Config oConfig;
+   oConfig.strTokenUrl = oServer.Url("/token");
+   oConfig.strClientId = "orders";
+   oConfig.strClientSecret = "s=cret&1";
+   oConfig.dRefreshRatio = 0.5;
+   auto pAuth = std::make_shared<CppHTTPOAuth2Provider>(oConfig, PRINT_LOG);
+   std::string strToken;
+   EXPECT_FALSE(pAuth->GetToken(strToken));
+   ASSERT_TRUE(pAuth->Start());
+
+   // the callers waiting for the first token share its fetch
+   std::vector<std::string> vecTokens(8);
+   std::vector<std::thread> vecThreads;
+   for (auto &strThreadToken : vecTokens)
+      vecThreads.emplace_back([&pAuth, &strThreadToken]() { EXPECT_TRUE(pAuth->GetToken(strThreadToken)); });
+   for (auto &oThread : vecThreads)
+      oThread.join();
+   for (const auto &strThreadToken : vecTokens)
+      EXPECT_EQ("tok-1", strThreadToken);
+   EXPECT_EQ(1u, pAuth->GetStats().ullFetches);
+   EXPECT_EQ("grant_type=client_credentials&client_id=orders&client_secret=s%3Dcret%261", strTokenRequest);
+
+   m_pRESTClient->SetAuthProvider(pAuth);
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/api"), m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+
+   // refreshed in the background at half of its lifetime, the requests don't wait
+   std::this_thread::sleep_for(std::chrono::milliseconds(1300));
+   EXPECT_EQ(2u, pAuth->GetStats().ullFetches);
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/api"), m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(100));
+   EXPECT_EQ(0, iRejected.load());
+
+   // a revoked token is replaced and the request sent again
+   iMinValid = iIssued + 1;
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/api"), m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+   EXPECT_EQ(2u, m_pRESTClient->GetAttempts());
+   EXPECT_EQ(1, iRejected.load());
+   EXPECT_TRUE(pAuth->GetToken(strToken));
+   EXPECT_EQ("tok-3", strToken);
+
+   // the request's own Authorization header takes precedence, its 401 isn't retried
+   CppHTTPClient::HeadersMap mapHeaders = m_mapHeader;
+   mapHeaders["Authorization"] = "Bearer tok-0";
+   EXPECT_TRUE(m_pRESTClient->Get(oServer.Url("/api"), mapHeaders, m_Response));
+   EXPECT_EQ(401, m_Response.iCode);
+   EXPECT_EQ(1u, m_pRESTClient->GetAttempts());
+
+   CppHTTPOAuth2Provider::Stats oStats = pAuth->GetStats();
+   EXPECT_EQ(3u, oStats.ullFetches);
+   EXPECT_EQ(0u, oStats.ullFailures);
+   EXPECT_EQ(1u, oStats.ullInvalidations);
+
+   // without a token the requests aren't sent
+   pAuth->Stop();
+   EXPECT_FALSE(m_pRESTClient->Get(oServer.Url("/api"), m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_NO_TOKEN, m_Response.eError);
+   EXPECT_EQ(0u, m_pRESTClient->GetAttempts());
+}
+
+TEST_F(RestClientTest, TestRestClientRateLimiter)
+{
+   auto pLimiter = std::make_shared<CppHTTPRateLimiter>();
+   ASSERT_TRUE(pLimiter->AddRule("http://httpbin.org", CppHTTPRateLimiter::Rule(5., 2)));
+   m_pRESTClient->SetRateLimiter(pLimiter);
+
+   // a burst of 2, then refused without connecting
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_TRUE(m_pRESTClient->Head("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_RATE_LIMITED, m_Response.eError);
+   EXPECT_EQ(0u, m_pRESTClient->GetAttempts());
+
+   // other origins aren't limited
+   EXPECT_TRUE(m_pRESTClient->Get("http://127.0.0.1/get", m_mapHeader, m_Response));
+
+   // a token every 200 ms
+   std::this_thread::sleep_for(std::chrono::milliseconds(250));
+   EXPECT_TRUE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_EQ(200, m_Response.iCode);
+
+   CppHTTPRateLimiter::RuleStats oStats = pLimiter->GetStats("http://httpbin.org");
+   EXPECT_EQ(3u, oStats.ullAdmitted);
+   EXPECT_EQ(1u, oStats.ullRejected);
+
+   // the requests failing fast on an open circuit give their token back
+   ASSERT_TRUE(pLimiter->AddRule("http://127.0.0.1:1", CppHTTPRateLimiter::Rule(0.1, 2)));
+   CppHTTPCircuitBreaker::Policy oPolicy;
+   oPolicy.usMinRequests = 1;
+   oPolicy.iOpenMs = 60000;
+   m_pRESTClient->SetCircuitBreaker(std::make_shared<CppHTTPCircuitBreaker>(oPolicy));
+   EXPECT_FALSE(m_pRESTClient->Get("http://127.0.0.1:1/get", m_mapHeader, m_Response));
+   for (int i = 0; i < 4; ++i)
+   {
+      EXPECT_FALSE(m_pRESTClient->Get("http://127.0.0.1:1/get", m_mapHeader, m_Response));
+      EXPECT_EQ(CppHTTPClient::ERR_CIRCUIT_OPEN, m_Response.eError);
+   }
+   oStats = pLimiter->GetStats("http://127.0.0.1:1");
+   EXPECT_EQ(0u, oStats.ullRejected);
+   EXPECT_EQ(4u, oStats.ullRefunded);
+   m_pRESTClient->SetCircuitBreaker(nullptr);
+}
+
+TEST_F(RestClientTest, TestRestClientLoadBalancer)
+{
+   auto pBalancer = std::make_shared<CppHTTPLoadBalancer>();
+   pBalancer->SetService("httpbin", {"http://httpbin.org/", "http://127.0.0.1"});
+   m_pRESTClient->SetLoadBalancer(pBalancer);
+
+   for (int i = 0; i < 4; ++i)
+   {
+      ASSERT_TRUE(m_pRESTClient->Get("lb://httpbin/get?lb=1", m_mapHeader, m_Response));
+      EXPECT_EQ(200, m_Response.iCode);
+   }
+   EXPECT_EQ("http://127.0.0.1/get?lb=1", m_pRESTClient->GetURL());
+
+   CppHTTPLoadBalancer::EndpointStats oStats = pBalancer->GetStats("http://httpbin.org");
+   EXPECT_EQ(2u, oStats.ullRequests);
+   EXPECT_EQ(0u, oStats.usOutstanding);
+   EXPECT_GT(oStats.dEwmaMs, 0.);
+   EXPECT_EQ(2u, pBalancer->GetStats("http://127.0.0.1").ullRequests);
+
+   // a server error counts as a failure of the endpoint
+   EXPECT_TRUE(m_pRESTClient->Get("lb://httpbin/status/503", m_mapHeader, m_Response));
+   EXPECT_EQ(1u, pBalancer->GetStats("http://httpbin.org").ullFailures);
+
+   EXPECT_FALSE(m_pRESTClient->Get("lb://unknown/get", m_mapHeader, m_Response));
+   EXPECT_EQ(CppHTTPClient::ERR_NO_ENDPOINT, m_Response.eError);
+   EXPECT_EQ(0u, m_pRESTClient->GetAttempts());
+}
+
+TEST_F(RestClientTest, TestRestClientProgress)
+{
+   unsigned uCalls = 0;
+   m_pRESTClient->SetProgressFnCallback([&uCalls](void *, double, double, double, double) {
+      ++uCalls;
+      return 1; // abort
+   });
+
+   EXPECT_FALSE(m_pRESTClient->Get("http://httpbin.org/get", m_mapHeader, m_Response));
+   EXPECT_GT(uCalls, 0u);
+   EXPECT_EQ(CppHTTPClient::ERR_CURL, m_Response.eError);
 }
 
 TEST_F(RestClientTest, TestRestClientGETHeaders)
@@ -471,6 +1341,1720 @@ TEST_F(RestClientTest, TestRestClientDeleteHeaders)
 
 #pragma endregion REST Tests
 
+#pragma region Async REST Tests
+
+TEST_F(AsyncClientTest, TestAsyncGETCode)
+{
+   bool bCompleted = false;
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader,
+                                   [&](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+                                      EXPECT_TRUE(bSuccess);
+                                      EXPECT_EQ(200, Response.iCode);
+                                      EXPECT_FALSE(Response.strBody.empty());
+                                      EXPECT_FALSE(Response.mapHeaders.empty());
+                                      bCompleted = true;
+                                   }));
+   RunLoop();
+   EXPECT_TRUE(bCompleted);
+}
+
+TEST_F(AsyncClientTest, TestAsyncPOSTBody)
+{
+   m_mapHeader.emplace("Content-Type", "text/text");
+
+   CppHTTPClient::HttpResponse oResponse;
+   ASSERT_TRUE(m_pAsyncClient->Post("http://httpbin.org/post", m_mapHeader, "data",
+                                    [&](const bool /*bSuccess*/, CppHTTPClient::HttpResponse &Response) {
+                                       oResponse = Response;
+                                    }));
+   RunLoop();
+   ASSERT_EQ(200, oResponse.iCode);
+
+   rapidjson::Document document;
+   ASSERT_FALSE(document.Parse(oResponse.strBody.c_str()).HasParseError());
+   rapidjson::Value::MemberIterator itTokenData = document.FindMember("data");
+   ASSERT_TRUE(itTokenData != document.MemberEnd());
+   EXPECT_STREQ("data", itTokenData->value.GetString());
+}
+
+// check for failure
+TEST_F(AsyncClientTest, TestAsyncGETFailureCode)
+{
+   bool bCompleted = false;
+   ASSERT_TRUE(m_pAsyncClient->Get("http://nonexistent", m_mapHeader,
+                                   [&](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+                                      EXPECT_FALSE(bSuccess);
+                                      EXPECT_EQ(-1, Response.iCode);
+                                      EXPECT_TRUE(Response.strBody.empty());
+                                      bCompleted = true;
+                                   }));
+   RunLoop();
+   EXPECT_TRUE(bCompleted);
+}
+
+TEST_F(AsyncClientTest, TestAsyncConcurrentRequests)
+{
+   const int iRequests = 10;
+   int iCompleted = 0;
+
+   // submitted from other threads, completed on this one
+   std::vector<std::thread> vecThreads;
+   for (int i = 0; i < iRequests; ++i)
+      vecThreads.emplace_back([&]() {
+         EXPECT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader,
+                                         [&](const bool /*bSuccess*/, CppHTTPClient::HttpResponse &Response) {
+                                            EXPECT_EQ(200, Response.iCode);
+                                            ++iCompleted;
+                                         }));
+      });
+   for (auto &oThread : vecThreads)
+      oThread.join();
+
+   RunLoop();
+   EXPECT_EQ(iRequests, iCompleted);
+}
+
+// completions delivered in batches to a consumer thread
+TEST_F(AsyncClientTest, TestAsyncBatchedCompletions)
+{
+   const unsigned long long ullRequests = 10;
+   auto pQueue = std::make_shared<CppHTTPCompletionQueue>();
+   m_pAsyncClient->SetCompletionQueue(pQueue, 4, 5);
+
+   std::vector<bool> vecReceived(ullRequests, false);
+   std::thread Consumer([&]() {
+      CppHTTPCompletionQueue::Batch vecCompletions;
+      size_t usReceived = 0;
+      while (usReceived < ullRequests && pQueue->Drain(vecCompletions, 2000) > 0)
+      {
+         for (auto &oCompletion : vecCompletions)
+         {
+            EXPECT_TRUE(oCompletion.bSuccess);
+            EXPECT_EQ(200, oCompletion.oResponse.iCode);
+            ASSERT_LT(oCompletion.oRequest.ullTag, ullRequests);
+            vecReceived[oCompletion.oRequest.ullTag] = true;
+         }
+         usReceived += vecCompletions.size();
+         vecCompletions.clear();
+      }
+   });
+
+   for (unsigned long long i = 0; i < ullRequests; ++i)
+   {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.strUrl = "http://httpbin.org/get";
+      oRequest.mapHeaders = m_mapHeader;
+      oRequest.ullTag = i;
+      ASSERT_TRUE(m_pAsyncClient->Submit(oRequest, nullptr));
+   }
+   RunLoop();
+
+   // the last partial batch is published by the flush timer
+   auto tpStart = std::chrono::steady_clock::now();
+   while (pQueue->GetCompletionCount() < ullRequests && std::chrono::steady_clock::now() - tpStart < std::chrono::seconds(2))
+      m_pAsyncClient->Poll(10);
+
+   Consumer.join();
+   EXPECT_EQ(std::vector<bool>(ullRequests, true), vecReceived);
+   EXPECT_EQ(ullRequests, pQueue->GetCompletionCount());
+   EXPECT_LT(pQueue->GetBatchCount(), ullRequests);
+}
+
+TEST_F(AsyncClientTest, TestAsyncPriorityOrder)
+{
+   // a single connection slot: the queue decides the order
+   m_pAsyncClient->SetMaxInFlight(1);
+
+   std::vector<int> vecOrder;
+   auto Submit = [&](CppHTTPAsyncClient::Priority ePriority, int iId) {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.strUrl = "http://httpbin.org/get";
+      oRequest.mapHeaders = m_mapHeader;
+      oRequest.ePriority = ePriority;
+      return m_pAsyncClient->Submit(oRequest, [&vecOrder, iId](const bool bSuccess, CppHTTPAsyncClient::HttpResponse &Response) {
+         EXPECT_TRUE(bSuccess);
+         EXPECT_EQ(200, Response.iCode);
+         vecOrder.push_back(iId);
+      });
+   };
+
+   ASSERT_TRUE(Submit(CppHTTPAsyncClient::PRIORITY_LOW, 2));
+   ASSERT_TRUE(Submit(CppHTTPAsyncClient::PRIORITY_LOW, 3));
+   ASSERT_TRUE(Submit(CppHTTPAsyncClient::PRIORITY_NORMAL, 1));
+   ASSERT_TRUE(Submit(CppHTTPAsyncClient::PRIORITY_HIGH, 0));
+   EXPECT_EQ(4u, m_pAsyncClient->GetPendingCount());
+   RunLoop();
+
+   EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), vecOrder);
+
+   CppHTTPQueueStats oLowStats = m_pAsyncClient->GetQueueStats(CppHTTPAsyncClient::PRIORITY_LOW);
+   CppHTTPQueueStats oHighStats = m_pAsyncClient->GetQueueStats(CppHTTPAsyncClient::PRIORITY_HIGH);
+   EXPECT_EQ(2u, oLowStats.ullDispatched);
+   EXPECT_EQ(0u, oLowStats.usDepth);
+   EXPECT_EQ(1u, oHighStats.ullDispatched);
+   EXPECT_GT(oLowStats.ullMaxWaitUs, oHighStats.ullMaxWaitUs);
+}
+
+TEST_F(AsyncClientTest, TestAsyncTenantFairness)
+{
+   m_pAsyncClient->SetMaxInFlight(1);
+
+   std::vector<std::string> vecOrder;
+   auto Submit = [&](const std::string &strTenant) {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.strUrl = "http://httpbin.org/get";
+      oRequest.mapHeaders = m_mapHeader;
+      oRequest.strTenant = strTenant;
+      return m_pAsyncClient->Submit(oRequest, [&vecOrder, strTenant](const bool, CppHTTPAsyncClient::HttpResponse &) {
+         vecOrder.push_back(strTenant);
+      });
+   };
+
+   for (int i = 0; i < 6; ++i)
+      ASSERT_TRUE(Submit("noisy"));
+   for (int i = 0; i < 2; ++i)
+      ASSERT_TRUE(Submit("quiet"));
+   RunLoop();
+
+   // the quiet tenant doesn't wait for the noisy one to finish
+   ASSERT_EQ(8u, vecOrder.size());
+   EXPECT_EQ(std::vector<std::string>({"noisy", "quiet", "noisy", "quiet"}),
+             std::vector<std::string>(vecOrder.begin(), vecOrder.begin() + 4));
+
+   CppHTTPAsyncClient::TenantStats oNoisy = m_pAsyncClient->GetTenantStats("noisy");
+   CppHTTPAsyncClient::TenantStats oQuiet = m_pAsyncClient->GetTenantStats("quiet");
+   EXPECT_EQ(6u, oNoisy.ullCompleted);
+   EXPECT_EQ(0u, oNoisy.ullFailed);
+   EXPECT_EQ(0u, oNoisy.usInFlight);
+   EXPECT_GT(oNoisy.ullBytesReceived, 0u);
+   EXPECT_EQ(6u, oNoisy.oQueue.ullDispatched);
+   EXPECT_EQ(2u, oQuiet.ullCompleted);
+   EXPECT_LT(oQuiet.ullMaxLatencyUs, oNoisy.ullMaxLatencyUs);
+}
+
+TEST_F(AsyncClientTest, TestAsyncCancel)
+{
+   m_pAsyncClient->SetMaxInFlight(1);
+
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   std::vector<CppHTTPClient::ErrorCode> vecErrors(3, CppHTTPClient::ERR_NONE);
+   auto Submit = [&](const std::string &strUrl, std::shared_ptr<CppHTTPCancelToken> pCancelToken, size_t usIndex) {
+      CppHTTPAsyncClient::Request oRequest;
+      oRequest.strUrl = strUrl;
+      oRequest.mapHeaders = m_mapHeader;
+      oRequest.pCancelToken = pCancelToken;
+      return m_pAsyncClient->Submit(oRequest, [&vecErrors, usIndex](const bool bSuccess, CppHTTPAsyncClient::HttpResponse &Response) {
+         EXPECT_EQ(bSuccess, Response.eError == CppHTTPClient::ERR_NONE);
+         vecErrors[usIndex] = Response.eError;
+      });
+   };
+
+   // running, queued behind it, and not cancellable
+   ASSERT_TRUE(Submit("http://httpbin.org/delay/3", pToken, 0));
+   ASSERT_TRUE(Submit("http://httpbin.org/get", pToken, 1));
+   ASSERT_TRUE(Submit("http://httpbin.org/get", nullptr, 2));
+
+   std::thread Canceller([pToken]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      pToken->Cancel();
+   });
+
+   auto tpStart = std::chrono::steady_clock::now();
+   RunLoop();
+   auto llElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+   Canceller.join();
+
+   EXPECT_LT(llElapsedMs, 1000);
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, vecErrors[0]);
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, vecErrors[1]);
+   EXPECT_EQ(CppHTTPClient::ERR_NONE, vecErrors[2]);
+
+   // already cancelled
+   ASSERT_TRUE(Submit("http://httpbin.org/get", pToken, 2));
+   RunLoop();
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, vecErrors[2]);
+}
+
+TEST_F(AsyncClientTest, TestAsyncDeadlines)
+{
+   m_pAsyncClient->SetMaxInFlight(1);
+
+   CppHTTPClient::TimeoutPolicy oTimeouts;
+   oTimeouts.lFirstByteMs = 300;
+   m_pAsyncClient->SetTimeouts(oTimeouts);
+
+   std::vector<CppHTTPClient::ErrorCode> vecErrors(3, CppHTTPClient::ERR_NONE);
+   std::vector<long long> vecElapsedMs(3, 0);
+   auto tpStart = std::chrono::steady_clock::now();
+   auto Submit = [&](CppHTTPAsyncClient::Request oRequest, size_t usIndex) {
+      oRequest.mapHeaders = m_mapHeader;
+      return m_pAsyncClient->Submit(oRequest, [&, usIndex](const bool, CppHTTPAsyncClient::HttpResponse &Response) {
+         vecErrors[usIndex] = Response.eError;
+         vecElapsedMs[usIndex] = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+      });
+   };
+
+   // holds the only connection slot until its first byte limit
+   CppHTTPAsyncClient::Request oRequest;
+   oRequest.strUrl = "http://httpbin.org/delay/2";
+   ASSERT_TRUE(Submit(oRequest, 0));
+
+   // expires while queued
+   oRequest.strUrl = "http://httpbin.org/get";
+   oRequest.tpDeadline = tpStart + std::chrono::milliseconds(100);
+   ASSERT_TRUE(Submit(oRequest, 1));
+
+   // the request limit overrides the client one
+   oRequest.strUrl = "http://httpbin.org/get";
+   oRequest.tpDeadline = CppHTTPClient::TimePoint();
+   oRequest.oTimeouts.lFirstByteMs = 1000;
+   ASSERT_TRUE(Submit(oRequest, 2));
+
+   RunLoop();
+
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, vecErrors[0]);
+   EXPECT_GE(vecElapsedMs[0], 300);
+   EXPECT_LT(vecElapsedMs[0], 1000);
+   EXPECT_EQ(CppHTTPClient::ERR_DEADLINE_EXCEEDED, vecErrors[1]);
+   EXPECT_LT(vecElapsedMs[1], 300);
+   EXPECT_EQ(CppHTTPClient::ERR_NONE, vecErrors[2]);
+}
+
+TEST_F(AsyncClientTest, TestAsyncDrain)
+{
+   std::vector<CppHTTPClient::ErrorCode> vecErrors(2, CppHTTPClient::ERR_NONE);
+   std::vector<bool> vecSuccess(2, false);
+   bool bResubmitted = true;
+
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/delay/1", m_mapHeader,
+                                   [&](const bool bSuccess, CppHTTPAsyncClient::HttpResponse &Response) {
+                                      vecSuccess[0] = bSuccess;
+                                      vecErrors[0] = Response.eError;
+                                      // new requests are refused while draining
+                                      bResubmitted = m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, nullptr);
+                                   }));
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/delay/5", m_mapHeader,
+                                   [&](const bool bSuccess, CppHTTPAsyncClient::HttpResponse &Response) {
+                                      vecSuccess[1] = bSuccess;
+                                      vecErrors[1] = Response.eError;
+                                   }));
+
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_FALSE(m_pAsyncClient->Drain(tpStart + std::chrono::milliseconds(1500)));
+   auto llElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+
+   EXPECT_TRUE(vecSuccess[0]);
+   EXPECT_EQ(CppHTTPClient::ERR_NONE, vecErrors[0]);
+   EXPECT_FALSE(bResubmitted);
+   EXPECT_FALSE(vecSuccess[1]);
+   EXPECT_EQ(CppHTTPClient::ERR_DRAINED, vecErrors[1]);
+   EXPECT_GE(llElapsedMs, 1500);
+   EXPECT_LT(llElapsedMs, 2500);
+
+   // the session is cleaned
+   EXPECT_EQ(nullptr, m_pAsyncClient->GetCurlMultiPointer());
+   EXPECT_FALSE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, nullptr));
+
+   // nothing pending: returns at once
+   ASSERT_TRUE(m_pAsyncClient->InitSession());
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, nullptr));
+   EXPECT_TRUE(m_pAsyncClient->Drain(std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+   EXPECT_EQ(0u, m_pAsyncClient->GetPendingCount());
+   ASSERT_TRUE(m_pAsyncClient->InitSession());
+}
+
+TEST_F(AsyncClientTest, TestAsyncExecuteBatch)
+{
+   std::vector<CppHTTPAsyncClient::Request> vecRequests(6);
+   for (size_t i = 0; i < 4; ++i)
+      vecRequests[i].strUrl = "http://httpbin.org/delay/0.3?i=" + std::to_string(i);
+   // vecRequests[4] has no URL and can't be submitted
+   vecRequests[5].strUrl = "http://httpbin.org/delay/3";
+
+   // at most 2 requests in progress: 0/1, 2/3 then 5 until the deadline
+   std::vector<CppHTTPAsyncClient::Completion> vecResults;
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_EQ(4u, m_pAsyncClient->ExecuteBatch(vecRequests, vecResults, 2, tpStart + std::chrono::milliseconds(1200)));
+   auto llElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count();
+   EXPECT_GE(llElapsedMs, 1200);
+   EXPECT_LT(llElapsedMs, 2000);
+
+   ASSERT_EQ(vecRequests.size(), vecResults.size());
+   for (size_t i = 0; i < 4; ++i)
+   {
+      EXPECT_TRUE(vecResults[i].bSuccess);
+      EXPECT_EQ(200, vecResults[i].oResponse.iCode);
+      EXPECT_EQ(vecRequests[i].strUrl, vecResults[i].oRequest.strUrl);
+
+      rapidjson::Document document;
+      ASSERT_FALSE(document.Parse(vecResults[i].oResponse.strBody.c_str()).HasParseError());
+      EXPECT_EQ(std::to_string(i), document["args"]["i"].GetString());
+   }
+   EXPECT_FALSE(vecResults[4].bSuccess);
+   EXPECT_EQ(CppHTTPClient::ERR_CURL, vecResults[4].oResponse.eError);
+   EXPECT_FALSE(vecResults[5].bSuccess);
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, vecResults[5].oResponse.eError);
+   EXPECT_EQ(0u, m_pAsyncClient->GetPendingCount());
+
+   // an expired batch sends nothing
+   EXPECT_EQ(0u, m_pAsyncClient->ExecuteBatch(vecRequests, vecResults, 0, std::chrono::steady_clock::now()));
+   for (const auto &oResult : vecResults)
+      EXPECT_FALSE(oResult.bSuccess);
+   EXPECT_EQ(CppHTTPClient::ERR_DEADLINE_EXCEEDED, vecResults[0].oResponse.eError);
+}
+
+TEST_F(AsyncClientTest, TestAsyncLoadBalancer)
+{
+   auto pBalancer = std::make_shared<CppHTTPLoadBalancer>();
+   pBalancer->SetService("httpbin", {"http://httpbin.org", "http://127.0.0.1"}, CppHTTPLoadBalancer::LB_P2C);
+   m_pAsyncClient->SetLoadBalancer(pBalancer);
+
+   // 4 concurrent requests: P2C spreads them by outstanding requests
+   std::vector<CppHTTPAsyncClient::Request> vecRequests(4);
+   for (auto &oRequest : vecRequests)
+      oRequest.strUrl = "lb://httpbin/delay/0.2";
+   std::vector<CppHTTPAsyncClient::Completion> vecResults;
+   EXPECT_EQ(4u, m_pAsyncClient->ExecuteBatch(vecRequests, vecResults));
+   for (const auto &oResult : vecResults)
+      EXPECT_EQ(200, oResult.oResponse.iCode);
+
+   CppHTTPLoadBalancer::EndpointStats oFirst = pBalancer->GetStats("http://httpbin.org");
+   CppHTTPLoadBalancer::EndpointStats oSecond = pBalancer->GetStats("http://127.0.0.1");
+   EXPECT_EQ(2u, oFirst.ullRequests);
+   EXPECT_EQ(2u, oSecond.ullRequests);
+   EXPECT_EQ(0u, oFirst.usOutstanding + oSecond.usOutstanding);
+   EXPECT_GE(oFirst.dEwmaMs, 200.);
+
+   // a cancelled request ends without measuring the endpoint
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   pToken->Cancel();
+   vecRequests.resize(1);
+   vecRequests[0].pCancelToken = pToken;
+   EXPECT_EQ(0u, m_pAsyncClient->ExecuteBatch(vecRequests, vecResults));
+   EXPECT_EQ(4u, pBalancer->GetStats("http://httpbin.org").ullRequests +
+                     pBalancer->GetStats("http://127.0.0.1").ullRequests);
+   EXPECT_EQ(0u, pBalancer->GetStats("http://httpbin.org").usOutstanding +
+                     pBalancer->GetStats("http://127.0.0.1").usOutstanding);
+
+   CppHTTPAsyncClient::Request oUnknown;
+   oUnknown.strUrl = "lb://unknown/get";
+   EXPECT_FALSE(m_pAsyncClient->Submit(oUnknown, nullptr));
+}
+
+TEST_F(AsyncClientTest, TestAsyncFanOut)
+{
+   // the template URL is appended to the endpoints
+   CppHTTPAsyncClient::Request oTemplate;
+   oTemplate.strUrl = "/get?shard=1";
+   oTemplate.mapHeaders = m_mapHeader;
+   std::vector<CppHTTPAsyncClient::FanOutResult> vecResults;
+   EXPECT_EQ(2u, m_pAsyncClient->FanOut(oTemplate, {"http://httpbin.org", "http://httpbin.org"}, vecResults));
+   ASSERT_EQ(2u, vecResults.size());
+   for (const auto &oResult : vecResults)
+   {
+      EXPECT_EQ("http://httpbin.org/get?shard=1", oResult.strUrl);
+      EXPECT_TRUE(oResult.bSuccess);
+      EXPECT_EQ(200, oResult.oResponse.iCode);
+      EXPECT_GT(oResult.ullLatencyUs, 0u);
+   }
+
+   // quorum: the straggler is cancelled once 2 endpoints answered
+   std::vector<std::string> vecEndpoints = {"http://httpbin.org/get", "http://httpbin.org/delay/0.3",
+                                            "http://httpbin.org/delay/3"};
+   CppHTTPAsyncClient::FanOutPolicy oPolicy;
+   oPolicy.eMode = CppHTTPAsyncClient::FANOUT_QUORUM;
+   oPolicy.usQuorum = 2;
+   oTemplate.strUrl.clear();
+   auto tpStart = std::chrono::steady_clock::now();
+   EXPECT_EQ(2u, m_pAsyncClient->FanOut(oTemplate, vecEndpoints, vecResults, oPolicy));
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(1000));
+   ASSERT_EQ(3u, vecResults.size());
+   EXPECT_TRUE(vecResults[0].bSuccess);
+   EXPECT_TRUE(vecResults[1].bSuccess);
+   EXPECT_LT(vecResults[0].ullLatencyUs, vecResults[1].ullLatencyUs);
+   EXPECT_FALSE(vecResults[2].bSuccess);
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, vecResults[2].oResponse.eError);
+   EXPECT_EQ(0u, m_pAsyncClient->GetPendingCount());
+
+   // unreachable quorum: the failures end the fan-out at once
+   oPolicy.usQuorum = 3;
+   vecEndpoints[0] = "http://httpbin.org/status/503";
+   tpStart = std::chrono::steady_clock::now();
+   EXPECT_EQ(0u, m_pAsyncClient->FanOut(oTemplate, vecEndpoints, vecResults, oPolicy));
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(250));
+   EXPECT_EQ(503, vecResults[0].oResponse.iCode);
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, vecResults[1].oResponse.eError);
+
+   // deadline: partial results
+   oPolicy.eMode = CppHTTPAsyncClient::FANOUT_ALL;
+   oPolicy.tpDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(800);
+   vecEndpoints[0] = "http://httpbin.org/get";
+   EXPECT_EQ(2u, m_pAsyncClient->FanOut(oTemplate, vecEndpoints, vecResults, oPolicy));
+   EXPECT_LT(std::chrono::steady_clock::now(), oPolicy.tpDeadline + std::chrono::milliseconds(500));
+   EXPECT_TRUE(vecResults[0].bSuccess);
+   EXPECT_TRUE(vecResults[1].bSuccess);
+   EXPECT_FALSE(vecResults[2].bSuccess);
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, vecResults[2].oResponse.eError);
+}
+
+TEST_F(AsyncClientTest, TestAsyncAdmission)
+{
+   m_pAsyncClient->SetMaxInFlight(1);
+   std::vector<CppHTTPClient::ErrorCode> vecErrors;
+   auto OnCompletion = [&](const bool, CppHTTPAsyncClient::HttpResponse &Response) {
+      vecErrors.push_back(Response.eError);
+   };
+
+   // reject: the loop did not run yet, the requests stay queued
+   m_pAsyncClient->SetQueueLimit(2, CppHTTPAsyncClient::OVERFLOW_REJECT);
+   EXPECT_EQ(2u, m_pAsyncClient->GetMaxQueued());
+   EXPECT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, OnCompletion));
+   EXPECT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, OnCompletion));
+   EXPECT_FALSE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, OnCompletion));
+   RunLoop();
+   EXPECT_EQ(2u, vecErrors.size());
+
+   CppHTTPAsyncClient::AdmissionStats oStats = m_pAsyncClient->GetAdmissionStats();
+   EXPECT_EQ(2u, oStats.ullAccepted);
+   EXPECT_EQ(1u, oStats.ullRejected);
+   EXPECT_EQ(2u, oStats.oQueue.ullDispatched);
+   EXPECT_EQ(0u, oStats.oQueue.usDepth);
+
+   // drop oldest: the first request makes room for the third one
+   vecErrors.clear();
+   m_pAsyncClient->SetQueueLimit(2, CppHTTPAsyncClient::OVERFLOW_DROP_OLDEST);
+   CppHTTPAsyncClient::Request oRequest;
+   oRequest.strUrl = "http://httpbin.org/get";
+   for (unsigned long long i = 0; i < 3; ++i)
+   {
+      oRequest.ullTag = i;
+      EXPECT_TRUE(m_pAsyncClient->Submit(oRequest, OnCompletion));
+   }
+   // TrySubmit never drops
+   EXPECT_FALSE(m_pAsyncClient->TrySubmit(oRequest, OnCompletion));
+   RunLoop();
+   ASSERT_EQ(3u, vecErrors.size());
+   EXPECT_EQ(CppHTTPClient::ERR_QUEUE_FULL, vecErrors[0]);
+   EXPECT_EQ(CppHTTPClient::ERR_NONE, vecErrors[1]);
+   EXPECT_EQ(CppHTTPClient::ERR_NONE, vecErrors[2]);
+
+   oStats = m_pAsyncClient->GetAdmissionStats();
+   EXPECT_EQ(1u, oStats.ullDropped);
+   EXPECT_EQ(2u, oStats.ullRejected);
+
+   // block: the producer waits for the loop to dispatch
+   vecErrors.clear();
+   m_pAsyncClient->SetQueueLimit(1, CppHTTPAsyncClient::OVERFLOW_BLOCK);
+   std::atomic<bool> bProduced(false);
+   std::thread Producer([&]() {
+      for (int i = 0; i < 4; ++i)
+         EXPECT_TRUE(m_pAsyncClient->Get("http://httpbin.org/delay/0.1", m_mapHeader, OnCompletion));
+      bProduced = true;
+   });
+   while (!bProduced || m_pAsyncClient->GetPendingCount() > 0)
+      m_pAsyncClient->Poll(100);
+   Producer.join();
+
+   ASSERT_EQ(4u, vecErrors.size());
+   for (auto eError : vecErrors)
+      EXPECT_EQ(CppHTTPClient::ERR_NONE, eError);
+   oStats = m_pAsyncClient->GetAdmissionStats();
+   EXPECT_GE(oStats.ullBlocked, 1u);
+   EXPECT_GT(oStats.ullBlockedUs, 0u);
+   EXPECT_EQ(0u, oStats.usInFlight);
+
+   // the loop thread alone frees places: a full queue refuses its requests rather than
+   // blocking it, whether they come from a completion callback or a hedged client
+   bool bRefused = false;
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, [&](const bool, CppHTTPAsyncClient::HttpResponse &) {
+      EXPECT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, OnCompletion));
+      bRefused = !m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, OnCompletion);
+   }));
+   CppHTTPHedgedClient oHedged(*m_pAsyncClient);
+   EXPECT_FALSE(oHedged.Get("http://httpbin.org/get", m_mapHeader, OnCompletion));
+   RunLoop();
+   EXPECT_TRUE(bRefused);
+   EXPECT_EQ(oStats.ullBlocked, m_pAsyncClient->GetAdmissionStats().ullBlocked);
+}
+
+TEST(HTTPBackgroundSender, TestDelivery)
+{
+   CppHTTPClient::HeadersMap mapHeaders;
+   mapHeaders.emplace("Content-Type", "application/json");
+
+   CppHTTPBackgroundSender oSender(PRINT_LOG, 64, 2);
+   EXPECT_FALSE(oSender.Enqueue("http://httpbin.org/post", mapHeaders, "{}"));
+   ASSERT_TRUE(oSender.Start());
+   EXPECT_FALSE(oSender.Start());
+
+   for (int i = 0; i < 20; ++i)
+      EXPECT_TRUE(oSender.Enqueue("http://httpbin.org/post", mapHeaders, "{\"i\":" + std::to_string(i) + "}"));
+   EXPECT_TRUE(oSender.Enqueue("http://httpbin.org/status/500", mapHeaders, "{}"));
+   EXPECT_TRUE(oSender.Flush(5000));
+
+   CppHTTPBackgroundSender::Stats oStats = oSender.GetStats();
+   EXPECT_EQ(21u, oStats.ullEnqueued);
+   EXPECT_EQ(20u, oStats.ullSent);
+   EXPECT_EQ(1u, oStats.ullFailed);
+   EXPECT_EQ(0u, oStats.usQueued);
+   oSender.Stop();
+}
+
+TEST(HTTPBackgroundSender, TestDropAndShutdown)
+{
+   CppHTTPClient::HeadersMap mapHeaders;
+
+   // a single worker busy for 1 s, the queue holds 2 messages
+   CppHTTPBackgroundSender oSender(PRINT_LOG, 2, 1, CppHTTPBackgroundSender::DROP_NEWEST);
+   ASSERT_TRUE(oSender.Start());
+   size_t usAccepted = 0;
+   for (int i = 0; i < 6; ++i)
+      usAccepted += oSender.Enqueue("http://httpbin.org/delay/1", mapHeaders, "{}") ? 1 : 0;
+   EXPECT_LE(usAccepted, 3u);
+
+   // no flush: the running request is aborted, the queued ones discarded
+   auto tpStart = std::chrono::steady_clock::now();
+   oSender.Stop();
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(500));
+
+   CppHTTPBackgroundSender::Stats oStats = oSender.GetStats();
+   EXPECT_EQ(usAccepted, oStats.ullEnqueued);
+   EXPECT_EQ(6u - usAccepted, oStats.ullDropped);
+   EXPECT_EQ(0u, oStats.ullSent);
+   EXPECT_EQ(usAccepted, oStats.ullDiscarded);
+
+   // flush on shutdown: the queued messages are sent before Stop() returns
+   CppHTTPBackgroundSender oFlushed(PRINT_LOG, 2, 1, CppHTTPBackgroundSender::DROP_OLDEST);
+   oFlushed.SetFlushOnShutdown(true, 5000);
+   ASSERT_TRUE(oFlushed.Start());
+   for (int i = 0; i < 5; ++i)
+      EXPECT_TRUE(oFlushed.Enqueue("http://httpbin.org/post", mapHeaders, "{}"));
+   oFlushed.Stop();
+
+   oStats = oFlushed.GetStats();
+   EXPECT_EQ(5u, oStats.ullEnqueued);
+   EXPECT_EQ(oStats.ullEnqueued - oStats.ullDropped, oStats.ullSent);
+   EXPECT_EQ(0u, oStats.ullDiscarded);
+}
+
+TEST(HTTPBatchProducer, TestSplitResponse)
+{
+   std::vector<std::string> vecResults;
+   EXPECT_TRUE(CppHTTPBatchProducer::SplitResponse("[{\"id\": 1}, 2, \"three\"]", 3,
+                                                   CppHTTPBatchProducer::FORMAT_JSON_ARRAY, vecResults));
+   ASSERT_EQ(3u, vecResults.size());
+   EXPECT_EQ("{\"id\":1}", vecResults[0]);
+   EXPECT_EQ("2", vecResults[1]);
+   EXPECT_EQ("\"three\"", vecResults[2]);
+
+   EXPECT_TRUE(CppHTTPBatchProducer::SplitResponse("{\"ok\":1}\r\n{\"ok\":0}\n", 2,
+                                                   CppHTTPBatchProducer::FORMAT_NDJSON, vecResults));
+   ASSERT_EQ(2u, vecResults.size());
+   EXPECT_EQ("{\"ok\":0}", vecResults[1]);
+
+   // one result per item or nothing
+   EXPECT_FALSE(CppHTTPBatchProducer::SplitResponse("[1, 2]", 3, CppHTTPBatchProducer::FORMAT_JSON_ARRAY, vecResults));
+   EXPECT_TRUE(vecResults.empty());
+   EXPECT_FALSE(CppHTTPBatchProducer::SplitResponse("{\"data\": []}", 1, CppHTTPBatchProducer::FORMAT_JSON_ARRAY, vecResults));
+}
+
+TEST(HTTPBatchProducer, TestBatching)
+{
+   // 4 items or 100 ms per batch
+   CppHTTPBatchProducer oProducer(PRINT_LOG, 4, 1 << 20, 100);
+   EXPECT_EQ(-1, oProducer.Send("http://httpbin.org/post", "{}").get().iCode);
+   ASSERT_TRUE(oProducer.Start());
+
+   std::vector<std::future<CppHTTPClient::HttpResponse>> vecFutures;
+   for (int i = 0; i < 10; ++i)
+      vecFutures.push_back(oProducer.Send("http://httpbin.org/post", "{\"i\":" + std::to_string(i) + "}"));
+
+   // the last 2 items are sent once their linger time elapsed
+   auto tpStart = std::chrono::steady_clock::now();
+   for (int i = 0; i < 10; ++i)
+   {
+      CppHTTPClient::HttpResponse Response = vecFutures[i].get();
+      EXPECT_EQ(200, Response.iCode);
+
+      // httpbin echoes the bulk request body
+      rapidjson::Document document;
+      ASSERT_FALSE(document.Parse(Response.strBody.c_str()).HasParseError());
+      rapidjson::Document oBulk;
+      ASSERT_FALSE(oBulk.Parse(document["data"].GetString()).HasParseError());
+      ASSERT_TRUE(oBulk.IsArray());
+      EXPECT_EQ((i < 8) ? 4u : 2u, oBulk.Size());
+      EXPECT_EQ(i, oBulk[i % 4]["i"].GetInt());
+   }
+   EXPECT_GE(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(50));
+
+   CppHTTPBatchProducer::Stats oStats = oProducer.GetStats();
+   EXPECT_EQ(10u, oStats.ullItems);
+   EXPECT_EQ(3u, oStats.ullBatches);
+   EXPECT_EQ(0u, oStats.ullFailedBatches);
+
+   // Stop() sends the pending batch at once
+   auto oFuture = oProducer.Send("http://httpbin.org/post", "{}");
+   oProducer.Stop();
+   ASSERT_EQ(std::future_status::ready, oFuture.wait_for(std::chrono::seconds(0)));
+   EXPECT_EQ(200, oFuture.get().iCode);
+}
+
+TEST_F(AsyncClientTest, TestHedgedRequests)
+{
+   CppHTTPHedgedClient::HedgePolicy oPolicy;
+   oPolicy.iDefaultDelayMs = 100;
+   oPolicy.dBudgetPercent = 100.;
+   CppHTTPHedgedClient oHedged(*m_pAsyncClient, oPolicy);
+
+   // slow primary replica: the hedge sent to the other endpoint wins, the primary is cancelled
+   bool bSuccess = false;
+   CppHTTPClient::HttpResponse oResponse;
+   auto tpStart = std::chrono::steady_clock::now();
+   ASSERT_TRUE(oHedged.Get("http://httpbin.org/delay/2", m_mapHeader,
+                           [&](const bool bDone, CppHTTPClient::HttpResponse &Response) {
+                              bSuccess = bDone;
+                              oResponse = Response;
+                           },
+                           "http://httpbin.org/get"));
+   RunLoop();
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(1000));
+   EXPECT_TRUE(bSuccess);
+   EXPECT_EQ(200, oResponse.iCode);
+   EXPECT_EQ(0u, m_pAsyncClient->GetPendingCount());
+
+   CppHTTPHedgedClient::Stats oStats = oHedged.GetStats();
+   EXPECT_EQ(1u, oStats.ullRequests);
+   EXPECT_EQ(1u, oStats.ullHedges);
+   EXPECT_EQ(1u, oStats.ullHedgeWins);
+   EXPECT_DOUBLE_EQ(1., oStats.GetWinRate());
+
+   // fast primary: answered before the hedge delay, no second copy
+   ASSERT_TRUE(oHedged.Get("http://httpbin.org/get", m_mapHeader,
+                           [&](const bool bDone, CppHTTPClient::HttpResponse &) { bSuccess = bDone; }));
+   RunLoop();
+   EXPECT_TRUE(bSuccess);
+   EXPECT_EQ(1u, oHedged.GetStats().ullHedges);
+
+   // spent budget: the request is not hedged
+   oPolicy.dBudgetPercent = 0.;
+   oHedged.SetPolicy(oPolicy);
+   ASSERT_TRUE(oHedged.Get("http://httpbin.org/delay/0.3", m_mapHeader,
+                           [&](const bool bDone, CppHTTPClient::HttpResponse &) { bSuccess = bDone; }));
+   RunLoop();
+   EXPECT_TRUE(bSuccess);
+   oStats = oHedged.GetStats();
+   EXPECT_EQ(3u, oStats.ullRequests);
+   EXPECT_EQ(1u, oStats.ullHedges);
+   EXPECT_EQ(1u, oStats.ullBudgetDenied);
+
+   // the caller's token cancels both copies
+   oPolicy.dBudgetPercent = 100.;
+   oPolicy.iDefaultDelayMs = 50;
+   oHedged.SetPolicy(oPolicy);
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   CppHTTPAsyncClient::Request oRequest;
+   oRequest.strUrl = "http://httpbin.org/delay/2";
+   oRequest.pCancelToken = pToken;
+   oResponse = CppHTTPClient::HttpResponse();
+   ASSERT_TRUE(oHedged.Submit(oRequest, [&](const bool bDone, CppHTTPClient::HttpResponse &Response) {
+      bSuccess = bDone;
+      oResponse = Response;
+   }));
+   m_pAsyncClient->ScheduleTimer(200, [pToken]() { pToken->Cancel(); });
+   tpStart = std::chrono::steady_clock::now();
+   RunLoop();
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(1000));
+   EXPECT_FALSE(bSuccess);
+   EXPECT_EQ(CppHTTPClient::ERR_CANCELLED, oResponse.eError);
+   EXPECT_EQ(2u, oHedged.GetStats().ullHedges);
+}
+
+TEST_F(AsyncClientTest, TestHedgeDelay)
+{
+   CppHTTPHedgedClient::HedgePolicy oPolicy;
+   oPolicy.iDefaultDelayMs = 500;
+   oPolicy.usMinSamples = 10;
+   oPolicy.dBudgetPercent = 0.;
+   CppHTTPHedgedClient oHedged(*m_pAsyncClient, oPolicy);
+   EXPECT_EQ(500, oHedged.GetStats().iDelayMs);
+
+   // the delay follows the latencies once enough of them are known
+   size_t usSucceeded = 0;
+   for (int i = 0; i < 10; ++i)
+   {
+      ASSERT_TRUE(oHedged.Get("http://httpbin.org/get", m_mapHeader,
+                              [&](const bool bDone, CppHTTPClient::HttpResponse &) { usSucceeded += bDone ? 1 : 0; }));
+      RunLoop();
+   }
+   EXPECT_EQ(10u, usSucceeded);
+   EXPECT_LT(oHedged.GetStats().iDelayMs, 500);
+   EXPECT_GE(oHedged.GetStats().iDelayMs, oPolicy.iMinDelayMs);
+}
+
+TEST_F(AsyncClientTest, TestHealthChecker)
+{
+   auto pBalancer = std::make_shared<CppHTTPLoadBalancer>();
+   pBalancer->SetService("httpbin", {"http://httpbin.org", "http://127.0.0.1:1"});
+   CppHTTPLoadBalancer::OutlierPolicy oOutlier;
+   oOutlier.iBaseEjectionMs = 50;
+   oOutlier.usMaxProbeFailures = 2;
+   pBalancer->SetOutlierPolicy(oOutlier);
+
+   CppHTTPHealthChecker::HealthCheckPolicy oPolicy;
+   oPolicy.eMethod = CppHTTPAsyncClient::HTTP_GET;
+   oPolicy.strPath = "/get";
+   oPolicy.iIntervalMs = 30;
+   oPolicy.iTimeoutMs = 500;
+   {
+      CppHTTPHealthChecker oChecker(*m_pAsyncClient, pBalancer, oPolicy);
+      oChecker.Start();
+      EXPECT_TRUE(oChecker.IsRunning());
+
+      // the refused endpoint is ejected, then kept out while its probes fail
+      auto tpEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(400);
+      while (std::chrono::steady_clock::now() < tpEnd)
+         m_pAsyncClient->Poll(10);
+
+      CppHTTPLoadBalancer::EndpointStats oBad = pBalancer->GetStats("http://127.0.0.1:1");
+      EXPECT_TRUE(oBad.bEjected);
+      EXPECT_GE(oBad.ullEjections, 2u);
+      EXPECT_FALSE(pBalancer->GetStats("http://httpbin.org").bEjected);
+      EXPECT_GT(oChecker.GetStats().ullProbes, oChecker.GetStats().ullFailures);
+      EXPECT_GE(oChecker.GetStats().ullFailures, 2u);
+
+      std::string strResolved;
+      std::string strEndpoint;
+      for (int i = 0; i < 4; ++i)
+      {
+         ASSERT_TRUE(pBalancer->Resolve("lb://httpbin/get", strResolved, strEndpoint));
+         EXPECT_EQ("http://httpbin.org", strEndpoint);
+         pBalancer->Release(strEndpoint);
+      }
+   }
+
+   // the probes in flight when the checker was destroyed complete harmlessly
+   RunLoop();
+   EXPECT_EQ(0u, m_pAsyncClient->GetPendingCount());
+}
+
+TEST_F(AsyncClientTest, TestAsyncConcurrencyLimiter)
+{
+   CppHTTPConcurrencyLimiter::Policy oPolicy;
+   oPolicy.usInitialLimit = 2;
+   oPolicy.usMaxLimit = 2;
+   auto pLimiter = std::make_shared<CppHTTPConcurrencyLimiter>(oPolicy);
+   m_pAsyncClient->SetConcurrencyLimiter(pLimiter);
+
+   // 2 requests run, 2 wait, the 5th is shed
+   size_t usCompleted = 0;
+   auto oCompletion = [&usCompleted](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+      EXPECT_TRUE(bSuccess);
+      EXPECT_EQ(200, Response.iCode);
+      ++usCompleted;
+   };
+   auto tpStart = std::chrono::steady_clock::now();
+   for (int i = 0; i < 4; ++i)
+      ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/delay/0.2", m_mapHeader, oCompletion));
+   EXPECT_FALSE(m_pAsyncClient->Get("http://httpbin.org/delay/0.2", m_mapHeader, oCompletion));
+   EXPECT_EQ(1u, m_pAsyncClient->GetAdmissionStats().ullRejected);
+
+   // admitted, started by the loop
+   CppHTTPConcurrencyLimiter::HostStats oStats = pLimiter->GetStats("http://httpbin.org:80");
+   EXPECT_EQ(4u, oStats.usWaiting);
+   EXPECT_EQ(1u, oStats.ullShed);
+
+   RunLoop();
+   EXPECT_EQ(4u, usCompleted);
+   EXPECT_GE(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(400));
+
+   oStats = pLimiter->GetStats("http://httpbin.org:80");
+   EXPECT_EQ(0u, oStats.usInFlight);
+   EXPECT_EQ(0u, oStats.usWaiting);
+   EXPECT_EQ(2u, pLimiter->GetLimit("http://httpbin.org:80"));
+
+   // a cancelled request gives its place back
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   CppHTTPAsyncClient::Request oRequest;
+   oRequest.strUrl = "http://httpbin.org/delay/1";
+   oRequest.pCancelToken = pToken;
+   ASSERT_TRUE(m_pAsyncClient->Submit(oRequest, nullptr));
+   m_pAsyncClient->Poll(50);
+   pToken->Cancel();
+   RunLoop();
+   EXPECT_EQ(0u, pLimiter->GetStats("http://httpbin.org:80").usInFlight);
+}
+
+TEST_F(AsyncClientTest, TestAsyncRetryAfter)
+{
+   std::atomic<int> iRequests(0);
+   StubServer oServer([&iRequests](const std::string &) {
+      return StubServer::Reply((++iRequests == 1) ? 429 : 200, "Retry-After: 1\r\n");
+   });
+   std::string strThrottled;
+   m_pAsyncClient->SetThrottleFnCallback([&strThrottled](const std::string &strHost, const long lPauseMs) {
+      EXPECT_EQ(1000, lPauseMs);
+      strThrottled = strHost;
+   });
+
+   // the 429 pauses the origin, the requests queued meanwhile wait for 1 s
+   std::vector<std::chrono::steady_clock::time_point> vecCompleted;
+   auto oCompletion = [&vecCompleted](const bool bSuccess, CppHTTPClient::HttpResponse &) {
+      EXPECT_TRUE(bSuccess);
+      vecCompleted.push_back(std::chrono::steady_clock::now());
+   };
+   ASSERT_TRUE(m_pAsyncClient->Get(oServer.Url("/get"), m_mapHeader, oCompletion));
+   while (vecCompleted.empty() && m_pAsyncClient->Poll(100) > 0)
+   {
+   }
+   ASSERT_EQ(1u, vecCompleted.size());
+   EXPECT_EQ(oServer.Origin(), strThrottled);
+
+   auto tpStart = std::chrono::steady_clock::now();
+   ASSERT_TRUE(m_pAsyncClient->Get(oServer.Url("/get"), m_mapHeader, oCompletion));
+   ASSERT_TRUE(m_pAsyncClient->Get(oServer.Url("/get"), m_mapHeader, oCompletion));
+   // other origins aren't paused
+   bool bOther = false;
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader,
+                                   [&bOther, &vecCompleted](const bool bSuccess, CppHTTPClient::HttpResponse &) {
+                                      EXPECT_EQ(1u, vecCompleted.size());
+                                      bOther = bSuccess;
+                                   }));
+   RunLoop();
+   EXPECT_TRUE(bOther);
+   ASSERT_EQ(3u, vecCompleted.size());
+   EXPECT_GE(vecCompleted[1] - tpStart, std::chrono::milliseconds(900));
+
+   CppHTTPAsyncClient::ThrottleStats oStats = m_pAsyncClient->GetThrottleStats(oServer.Origin());
+   EXPECT_EQ(1u, oStats.ullThrottled);
+   EXPECT_EQ(2u, oStats.ullPaced);
+   EXPECT_EQ(1000u, oStats.ullPausedMs);
+
+   // ignored when disabled
+   m_pAsyncClient->SetMaxRetryAfter(0);
+   iRequests = 0;
+   ASSERT_TRUE(m_pAsyncClient->Get(oServer.Url("/get"), m_mapHeader, oCompletion));
+   ASSERT_TRUE(m_pAsyncClient->Get(oServer.Url("/get"), m_mapHeader, oCompletion));
+   tpStart = std::chrono::steady_clock::now();
+   RunLoop();
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(500));
+   EXPECT_EQ(1u, m_pAsyncClient->GetThrottleStats(oServer.Origin()).ullThrottled);
+}
+
+TEST_F(AsyncClientTest, TestAsyncNegativeCache)
+{
+   auto pCache = std::make_shared<CppHTTPNegativeCache>();
+   m_pAsyncClient->SetNegativeCache(pCache);
+
+   std::vector<std::string> vecErrors;
+   auto oCompletion = [&vecErrors](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+      EXPECT_FALSE(bSuccess);
+      EXPECT_EQ(CppHTTPClient::ERR_CURL, Response.eError);
+      vecErrors.push_back(Response.strError);
+   };
+   ASSERT_TRUE(m_pAsyncClient->Get("http://127.0.0.1:1/get", m_mapHeader, oCompletion));
+   RunLoop();
+
+   // the next requests to the refused origin fail when dispatched, the others are sent
+   ASSERT_TRUE(m_pAsyncClient->Get("http://127.0.0.1:1/get", m_mapHeader, oCompletion));
+   ASSERT_TRUE(m_pAsyncClient->Get("http://127.0.0.1:1/status/200", m_mapHeader, oCompletion));
+   bool bOther = false;
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader,
+                                   [&bOther](const bool bSuccess, CppHTTPClient::HttpResponse &) { bOther = bSuccess; }));
+   RunLoop();
+
+   EXPECT_TRUE(bOther);
+   ASSERT_EQ(3u, vecErrors.size());
+   EXPECT_EQ(std::string::npos, vecErrors[0].find("(cached)"));
+   EXPECT_NE(std::string::npos, vecErrors[1].find("(cached)"));
+   EXPECT_NE(std::string::npos, vecErrors[2].find("(cached)"));
+   EXPECT_EQ(2u, pCache->GetStats().ullHits);
+   EXPECT_EQ(1u, pCache->GetStats().ullCached);
+}
+
+TEST_F(AsyncClientTest, TestAsyncRateLimiter)
+{
+   auto pLimiter = std::make_shared<CppHTTPRateLimiter>();
+   ASSERT_TRUE(pLimiter->AddRule("http://httpbin.org/get", CppHTTPRateLimiter::Rule(10., 1, 250)));
+   m_pAsyncClient->SetRateLimiter(pLimiter);
+
+   // tokens at 0, 100 and 200 ms, the 4th one would come after the longest delay
+   std::vector<std::chrono::steady_clock::time_point> vecCompleted;
+   auto oCompletion = [&vecCompleted](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+      EXPECT_TRUE(bSuccess);
+      EXPECT_EQ(200, Response.iCode);
+      vecCompleted.push_back(std::chrono::steady_clock::now());
+   };
+   auto tpStart = std::chrono::steady_clock::now();
+   for (int i = 0; i < 3; ++i)
+      ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/get", m_mapHeader, oCompletion));
+   EXPECT_FALSE(m_pAsyncClient->Get("http://httpbin.org/get?id=4", m_mapHeader, oCompletion));
+
+   // the paced requests don't hold back the others
+   bool bOther = false;
+   ASSERT_TRUE(m_pAsyncClient->Get("http://httpbin.org/status/204", m_mapHeader,
+                                   [&bOther, &vecCompleted](const bool bSuccess, CppHTTPClient::HttpResponse &) {
+                                      EXPECT_TRUE(vecCompleted.size() < 3);
+                                      bOther = bSuccess;
+                                   }));
+
+   RunLoop();
+   EXPECT_TRUE(bOther);
+   ASSERT_EQ(3u, vecCompleted.size());
+   EXPECT_GE(vecCompleted[2] - tpStart, std::chrono::milliseconds(200));
+
+   CppHTTPRateLimiter::RuleStats oStats = pLimiter->GetStats("http://httpbin.org/get");
+   EXPECT_EQ(3u, oStats.ullAdmitted);
+   EXPECT_EQ(2u, oStats.ullDelayed);
+   EXPECT_EQ(1u, oStats.ullRejected);
+   EXPECT_EQ(1u, m_pAsyncClient->GetAdmissionStats().ullRejected);
+
+   // the URLs without a scheme match the rules, a request cancelled in the queue gives its token back
+   pLimiter = std::make_shared<CppHTTPRateLimiter>();
+   ASSERT_TRUE(pLimiter->AddRule("http://httpbin.org", CppHTTPRateLimiter::Rule(1., 1, 2000)));
+   m_pAsyncClient->SetRateLimiter(pLimiter);
+   ASSERT_TRUE(m_pAsyncClient->Get("httpbin.org/get", m_mapHeader, oCompletion));
+   auto pToken = std::make_shared<CppHTTPCancelToken>();
+   CppHTTPAsyncClient::Request oRequest;
+   oRequest.strUrl = "httpbin.org/get?id=2";
+   oRequest.pCancelToken = pToken;
+   bool bCancelled = false;
+   ASSERT_TRUE(m_pAsyncClient->Submit(oRequest, [&bCancelled](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+      bCancelled = !bSuccess && Response.eError == CppHTTPClient::ERR_CANCELLED;
+   }));
+   m_pAsyncClient->ScheduleTimer(100, [pToken]() { pToken->Cancel(); });
+   tpStart = std::chrono::steady_clock::now();
+   RunLoop();
+   EXPECT_TRUE(bCancelled);
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(900));
+
+   oStats = pLimiter->GetStats("http://httpbin.org");
+   EXPECT_EQ(2u, oStats.ullAdmitted);
+   EXPECT_EQ(1u, oStats.ullRefunded);
+   CppHTTPRateLimiter::TimePoint tpReady;
+   ASSERT_TRUE(pLimiter->Reserve("http://httpbin.org/get", tpReady));
+   EXPECT_LE(tpReady, tpStart + std::chrono::milliseconds(1100));
+}
+
+TEST(HTTPLoadBalancer, TestStrategies)
+{
+   CppHTTPLoadBalancer oBalancer;
+   std::string strResolved;
+   std::string strEndpoint;
+   EXPECT_FALSE(oBalancer.Resolve("http://rr/get", strResolved, strEndpoint));
+   EXPECT_FALSE(oBalancer.Resolve("lb://rr/get", strResolved, strEndpoint));
+
+   // round robin
+   oBalancer.SetService("rr", {"http://a:8080/", "http://b:8080", "http://a:8080"});
+   EXPECT_EQ(2u, oBalancer.GetEndpoints("rr").size());
+   ASSERT_TRUE(oBalancer.Resolve("LB://rr/v1/users?id=1", strResolved, strEndpoint));
+   EXPECT_EQ("http://a:8080/v1/users?id=1", strResolved);
+   EXPECT_EQ("http://a:8080", strEndpoint);
+   ASSERT_TRUE(oBalancer.Resolve("lb://rr", strResolved, strEndpoint));
+   EXPECT_EQ("http://b:8080", strResolved);
+   ASSERT_TRUE(oBalancer.Resolve("lb://rr?q", strResolved, strEndpoint));
+   EXPECT_EQ("http://a:8080?q", strResolved);
+   EXPECT_EQ(2u, oBalancer.GetStats("http://a:8080").usOutstanding);
+   oBalancer.Release("http://a:8080", 1000, true);
+   oBalancer.Release("http://a:8080");
+   oBalancer.Release("http://b:8080", 1000, false);
+   EXPECT_EQ(0u, oBalancer.GetStats("http://a:8080").usOutstanding);
+   EXPECT_EQ(1u, oBalancer.GetStats("http://a:8080").ullRequests);
+   EXPECT_EQ(1u, oBalancer.GetStats("http://b:8080").ullFailures);
+
+   // power of two choices: the least outstanding of the two endpoints
+   oBalancer.SetService("p2c", {"http://a:8080", "http://b:8080"}, CppHTTPLoadBalancer::LB_P2C);
+   std::map<std::string, int> mapPicked;
+   for (int i = 0; i < 10; ++i)
+   {
+      ASSERT_TRUE(oBalancer.Resolve("lb://p2c/", strResolved, strEndpoint));
+      ++mapPicked[strEndpoint];
+   }
+   EXPECT_EQ(5, mapPicked["http://a:8080"]);
+   EXPECT_EQ(5, mapPicked["http://b:8080"]);
+   for (const auto &prPicked : mapPicked)
+      for (int i = 0; i < prPicked.second; ++i)
+         oBalancer.Release(prPicked.first);
+
+   // EWMA: the slow endpoint gets the requests once the fast one is loaded enough
+   oBalancer.SetService("ewma", {"http://slow:8080", "http://fast:8080"}, CppHTTPLoadBalancer::LB_EWMA);
+   ASSERT_TRUE(oBalancer.Resolve("lb://ewma/", strResolved, strEndpoint));
+   oBalancer.Release("http://slow:8080", 45000, true);
+   oBalancer.Release("http://fast:8080", 10000, true);
+   EXPECT_DOUBLE_EQ(45., oBalancer.GetStats("http://slow:8080").dEwmaMs);
+   mapPicked.clear();
+   for (int i = 0; i < 5; ++i)
+   {
+      ASSERT_TRUE(oBalancer.Resolve("lb://ewma/", strResolved, strEndpoint));
+      ++mapPicked[strEndpoint];
+   }
+   EXPECT_EQ(4, mapPicked["http://fast:8080"]);
+   EXPECT_EQ(1, mapPicked["http://slow:8080"]);
+
+   // a failure counts as the penalty
+   oBalancer.Release("http://fast:8080", 1000, false);
+   EXPECT_DOUBLE_EQ(1000., oBalancer.GetStats("http://fast:8080").dEwmaMs);
+
+   // the endpoints of a removed service are forgotten once idle
+   oBalancer.RemoveService("ewma");
+   EXPECT_EQ(4u, oBalancer.GetEndpointCount());
+   for (int i = 0; i < 3; ++i)
+      oBalancer.Release("http://fast:8080");
+   oBalancer.Release("http://slow:8080");
+   oBalancer.RemoveService("p2c");
+   EXPECT_EQ(2u, oBalancer.GetEndpointCount());
+}
+
+TEST(HTTPLoadBalancer, TestOutlierEjection)
+{
+   CppHTTPLoadBalancer oBalancer;
+   CppHTTPLoadBalancer::OutlierPolicy oPolicy;
+   oPolicy.usMinRequests = 3;
+   oPolicy.iBaseEjectionMs = 50;
+   oPolicy.iMaxEjectionMs = 400;
+   oBalancer.SetOutlierPolicy(oPolicy);
+   oBalancer.SetService("errors", {"http://a:8080", "http://b:8080"});
+   std::string strResolved;
+   std::string strEndpoint;
+
+   // error rate: the failing endpoint is ejected once judged on 3 requests
+   oBalancer.Release("http://a:8080", 1000, false);
+   oBalancer.Release("http://a:8080", 1000, false);
+   EXPECT_FALSE(oBalancer.GetStats("http://a:8080").bEjected);
+   oBalancer.Release("http://a:8080", 1000, false);
+   EXPECT_TRUE(oBalancer.GetStats("http://a:8080").bEjected);
+   for (int i = 0; i < 4; ++i)
+   {
+      ASSERT_TRUE(oBalancer.Resolve("lb://errors/", strResolved, strEndpoint));
+      EXPECT_EQ("http://b:8080", strEndpoint);
+      oBalancer.Release(strEndpoint);
+   }
+
+   // at most half of the endpoints are ejected
+   for (int i = 0; i < 5; ++i)
+      oBalancer.Release("http://b:8080", 1000, false);
+   EXPECT_FALSE(oBalancer.GetStats("http://b:8080").bEjected);
+   oBalancer.SetService("errors", {"http://a:8080", "http://b:8080", "http://c:8080", "http://d:8080"});
+
+   // readmitted once the ejection time elapsed, ejected twice as long the next time
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+   for (int i = 0; i < 4; ++i)
+   {
+      ASSERT_TRUE(oBalancer.Resolve("lb://errors/", strResolved, strEndpoint));
+      oBalancer.Release(strEndpoint);
+   }
+   EXPECT_FALSE(oBalancer.GetStats("http://a:8080").bEjected);
+   for (int i = 0; i < 3; ++i)
+      oBalancer.Release("http://a:8080", 1000, false);
+   EXPECT_TRUE(oBalancer.GetStats("http://a:8080").bEjected);
+   EXPECT_EQ(2u, oBalancer.GetStats("http://a:8080").uEjections);
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+   for (int i = 0; i < 4; ++i)
+   {
+      ASSERT_TRUE(oBalancer.Resolve("lb://errors/", strResolved, strEndpoint));
+      EXPECT_NE("http://a:8080", strEndpoint);
+      oBalancer.Release(strEndpoint);
+   }
+
+   // latency: 3 times slower than the median of the others
+   oBalancer.SetService("latency", {"http://x:8080", "http://y:8080", "http://z:8080"});
+   for (int i = 0; i < 3; ++i)
+   {
+      oBalancer.Release("http://x:8080", 10000, true);
+      oBalancer.Release("http://y:8080", 12000, true);
+      oBalancer.Release("http://z:8080", 100000, true);
+   }
+   EXPECT_FALSE(oBalancer.GetStats("http://x:8080").bEjected);
+   EXPECT_FALSE(oBalancer.GetStats("http://y:8080").bEjected);
+   EXPECT_TRUE(oBalancer.GetStats("http://z:8080").bEjected);
+
+   // with the health checks, the readmission waits for a successful probe
+   oBalancer.SetActiveHealthChecks(true);
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+   for (int i = 0; i < 3; ++i)
+   {
+      ASSERT_TRUE(oBalancer.Resolve("lb://latency/", strResolved, strEndpoint));
+      EXPECT_NE("http://z:8080", strEndpoint);
+      oBalancer.Release(strEndpoint);
+   }
+   oBalancer.ReportProbe("http://z:8080", true);
+   EXPECT_FALSE(oBalancer.GetStats("http://z:8080").bEjected);
+
+   // disabling the detection readmits the endpoints
+   oPolicy.bEnabled = false;
+   oBalancer.SetOutlierPolicy(oPolicy);
+   EXPECT_FALSE(oBalancer.GetStats("http://a:8080").bEjected);
+}
+
+TEST(HTTPLoadBalancer, TestConfigReload)
+{
+   const std::string strPath = "test_services.json";
+   {
+      std::ofstream oFile(strPath);
+      oFile << R"({ "users": { "strategy": "p2c", "endpoints": ["http://a:8080", "http://b:8080"] } })";
+   }
+
+   CppHTTPLoadBalancer oBalancer;
+   ASSERT_TRUE(oBalancer.SetConfigFile(strPath, 10));
+   EXPECT_EQ(2u, oBalancer.GetEndpoints("users").size());
+
+   std::string strResolved;
+   std::string strEndpoint;
+   ASSERT_TRUE(oBalancer.Resolve("lb://users/get", strResolved, strEndpoint));
+   oBalancer.Release(strEndpoint, 5000, true);
+
+   // the changed file replaces the services, the statistics of the endpoints kept are preserved
+   {
+      std::ofstream oFile(strPath);
+      oFile << R"({ "orders": { "endpoints": ["http://c:8080"] }, "users": { "endpoints": [")" << strEndpoint
+            << R"("] } })";
+   }
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   ASSERT_TRUE(oBalancer.Resolve("lb://orders/get", strResolved, strEndpoint));
+   EXPECT_EQ("http://c:8080/get", strResolved);
+   EXPECT_EQ(1u, oBalancer.GetEndpoints("users").size());
+   EXPECT_EQ(1u, oBalancer.GetStats(oBalancer.GetEndpoints("users")[0]).ullRequests);
+   EXPECT_EQ(2u, oBalancer.GetEndpointCount());
+
+   // an invalid file keeps the services
+   {
+      std::ofstream oFile(strPath);
+      oFile << R"({ "users": { "endpoints": "http://a:8080" } })";
+   }
+   EXPECT_FALSE(oBalancer.Reload());
+   EXPECT_EQ(1u, oBalancer.GetEndpoints("orders").size());
+
+   std::remove(strPath.c_str());
+}
+
+TEST(HTTPConcurrencyLimiter, TestAimd)
+{
+   CppHTTPConcurrencyLimiter::Policy oPolicy;
+   oPolicy.usInitialLimit = 4;
+   oPolicy.usMaxLimit = 5;
+   oPolicy.iDropLatencyMs = 100;
+   CppHTTPConcurrencyLimiter oLimiter(oPolicy);
+   const std::string strHost = "http://replica:80";
+
+   // 4 in flight, 4 waiting, then shed
+   for (int i = 0; i < 8; ++i)
+      ASSERT_TRUE(oLimiter.Admit(strHost));
+   EXPECT_FALSE(oLimiter.Admit(strHost));
+   for (int i = 0; i < 4; ++i)
+   {
+      ASSERT_TRUE(oLimiter.HasCapacity(strHost));
+      oLimiter.Acquire(strHost);
+   }
+   EXPECT_FALSE(oLimiter.HasCapacity(strHost));
+
+   // additive increase while used, up to the maximum
+   oLimiter.OnComplete(strHost, 10000, false);
+   EXPECT_EQ(5u, oLimiter.GetLimit(strHost));
+   oLimiter.Acquire(strHost);
+   oLimiter.Acquire(strHost);
+   oLimiter.OnComplete(strHost, 10000, false);
+   EXPECT_EQ(5u, oLimiter.GetLimit(strHost));
+
+   // multiplicative decrease on drops, a slow response included
+   oLimiter.OnComplete(strHost, 10000, true);
+   EXPECT_EQ(4u, oLimiter.GetLimit(strHost));
+   oLimiter.OnComplete(strHost, 200000, false);
+   EXPECT_EQ(4u, oLimiter.GetLimit(strHost));
+   EXPECT_NEAR(4.05, oLimiter.GetStats(strHost).dLimit, 1e-9);
+
+   oLimiter.Acquire(strHost);
+   oLimiter.Release(strHost);
+   oLimiter.Withdraw(strHost);
+   CppHTTPConcurrencyLimiter::HostStats oStats = oLimiter.GetStats(strHost);
+   EXPECT_EQ(2u, oStats.usInFlight);
+   EXPECT_EQ(0u, oStats.usWaiting);
+   EXPECT_EQ(1u, oStats.ullShed);
+}
+
+TEST(HTTPConcurrencyLimiter, TestGradient)
+{
+   CppHTTPConcurrencyLimiter::Policy oPolicy;
+   oPolicy.eAlgorithm = CppHTTPConcurrencyLimiter::LIMIT_GRADIENT;
+   oPolicy.usInitialLimit = 10;
+   oPolicy.usMaxLimit = 100;
+   oPolicy.usLongWindow = 100;
+   CppHTTPConcurrencyLimiter oLimiter(oPolicy);
+   const std::string strHost = "http://replica:80";
+
+   // a stable latency with the limit in use: the limit grows
+   auto Complete = [&](const unsigned long long ullLatencyUs) {
+      while (oLimiter.GetStats(strHost).usInFlight < oLimiter.GetLimit(strHost))
+      {
+         oLimiter.Admit(strHost);
+         oLimiter.Acquire(strHost);
+      }
+      oLimiter.OnComplete(strHost, ullLatencyUs, false);
+   };
+   for (int i = 0; i < 50; ++i)
+      Complete(10000);
+   const size_t usGrown = oLimiter.GetLimit(strHost);
+   EXPECT_GT(usGrown, 30u);
+
+   // the latency rises: the limit falls before any failure
+   for (int i = 0; i < 20; ++i)
+      Complete(50000);
+   EXPECT_LT(oLimiter.GetLimit(strHost), usGrown / 2);
+   EXPECT_GT(oLimiter.GetStats(strHost).dShortRttMs, 2. * oLimiter.GetStats(strHost).dLongRttMs);
+}
+
+TEST(HTTPClient, TestRetryAfter)
+{
+   CppHTTPClient::HeadersMap mapHeaders;
+   EXPECT_EQ(-1, CppHTTPClient::GetRetryAfterMs(429, mapHeaders));
+   mapHeaders["retry-after"] = "3";
+   EXPECT_EQ(3000, CppHTTPClient::GetRetryAfterMs(429, mapHeaders));
+   EXPECT_EQ(3000, CppHTTPClient::GetRetryAfterMs(503, mapHeaders));
+   EXPECT_EQ(-1, CppHTTPClient::GetRetryAfterMs(500, mapHeaders));
+   EXPECT_EQ(-1, CppHTTPClient::GetRetryAfterMs(200, mapHeaders));
+   mapHeaders["retry-after"] = "99999999999";
+   EXPECT_EQ(86400000, CppHTTPClient::GetRetryAfterMs(429, mapHeaders));
+   mapHeaders["retry-after"] = "soon";
+   EXPECT_EQ(-1, CppHTTPClient::GetRetryAfterMs(429, mapHeaders));
+
+   // HTTP dates, a past one is no pause
+   char szDate[64];
+   time_t tDate = time(nullptr) + 10;
+   strftime(szDate, sizeof(szDate), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&tDate));
+   mapHeaders.clear();
+   mapHeaders["Retry-After"] = szDate;
+   EXPECT_NEAR(10000, CppHTTPClient::GetRetryAfterMs(503, mapHeaders), 1500);
+   mapHeaders["Retry-After"] = "Wed, 21 Oct 2015 07:28:00 GMT";
+   EXPECT_EQ(0, CppHTTPClient::GetRetryAfterMs(503, mapHeaders));
+}
+
+TEST(HTTPNegativeCache, TestTtl)
+{
+   CppHTTPNegativeCache::Policy oPolicy;
+   oPolicy.iDnsTtlMs = 400;
+   oPolicy.iConnectTtlMs = 200;
+   oPolicy.dJitter = 0.25;
+   oPolicy.usMaxHosts = 2;
+   CppHTTPNegativeCache oCache(oPolicy);
+   CURLcode eCached = CURLE_OK;
+
+   // only DNS failures and refused connections are cached
+   oCache.OnResult("http://a:80", CURLE_OPERATION_TIMEDOUT);
+   EXPECT_FALSE(oCache.Check("http://a:80", eCached));
+   oCache.OnResult("http://a:80", CURLE_COULDNT_CONNECT);
+   oCache.OnResult("http://b:80", CURLE_COULDNT_RESOLVE_HOST);
+   oCache.OnResult("http://c:80", CURLE_COULDNT_RESOLVE_HOST);
+   EXPECT_FALSE(oCache.IsCached("http://c:80"));
+   EXPECT_TRUE(oCache.Check("http://a:80", eCached));
+   EXPECT_EQ(CURLE_COULDNT_CONNECT, eCached);
+   EXPECT_TRUE(oCache.Check("http://b:80", eCached));
+   EXPECT_EQ(CURLE_COULDNT_RESOLVE_HOST, eCached);
+
+   // the jittered TTLs stay within [150, 250] ms and [300, 500] ms
+   std::this_thread::sleep_for(std::chrono::milliseconds(140));
+   EXPECT_TRUE(oCache.IsCached("http://a:80"));
+   std::this_thread::sleep_for(std::chrono::milliseconds(120));
+   EXPECT_FALSE(oCache.IsCached("http://a:80"));
+   EXPECT_TRUE(oCache.IsCached("http://b:80"));
+
+   // a single request re-probes, a success forgets the origin
+   EXPECT_FALSE(oCache.Check("http://a:80", eCached));
+   EXPECT_TRUE(oCache.Check("http://a:80", eCached));
+   oCache.OnResult("http://a:80", CURLE_OK);
+   EXPECT_FALSE(oCache.Check("http://a:80", eCached));
+
+   CppHTTPNegativeCache::Stats oStats = oCache.GetStats();
+   EXPECT_EQ(1u, oStats.usHosts);
+   EXPECT_EQ(3u, oStats.ullHits);
+   EXPECT_EQ(1u, oStats.ullProbes);
+   EXPECT_EQ(2u, oStats.ullCached);
+   oCache.Clear();
+   EXPECT_FALSE(oCache.IsCached("http://b:80"));
+}
+
+TEST(HTTPOAuth2Provider, TestParseTokenResponse)
+{
+   std::string strToken;
+   long lLifetimeMs = 0;
+   EXPECT_TRUE(CppHTTPOAuth2Provider::ParseTokenResponse(
+       "{\"access_token\":\"abc\",\"token_type\":\"bearer\",\"expires_in\":3600}", strToken, lLifetimeMs));
+   EXPECT_EQ("abc", strToken);
+   EXPECT_EQ(3600000, lLifetimeMs);
+   EXPECT_TRUE(CppHTTPOAuth2Provider::ParseTokenResponse("{\"access_token\":\"def\",\"expires_in\":\"60\"}", strToken, lLifetimeMs));
+   EXPECT_EQ("def", strToken);
+   EXPECT_EQ(60000, lLifetimeMs);
+   EXPECT_TRUE(CppHTTPOAuth2Provider::ParseTokenResponse("{\"access_token\":\"ghi\"}", strToken, lLifetimeMs));
+   EXPECT_EQ(-1, lLifetimeMs);
+
+   EXPECT_FALSE(CppHTTPOAuth2Provider::ParseTokenResponse("{\"access_token\":\"abc\",\"token_type\":\"mac\"}", strToken, lLifetimeMs));
+   EXPECT_FALSE(CppHTTPOAuth2Provider::ParseTokenResponse("{\"error\":\"invalid_client\"}", strToken, lLifetimeMs));
+   EXPECT_FALSE(CppHTTPOAuth2Provider::ParseTokenResponse("{\"access_token\":", strToken, lLifetimeMs));
+   EXPECT_EQ("ghi", strToken);
+}
+
+TEST(HTTPRateLimiter, TestTokenBucket)
+{
+   CppHTTPRateLimiter oLimiter;
+   EXPECT_FALSE(oLimiter.AddRule("", CppHTTPRateLimiter::Rule()));
+   EXPECT_FALSE(oLimiter.AddRule("https://api", CppHTTPRateLimiter::Rule(0.)));
+   ASSERT_TRUE(oLimiter.AddRule("https://api", CppHTTPRateLimiter::Rule(1., 3)));
+   ASSERT_TRUE(oLimiter.AddRule("https://api/v1/orders", CppHTTPRateLimiter::Rule(1., 1)));
+   EXPECT_EQ(2u, oLimiter.GetRuleCount());
+
+   // the longest prefix wins, at a path boundary
+   EXPECT_TRUE(oLimiter.TryAcquire("https://api/v1/orders?id=1"));
+   EXPECT_FALSE(oLimiter.TryAcquire("https://api/v1/orders/2"));
+   for (int i = 0; i < 3; ++i)
+      EXPECT_TRUE(oLimiter.TryAcquire("https://api/v1/users"));
+   EXPECT_FALSE(oLimiter.TryAcquire("https://api"));
+   EXPECT_TRUE(oLimiter.TryAcquire("https://apix/v1/users"));
+   EXPECT_EQ(1u, oLimiter.GetStats("https://api/v1/orders").ullRejected);
+   EXPECT_EQ(3u, oLimiter.GetStats("https://api").ullAdmitted);
+
+   // reservations queue up, one interval apart, up to the longest delay
+   CppHTTPRateLimiter oPacer;
+   ASSERT_TRUE(oPacer.AddRule("http://host", CppHTTPRateLimiter::Rule(100., 2, 25)));
+   CppHTTPRateLimiter::TimePoint tpReady;
+   ASSERT_TRUE(oPacer.Reserve("http://other/", tpReady));
+   EXPECT_EQ(CppHTTPRateLimiter::TimePoint(), tpReady);
+   auto tpNow = std::chrono::steady_clock::now();
+   std::vector<CppHTTPRateLimiter::TimePoint> vecReady;
+   while (oPacer.Reserve("http://host/get", tpReady))
+      vecReady.push_back(tpReady);
+   ASSERT_EQ(4u, vecReady.size());
+   EXPECT_LE(vecReady[1], tpNow + std::chrono::milliseconds(5));
+   EXPECT_GE(vecReady[2], tpNow + std::chrono::milliseconds(5));
+   double dIntervalMs = std::chrono::duration<double, std::milli>(vecReady[3] - vecReady[2]).count();
+   EXPECT_NEAR(10., dIntervalMs, 0.5);
+   EXPECT_EQ(2u, oPacer.GetStats("http://host").ullDelayed);
+
+   // a token given back is reserved again, a full bucket has nothing to take back
+   EXPECT_FALSE(oPacer.Reserve("http://host/get", tpReady));
+   oPacer.Refund("http://host/get");
+   ASSERT_TRUE(oPacer.Reserve("http://host/get", tpReady));
+   double dRefundedMs = std::chrono::duration<double, std::milli>(tpReady - vecReady[3]).count();
+   EXPECT_NEAR(0., dRefundedMs, 0.5);
+   oPacer.Refund("http://other/");
+   EXPECT_EQ(1u, oPacer.GetStats("http://host").ullRefunded);
+
+   // concurrent takers never exceed the burst plus the refill
+   CppHTTPRateLimiter oShared;
+   ASSERT_TRUE(oShared.AddRule("http://shared", CppHTTPRateLimiter::Rule(1000., 50)));
+   std::atomic<unsigned> uAdmitted(0);
+   auto tpStart = std::chrono::steady_clock::now();
+   std::vector<std::thread> vecThreads;
+   for (int i = 0; i < 8; ++i)
+      vecThreads.emplace_back([&oShared, &uAdmitted]() {
+         for (int j = 0; j < 20000; ++j)
+            if (oShared.TryAcquire("http://shared/x"))
+               ++uAdmitted;
+      });
+   for (auto &oThread : vecThreads)
+      oThread.join();
+   double dElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+   EXPECT_GE(uAdmitted.load(), 50u);
+   EXPECT_LE(uAdmitted.load(), 50u + static_cast<unsigned>(dElapsedMs) + 1u);
+   EXPECT_EQ(uAdmitted.load(), oShared.GetStats("http://shared").ullAdmitted);
+}
+
+TEST(HTTPCircuitBreaker, TestStates)
+{
+   CppHTTPCircuitBreaker::Policy oPolicy;
+   oPolicy.dFailurePercent = 50.;
+   oPolicy.usMinRequests = 4;
+   oPolicy.iOpenMs = 100;
+   oPolicy.usProbes = 2;
+   CppHTTPCircuitBreaker oBreaker(oPolicy);
+   const std::string strHost = "http://replica:80";
+   unsigned long long ullProbe = 1;
+
+   // below the minimum of requests, or below the failure rate, the circuit stays closed
+   for (int i = 0; i < 3; ++i)
+   {
+      ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe));
+      EXPECT_EQ(0u, ullProbe);
+      oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_FAILURE, ullProbe);
+   }
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_IGNORED, ullProbe);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_CLOSED, oBreaker.GetState(strHost));
+   EXPECT_EQ(3u, oBreaker.GetStats(strHost).usRequests);
+
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbe);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_OPEN, oBreaker.GetState(strHost));
+   EXPECT_FALSE(oBreaker.Allow(strHost, ullProbe));
+
+   // half-open: 2 probes only, a failed probe opens the circuit again
+   std::this_thread::sleep_for(std::chrono::milliseconds(120));
+   unsigned long long ullProbe1 = 0;
+   unsigned long long ullProbe2 = 0;
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe1));
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe2));
+   EXPECT_TRUE(ullProbe1 != 0 && ullProbe1 == ullProbe2);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_HALF_OPEN, oBreaker.GetState(strHost));
+   EXPECT_FALSE(oBreaker.Allow(strHost, ullProbe));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbe1);
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_FAILURE, ullProbe2);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_OPEN, oBreaker.GetState(strHost));
+   EXPECT_EQ(2u, oBreaker.GetStats(strHost).ullOpened);
+
+   // all the probes succeed: the circuit closes with an empty window
+   std::this_thread::sleep_for(std::chrono::milliseconds(120));
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe1));
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe2));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbe1);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_HALF_OPEN, oBreaker.GetState(strHost));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbe2);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_CLOSED, oBreaker.GetState(strHost));
+   EXPECT_EQ(0u, oBreaker.GetStats(strHost).usRequests);
+   EXPECT_EQ(2u, oBreaker.GetStats(strHost).ullRejected);
+}
+
+TEST(HTTPCircuitBreaker, TestStaleProbes)
+{
+   CppHTTPCircuitBreaker::Policy oPolicy;
+   oPolicy.usMinRequests = 1;
+   oPolicy.iOpenMs = 50;
+   oPolicy.usProbes = 2;
+   CppHTTPCircuitBreaker oBreaker(oPolicy);
+   const std::string strHost = "http://replica:80";
+   unsigned long long ullProbe = 0;
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbe));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_FAILURE, ullProbe);
+   ASSERT_EQ(CppHTTPCircuitBreaker::STATE_OPEN, oBreaker.GetState(strHost));
+
+   // probes A and B, A fails and the circuit opens again
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+   unsigned long long ullProbeA = 0;
+   unsigned long long ullProbeB = 0;
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbeA));
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbeB));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_FAILURE, ullProbeA);
+   ASSERT_EQ(CppHTTPCircuitBreaker::STATE_OPEN, oBreaker.GetState(strHost));
+
+   // probe C of the next cycle, the late B is ignored whatever its outcome
+   std::this_thread::sleep_for(std::chrono::milliseconds(60));
+   unsigned long long ullProbeC = 0;
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbeC));
+   EXPECT_NE(ullProbeB, ullProbeC);
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_IGNORED, ullProbeB);
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbeB);
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_IGNORED, ullProbeC);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_HALF_OPEN, oBreaker.GetState(strHost));
+
+   // the slots given back are probed again, the circuit closes once both succeed
+   unsigned long long ullProbeD = 0;
+   unsigned long long ullProbeE = 0;
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbeD));
+   ASSERT_TRUE(oBreaker.Allow(strHost, ullProbeE));
+   EXPECT_FALSE(oBreaker.Allow(strHost, ullProbe));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbeD);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_HALF_OPEN, oBreaker.GetState(strHost));
+   oBreaker.OnResult(strHost, CppHTTPCircuitBreaker::OUTCOME_SUCCESS, ullProbeE);
+   EXPECT_EQ(CppHTTPCircuitBreaker::STATE_CLOSED, oBreaker.GetState(strHost));
+}
+
+TEST(HTTPSingleFlight, TestKey)
+{
+   CppHTTPClient::HeadersMap mapHeaders;
+   mapHeaders.emplace("Authorization", "Bearer a");
+   mapHeaders.emplace("X-Request-Id", "1");
+   CppHTTPClient::HeadersMap mapOther = mapHeaders;
+   mapOther["X-Request-Id"] = "2";
+
+   // all the headers by default
+   CppHTTPSingleFlight oAll;
+   EXPECT_NE(oAll.MakeKey("GET", "http://httpbin.org/get", mapHeaders),
+             oAll.MakeKey("GET", "http://httpbin.org/get", mapOther));
+
+   // the selected headers only, names case-insensitive
+   CppHTTPSingleFlight oSelected({"authorization"});
+   EXPECT_EQ(oSelected.MakeKey("GET", "http://httpbin.org/get", mapHeaders),
+             oSelected.MakeKey("GET", "http://httpbin.org/get", mapOther));
+   mapOther["Authorization"] = "Bearer b";
+   EXPECT_NE(oSelected.MakeKey("GET", "http://httpbin.org/get", mapHeaders),
+             oSelected.MakeKey("GET", "http://httpbin.org/get", mapOther));
+   EXPECT_NE(oSelected.MakeKey("GET", "http://httpbin.org/get", mapHeaders),
+             oSelected.MakeKey("HEAD", "http://httpbin.org/get", mapHeaders));
+}
+
+TEST(HTTPSingleFlight, TestCoalescing)
+{
+   const size_t usThreads = 8;
+   auto pSingleFlight = std::make_shared<CppHTTPSingleFlight>(std::vector<std::string>{"Accept"});
+   std::vector<CppHTTPClient::SharedResponse> vecResponses(usThreads);
+   std::vector<bool> vecSuccess(usThreads, false);
+   std::atomic<size_t> usReady(0);
+
+   std::vector<std::thread> vecThreads;
+   for (size_t i = 0; i < usThreads; ++i)
+   {
+      vecThreads.emplace_back([&, i]() {
+         CppHTTPClient oClient(PRINT_LOG);
+         oClient.SetSingleFlight(pSingleFlight);
+         oClient.InitSession();
+         CppHTTPClient::HeadersMap mapHeaders;
+         mapHeaders.emplace("X-Caller", std::to_string(i)); // not part of the key
+
+         ++usReady;
+         while (usReady < usThreads)
+            std::this_thread::yield();
+         vecSuccess[i] = oClient.Get("http://httpbin.org/delay/0.5", mapHeaders, vecResponses[i]);
+         oClient.CleanupSession();
+      });
+   }
+   for (auto &Thread : vecThreads)
+      Thread.join();
+
+   CppHTTPSingleFlight::Stats oStats = pSingleFlight->GetStats();
+   EXPECT_EQ(usThreads, oStats.ullRequests);
+   EXPECT_LT(oStats.ullTransfers, usThreads);
+   EXPECT_EQ(usThreads, oStats.ullTransfers + oStats.ullCoalesced);
+   EXPECT_EQ(0u, oStats.usInFlight);
+   EXPECT_GT(oStats.GetCoalescingRatio(), 0.);
+
+   // one response object per transfer
+   std::set<const CppHTTPClient::HttpResponse *> setResponses;
+   for (size_t i = 0; i < usThreads; ++i)
+   {
+      EXPECT_TRUE(vecSuccess[i]);
+      ASSERT_TRUE(vecResponses[i] != nullptr);
+      EXPECT_EQ(200, vecResponses[i]->iCode);
+      setResponses.insert(vecResponses[i].get());
+   }
+   EXPECT_EQ(oStats.ullTransfers, setResponses.size());
+
+   // nothing is cached: a later request performs a new transfer
+   CppHTTPClient oClient(PRINT_LOG);
+   oClient.SetSingleFlight(pSingleFlight);
+   oClient.InitSession();
+   CppHTTPClient::HttpResponse oResponse;
+   EXPECT_TRUE(oClient.Get("http://httpbin.org/get", CppHTTPClient::HeadersMap(), oResponse));
+   EXPECT_EQ(200, oResponse.iCode);
+   EXPECT_EQ(oStats.ullTransfers + 1, pSingleFlight->GetStats().ullTransfers);
+   oClient.CleanupSession();
+}
+
+// hands out the same token, for the clients of different tenants
+class FixedAuthProvider : public CppHTTPAuthProvider
+{
+public:
+   explicit FixedAuthProvider(const std::string &strToken) : m_strToken(strToken) {}
+   const bool GetToken(std::string &strToken) override
+   {
+      strToken = m_strToken;
+      return true;
+   }
+   void Invalidate(const std::string &) override {}
+
+private:
+   const std::string m_strToken;
+};
+
+TEST(HTTPSingleFlight, TestAuthProviders)
+{
+   // answers with the bearer token of the request
+   StubServer oServer([](const std::string &strRequest) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      size_t usAuth = strRequest.find("Authorization: Bearer ");
+      std::string strToken = (usAuth == std::string::npos) ? "none" : strRequest.substr(usAuth + 22, 5);
+      return StubServer::Reply(200, std::string(), strToken);
+   });
+
+   // two clients of tenant A, one of tenant B, one without credentials
+   auto pSingleFlight = std::make_shared<CppHTTPSingleFlight>();
+   auto pTenantA = std::make_shared<FixedAuthProvider>("tok-a");
+   std::vector<std::shared_ptr<CppHTTPAuthProvider>> vecProviders{pTenantA, pTenantA,
+                                                                   std::make_shared<FixedAuthProvider>("tok-b"), nullptr};
+   const size_t usThreads = vecProviders.size();
+   std::vector<CppHTTPClient::SharedResponse> vecResponses(usThreads);
+   std::atomic<size_t> usReady(0);
+
+   std::vector<std::thread> vecThreads;
+   for (size_t i = 0; i < usThreads; ++i)
+   {
+      vecThreads.emplace_back([&, i]() {
+         CppHTTPClient oClient(PRINT_LOG);
+         oClient.SetSingleFlight(pSingleFlight);
+         oClient.SetAuthProvider(vecProviders[i]);
+         oClient.InitSession();
+
+         ++usReady;
+         while (usReady < usThreads)
+            std::this_thread::yield();
+         EXPECT_TRUE(oClient.Get(oServer.Url("/report"), CppHTTPClient::HeadersMap(), vecResponses[i]));
+         oClient.CleanupSession();
+      });
+   }
+   for (auto &Thread : vecThreads)
+      Thread.join();
+
+   // a response is only shared with the clients sending the same credentials
+   const std::vector<std::string> vecExpected{"tok-a", "tok-a", "tok-b", "none"};
+   for (size_t i = 0; i < usThreads; ++i)
+   {
+      ASSERT_TRUE(vecResponses[i] != nullptr);
+      EXPECT_EQ(vecExpected[i], vecResponses[i]->strBody);
+   }
+   EXPECT_NE(vecResponses[2], vecResponses[3]);
+   CppHTTPSingleFlight::Stats oStats = pSingleFlight->GetStats();
+   EXPECT_EQ(usThreads, oStats.ullTransfers + oStats.ullCoalesced);
+   EXPECT_LE(oStats.ullCoalesced, 1u);
+}
+
+// drives the client from an external epoll loop
+TEST(HTTPAsyncClient, TestExternalEventLoop)
+{
+   int iEpoll = epoll_create1(EPOLL_CLOEXEC);
+   ASSERT_NE(-1, iEpoll);
+   long lTimeoutMs = -1;
+
+   CppHTTPAsyncClient AsyncClient(PRINT_LOG);
+   AsyncClient.SetSocketCallback([&](curl_socket_t Socket, int iEvents) {
+      struct epoll_event oEvent;
+      oEvent.events = ((iEvents & CppHTTPAsyncClient::EVENT_IN) ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+                      ((iEvents & CppHTTPAsyncClient::EVENT_OUT) ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+      oEvent.data.fd = Socket;
+      if (iEvents == CppHTTPAsyncClient::EVENT_NONE)
+         epoll_ctl(iEpoll, EPOLL_CTL_DEL, Socket, nullptr);
+      else if (epoll_ctl(iEpoll, EPOLL_CTL_MOD, Socket, &oEvent) != 0)
+         epoll_ctl(iEpoll, EPOLL_CTL_ADD, Socket, &oEvent);
+   });
+   AsyncClient.SetTimerCallback([&](long lMs) { lTimeoutMs = lMs; });
+   ASSERT_TRUE(AsyncClient.InitSession());
+
+   int iCompleted = 0;
+   for (int i = 0; i < 3; ++i)
+      ASSERT_TRUE(AsyncClient.Get("http://httpbin.org/get", CppHTTPClient::HeadersMap(),
+                                  [&](const bool bSuccess, CppHTTPClient::HttpResponse &Response) {
+                                     EXPECT_TRUE(bSuccess);
+                                     EXPECT_EQ(200, Response.iCode);
+                                     ++iCompleted;
+                                  }));
+
+   while (iCompleted < 3)
+   {
+      struct epoll_event arrEvents[16];
+      int iReady = epoll_wait(iEpoll, arrEvents, 16, (lTimeoutMs < 0) ? 1000 : static_cast<int>(lTimeoutMs));
+      ASSERT_GE(iReady, 0);
+      if (iReady == 0)
+      {
+         lTimeoutMs = -1;
+         AsyncClient.OnTimeout();
+      }
+      for (int i = 0; i < iReady; ++i)
+         AsyncClient.OnSocketReady(arrEvents[i].data.fd,
+                                   ((arrEvents[i].events & (EPOLLIN | EPOLLHUP)) ? CppHTTPAsyncClient::EVENT_IN : 0) |
+                                       ((arrEvents[i].events & EPOLLOUT) ? CppHTTPAsyncClient::EVENT_OUT : 0) |
+                                       ((arrEvents[i].events & EPOLLERR) ? CppHTTPAsyncClient::EVENT_ERROR : 0));
+   }
+
+   EXPECT_EQ(0u, AsyncClient.GetPendingCount());
+   EXPECT_TRUE(AsyncClient.CleanupSession());
+   close(iEpoll);
+}
+
+#pragma endregion Async REST Tests
+
 #pragma region REST Wrapper Tests
 
 /// HEAD Tests
@@ -0,0 +1,162 @@
+#include "gtest/gtest.h" // Google Test Framework
+
+#include "httpasioadapter.h"
+
+#include <thread>
+
+#define PRINT_LOG [](const std::string &strLogMsg) { std::cout << strLogMsg << std::endl; }
+
+namespace
+{
+// Fixture for the Asio adapter tests, the io_context is run by a thread of its own
+class AsioAdapterTest : public ::testing::Test
+{
+protected:
+   asio::io_context m_oContext;
+   std::unique_ptr<CppHTTPAsioAdapter> m_pAdapter;
+   CppHTTPClient::HeadersMap m_mapHeader;
+   int m_iPending;
+
+   AsioAdapterTest() : m_iPending(0)
+   {
+      m_mapHeader.emplace("User-Agent", CLIENT_USERAGENT);
+   }
+
+   virtual ~AsioAdapterTest() {}
+
+   virtual void SetUp()
+   {
+      m_pAdapter.reset(new CppHTTPAsioAdapter(m_oContext, PRINT_LOG));
+      m_pAdapter->InitSession();
+   }
+
+   virtual void TearDown()
+   {
+      m_pAdapter->CleanupSession();
+      m_pAdapter.reset();
+   }
+
+   /* runs the io_context until iPending handlers called Complete(), returns the id of
+    * the thread that ran it. The adapter keeps the timer and the idle connections
+    * watched, so run() would not return by itself. */
+   std::thread::id RunContext(const int iPending = 1)
+   {
+      m_iPending = iPending;
+      std::thread Runner([this]() { m_oContext.run(); });
+      std::thread::id idRunner = Runner.get_id();
+      Runner.join();
+      m_oContext.restart();
+      return idRunner;
+   }
+
+   // called by the completion handlers, on the io_context thread
+   void Complete()
+   {
+      if (--m_iPending == 0)
+         m_oContext.stop();
+   }
+};
+
+TEST_F(AsioAdapterTest, TestAsioGET)
+{
+   asio::error_code ecResult = asio::error::fault;
+   CppHTTPClient::HttpResponse oResponse;
+   std::thread::id idHandler;
+   m_pAdapter->async_get("http://httpbin.org/get", m_mapHeader,
+                         [&](asio::error_code ec, CppHTTPClient::HttpResponse Response) {
+                            ecResult = ec;
+                            oResponse = std::move(Response);
+                            idHandler = std::this_thread::get_id();
+                            Complete();
+                         });
+
+   // the handler runs on the io_context thread
+   EXPECT_EQ(RunContext(), idHandler);
+   EXPECT_FALSE(ecResult);
+   EXPECT_EQ(200, oResponse.iCode);
+   EXPECT_FALSE(oResponse.strBody.empty());
+}
+
+TEST_F(AsioAdapterTest, TestAsioPOST)
+{
+   asio::error_code ecResult = asio::error::fault;
+   CppHTTPClient::HttpResponse oResponse;
+   std::thread::id idHandler;
+   m_pAdapter->async_post("http://httpbin.org/post", m_mapHeader, "data",
+                          [&](asio::error_code ec, CppHTTPClient::HttpResponse Response) {
+                             ecResult = ec;
+                             oResponse = std::move(Response);
+                             idHandler = std::this_thread::get_id();
+                             Complete();
+                          });
+
+   EXPECT_EQ(RunContext(), idHandler);
+   EXPECT_FALSE(ecResult);
+   EXPECT_EQ(200, oResponse.iCode);
+   EXPECT_NE(std::string::npos, oResponse.strBody.find("data"));
+}
+
+TEST_F(AsioAdapterTest, TestAsioConcurrentRequests)
+{
+   // one stream_descriptor per connection, watched together
+   const int iCount = 5;
+   int iSucceeded = 0;
+   for (int i = 0; i < iCount; ++i)
+      m_pAdapter->async_get("http://httpbin.org/anything/" + std::to_string(i), m_mapHeader,
+                            [&](asio::error_code ec, CppHTTPClient::HttpResponse Response) {
+                               if (!ec && Response.iCode == 200)
+                                  ++iSucceeded;
+                               Complete();
+                            });
+
+   RunContext(iCount);
+   EXPECT_EQ(iCount, iSucceeded);
+}
+
+// the transfer limit is only enforced through the steady_timer driving cURL's timer
+TEST_F(AsioAdapterTest, TestAsioTimeout)
+{
+   CppHTTPAsyncClient::TimeoutPolicy oTimeouts;
+   oTimeouts.lTotalMs = 200;
+   m_pAdapter->GetClient().SetTimeouts(oTimeouts);
+
+   asio::error_code ecResult;
+   CppHTTPClient::HttpResponse oResponse;
+   m_pAdapter->async_get("http://httpbin.org/delay/2", m_mapHeader,
+                         [&](asio::error_code ec, CppHTTPClient::HttpResponse Response) {
+                            ecResult = ec;
+                            oResponse = std::move(Response);
+                            Complete();
+                         });
+
+   auto tpStart = std::chrono::steady_clock::now();
+   RunContext();
+   EXPECT_LT(std::chrono::steady_clock::now() - tpStart, std::chrono::milliseconds(1500));
+   EXPECT_EQ(CppHTTPAsioAdapter::MakeErrorCode(CppHTTPAsioAdapter::REQUEST_FAILED), ecResult);
+   EXPECT_EQ(CppHTTPClient::ERR_TIMEOUT_FIRST_BYTE, oResponse.eError);
+}
+
+// check for failure
+TEST_F(AsioAdapterTest, TestAsioGETFailureCode)
+{
+   asio::error_code ecResult;
+   CppHTTPClient::HttpResponse oResponse;
+   m_pAdapter->async_get("http://nonexistent", m_mapHeader,
+                         [&](asio::error_code ec, CppHTTPClient::HttpResponse Response) {
+                            ecResult = ec;
+                            oResponse = std::move(Response);
+                            Complete();
+                         });
+
+   RunContext();
+   EXPECT_EQ(CppHTTPAsioAdapter::MakeErrorCode(CppHTTPAsioAdapter::REQUEST_FAILED), ecResult);
+   EXPECT_EQ(-1, oResponse.iCode);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
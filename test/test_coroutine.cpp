@@ -0,0 +1,117 @@
+#include "gtest/gtest.h" // Google Test Framework
+
+#include "document.h" // rapidjson's DOM-style API
+#include "httpcoroutine.h"
+
+#define PRINT_LOG [](const std::string &strLogMsg) { std::cout << strLogMsg << std::endl; }
+
+namespace
+{
+// Fixture for coroutine tests
+class CoroClientTest : public ::testing::Test
+{
+protected:
+   std::unique_ptr<CppHTTPAsyncClient> m_pAsyncClient;
+   std::unique_ptr<CppHTTPCoroClient> m_pCoroClient;
+   CppHTTPClient::HeadersMap m_mapHeader;
+
+   CoroClientTest()
+   {
+      m_mapHeader.emplace("User-Agent", CLIENT_USERAGENT);
+   }
+
+   virtual ~CoroClientTest() {}
+
+   virtual void SetUp()
+   {
+      m_pAsyncClient.reset(new CppHTTPAsyncClient(PRINT_LOG));
+      m_pAsyncClient->InitSession();
+      m_pCoroClient.reset(new CppHTTPCoroClient(*m_pAsyncClient));
+   }
+
+   virtual void TearDown()
+   {
+      m_pCoroClient.reset();
+      m_pAsyncClient->CleanupSession();
+      m_pAsyncClient.reset();
+   }
+};
+
+CppHTTPTask<CppHTTPClient::HttpResponse> FetchOne(CppHTTPCoroClient &oClient, const std::string strUrl,
+                                                  const CppHTTPClient::HeadersMap Headers)
+{
+   co_return co_await oClient.Get(strUrl, Headers);
+}
+
+CppHTTPTask<int> GetThenPost(CppHTTPCoroClient &oClient, const CppHTTPClient::HeadersMap Headers)
+{
+   CppHTTPClient::HttpResponse Response = co_await oClient.Get("http://httpbin.org/get", Headers);
+   if (Response.iCode != 200)
+      co_return Response.iCode;
+
+   Response = co_await oClient.Post("http://httpbin.org/post", Headers, "data");
+   co_return Response.iCode;
+}
+
+CppHTTPTask<std::vector<CppHTTPClient::HttpResponse>> FetchAll(CppHTTPCoroClient &oClient, const int iCount,
+                                                                const CppHTTPClient::HeadersMap Headers)
+{
+   std::vector<CppHTTPTask<CppHTTPClient::HttpResponse>> vecTasks;
+   for (int i = 0; i < iCount; ++i)
+      vecTasks.push_back(FetchOne(oClient, "http://httpbin.org/anything/" + std::to_string(i), Headers));
+
+   co_return co_await WhenAll(std::move(vecTasks));
+}
+
+TEST_F(CoroClientTest, TestCoroGETCode)
+{
+   CppHTTPClient::HttpResponse Response = m_pCoroClient->Run(FetchOne(*m_pCoroClient, "http://httpbin.org/get", m_mapHeader));
+   EXPECT_EQ(200, Response.iCode);
+   EXPECT_FALSE(Response.strBody.empty());
+}
+
+TEST_F(CoroClientTest, TestCoroSequentialRequests)
+{
+   EXPECT_EQ(200, m_pCoroClient->Run(GetThenPost(*m_pCoroClient, m_mapHeader)));
+}
+
+// check for failure
+TEST_F(CoroClientTest, TestCoroGETFailureCode)
+{
+   CppHTTPClient::HttpResponse Response = m_pCoroClient->Run(FetchOne(*m_pCoroClient, "http://nonexistent", m_mapHeader));
+   EXPECT_EQ(-1, Response.iCode);
+   EXPECT_TRUE(Response.strBody.empty());
+}
+
+TEST_F(CoroClientTest, TestCoroWhenAll)
+{
+   const int iCount = 5;
+   std::vector<CppHTTPClient::HttpResponse> vecResponses = m_pCoroClient->Run(FetchAll(*m_pCoroClient, iCount, m_mapHeader));
+   ASSERT_EQ(static_cast<size_t>(iCount), vecResponses.size());
+
+   // results are in the order of the requests
+   for (int i = 0; i < iCount; ++i)
+   {
+      ASSERT_EQ(200, vecResponses[i].iCode);
+
+      rapidjson::Document document;
+      ASSERT_FALSE(document.Parse(vecResponses[i].strBody.c_str()).HasParseError());
+      rapidjson::Value::MemberIterator itTokenUrl = document.FindMember("url");
+      ASSERT_TRUE(itTokenUrl != document.MemberEnd());
+      EXPECT_EQ("https://httpbin.org/anything/" + std::to_string(i), itTokenUrl->value.GetString());
+   }
+}
+
+TEST_F(CoroClientTest, TestCoroWhenAllEmpty)
+{
+   std::vector<CppHTTPClient::HttpResponse> vecResponses = m_pCoroClient->Run(FetchAll(*m_pCoroClient, 0, m_mapHeader));
+   EXPECT_TRUE(vecResponses.empty());
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}